@@ -0,0 +1,57 @@
+#include "utils.h"
+
+using namespace std;
+using namespace msat;
+using namespace msat::benchmarks;
+
+namespace {
+
+/**
+ * Read the full disk of a derived dataset, reporting the time spent in
+ * geolocation and in computing the derived values
+ */
+void read_derived(Run& run, const std::string& name, const char* const* open_options=nullptr)
+{
+    unique_ptr<GDALDataset> ds = open_ro(name, open_options);
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    run.measure([&]{ run.pixels = read_band(rb, GDT_Float32); });
+    run.bytes = stats_value(ds.get(), "BYTES_READ");
+    run.values["derived_time"] = stats_value(ds.get(), "DERIVED_TIME");
+    run.values["geolocation_time"] = stats_value(ds.get(), "GEOLOCATION_TIME");
+}
+
+class Benchmarks : public BenchmarkGroup
+{
+    using BenchmarkGroup::BenchmarkGroup;
+
+    void register_benchmarks() override;
+} bench("derived");
+
+void Benchmarks::register_benchmarks()
+{
+
+// Reflectance of a visible channel
+add("reflectance", [](Run& run) {
+    read_derived(run, xrit_name("VIS006r", "H:MSG2:VIS006r:200807150900"));
+});
+
+// Reflectance of IR 3.9, using IR 10.8 and IR 13.4
+add("reflectance_ir039", [](Run& run) {
+    read_derived(run, xrit_name("IR_039r", "H:MSG2:IR_039r:201001191200"));
+});
+
+// Satellite zenith angle
+add("sat_za", [](Run& run) {
+    const char* options[] = { "MSAT_COMPUTE=sat_za", nullptr };
+    read_derived(run, xrit_name("IR_108", "H:MSG2:IR_108:201001191200"), options);
+});
+
+// Cosine of the solar zenith angle
+add("cos_sol_za", [](Run& run) {
+    const char* options[] = { "MSAT_COMPUTE=cos_sol_za", nullptr };
+    read_derived(run, xrit_name("IR_108", "H:MSG2:IR_108:201001191200"), options);
+});
+
+}
+
+}
@@ -0,0 +1,100 @@
+#include "utils.h"
+#include <msat/hrit/MSG_channel.h>
+#include <cstring>
+#include <cctype>
+
+using namespace std;
+using namespace msat;
+using namespace msat::benchmarks;
+
+namespace {
+
+struct Channel
+{
+    const char* name;
+    int id;
+};
+
+const Channel channels[] = {
+    { "vis006", MSG_SEVIRI_1_5_VIS_0_6 },
+    { "ir108", MSG_SEVIRI_1_5_IR_10_8 },
+};
+
+/// PACKING creation option values, with "none" for the template default
+const char* packings[] = { "none", "SIMPLE", "COMPLEX", "CCSDS", "JPEG", "PNG" };
+
+std::vector<std::string> grib_options(const char* packing)
+{
+    std::vector<std::string> res { "TEMPLATE=msat/wmo" };
+    if (strcmp(packing, "none") != 0)
+        res.push_back(string("PACKING=") + packing);
+    return res;
+}
+
+/**
+ * Run \a f, reporting as skipped the failures of packings that grib_api may
+ * have been built without
+ */
+template<typename F>
+void with_packing(const char* packing, F f)
+{
+    try {
+        f();
+    } catch (BenchmarkSkipped&) {
+        throw;
+    } catch (std::exception& e) {
+        if (strcmp(packing, "CCSDS") == 0 || strcmp(packing, "JPEG") == 0 || strcmp(packing, "PNG") == 0)
+            throw BenchmarkSkipped(string("PACKING=") + packing + " is not supported: " + e.what());
+        throw;
+    }
+}
+
+string lowercase(const char* str)
+{
+    string res(str);
+    for (auto& c: res)
+        c = tolower(c);
+    return res;
+}
+
+class Benchmarks : public BenchmarkGroup
+{
+    using BenchmarkGroup::BenchmarkGroup;
+
+    void register_benchmarks() override;
+} bench("grib");
+
+void Benchmarks::register_benchmarks()
+{
+
+// Encode and decode a full disk with each packing, reporting the size of the
+// result, for a solar and a thermal channel
+for (const char* packing: packings)
+    for (const Channel& channel: channels)
+    {
+        string suffix = lowercase(packing) + "_" + channel.name;
+        int channel_id = channel.id;
+
+        add("encode_" + suffix, [=](Run& run) {
+            with_packing(packing, [&]{ bench_export(run, "MsatGRIB", channel_id, grib_options(packing)); });
+        });
+
+        add("decode_" + suffix, [=](Run& run) {
+            with_packing(packing, [&]{ bench_import(run, "MsatGRIB", channel_id, grib_options(packing)); });
+        });
+    }
+
+// Read the GRIB file of the test data
+add("decode_testdata", [](Run& run) {
+    require_driver("MsatGRIB");
+    string pathname = string(DATA_DIR) + "/MSG_Seviri_1_5_Infrared_9_7_channel_20060426_1945.grb";
+    run.measure([&]{
+        unique_ptr<GDALDataset> ds = open_ro(pathname);
+        run.pixels = read_band(ds->GetRasterBand(1), GDT_Float32);
+    });
+    run.bytes = std::filesystem::file_size(pathname);
+});
+
+}
+
+}
@@ -0,0 +1,127 @@
+#include "benchmark.h"
+#include <config.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+using namespace std;
+using namespace msat::benchmarks;
+
+static void usage(ostream& out, const char* argv0)
+{
+    out << "Usage: " << argv0 << " [options] [pattern...]" << endl
+        << endl
+        << "Run the benchmarks whose names match one of the shell wildcard patterns," << endl
+        << "or all benchmarks, writing their results as JSON." << endl
+        << endl
+        << "Options:" << endl
+        << "  --list            list the benchmarks and exit" << endl
+        << "  --iterations=N    run each benchmark N times (default: 1)" << endl
+        << "  --output=FILE     write results to FILE instead of standard output" << endl
+        << "  --xrit=PATTERN    read xRIT datasets with names like PATTERN, with {channel}" << endl
+        << "                    in place of the channel name, instead of the test data" << endl;
+}
+
+static bool parse_option(const char* arg, const char* name, string& val)
+{
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+        return false;
+    val = arg + len + 1;
+    return true;
+}
+
+int main(int argc, const char* argv[])
+{
+    Options& options = Options::get();
+    bool list = false;
+    string output;
+    vector<string> patterns;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        string val;
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0)
+        {
+            usage(cout, argv[0]);
+            return 0;
+        } else if (strcmp(argv[i], "--list") == 0)
+            list = true;
+        else if (parse_option(argv[i], "--iterations", val))
+        {
+            options.iterations = strtoul(val.c_str(), nullptr, 10);
+            if (options.iterations == 0)
+            {
+                cerr << argv[0] << ": invalid number of iterations " << val << endl;
+                return 2;
+            }
+        }
+        else if (parse_option(argv[i], "--output", val))
+            output = val;
+        else if (parse_option(argv[i], "--xrit", val))
+            options.xrit = val;
+        else if (argv[i][0] == '-')
+        {
+            usage(cerr, argv[0]);
+            return 2;
+        } else
+            patterns.push_back(argv[i]);
+    }
+
+    vector<const Benchmark*> benchmarks = BenchmarkRegistry::get().select(patterns);
+
+    if (list)
+    {
+        for (const auto& bench: benchmarks)
+            cout << bench->name << endl;
+        return 0;
+    }
+
+    char date[32];
+    time_t now = time(nullptr);
+    strftime(date, 32, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    char host[256];
+    if (gethostname(host, 256) != 0)
+        strcpy(host, "unknown");
+
+    ofstream outfile;
+    if (!output.empty())
+    {
+        outfile.open(output);
+        if (!outfile)
+        {
+            cerr << argv[0] << ": cannot write to " << output << endl;
+            return 2;
+        }
+    }
+    ostream& out = output.empty() ? cout : outfile;
+
+    out << "{\"package\": ";
+    write_json_string(out, PACKAGE_STRING);
+    out << ", \"date\": ";
+    write_json_string(out, date);
+    out << ", \"host\": ";
+    write_json_string(out, host);
+    out << ", \"benchmarks\": [";
+
+    bool success = true;
+    for (size_t i = 0; i < benchmarks.size(); ++i)
+    {
+        BenchmarkResult res = run_benchmark(*benchmarks[i]);
+        res.print_summary(cerr);
+        if (!res.error.empty())
+            success = false;
+        out << (i ? ",\n  " : "\n  ");
+        res.to_json(out);
+        out.flush();
+    }
+
+    out << "\n]}" << endl;
+
+    return success ? 0 : 1;
+}
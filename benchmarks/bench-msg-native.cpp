@@ -0,0 +1,62 @@
+#include "benchmark.h"
+#include <msat/msg-native/MSG_native_line.h>
+#include <msat/facts.h>
+#include <vector>
+
+using namespace std;
+using namespace msat;
+using namespace msat::benchmarks;
+
+namespace {
+
+class Benchmarks : public BenchmarkGroup
+{
+    using BenchmarkGroup::BenchmarkGroup;
+
+    void register_benchmarks() override;
+} bench("msg_native");
+
+void Benchmarks::register_benchmarks()
+{
+
+// Unpack the 10 bit samples of all the lines of a full disk channel
+add("unpack", [](Run& run) {
+    const int lines = METEOSAT_IMAGE_NLINES;
+    const long pixels = METEOSAT_IMAGE_NCOLUMNS;
+    // 4 samples are packed in 5 bytes
+    const size_t line_size = pixels * 5 / 4;
+
+    vector<unsigned char> packed(line_size * lines);
+    uint32_t seed = 2463534242u;
+    for (auto& c: packed)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        c = seed & 0xff;
+    }
+
+    vector<unsigned short> samples(pixels);
+    unsigned short* buf = samples.data();
+    long nsample = 0;
+    MSG_native_linedata data;
+    data.datasize = line_size;
+    run.measure([&]{
+        for (int y = 0; y < lines; ++y)
+        {
+            data.data_10bit = packed.data() + y * line_size;
+            data.to_sample(&buf, &nsample);
+        }
+    });
+    // Do not let the destructor free the packed buffer
+    data.data_10bit = nullptr;
+
+    if (nsample != pixels)
+        throw std::runtime_error("unpacked " + to_string(nsample) + " samples instead of " + to_string(pixels));
+    run.bytes = packed.size();
+    run.pixels = (uint64_t)lines * pixels;
+});
+
+}
+
+}
@@ -0,0 +1,62 @@
+#include "utils.h"
+#include <msat/hrit/MSG_channel.h>
+
+using namespace std;
+using namespace msat;
+using namespace msat::benchmarks;
+
+namespace {
+
+struct Variant
+{
+    const char* name;
+    std::vector<std::string> options;
+};
+
+/// Formats and compression settings of the MsatNetCDF writer
+const Variant variants[] = {
+    { "classic", {} },
+    { "nc4", { "FORMAT=NC4" } },
+    { "deflate1", { "COMPRESS=DEFLATE", "ZLEVEL=1" } },
+    { "deflate6_shuffle", { "COMPRESS=DEFLATE", "ZLEVEL=6", "SHUFFLE=YES" } },
+};
+
+class Benchmarks : public BenchmarkGroup
+{
+    using BenchmarkGroup::BenchmarkGroup;
+
+    void register_benchmarks() override;
+} bench("netcdf");
+
+void Benchmarks::register_benchmarks()
+{
+
+// Write and read back a full disk in each format, reporting the size of the
+// result
+for (const Variant& variant: variants)
+{
+    const std::vector<std::string>& options = variant.options;
+
+    add(string("encode_") + variant.name, [&options](Run& run) {
+        bench_export(run, "MsatNetCDF", MSG_SEVIRI_1_5_IR_10_8, options);
+    });
+
+    add(string("decode_") + variant.name, [&options](Run& run) {
+        bench_import(run, "MsatNetCDF", MSG_SEVIRI_1_5_IR_10_8, options);
+    });
+}
+
+// Read the NetCDF file of the test data
+add("decode_testdata", [](Run& run) {
+    require_driver("MsatNetCDF");
+    string pathname = string(DATA_DIR) + "/MSG_Seviri_1_5_Infrared_10_8_channel_20051219_1415.nc";
+    run.measure([&]{
+        unique_ptr<GDALDataset> ds = open_ro(pathname);
+        run.pixels = read_band(ds->GetRasterBand(1), GDT_Float32);
+    });
+    run.bytes = std::filesystem::file_size(pathname);
+});
+
+}
+
+}
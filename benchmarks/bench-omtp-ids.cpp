@@ -0,0 +1,206 @@
+#include "utils.h"
+#include <msat/omtp-ids/OpenMTP-IDS.hh>
+#include <msat/utils/sys.h>
+#include <config.h>
+#include <fstream>
+#include <sstream>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+using namespace msat;
+using namespace msat::benchmarks;
+
+namespace {
+
+/// Size of the synthetic image, about as big as a Meteosat-7 IDS file
+const int no_records = 500;
+const int no_scanlines = 10;
+const int no_pixels = 2500;
+const int padding = 4;
+
+/// Build a synthetic OpenMTP-IDS image, serialized in memory
+string make_image()
+{
+    OpenMTP_IDS img;
+    img.fileheader().no_records(no_records + 1);
+    img.fileheader().record_length(200);
+    img.fileheader().year(2005);
+    img.fileheader().julian_day(117);
+
+    uint32_t seed = 2463534242u;
+    for (int r = 0; r < no_records; ++r)
+    {
+        Record record;
+        record.recordheader().no_scanlines(no_scanlines);
+        for (int l = 0; l < no_scanlines; ++l)
+        {
+            int y = r * no_scanlines + l;
+            ScanLine line;
+            line.lineheader().length(omtp_ids::LINEHEADER_LEN + no_pixels + padding);
+            line.lineheader().line(y + 1);
+            line.lineheader().no_pixels(no_pixels);
+            line.linepixel().reserve(no_pixels);
+            for (int x = 0; x < no_pixels; ++x)
+            {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                line.linepixel().push_back((x / 7 + y / 5 + (seed & 7)) & 0xff);
+            }
+            record.scanline().push_back(line);
+        }
+        img.record().push_back(record);
+    }
+
+    stringstream buf;
+    buf << img;
+    return buf.str();
+}
+
+/// Check that \a img is the image built by make_image
+void check_image(const OpenMTP_IDS& img)
+{
+    if (img.record().size() != (size_t)no_records)
+        throw std::runtime_error("parsed " + to_string(img.record().size()) + " records instead of " + to_string(no_records));
+}
+
+/// Read a big endian 16 bit integer one byte at a time
+int get2(std::istream& is)
+{
+    int hi = is.get();
+    return (hi << 8) | is.get();
+}
+
+/**
+ * Parse with the byte by byte access pattern of the parser before bulk reads:
+ * header fields, pixels and padding of scan lines are read with one get()
+ * each. File and record headers, which are few, use the library parser.
+ */
+void parse_per_byte(std::istream& is, OpenMTP_IDS& img)
+{
+    img = OpenMTP_IDS();
+    is >> img.fileheader();
+    if (!is.good())
+        throw std::runtime_error("failure while reading file header");
+
+    img.record().resize(img.fileheader().no_records() - 1);
+    for (auto& record: img.record())
+    {
+        is >> record.recordheader();
+        record.scanline().resize(record.recordheader().no_scanlines());
+        for (auto& line: record.scanline())
+        {
+            LineHeader& lh = line.lineheader();
+            lh.length(get2(is));
+            lh.line(get2(is));
+            lh.start(get2(is));
+            lh.no_pixels(get2(is));
+            lh.channel_id(get2(is));
+            lh.quality(get2(is));
+            int pad[omtp_ids::PAD];
+            for (int i = 0; i < omtp_ids::PAD; ++i)
+                pad[i] = get2(is);
+            lh.pad(pad);
+
+            line.linepixel().resize(lh.no_pixels());
+            for (auto& p: line.linepixel())
+            {
+                p = is.get();
+                if (!is.good())
+                    throw std::runtime_error("failure while reading line pixel");
+            }
+            for (int i = lh.no_pixels() + omtp_ids::LINEHEADER_LEN; i < lh.length(); ++i)
+                is.get();
+        }
+        if (!is.good())
+            throw std::runtime_error("failure while reading record");
+    }
+}
+
+class Benchmarks : public BenchmarkGroup
+{
+    using BenchmarkGroup::BenchmarkGroup;
+
+    void register_benchmarks() override;
+} bench("omtp_ids");
+
+void Benchmarks::register_benchmarks()
+{
+
+// Baseline: parse a file through a std::ifstream one byte at a time, as the
+// parser did before reading in bulk
+add("parse_per_byte", [](Run& run) {
+    sys::Tempdir td("msat-bench");
+    std::filesystem::path pathname = td.path() / "image.ids";
+    string data = make_image();
+    sys::write_file(pathname, data);
+
+    OpenMTP_IDS img;
+    run.measure([&]{
+        ifstream in(pathname, ios::binary);
+        parse_per_byte(in, img);
+    });
+    check_image(img);
+    run.bytes = data.size();
+    run.pixels = (uint64_t)no_records * no_scanlines * no_pixels;
+});
+
+// Parse a file through a std::ifstream, with bulk reads
+add("parse_stream", [](Run& run) {
+    sys::Tempdir td("msat-bench");
+    std::filesystem::path pathname = td.path() / "image.ids";
+    string data = make_image();
+    sys::write_file(pathname, data);
+
+    OpenMTP_IDS img;
+    run.measure([&]{
+        ifstream in(pathname, ios::binary);
+        in >> img;
+        if (!in.good())
+            throw std::runtime_error(pathname.string() + ": cannot parse file");
+    });
+    check_image(img);
+    run.bytes = data.size();
+    run.pixels = (uint64_t)no_records * no_scanlines * no_pixels;
+});
+
+// Parse a file with OpenMTP_IDS::read, which maps it in memory
+add("parse_file", [](Run& run) {
+    sys::Tempdir td("msat-bench");
+    std::filesystem::path pathname = td.path() / "image.ids";
+    string data = make_image();
+    sys::write_file(pathname, data);
+
+    OpenMTP_IDS img;
+    run.measure([&]{ img.read(pathname.c_str()); });
+    check_image(img);
+    run.bytes = data.size();
+    run.pixels = (uint64_t)no_records * no_scanlines * no_pixels;
+});
+
+#ifdef HAVE_ZLIB
+// Parse a gzipped file with OpenMTP_IDS::read, which decompresses it on the
+// fly
+add("parse_gzip", [](Run& run) {
+    sys::Tempdir td("msat-bench");
+    std::filesystem::path pathname = td.path() / "image.ids.gz";
+    string data = make_image();
+    gzFile out = gzopen(pathname.c_str(), "wb");
+    if (!out || gzwrite(out, data.data(), data.size()) != (int)data.size())
+        throw std::runtime_error(pathname.string() + ": cannot write file");
+    gzclose(out);
+
+    OpenMTP_IDS img;
+    run.measure([&]{ img.read(pathname.c_str()); });
+    check_image(img);
+    run.bytes = data.size();
+    run.pixels = (uint64_t)no_records * no_scanlines * no_pixels;
+    run.values["compressed_size"] = std::filesystem::file_size(pathname);
+});
+#endif
+
+}
+
+}
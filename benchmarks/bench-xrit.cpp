@@ -0,0 +1,95 @@
+#include "utils.h"
+#include <msat/gdal/dataset.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/xrit/dataaccess.h>
+#include <msat/hrit/MSG_header.h>
+
+using namespace std;
+using namespace msat;
+using namespace msat::benchmarks;
+
+namespace {
+
+/// Default xRIT datasets, from the test data
+const char* default_linear = "H:MSG2:IR_108:201001191200";
+const char* default_calibrated = "H:MSG1:IR_039:200611130800";
+
+class Benchmarks : public BenchmarkGroup
+{
+    using BenchmarkGroup::BenchmarkGroup;
+
+    void register_benchmarks() override;
+} bench("xrit");
+
+void Benchmarks::register_benchmarks()
+{
+
+// Scan the segment files and read the headers of an image
+add("open", [](Run& run) {
+    gdal_init();
+    string name = xrit_name("IR_108", default_linear);
+    unique_ptr<GDALDataset> ds;
+    run.measure([&]{ ds = open_ro(name); });
+    run.bytes = stats_value(ds.get(), "BYTES_READ");
+});
+
+// Parse the headers of all the files of an image over and over, as the
+// ingest indexer does with many images
+add("headers", [](Run& run) {
+    xrit::FileAccess fa(xrit_name("IR_108", default_linear));
+    vector<string> files = fa.segmentFiles();
+    files.push_back(fa.prologueFile());
+    files.push_back(fa.epilogueFile());
+    size_t rounds = 20000 / files.size() + 1;
+
+    xrit::DataAccess da;
+    MSG_header header;
+    run.measure([&]{
+        for (size_t i = 0; i < rounds; ++i)
+            for (const auto& file: files)
+                da.read_file(file, header);
+    });
+    double headers = rounds * files.size();
+    run.bytes = da.stats.bytes_read;
+    run.values["headers"] = headers;
+    run.values["headers_per_second"] = headers / run.wall_time;
+});
+
+// Read the full disk as raw counts
+add("read_linear", [](Run& run) {
+    unique_ptr<GDALDataset> ds = open_ro(xrit_name("IR_108", default_linear));
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    double bytes = stats_value(ds.get(), "BYTES_READ");
+    run.measure([&]{ run.pixels = read_band(rb, rb->GetRasterDataType()); });
+    run.bytes = stats_value(ds.get(), "BYTES_READ") - bytes;
+    run.values["segments_decoded"] = stats_value(ds.get(), "SEGMENTS_DECODED");
+});
+
+// Read the full disk as calibrated values
+add("read_calibrated", [](Run& run) {
+    unique_ptr<GDALDataset> ds = open_ro(xrit_name("IR_039", default_calibrated));
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    double bytes = stats_value(ds.get(), "BYTES_READ");
+    run.measure([&]{ run.pixels = read_band(rb, GDT_Float32, true); });
+    run.bytes = stats_value(ds.get(), "BYTES_READ") - bytes;
+    run.values["segments_decoded"] = stats_value(ds.get(), "SEGMENTS_DECODED");
+});
+
+// Crop an area over Europe to an in-memory dataset
+add("crop", [](Run& run) {
+    GDALDriver* mem = require_driver("MEM");
+    unique_ptr<GDALDataset> ds = open_ro(xrit_name("IR_108", default_linear));
+    proj::ImageBox area(proj::ImagePoint(1500, 100), proj::ImagePoint(2500, 450));
+    double bytes = stats_value(ds.get(), "BYTES_READ");
+    run.measure([&]{
+        unique_ptr<GDALDataset> cropped(dataset::recode(ds.get(), area, "", mem));
+        if (!cropped)
+            throw std::runtime_error("cannot crop dataset");
+        run.pixels = (uint64_t)cropped->GetRasterXSize() * cropped->GetRasterYSize();
+    });
+    run.bytes = stats_value(ds.get(), "BYTES_READ") - bytes;
+});
+
+}
+
+}
@@ -0,0 +1,401 @@
+#include "benchmark.h"
+#include <msat/utils/subprocess.h>
+#include <msat/utils/sys.h>
+#include <ostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <system_error>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace msat {
+namespace benchmarks {
+
+namespace {
+
+double cpu_seconds()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+         + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0;
+}
+
+/// Encode a BenchmarkResult to send it from the child process to the parent
+struct Encoder
+{
+    string buf;
+
+    void add(uint64_t val) { buf.append((const char*)&val, sizeof(val)); }
+    void add(double val) { buf.append((const char*)&val, sizeof(val)); }
+    void add(const string& val)
+    {
+        add((uint64_t)val.size());
+        buf.append(val);
+    }
+
+    void add(const BenchmarkResult& res)
+    {
+        add(res.name);
+        add(res.skipped);
+        add(res.error);
+        add(res.peak_rss);
+        add((uint64_t)res.runs.size());
+        for (const auto& run: res.runs)
+        {
+            add(run.wall_time);
+            add(run.cpu_time);
+            add(run.bytes);
+            add(run.pixels);
+            add((uint64_t)run.values.size());
+            for (const auto& val: run.values)
+            {
+                add(val.first);
+                add(val.second);
+            }
+        }
+    }
+};
+
+/// Decode what was written by Encoder
+struct Decoder
+{
+    const string& buf;
+    size_t pos = 0;
+
+    Decoder(const string& buf) : buf(buf) {}
+
+    void get(void* dest, size_t size)
+    {
+        if (pos + size > buf.size())
+            throw runtime_error("benchmark results from child process are truncated");
+        memcpy(dest, buf.data() + pos, size);
+        pos += size;
+    }
+    uint64_t get_uint64() { uint64_t res; get(&res, sizeof(res)); return res; }
+    double get_double() { double res; get(&res, sizeof(res)); return res; }
+    string get_string()
+    {
+        size_t size = get_uint64();
+        string res(size, 0);
+        get(&res[0], size);
+        return res;
+    }
+
+    void get(BenchmarkResult& res)
+    {
+        res.name = get_string();
+        res.skipped = get_string();
+        res.error = get_string();
+        res.peak_rss = get_uint64();
+        res.runs.resize(get_uint64());
+        for (auto& run: res.runs)
+        {
+            run.wall_time = get_double();
+            run.cpu_time = get_double();
+            run.bytes = get_uint64();
+            run.pixels = get_uint64();
+            size_t count = get_uint64();
+            for (size_t i = 0; i < count; ++i)
+            {
+                string key = get_string();
+                run.values[key] = get_double();
+            }
+        }
+    }
+};
+
+/**
+ * Child process running a benchmark, which sends its results to the parent
+ * through a pipe
+ */
+class BenchmarkChild : public subprocess::Child
+{
+protected:
+    const Benchmark& bench;
+    int results[2] = { -1, -1 };
+
+    void pre_fork() override
+    {
+        Child::pre_fork();
+        if (pipe(results) == -1)
+            throw std::system_error(errno, std::system_category(), "failed to create a pipe for benchmark results");
+        pass_fds.push_back(results[1]);
+    }
+
+    void post_fork_parent() override
+    {
+        Child::post_fork_parent();
+        ::close(results[1]);
+        results[1] = -1;
+    }
+
+    void post_fork_child() override
+    {
+        Child::post_fork_child();
+        ::close(results[0]);
+        results[0] = -1;
+    }
+
+    int main() noexcept override
+    {
+        BenchmarkResult res;
+        res.name = bench.name;
+        try {
+            for (unsigned i = 0; i < Options::get().iterations; ++i)
+            {
+                Run run;
+                bench.body(run);
+                res.runs.push_back(run);
+            }
+        } catch (BenchmarkSkipped& e) {
+            res.skipped = e.what();
+            res.runs.clear();
+        } catch (std::exception& e) {
+            res.error = e.what();
+            res.runs.clear();
+        }
+
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        res.peak_rss = (uint64_t)ru.ru_maxrss * 1024;
+
+        Encoder enc;
+        enc.add(res);
+        try {
+            sys::FileDescriptor out(results[1]);
+            out.write_all_or_throw(enc.buf);
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s: cannot send results: %s\n", bench.name.c_str(), e.what());
+            return 1;
+        }
+        return 0;
+    }
+
+public:
+    BenchmarkChild(const Benchmark& bench) : bench(bench)
+    {
+        // Keep stdout for the results of the parent process
+        set_stdout(STDERR_FILENO);
+    }
+
+    ~BenchmarkChild()
+    {
+        if (results[0] != -1) ::close(results[0]);
+        if (results[1] != -1) ::close(results[1]);
+    }
+
+    /// Read all the results sent by the child process
+    string read_results()
+    {
+        string res;
+        char buf[4096];
+        sys::FileDescriptor in(results[0]);
+        while (size_t size = in.read(buf, sizeof(buf)))
+            res.append(buf, size);
+        return res;
+    }
+};
+
+}
+
+Options& Options::get()
+{
+    static Options options;
+    return options;
+}
+
+void Run::measure(std::function<void()> f)
+{
+    auto start = chrono::steady_clock::now();
+    double cpu_start = cpu_seconds();
+    f();
+    cpu_time += cpu_seconds() - cpu_start;
+    wall_time += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void write_json_string(std::ostream& out, const std::string& str)
+{
+    out << '"';
+    for (char c: str)
+    {
+        switch (c)
+        {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, 8, "\\u%04x", (unsigned)c);
+                    out << buf;
+                } else
+                    out << c;
+        }
+    }
+    out << '"';
+}
+
+void BenchmarkResult::to_json(std::ostream& out) const
+{
+    out << "{\"name\": ";
+    write_json_string(out, name);
+    if (!skipped.empty())
+    {
+        out << ", \"skipped\": ";
+        write_json_string(out, skipped);
+        out << "}";
+        return;
+    }
+    if (!error.empty())
+    {
+        out << ", \"error\": ";
+        write_json_string(out, error);
+        out << "}";
+        return;
+    }
+
+    // Times are the average of all runs, and the counters are those of the
+    // last run, as all runs do the same work
+    double wall_time = 0, wall_time_min = runs[0].wall_time, cpu_time = 0;
+    for (const auto& run: runs)
+    {
+        wall_time += run.wall_time;
+        wall_time_min = min(wall_time_min, run.wall_time);
+        cpu_time += run.cpu_time;
+    }
+    wall_time /= runs.size();
+    cpu_time /= runs.size();
+    const Run& last = runs.back();
+
+    out.precision(9);
+    out << ", \"iterations\": " << runs.size()
+        << ", \"wall_time\": " << wall_time
+        << ", \"wall_time_min\": " << wall_time_min
+        << ", \"cpu_time\": " << cpu_time
+        << ", \"peak_rss\": " << peak_rss
+        << ", \"bytes\": " << last.bytes
+        << ", \"pixels\": " << last.pixels
+        << ", \"bytes_per_second\": " << (wall_time > 0 ? last.bytes / wall_time : 0)
+        << ", \"pixels_per_second\": " << (wall_time > 0 ? last.pixels / wall_time : 0)
+        << ", \"values\": {";
+    for (auto i = last.values.begin(); i != last.values.end(); ++i)
+    {
+        if (i != last.values.begin()) out << ", ";
+        write_json_string(out, i->first);
+        out << ": " << i->second;
+    }
+    out << "}}";
+}
+
+void BenchmarkResult::print_summary(std::ostream& out) const
+{
+    char buf[256];
+    if (!skipped.empty())
+    {
+        out << name << ": skipped: " << skipped << endl;
+        return;
+    }
+    if (!error.empty())
+    {
+        out << name << ": failed: " << error << endl;
+        return;
+    }
+
+    double wall_time = 0, cpu_time = 0;
+    for (const auto& run: runs)
+    {
+        wall_time += run.wall_time;
+        cpu_time += run.cpu_time;
+    }
+    wall_time /= runs.size();
+    cpu_time /= runs.size();
+    snprintf(buf, 256, "%.3fs wall, %.3fs cpu, %.1fMiB peak rss",
+            wall_time, cpu_time, peak_rss / 1048576.0);
+    out << name << ": " << buf;
+    if (runs.back().bytes && wall_time > 0)
+    {
+        snprintf(buf, 256, ", %.1fMiB/s", runs.back().bytes / 1048576.0 / wall_time);
+        out << buf;
+    }
+    if (runs.back().pixels && wall_time > 0)
+    {
+        snprintf(buf, 256, ", %.1fMpixel/s", runs.back().pixels / 1000000.0 / wall_time);
+        out << buf;
+    }
+    out << endl;
+}
+
+BenchmarkGroup::BenchmarkGroup(const std::string& name)
+    : name(name)
+{
+    BenchmarkRegistry::get().groups.push_back(this);
+}
+
+void BenchmarkGroup::add(const std::string& name, std::function<void(Run&)> body)
+{
+    benchmarks.push_back(Benchmark{this->name + "/" + name, body});
+}
+
+BenchmarkRegistry& BenchmarkRegistry::get()
+{
+    static BenchmarkRegistry* instance = nullptr;
+    if (!instance)
+        instance = new BenchmarkRegistry;
+    return *instance;
+}
+
+std::vector<const Benchmark*> BenchmarkRegistry::select(const std::vector<std::string>& patterns)
+{
+    std::vector<const Benchmark*> res;
+    for (auto& group: groups)
+    {
+        if (group->benchmarks.empty())
+            group->register_benchmarks();
+        for (const auto& bench: group->benchmarks)
+        {
+            bool selected = patterns.empty();
+            for (const auto& pattern: patterns)
+                if (fnmatch(pattern.c_str(), bench.name.c_str(), 0) == 0)
+                {
+                    selected = true;
+                    break;
+                }
+            if (selected)
+                res.push_back(&bench);
+        }
+    }
+    return res;
+}
+
+BenchmarkResult run_benchmark(const Benchmark& bench)
+{
+    BenchmarkChild child(bench);
+    child.fork();
+    string encoded = child.read_results();
+    child.wait();
+
+    BenchmarkResult res;
+    if (child.raw_returncode() != 0 || encoded.empty())
+    {
+        res.name = bench.name;
+        res.error = "benchmark process " + subprocess::Child::format_raw_returncode(child.raw_returncode());
+        return res;
+    }
+
+    Decoder dec(encoded);
+    dec.get(res);
+    return res;
+}
+
+}
+}
@@ -0,0 +1,150 @@
+#ifndef MSAT_BENCHMARKS_BENCHMARK_H
+#define MSAT_BENCHMARKS_BENCHMARK_H
+
+/**
+ * Infrastructure for end-to-end benchmarks.
+ *
+ * Benchmarks are grouped in static BenchmarkGroup objects, in the same way as
+ * unit tests are grouped in msat::tests::TestCase. Each benchmark runs in its
+ * own child process, so that its peak resident set size is not affected by
+ * the benchmarks that ran before it.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <stdexcept>
+#include <iosfwd>
+#include <cstdint>
+
+namespace msat {
+namespace benchmarks {
+
+/// Thrown by benchmarks that cannot run with this build or input data
+struct BenchmarkSkipped : public std::runtime_error
+{
+    using std::runtime_error::runtime_error;
+};
+
+/// Command line options that benchmarks can use
+struct Options
+{
+    /// Number of times each benchmark is run
+    unsigned iterations = 1;
+
+    /**
+     * Names of xRIT datasets to use instead of the test data, with
+     * {channel} in place of the channel name
+     */
+    std::string xrit;
+
+    static Options& get();
+};
+
+/**
+ * Measurements of one run of a benchmark.
+ *
+ * Only code run via measure() is timed, so that benchmarks can prepare their
+ * input and check their output without affecting the results.
+ */
+struct Run
+{
+    /// Wall clock time spent in measure(), in seconds
+    double wall_time = 0;
+
+    /// CPU time spent in measure() by all threads, in seconds
+    double cpu_time = 0;
+
+    /// Bytes processed by the measured code
+    uint64_t bytes = 0;
+
+    /// Pixels processed by the measured code
+    uint64_t pixels = 0;
+
+    /// Other results worth reporting, like the size of an output file
+    std::map<std::string, double> values;
+
+    /// Run \a f, adding its wall clock and CPU time to this run
+    void measure(std::function<void()> f);
+};
+
+struct Benchmark
+{
+    /// Name of the benchmark, as group/name
+    std::string name;
+
+    std::function<void(Run&)> body;
+};
+
+/// Results of all the runs of a benchmark
+struct BenchmarkResult
+{
+    std::string name;
+
+    /// If the benchmark was skipped, the reason why
+    std::string skipped;
+
+    /// If the benchmark failed, the error message
+    std::string error;
+
+    std::vector<Run> runs;
+
+    /// Peak resident set size of the process that ran the benchmark, in bytes
+    uint64_t peak_rss = 0;
+
+    /// Write the result as a JSON object
+    void to_json(std::ostream& out) const;
+
+    /// Write a one line summary of the result
+    void print_summary(std::ostream& out) const;
+};
+
+/**
+ * Group of related benchmarks.
+ *
+ * Subclasses are instantiated as static objects, and add their benchmarks
+ * in register_benchmarks().
+ */
+class BenchmarkGroup
+{
+public:
+    std::string name;
+    std::vector<Benchmark> benchmarks;
+
+    BenchmarkGroup(const std::string& name);
+    virtual ~BenchmarkGroup() {}
+
+    virtual void register_benchmarks() = 0;
+
+    /// Add a benchmark called group/name
+    void add(const std::string& name, std::function<void(Run&)> body);
+};
+
+class BenchmarkRegistry
+{
+public:
+    std::vector<BenchmarkGroup*> groups;
+
+    static BenchmarkRegistry& get();
+
+    /**
+     * Return the benchmarks whose name matches one of the shell wildcard
+     * \a patterns, or all benchmarks if \a patterns is empty
+     */
+    std::vector<const Benchmark*> select(const std::vector<std::string>& patterns);
+};
+
+/**
+ * Run \a bench Options::iterations times in a child process, and collect its
+ * results
+ */
+BenchmarkResult run_benchmark(const Benchmark& bench);
+
+/// Write \a str as a JSON string
+void write_json_string(std::ostream& out, const std::string& str);
+
+}
+}
+
+#endif
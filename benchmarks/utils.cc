@@ -0,0 +1,221 @@
+#include "utils.h"
+#include <msat/gdal/dataset.h>
+#include <msat/facts.h>
+#include <msat/utils/sys.h>
+#include <cpl_conv.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+namespace msat {
+namespace benchmarks {
+
+namespace {
+
+void throw_on_gdal_failures(CPLErr eErrClass, int err_no, const char *msg)
+{
+    // Warnings are not worth interrupting a benchmark
+    if (eErrClass == CE_Failure || eErrClass == CE_Fatal)
+        throw std::runtime_error(string("GDAL error ") + to_string(err_no) + ": " + msg);
+}
+
+/// Write \a src to \a pathname with \a driver and creation \a options
+void create_copy(GDALDriver* driver, GDALDataset* src, const std::filesystem::path& pathname, const std::vector<std::string>& options)
+{
+    std::vector<const char*> opts;
+    for (const auto& opt: options)
+        opts.push_back(opt.c_str());
+    opts.push_back(nullptr);
+
+    std::unique_ptr<GDALDataset> ds((GDALDataset*)GDALCreateCopy(driver, pathname.c_str(), src, TRUE, (char**)opts.data(), nullptr, nullptr));
+    if (!ds)
+        throw std::runtime_error(pathname.string() + ": cannot create file");
+}
+
+/// Channels whose values are radiances instead of brightness temperatures
+bool is_solar_channel(int channel_id)
+{
+    return channel_id <= 3 || channel_id == 12;
+}
+
+}
+
+void gdal_init()
+{
+    static bool initialized = false;
+    if (initialized) return;
+    GDALAllRegister();
+    CPLSetErrorHandler(throw_on_gdal_failures);
+    initialized = true;
+}
+
+GDALDriver* require_driver(const std::string& name)
+{
+    gdal_init();
+    GDALDriver* driver = GetGDALDriverManager()->GetDriverByName(name.c_str());
+    if (!driver)
+        throw BenchmarkSkipped("driver " + name + " is not available");
+    return driver;
+}
+
+std::unique_ptr<GDALDataset> open_ro(const std::string& name, const char* const* open_options)
+{
+    gdal_init();
+    std::unique_ptr<GDALDataset> res((GDALDataset*)GDALOpenEx(name.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, nullptr, open_options, nullptr));
+    if (!res)
+        throw std::runtime_error(name + ": cannot open dataset");
+    return res;
+}
+
+std::string xrit_name(const std::string& channel, const std::string& default_name)
+{
+    const string& pattern = Options::get().xrit;
+    if (pattern.empty())
+        return string(DATA_DIR) + "/" + default_name;
+
+    string res = pattern;
+    size_t pos = res.find("{channel}");
+    if (pos == string::npos)
+        throw std::runtime_error("xRIT dataset pattern " + pattern + " does not contain {channel}");
+    res.replace(pos, 9, channel);
+    return res;
+}
+
+double stats_value(GDALDataset* ds, const char* name)
+{
+    const char* val = ds->GetMetadataItem(name, MD_DOMAIN_MSAT_STATS);
+    return val ? CPLAtof(val) : 0;
+}
+
+uint64_t read_band(GDALRasterBand* rb, GDALDataType type, bool calibrate)
+{
+    if (calibrate) type = GDT_Float32;
+    const int sx = rb->GetXSize();
+    const int sy = rb->GetYSize();
+    vector<unsigned char> buf((size_t)sx * GDALGetDataTypeSizeBytes(type));
+
+    double scale = 1, offset = 0;
+    if (calibrate)
+    {
+        scale = rb->GetScale();
+        offset = rb->GetOffset();
+    }
+    bool scaled = scale != 1 || offset != 0;
+
+    for (int y = 0; y < sy; ++y)
+    {
+        if (rb->RasterIO(GF_Read, 0, y, sx, 1, buf.data(), sx, 1, type, 0, 0) != CE_None)
+            throw std::runtime_error("cannot read line " + to_string(y));
+        if (scaled)
+        {
+            float* vals = (float*)buf.data();
+            for (int x = 0; x < sx; ++x)
+                vals[x] = vals[x] * scale + offset;
+        }
+    }
+
+    return (uint64_t)sx * sy;
+}
+
+std::unique_ptr<GDALDataset> synthetic_seviri(int channel_id)
+{
+    GDALDriver* mem = require_driver("MEM");
+    const int size = METEOSAT_IMAGE_NCOLUMNS;
+    std::unique_ptr<GDALDataset> ds(mem->Create("", size, size, 1, GDT_Float32, nullptr));
+    if (!ds)
+        throw std::runtime_error("cannot create an in-memory dataset");
+
+    // Georeferenced as the images of MSG2, like the test data
+    const int spacecraft_id = 56;
+    ds->SetProjection(dataset::spaceviewWKT(0).c_str());
+    double gt[6] = {
+        -size / 2 * METEOSAT_PIXELSIZE_X, METEOSAT_PIXELSIZE_X, 0,
+        size / 2 * METEOSAT_PIXELSIZE_Y, 0, -METEOSAT_PIXELSIZE_Y,
+    };
+    ds->SetGeoTransform(gt);
+
+    char buf[25];
+    snprintf(buf, 25, "%d", spacecraft_id);
+    ds->SetMetadataItem(MD_MSAT_SPACECRAFT_ID, buf, MD_DOMAIN_MSAT);
+    ds->SetMetadataItem(MD_MSAT_SPACECRAFT, facts::spacecraftName(spacecraft_id), MD_DOMAIN_MSAT);
+    ds->SetMetadataItem(MD_MSAT_DATETIME, "2010-01-19 12:00:00", MD_DOMAIN_MSAT);
+
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    snprintf(buf, 25, "%d", channel_id);
+    rb->SetMetadataItem(MD_MSAT_CHANNEL_ID, buf, MD_DOMAIN_MSAT);
+    const char* name = facts::channelName(spacecraft_id, channel_id);
+    rb->SetMetadataItem(MD_MSAT_CHANNEL, name, MD_DOMAIN_MSAT);
+    rb->SetDescription(name);
+    rb->SetNoDataValue(0);
+
+    // 10 bit counts, as sent by SEVIRI, from a smooth field with some noise
+    // to give encoders something realistic to compress, scaled to radiances
+    // for solar channels and to brightness temperatures otherwise
+    const double base = is_solar_channel(channel_id) ? 0 : 200;
+    const double range = is_solar_channel(channel_id) ? 30 : 110;
+    std::shared_ptr<const dataset::EarthDisk> disk = dataset::earth_disk(ds.get());
+    uint32_t seed = 2463534242u;
+    vector<float> line(size);
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            if (!disk->is_earth(x, y))
+            {
+                line[x] = 0;
+                continue;
+            }
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            double noise = (seed & 0xffff) / 32768.0 - 1.0;
+            double field = 0.5 + 0.3 * sin(x / 41.0) * cos(y / 67.0)
+                         + 0.15 * sin((x + 2 * y) / 233.0) + 0.04 * noise;
+            int count = max(1, min(1023, (int)lrint(field * 1023)));
+            line[x] = base + range * count / 1023;
+        }
+        if (rb->RasterIO(GF_Write, 0, y, size, 1, line.data(), size, 1, GDT_Float32, 0, 0) != CE_None)
+            throw std::runtime_error("cannot write line " + to_string(y) + " of synthetic image");
+    }
+
+    return ds;
+}
+
+void bench_export(Run& run, const std::string& driver, int channel_id, const std::vector<std::string>& options)
+{
+    GDALDriver* drv = require_driver(driver);
+    std::unique_ptr<GDALDataset> src = synthetic_seviri(channel_id);
+    sys::Tempdir td("msat-bench");
+    std::filesystem::path pathname = td.path() / "image";
+
+    run.measure([&]{ create_copy(drv, src.get(), pathname, options); });
+
+    run.pixels = (uint64_t)src->GetRasterXSize() * src->GetRasterYSize();
+    run.bytes = run.pixels * sizeof(float);
+    uint64_t size = std::filesystem::file_size(pathname);
+    run.values["output_size"] = size;
+    run.values["bits_per_pixel"] = size * 8.0 / run.pixels;
+}
+
+void bench_import(Run& run, const std::string& driver, int channel_id, const std::vector<std::string>& options)
+{
+    GDALDriver* drv = require_driver(driver);
+    sys::Tempdir td("msat-bench");
+    std::filesystem::path pathname = td.path() / "image";
+    {
+        std::unique_ptr<GDALDataset> src = synthetic_seviri(channel_id);
+        create_copy(drv, src.get(), pathname, options);
+    }
+
+    run.measure([&]{
+        std::unique_ptr<GDALDataset> ds = open_ro(pathname.string());
+        run.pixels = read_band(ds->GetRasterBand(1), GDT_Float32);
+    });
+    run.bytes = std::filesystem::file_size(pathname);
+}
+
+}
+}
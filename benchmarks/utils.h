@@ -0,0 +1,67 @@
+#ifndef MSAT_BENCHMARKS_UTILS_H
+#define MSAT_BENCHMARKS_UTILS_H
+
+#include "benchmark.h"
+#include <msat/gdal/const.h>
+#include <gdal/gdal_priv.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace msat {
+namespace benchmarks {
+
+/// Register the GDAL drivers, turning GDAL failures into exceptions
+void gdal_init();
+
+/// Return the GDAL driver \a name, throwing BenchmarkSkipped if it is not available
+GDALDriver* require_driver(const std::string& name);
+
+/// Open a dataset read only, throwing an exception if it cannot be opened
+std::unique_ptr<GDALDataset> open_ro(const std::string& name, const char* const* open_options=nullptr);
+
+/**
+ * Return the name of the xRIT dataset to use for \a channel.
+ *
+ * If Options::xrit is set, it is \a channel substituted in Options::xrit,
+ * else it is \a default_name in the test data directory.
+ */
+std::string xrit_name(const std::string& channel, const std::string& default_name);
+
+/// Return the value of the MD_DOMAIN_MSAT_STATS counter \a name of \a ds
+double stats_value(GDALDataset* ds, const char* name);
+
+/**
+ * Read all the lines of \a rb as \a type, returning the number of pixels
+ * read.
+ *
+ * If \a calibrate is true, values are read as GDT_Float32 and the scale and
+ * offset of the band are applied to them.
+ */
+uint64_t read_band(GDALRasterBand* rb, GDALDataType type, bool calibrate=false);
+
+/**
+ * Create in memory a full disk SEVIRI image of \a channel_id, with synthetic
+ * 10 bit values on the Earth disk and nodata in space.
+ *
+ * Metadata and georeferencing are as in the images read from xRIT.
+ */
+std::unique_ptr<GDALDataset> synthetic_seviri(int channel_id);
+
+/**
+ * Benchmark writing a synthetic_seviri() image of \a channel_id with
+ * \a driver and creation \a options, reporting the size of the output.
+ */
+void bench_export(Run& run, const std::string& driver, int channel_id, const std::vector<std::string>& options);
+
+/**
+ * Benchmark reading back with \a driver the image that bench_export() writes
+ * with the same arguments.
+ */
+void bench_import(Run& run, const std::string& driver, int channel_id, const std::vector<std::string>& options);
+
+}
+}
+
+#endif
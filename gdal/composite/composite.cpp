@@ -0,0 +1,375 @@
+#include "composite.h"
+#include "gdal/xrit/dataset.h"
+#include "gdal/xrit/rasterband.h"
+#include "gdal/reflectance/reflectance.h"
+#include "gdal/reflectance/pixeltolatlon.h"
+#include <msat/gdal/const.h>
+#include <msat/hrit/MSG_channel.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <stdexcept>
+#include <deque>
+#include <mutex>
+#include <cstdlib>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+
+using namespace std;
+
+namespace msat {
+namespace composite {
+
+uint8_t Component::stretch(double val) const
+{
+    double t = (val - min) / (max - min);
+    // This also catches NaN
+    if (!(t > 0)) return 0;
+    if (t >= 1) return 255;
+    if (gamma != 1)
+        t = pow(t, 1.0 / gamma);
+    return (uint8_t)lround(t * 255);
+}
+
+bool Recipe::read(const std::string& pathname)
+{
+    FILE* in = fopen(pathname.c_str(), "rt");
+    if (!in)
+    {
+        CPLError(CE_Failure, CPLE_OpenFailed, "%s cannot be opened: %s", pathname.c_str(), strerror(errno));
+        return false;
+    }
+
+    static const char* names[] = { "red", "green", "blue" };
+    bool found[3] = { false, false, false };
+    char line[1024];
+    unsigned lineno = 0;
+    bool res = true;
+    while (res && fgets(line, sizeof(line), in))
+    {
+        ++lineno;
+        char name[32];
+        char channel[32];
+        Component c;
+        int count = sscanf(line, " %31s %31s %lf %lf %lf", name, channel, &c.min, &c.max, &c.gamma);
+        if (count < 1 || name[0] == '#') continue;
+        if (count < 4 || c.min == c.max || c.gamma <= 0)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s:%u: expected 'component channel min max [gamma]'", pathname.c_str(), lineno);
+            res = false;
+            break;
+        }
+        c.channel = channel;
+
+        unsigned idx = 0;
+        while (idx < 3 && !EQUAL(name, names[idx]))
+            ++idx;
+        if (idx == 3)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s:%u: component should be red, green or blue, not %s", pathname.c_str(), lineno, name);
+            res = false;
+            break;
+        }
+        components[idx] = c;
+        found[idx] = true;
+    }
+    fclose(in);
+    if (!res) return false;
+
+    for (unsigned i = 0; i < 3; ++i)
+        if (!found[i])
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: missing %s component", pathname.c_str(), names[i]);
+            return false;
+        }
+    return true;
+}
+
+
+namespace {
+
+std::mutex slot_cache_mutex;
+std::deque<std::pair<std::string, std::shared_ptr<Slot>>> slot_cache;
+
+}
+
+Slot::~Slot()
+{
+    for (auto& i: channels)
+        delete i.second;
+}
+
+GDALDataset* Slot::channel(const xrit::FileAccess& fa, const std::string& name)
+{
+    auto i = channels.find(name);
+    if (i != channels.end())
+        return i->second;
+
+    unique_ptr<xrit::XRITDataset> ds(new xrit::XRITDataset(xrit::FileAccess(fa, name)));
+    if (!ds->init()) return nullptr;
+    GDALDataset* res = ds.release();
+    channels[name] = res;
+    return res;
+}
+
+std::shared_ptr<Slot> Slot::get(const xrit::FileAccess& fa)
+{
+    unsigned size = atoi(CPLGetConfigOption("MSAT_COMPOSITE_CACHE", "0"));
+    if (size == 0)
+        return std::make_shared<Slot>();
+
+    string key = fa.directory + "/" + fa.resolution + ":" + fa.productid1 + "::" + fa.timing;
+    std::lock_guard<std::mutex> lock(slot_cache_mutex);
+    for (auto i = slot_cache.begin(); i != slot_cache.end(); ++i)
+        if (i->first == key)
+        {
+            // Move to the front, as the most recently used
+            auto entry = *i;
+            slot_cache.erase(i);
+            slot_cache.push_front(entry);
+            return entry.second;
+        }
+
+    auto res = std::make_shared<Slot>();
+    slot_cache.emplace_front(key, res);
+    while (slot_cache.size() > size)
+        slot_cache.pop_back();
+    return res;
+}
+
+
+CompositeDataset::CompositeDataset(const Recipe& recipe)
+    : recipe(recipe)
+{
+}
+
+CompositeDataset::~CompositeDataset()
+{
+    // Computed datasets refer to the channels, and go before the slot
+    for (auto& ds: derived)
+        delete ds;
+}
+
+GDALDataset* CompositeDataset::channel(const xrit::FileAccess& fa, const std::string& name)
+{
+    GDALDataset* ds = slot->channel(fa, name);
+    if (ds) add_info(ds, name);
+    return ds;
+}
+
+bool CompositeDataset::init(const std::string& pathname)
+{
+    xrit::FileAccess fa(pathname);
+    slot = Slot::get(fa);
+
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        string name = recipe.components[c].channel;
+        bool reflectance = !name.empty() && name.back() == 'r';
+        if (reflectance)
+            name.pop_back();
+
+        GDALDataset* ds = channel(fa, name);
+        if (!ds) return false;
+
+        if (!reflectance)
+        {
+            sources[c] = ds->GetRasterBand(1);
+            continue;
+        }
+
+        xrit::XRITRasterBand* rb = dynamic_cast<xrit::XRITRasterBand*>(ds->GetRasterBand(1));
+        unique_ptr<utils::ReflectanceDataset> rds(new utils::ReflectanceDataset(rb->channel_id));
+        rds->add_source(ds);
+        if (rb->channel_id == MSG_SEVIRI_1_5_IR_3_9)
+        {
+            GDALDataset* ds108 = channel(fa, "IR_108");
+            if (!ds108) return false;
+            GDALDataset* ds134 = channel(fa, "IR_134");
+            if (!ds134) return false;
+            rds->add_source(ds108);
+            rds->add_source(ds134);
+        }
+
+        // All reflectance components georeference the same pixels
+        if (!slot->p2ll)
+        {
+            slot->p2ll = std::make_shared<utils::PixelToLatlon>(ds);
+            slot->p2ll->cache_rows = true;
+        }
+        rds->p2ll = slot->p2ll;
+        rds->init_rasterband();
+
+        sources[c] = rds->GetRasterBand(1);
+        derived.push_back(rds.release());
+    }
+
+    disk = dataset::earth_disk(this);
+
+    for (int i = 1; i <= 3; ++i)
+        SetBand(i, new CompositeRasterBand(this, i));
+
+    return true;
+}
+
+CPLErr CompositeDataset::compute_line(int y, int band_idx, void* buf)
+{
+    // Destination of each component: buf for the band being read, and
+    // blocks in the cache for the others, unless they are already there
+    std::array<GByte*, 3> dest{};
+    std::array<GDALRasterBlock*, 3> blocks{};
+    for (int c = 0; c < 3; ++c)
+    {
+        if (c + 1 == band_idx)
+        {
+            dest[c] = (GByte*)buf;
+            continue;
+        }
+
+        GDALRasterBand* rb = GetRasterBand(c + 1);
+        GDALRasterBlock* block = rb->TryGetLockedBlockRef(0, y);
+        if (block)
+        {
+            block->DropLock();
+            continue;
+        }
+        block = rb->GetLockedBlockRef(0, y, TRUE);
+        if (!block) continue;
+        blocks[c] = block;
+        dest[c] = (GByte*)block->GetDataRef();
+    }
+
+    for (auto d: dest)
+        if (d) memset(d, 0, nRasterXSize);
+
+    CPLErr res = CE_None;
+    int start = disk->starts[y];
+    int end = disk->ends[y];
+    if (start < end)
+    {
+        std::vector<double> vals(end - start);
+        for (int c = 0; c < 3 && res == CE_None; ++c)
+        {
+            if (!dest[c]) continue;
+            GDALRasterBand* src = sources[c];
+            if (src->RasterIO(GF_Read, start, y, end - start, 1, vals.data(), end - start, 1, GDT_Float64, 0, 0) != CE_None)
+            {
+                res = CE_Failure;
+                break;
+            }
+
+            const Component& comp = recipe.components[c];
+            double nodata = src->GetNoDataValue();
+            double scale = src->GetScale();
+            double offset = src->GetOffset();
+            GByte* d = dest[c] + start;
+            for (int i = 0; i < end - start; ++i)
+                d[i] = vals[i] == nodata ? 0 : comp.stretch(vals[i] * scale + offset);
+        }
+    }
+
+    for (int c = 0; c < 3; ++c)
+    {
+        if (!blocks[c]) continue;
+        blocks[c]->DropLock();
+        // Do not leave partially computed lines in the block cache, where
+        // they would be returned by later reads
+        if (res != CE_None)
+            GetRasterBand(c + 1)->FlushBlock(0, y, FALSE);
+    }
+
+    return res;
+}
+
+
+CompositeRasterBand::CompositeRasterBand(CompositeDataset* ds, int idx)
+{
+    poDS = ds;
+    nBand = idx;
+    eDataType = GDT_Byte;
+
+    add_info(ds->sources[idx - 1], "CompositeRasterBand");
+    // Compute a full line at a time, for all components
+    nBlockXSize = ds->GetRasterXSize();
+    nBlockYSize = 1;
+
+    SetDescription(ds->recipe.components[idx - 1].channel.c_str());
+}
+
+CPLErr CompositeRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+    return static_cast<CompositeDataset*>(poDS)->compute_line(yblock, nBand, buf);
+}
+
+GDALColorInterp CompositeRasterBand::GetColorInterpretation()
+{
+    switch (nBand)
+    {
+        case 1: return GCI_RedBand;
+        case 2: return GCI_GreenBand;
+        default: return GCI_BlueBand;
+    }
+}
+
+
+GDALDataset* CompositeOpen(GDALOpenInfo* info)
+{
+    // MSATCOMPOSITE:recipe:xrit file name
+    if (!STARTS_WITH_CI(info->pszFilename, "MSATCOMPOSITE:"))
+        return NULL;
+
+    string spec(info->pszFilename + 14);
+    size_t pos = spec.find(':');
+    if (pos == string::npos)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: expected MSATCOMPOSITE:recipe:xritname", info->pszFilename);
+        return NULL;
+    }
+    string pathname = spec.substr(pos + 1);
+    if (!msat::xrit::isValid(pathname))
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s is not a valid XRIT file name", pathname.c_str());
+        return NULL;
+    }
+
+    Recipe recipe;
+    if (!recipe.read(spec.substr(0, pos)))
+        return NULL;
+
+    try {
+        unique_ptr<CompositeDataset> ds(new CompositeDataset(recipe));
+        if (!ds->init(pathname)) return NULL;
+        return ds.release();
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", info->pszFilename, e.what());
+        return NULL;
+    }
+}
+
+}
+}
+
+extern "C" {
+
+void GDALRegister_MsatComposite()
+{
+    if (!GDAL_CHECK_VERSION("MsatComposite"))
+        return;
+
+    if (GDALGetDriverByName("MsatComposite") == NULL)
+    {
+        unique_ptr<GDALDriver> driver(new GDALDriver());
+        driver->SetDescription("MsatComposite");
+        driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Meteosatlib RGB composite of XRIT channels");
+        driver->pfnOpen = msat::composite::CompositeOpen;
+        GetGDALDriverManager()->RegisterDriver(driver.release());
+    }
+}
+
+}
@@ -0,0 +1,159 @@
+#ifndef MSAT_GDALDRIVER_COMPOSITE_H
+#define MSAT_GDALDRIVER_COMPOSITE_H
+
+#include "gdal/reflectance/base.h"
+#include <msat/gdal/dataset.h>
+#include <msat/xrit/fileaccess.h>
+#include <array>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace msat {
+namespace utils {
+struct PixelToLatlon;
+}
+
+namespace composite {
+
+/// How to render one of the red, green and blue components of a composite
+struct Component
+{
+    /// XRIT channel name, with an 'r' suffix to use its reflectance
+    std::string channel;
+    /// Physical values rendered as 0 and 255. min can be greater than max,
+    /// to invert the scale
+    double min = 0;
+    double max = 0;
+    /// Gamma correction
+    double gamma = 1;
+
+    /// Render a physical value
+    uint8_t stretch(double val) const;
+};
+
+/**
+ * Description of a RGB composite.
+ *
+ * Recipe files have one line for each of the red, green and blue
+ * components, with the component name, the channel, the values rendered as
+ * 0 and 255, and an optional gamma:
+ *
+ * \code
+ * # Natural colours
+ * red   IR_016r 0 80 1.0
+ * green VIS008r 0 90
+ * blue  VIS006r 0 90
+ * \endcode
+ *
+ * Empty lines and lines starting with '#' are ignored.
+ */
+struct Recipe
+{
+    std::array<Component, 3> components;
+
+    /// Read a recipe file, returning false and raising a CPLError on failure
+    bool read(const std::string& pathname);
+};
+
+/**
+ * Decoded channels of a XRIT timeslot, that can be shared by all the
+ * composites of the timeslot.
+ *
+ * If the MSAT_COMPOSITE_CACHE configuration option is set to a number N,
+ * the channels of the last N timeslots opened are kept decoded after their
+ * composites are closed, and reused by the following composites of the same
+ * timeslots. A Slot cannot be used by more than one thread at the same time,
+ * so this should only be enabled by programs that read one composite at a
+ * time.
+ */
+struct Slot
+{
+    /// Decoded channels, by channel name
+    std::map<std::string, GDALDataset*> channels;
+
+    /// Georeferencing shared by all reflectance components
+    std::shared_ptr<utils::PixelToLatlon> p2ll;
+
+    Slot() = default;
+    Slot(const Slot&) = delete;
+    ~Slot();
+    Slot& operator=(const Slot&) = delete;
+
+    /**
+     * Return the decoded channel \a name, opening it if needed.
+     *
+     * Returns nullptr and raises a CPLError on failure.
+     */
+    GDALDataset* channel(const xrit::FileAccess& fa, const std::string& name);
+
+    /// Return the Slot for \a fa, from the cache if it is enabled
+    static std::shared_ptr<Slot> get(const xrit::FileAccess& fa);
+};
+
+/**
+ * RGB composite of channels of the same XRIT timeslot.
+ *
+ * Each channel is decoded once, even if it is used by more components or
+ * to compute reflectances, and all reflectance components share their
+ * georeferencing. The three components of a line are computed together,
+ * and only for the pixels that see the Earth.
+ */
+class CompositeDataset : public utils::ProxyDataset
+{
+public:
+    Recipe recipe;
+
+    /// Decoded channels of the timeslot
+    std::shared_ptr<Slot> slot;
+
+    /// Datasets computed from the channels
+    std::vector<GDALDataset*> derived;
+
+    /// Source raster band for each component
+    std::array<GDALRasterBand*, 3> sources{};
+
+    /// Pixels outside the Earth disk are black
+    std::shared_ptr<const dataset::EarthDisk> disk;
+
+    explicit CompositeDataset(const Recipe& recipe);
+    ~CompositeDataset();
+
+    /**
+     * Open the channels of the timeslot of the XRIT file name \a pathname,
+     * and create the raster bands.
+     *
+     * Returns false and raises a CPLError on failure.
+     */
+    bool init(const std::string& pathname);
+
+    /**
+     * Compute line \a y of all components, storing the one of band
+     * \a band_idx in \a buf, and the others in the GDAL block cache.
+     */
+    CPLErr compute_line(int y, int band_idx, void* buf);
+
+protected:
+    /// Return the decoded channel \a name, checking it against the others
+    GDALDataset* channel(const xrit::FileAccess& fa, const std::string& name);
+};
+
+class CompositeRasterBand : public utils::ProxyRasterBand
+{
+public:
+    CompositeRasterBand(CompositeDataset* ds, int idx);
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+    GDALColorInterp GetColorInterpretation() override;
+};
+
+}
+}
+
+extern "C" {
+void GDALRegister_MsatComposite(void);
+}
+
+#endif
@@ -1,12 +1,20 @@
 #include "grib.h"
 #include "utils.h"
+#include "index.h"
 #include <msat/gdal/const.h>
 #include <msat/gdal/dataset.h>
 #include <msat/facts.h>
+#include <msat/Progress.h>
 #include <gdal/gdal_priv.h>
 #include <gdal/ogr_spatialref.h>
 #include "gdal/utils.h"
 #include <memory>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
 
 #include "config.h"
 
@@ -30,14 +38,19 @@ GDALDataset* GRIBCreateCopy(const char* pszFilename, GDALDataset* src,
                               int bStrict, char** papszOptions,
                               GDALProgressFunc pfnProgress, void* pProgressData);
 
+/**
+ * Raster band for one message of a GRIB file.
+ *
+ * The message is only read and decoded when the band data is accessed.
+ */
 class GRIBRasterBand : public GDALRasterBand
 {
-	Grib& grib;
+	MessageInfo info;
 	double missing;
 	string unit;
 
 public:
-	GRIBRasterBand(GRIBDataset* ds, int idx /*, GDALDataType dt */);
+	GRIBRasterBand(GRIBDataset* ds, int idx, const MessageInfo& info);
 
     const char* GetUnitType() override
     {
@@ -60,48 +73,41 @@ public:
         return missing;
     }
 
-    CPLErr IReadBlock(int xblock, int yblock, void *buf) override
-	{
-		if (xblock != 0 || yblock != 0)
-		{
-			CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
-			return CE_Failure;
-		}
-
-		size_t length = nRasterXSize * nRasterYSize;
-		grib.get_double_array("values", (double*)buf, &length);
-		if (length != (size_t)(nRasterXSize * nRasterYSize)) {
-			CPLError(CE_Failure, CPLE_AppDefined, "Only %d values read instead of %d", (int)length, nRasterXSize * nRasterYSize);
-			return CE_Failure;
-		}
-		return CE_None;
-	}
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
 };
 
 class GRIBDataset : public GDALDataset
 {
 public:
+    string pathname;
+    // First message of the dataset, used for georeferencing
     Grib grib;
     int spacecraft_id;
     OGRSpatialReference osr;
 
-    GRIBDataset(Grib&& grib) : grib(move(grib)) {}
+    GRIBDataset(const string& pathname) : pathname(pathname) {}
 
-	bool init()
+    /**
+     * Initialise the dataset with the given messages as bands.
+     *
+     * All messages need to describe the same image.
+     */
+	bool init(const std::vector<MessageInfo>& messages)
 	{
 		try {
-			nRasterXSize = grib.get_long("numberOfPointsAlongXAxis");
-			nRasterYSize = grib.get_long("numberOfPointsAlongYAxis");
-			nBands = 1;
+			if (grib.new_headers_from_file(NULL, pathname.c_str(), messages[0].offset, messages[0].length) != CE_None)
+				return false;
+
+			nRasterXSize = messages[0].nx;
+			nRasterYSize = messages[0].ny;
 
 			// Datetime
-			char buf[25];
-			grib.formatTime(buf);
-			if (SetMetadataItem(MD_MSAT_DATETIME, buf, MD_DOMAIN_MSAT) != CE_None)
+			if (SetMetadataItem(MD_MSAT_DATETIME, messages[0].datetime.c_str(), MD_DOMAIN_MSAT) != CE_None)
 				return false;
 
 			// Spacecraft
-			spacecraft_id = (int)grib.get_long_oneof("satelliteNumber", "satelliteIdentifier", "indicatorOfTypeOfLevel", NULL);
+			char buf[25];
+			spacecraft_id = messages[0].spacecraft_id;
 			snprintf(buf, 25, "%d", spacecraft_id);
 			if (SetMetadataItem(MD_MSAT_SPACECRAFT_ID, buf, MD_DOMAIN_MSAT) != CE_None)
 				return false;
@@ -119,7 +125,8 @@ public:
 			// if (bpp <= 32)
 				// SetBand(1, new GRIBRasterBand(this, 1, GDT_Float32));
 			// else
-			SetBand(1, new GRIBRasterBand(this, 1 /*, GDT_Float64 */));
+			for (size_t i = 0; i < messages.size(); ++i)
+				SetBand(i + 1, new GRIBRasterBand(this, i + 1, messages[i]));
 			return true;
 		} catch (griberror& e) {
 			return false;
@@ -156,8 +163,8 @@ public:
     }
 };
 
-GRIBRasterBand::GRIBRasterBand(GRIBDataset* ds, int idx /*, GDALDataType dt */)
-    : grib(ds->grib)
+GRIBRasterBand::GRIBRasterBand(GRIBDataset* ds, int idx, const MessageInfo& info)
+    : info(info)
 {
     poDS = ds;
     nBand = idx;
@@ -167,64 +174,156 @@ GRIBRasterBand::GRIBRasterBand(GRIBDataset* ds, int idx /*, GDALDataType dt */)
     nBlockYSize = ds->GetRasterYSize();
 
     // Channel
-    long channel_id;
-    if (!grib.get_long_ifexists("channelNumber", &channel_id))
-      if (!grib.get_long_ifexists("level", &channel_id))
-        {
-	  long cw_scale = grib.get_long("scaleFactorOfCentralWaveNumber");
-	  long cw_val = grib.get_long("scaledValueOfCentralWaveNumber");
-	  
-	  double central_vave_number = (double)cw_val * exp10(-cw_scale);
-	  channel_id = facts::channel_from_central_wave_number(ds->spacecraft_id, central_vave_number);
-        }
-    
     char buf[25];
-    snprintf(buf, 25, "%ld", channel_id);
+    snprintf(buf, 25, "%d", info.channel_id);
     SetMetadataItem(MD_MSAT_CHANNEL_ID, buf, MD_DOMAIN_MSAT);
-    string channelName = facts::channelName(ds->spacecraft_id, channel_id);
+    string channelName = facts::channelName(ds->spacecraft_id, info.channel_id);
     SetMetadataItem(MD_MSAT_CHANNEL, channelName.c_str(), MD_DOMAIN_MSAT);
     
     SetDescription(channelName.c_str());
     
-    unit = facts::channelUnit(ds->spacecraft_id, channel_id);
+    unit = facts::channelUnit(ds->spacecraft_id, info.channel_id);
     
     // TODO glb_preferredBPP = grib.get_long("numberOfBitsContainingEachPackedValue");
     // TODO // This is pointless, as grib won't store it
     
     // Invent a suitable missing value instead of 9999 or whatever grib_api
     // has as default
-    missing = facts::defaultScaledMissing(channel_id);
-    grib.set_double("missingValue", missing);
+    missing = facts::defaultScaledMissing(info.channel_id);
+}
+
+CPLErr GRIBRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+	if (xblock != 0 || yblock != 0)
+	{
+		CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+		return CE_Failure;
+	}
+
+	// Read and decode the message only now, and only for as long as needed
+	GRIBDataset* ds = (GRIBDataset*)poDS;
+	Grib grib;
+	if (grib.new_from_file_offset(NULL, ds->pathname.c_str(), info.offset, info.length) != CE_None)
+		return CE_Failure;
+
+	try {
+		grib.set_double("missingValue", missing);
+		size_t length = nRasterXSize * nRasterYSize;
+		grib.get_double_array("values", (double*)buf, &length);
+		if (length != (size_t)(nRasterXSize * nRasterYSize)) {
+			CPLError(CE_Failure, CPLE_AppDefined, "Only %d values read instead of %d", (int)length, nRasterXSize * nRasterYSize);
+			return CE_Failure;
+		}
+	} catch (griberror& e) {
+		return CE_Failure;
+	}
+	return CE_None;
 }
 
 GDALDataset* GRIBOpen(GDALOpenInfo* info)
 {
-    // We want a real file
+    // Subdataset with a subset of the messages: MSATGRIB:n,n,...:pathname
+    string filename;
+    std::vector<size_t> selected;
+    if (STARTS_WITH_CI(info->pszFilename, "MSATGRIB:"))
+    {
+        const char* s = info->pszFilename + 9;
+        while (true)
+        {
+            char* end;
+            unsigned long idx = strtoul(s, &end, 10);
+            if (end == s) return NULL;
+            selected.push_back(idx);
+            s = end;
+            if (*s == ',') ++s;
+            else if (*s == ':') { ++s; break; }
+            else return NULL;
+        }
+        filename = s;
+    } else {
+        // We want a real file
 #if GDAL_VERSION_MAJOR >= 2
-    if (info->fpL == NULL) return NULL;
+        if (info->fpL == NULL) return NULL;
 #else
-    if (info->fp == NULL) return NULL;
+        if (info->fp == NULL) return NULL;
 #endif
 
-	if (info->nHeaderBytes < 4)
-		return NULL;
+        if (info->nHeaderBytes < 4)
+            return NULL;
 
-	// Look for a grib signature in the header
-	string header((const char*)info->pabyHeader, 0, info->nHeaderBytes);
-	if (header.find("GRIB") == string::npos)
-		return NULL;
+        // Look for a grib signature in the header
+        string header((const char*)info->pabyHeader, 0, info->nHeaderBytes);
+        if (header.find("GRIB") == string::npos)
+            return NULL;
 
-	string filename(info->pszFilename);
+        filename = info->pszFilename;
+    }
 
-    Grib grib;
-    if (grib.new_from_file(NULL, info->pszFilename) != CE_None)
+    MessageIndex index;
+    if (!index.read(filename))
         return NULL;
 
+    // Group messages describing the same image
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < index.messages.size(); ++i)
+    {
+        auto g = groups.begin();
+        for ( ; g != groups.end(); ++g)
+            if (index.messages[(*g)[0]].same_image(index.messages[i]))
+                break;
+        if (g == groups.end())
+            groups.emplace_back(1, i);
+        else
+            g->push_back(i);
+    }
+
+    // By default, use the first image as bands
+    if (selected.empty())
+        selected = groups[0];
+
+    std::vector<MessageInfo> messages;
+    for (auto i: selected)
+    {
+        if (i >= index.messages.size())
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s has no GRIB message %zu", filename.c_str(), i);
+            return NULL;
+        }
+        if (!messages.empty() && !messages[0].same_image(index.messages[i]))
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: GRIB message %zu does not have the same grid and time as message %zu", filename.c_str(), i, selected[0]);
+            return NULL;
+        }
+        messages.push_back(index.messages[i]);
+    }
+
     // Create the dataset
-    unique_ptr<GRIBDataset> ds(new GRIBDataset(move(grib)));
+    unique_ptr<GRIBDataset> ds(new GRIBDataset(filename));
 
     // Initialise the dataset
-    if (!ds->init()) return NULL;
+    if (!ds->init(messages)) return NULL;
+
+    // If the file contains more than one image, list them as subdatasets
+    if (groups.size() > 1 && info->pszFilename == filename)
+    {
+        char** subdatasets = nullptr;
+        for (size_t i = 0; i < groups.size(); ++i)
+        {
+            string name = "MSATGRIB:";
+            for (size_t j = 0; j < groups[i].size(); ++j)
+            {
+                if (j) name += ",";
+                name += to_string(groups[i][j]);
+            }
+            name += ":" + filename;
+            const MessageInfo& first = index.messages[groups[i][0]];
+            subdatasets = CSLSetNameValue(subdatasets, CPLSPrintf("SUBDATASET_%zu_NAME", i + 1), name.c_str());
+            subdatasets = CSLSetNameValue(subdatasets, CPLSPrintf("SUBDATASET_%zu_DESC", i + 1),
+                    CPLSPrintf("%s %dx%d, %zu channels", first.datetime.c_str(), first.nx, first.ny, groups[i].size()));
+        }
+        ds->SetMetadata(subdatasets, "SUBDATASETS");
+        CSLDestroy(subdatasets);
+    }
 
     return msat::gdal::add_extras(ds.release(), info);
 }
@@ -299,26 +398,86 @@ bool copy_data(NcVar& dst, GDALRasterBand& src, GDALDataType outType)
 
 namespace {
 
+// Size in bytes of the buffer used to read source values
+const size_t read_strip_size = 8 * 1024 * 1024;
+
+// PACKING creation option values, and the corresponding grib_api packing types
+const struct {
+    const char* name;
+    const char* type;
+} packings[] = {
+    { "SIMPLE", "grid_simple" },
+    { "COMPLEX", "grid_complex" },
+    { "CCSDS", "grid_ccsds" },
+    { "JPEG", "grid_jpeg" },
+    { "PNG", "grid_png" },
+};
+
+/// Return the grib_api packing type for a PACKING option value, or NULL if it is not supported
+const char* packing_type(const char* name)
+{
+    for (const auto& p: packings)
+        if (EQUAL(name, p.name))
+            return p.type;
+    return NULL;
+}
+
+/**
+ * Number of bits needed to encode values between \a vmin and \a vmax with
+ * \a digits decimal digits, or 0 if it cannot be computed
+ */
+long bits_for_range(double vmin, double vmax, int digits)
+{
+    if (!(vmax > vmin)) return 0;
+    double levels = (vmax - vmin) * exp10(digits) + 1;
+    long bits = (long)ceil(log2(levels));
+    return std::max(1l, std::min(32l, bits));
+}
+
 struct CreateGRIB
 {
     Grib& grib;
     GDALDataset* src;
     GDALRasterBand* rb;
     OGRSpatialReference osr;
+    char** options;
     std::vector<double> values;
     size_t count_missing = 0;
     double grib_missing = 0;
+    // Range of the non-missing values, after scaling
+    double value_min = HUGE_VAL;
+    double value_max = -HUGE_VAL;
 
-    CreateGRIB(Grib& grib, GDALDataset* src)
-        : grib(grib), src(src), rb(src->GetRasterBand(1)), osr(*src->GetSpatialRef())
+    CreateGRIB(Grib& grib, GDALDataset* src, int band=1, char** options=nullptr)
+        : grib(grib), src(src), rb(src->GetRasterBand(band)), osr(*src->GetSpatialRef()), options(options)
     {
     }
 
     virtual ~CreateGRIB() {}
 
-    virtual bool create()
+    /**
+     * Encode the band into the grib handle.
+     *
+     * Everything that accesses the source dataset runs while holding
+     * \a io_mutex, so that several bands of the same dataset can be encoded
+     * in parallel; scaling and packing the values run unlocked.
+     */
+    bool encode(std::mutex& io_mutex)
+    {
+        {
+            std::lock_guard<std::mutex> lock(io_mutex);
+            if (!check_source()) return false;
+        }
+        if (!read_values(io_mutex)) return false;
+        {
+            std::lock_guard<std::mutex> lock(io_mutex);
+            if (!create()) return false;
+        }
+        return data_section();
+    }
+
+    bool check_source()
     {
-        // Sanity checks
         const char *stype = osr.GetAttrValue("PROJECTION");
         if (!stype)
         {
@@ -330,30 +489,126 @@ struct CreateGRIB
             CPLError(CE_Failure, CPLE_AppDefined, "we are given a satellite height of %f but only %d is supported", osr.GetProjParm(SRS_PP_SATELLITE_HEIGHT), ORBIT_RADIUS_FOR_GDAL);
             return false;
         }
+        return true;
+    }
 
-        // Read values
-        values.resize(src->GetRasterXSize() * src->GetRasterYSize());
-        if (rb->RasterIO(GF_Read, 0, 0, src->GetRasterXSize(), src->GetRasterYSize(), values.data(), src->GetRasterXSize(), src->GetRasterYSize(), GDT_Float64, 0, 0) != CE_None)
-            return false;
+    /**
+     * Read the band into values, scaled and with missing values replaced by
+     * grib_missing, computing count_missing, value_min and value_max.
+     */
+    bool read_values(std::mutex& io_mutex)
+    {
+        GDALDataType type;
+        {
+            std::lock_guard<std::mutex> lock(io_mutex);
+            type = rb->GetRasterDataType();
+        }
+        // Read in the source type, to keep strip buffers small and avoid a
+        // conversion pass in GDAL
+        switch (type)
+        {
+            case GDT_Byte: return read_values<GByte>(io_mutex, type);
+            case GDT_UInt16: return read_values<GUInt16>(io_mutex, type);
+            case GDT_Int16: return read_values<GInt16>(io_mutex, type);
+            case GDT_UInt32: return read_values<GUInt32>(io_mutex, type);
+            case GDT_Int32: return read_values<GInt32>(io_mutex, type);
+            case GDT_Float32: return read_values<float>(io_mutex, type);
+            default: return read_values<double>(io_mutex, GDT_Float64);
+        }
+    }
 
-        // Scale values and count missing values
-        double missing = rb->GetNoDataValue();
-        double offset = rb->GetOffset();
-        double scale = rb->GetScale();
+    template<typename T>
+    bool read_values(std::mutex& io_mutex, GDALDataType type)
+    {
+        int sx, sy;
+        double missing, offset, scale;
+        std::shared_ptr<const msat::dataset::EarthDisk> disk;
+        {
+            std::lock_guard<std::mutex> lock(io_mutex);
+            sx = rb->GetXSize();
+            sy = rb->GetYSize();
+            missing = rb->GetNoDataValue();
+            offset = rb->GetOffset();
+            scale = rb->GetScale();
+            disk = msat::dataset::earth_disk_mask(rb);
+        }
         grib_missing = missing * scale + offset;
-        for (auto& v: values)
+        values.resize((size_t)sx * sy);
+
+        // Scale a run of values, counting missing values and keeping track
+        // of the range in the same pass. This is written without branches,
+        // so that the compiler can vectorise it.
+        double vmin = value_min;
+        double vmax = value_max;
+        size_t nmissing = 0;
+        auto scale_values = [&](const T* in, size_t len, double* out) {
+            for (size_t i = 0; i < len; ++i)
+            {
+                double v = in[i];
+                bool is_missing = v == missing;
+                double scaled = v * scale + offset;
+                nmissing += is_missing;
+                out[i] = is_missing ? grib_missing : scaled;
+                vmin = is_missing ? vmin : std::min(vmin, scaled);
+                vmax = is_missing ? vmax : std::max(vmax, scaled);
+            }
+        };
+
+        // Work in strips of lines, so that only a strip of source values is
+        // held in memory besides the output
+        int strip_lines = std::max<size_t>(1, read_strip_size / (sizeof(T) * sx));
+        std::vector<T> strip((size_t)std::min(strip_lines, sy) * sx);
+        for (int y0 = 0; y0 < sy; y0 += strip_lines)
         {
-            if (v == missing)
+            int lines = std::min(strip_lines, sy - y0);
+            double* out = values.data() + (size_t)y0 * sx;
+            if (!disk)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(io_mutex);
+                    if (rb->RasterIO(GF_Read, 0, y0, sx, lines, strip.data(), sx, lines, type, 0, 0) != CE_None)
+                        return false;
+                }
+                scale_values(strip.data(), (size_t)lines * sx, out);
+                continue;
+            }
+
+            // Only read the part of each line that sees the Earth, and
+            // encode space as missing
             {
-                ++count_missing;
-                v = grib_missing;
+                std::lock_guard<std::mutex> lock(io_mutex);
+                for (int y = y0; y < y0 + lines; ++y)
+                {
+                    int start = disk->starts[y];
+                    int end = disk->ends[y];
+                    if (start >= end) continue;
+                    T* line = strip.data() + (size_t)(y - y0) * sx;
+                    if (rb->RasterIO(GF_Read, start, y, end - start, 1, line + start, end - start, 1, type, 0, 0) != CE_None)
+                        return false;
+                }
+            }
+            for (int y = y0; y < y0 + lines; ++y, out += sx)
+            {
+                int start = disk->starts[y];
+                int end = disk->ends[y];
+                if (start >= end)
+                    start = end = 0;
+                std::fill(out, out + start, grib_missing);
+                std::fill(out + end, out + sx, grib_missing);
+                count_missing += sx - (end - start);
+                scale_values(strip.data() + (size_t)(y - y0) * sx + start, end - start, out + start);
             }
-            else
-                v = v * scale + offset;
         }
+
+        count_missing += nmissing;
+        value_min = vmin;
+        value_max = vmax;
         return true;
     }
 
+    /// Fill in all sections except the data section
+    virtual bool create() = 0;
+
     virtual bool bit_map_section()
     {
         // The purpose of the Bit-Map Section is to indicate the presence or
@@ -382,6 +637,7 @@ struct CreateGRIB
             CPLError(CE_Failure, CPLE_AppDefined, "All values to encode are missing, and GRIB cannot handle this");
             return false;
         }
+        CPLDebug("MsatGRIB", "encoding %zd values in range %f to %f, %zd missing", values.size(), value_min, value_max, count_missing);
 
         grib.set_double_array("values", values.data(), values.size());
         return true;
@@ -610,16 +866,12 @@ struct CreateGRIB2 : public CreateGRIB
     {
         grib.new_from_samples(NULL, "GRIB2");
 
-        if (!CreateGRIB::create())
-            return false;
-
         if (!indicator_section()) return false;
         if (!identification_section()) return false;
         if (!grid_definition_section()) return false;
         if (!product_definition_section()) return false;
         if (!data_representation_section()) return false;
         if (!bit_map_section()) return false;
-        if (!data_section()) return false;
 
         return true;
     }
@@ -628,6 +880,32 @@ struct CreateGRIB2 : public CreateGRIB
 struct CreateGribWMO : public CreateGRIB2
 {
     using CreateGRIB2::CreateGRIB2;
+
+    bool data_representation_section() override
+    {
+        if (!CreateGRIB2::data_representation_section())
+            return false;
+
+        const char* packing = CSLFetchNameValue(options, "PACKING");
+        if (packing != NULL)
+            grib.set_string("packingType", packing_type(packing));
+
+        long bits = 0;
+        const char* nbits = CSLFetchNameValue(options, "NBITS");
+        if (nbits != NULL)
+            bits = atoi(nbits);
+        else if (packing != NULL)
+        {
+            // Use just enough bits to keep the significant digits of the
+            // channel over the range of the values
+            const char* sval = rb->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT);
+            if (sval != NULL)
+                bits = bits_for_range(value_min, value_max, facts::significantDigitsForChannel(strtoul(sval, NULL, 10)));
+        }
+        if (bits > 0)
+            grib.set_long("bitsPerValue", bits);
+        return true;
+    }
 };
 
 struct CreateGRIB1 : public CreateGRIB
@@ -784,13 +1062,9 @@ struct CreateGRIB1 : public CreateGRIB
     {
         grib.new_from_samples(NULL, "GRIB1");
 
-        if (!CreateGRIB::create())
-            return false;
-
         if (!identification_section()) return false;
         if (!grid_definition_section()) return false;
         if (!bit_map_section()) return false;
-        if (!data_section()) return false;
 
         return true;
     }
@@ -831,6 +1105,161 @@ struct CreateGribMsat : public CreateGRIB1
     using CreateGRIB1::CreateGRIB1;
 };
 
+std::unique_ptr<CreateGRIB> make_creator(const std::string& template_name, Grib& grib, GDALDataset* src, int band, char** options)
+{
+    if (template_name == "msat/wmo")
+        return std::unique_ptr<CreateGRIB>(new CreateGribWMO(grib, src, band, options));
+    if (template_name == "msat/ecmwf")
+        return std::unique_ptr<CreateGRIB>(new CreateGribECMWF(grib, src, band, options));
+    if (template_name == "msat/msat")
+        return std::unique_ptr<CreateGRIB>(new CreateGribMsat(grib, src, band, options));
+    return std::unique_ptr<CreateGRIB>();
+}
+
+/// Outcome of encoding one band
+struct EncodedBand
+{
+    Grib grib;
+    bool done = false;
+    bool ok = false;
+    int err_no = CPLE_None;
+    std::string error;
+};
+
+void CPL_STDCALL keep_band_error(CPLErr eErrClass, int err_no, const char* msg)
+{
+    if (eErrClass < CE_Failure) return;
+    EncodedBand* band = static_cast<EncodedBand*>(CPLGetErrorHandlerUserData());
+    band->err_no = err_no;
+    band->error = msg;
+}
+
+/**
+ * Encode all bands of a dataset as GRIB messages, using a pool of worker
+ * threads, and hand them out in band order.
+ */
+class BandEncoder
+{
+    std::string template_name;
+    GDALDataset* src;
+    char** options;
+    std::vector<EncodedBand> bands;
+    std::vector<std::thread> workers;
+    // Serializes access to the source dataset
+    std::mutex io_mutex;
+    // Protects the fields below
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next_band = 0;
+    size_t next_out = 0;
+    size_t max_pending;
+    bool aborted = false;
+
+    void work()
+    {
+        while (true)
+        {
+            size_t idx;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // Do not get too far ahead of the writer, to bound the
+                // number of encoded messages kept in memory
+                cond.wait(lock, [&] { return aborted || next_band == bands.size() || next_band < next_out + max_pending; });
+                if (aborted || next_band == bands.size()) return;
+                idx = next_band++;
+            }
+
+            EncodedBand& band = bands[idx];
+            // CPLError handlers are per thread: collect errors here, and
+            // raise them again from the thread that writes the file
+            CPLPushErrorHandlerEx(keep_band_error, &band);
+            bool ok = false;
+            try {
+                std::unique_ptr<CreateGRIB> creator;
+                {
+                    std::lock_guard<std::mutex> lock(io_mutex);
+                    creator = make_creator(template_name, band.grib, src, idx + 1, options);
+                }
+                ProgressSpan span("encode");
+                span.add_pixels((uint64_t)src->GetRasterXSize() * src->GetRasterYSize());
+                ok = creator->encode(io_mutex);
+            } catch (griberror& e) {
+                ok = false;
+            }
+            CPLPopErrorHandler();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                band.ok = ok;
+                band.done = true;
+            }
+            cond.notify_all();
+        }
+    }
+
+public:
+    BandEncoder(const std::string& template_name, GDALDataset* src, char** options, unsigned nthreads)
+        : template_name(template_name), src(src), options(options), bands(src->GetRasterCount())
+    {
+        nthreads = std::max(1u, std::min(nthreads, (unsigned)bands.size()));
+        max_pending = nthreads * 2;
+        for (unsigned i = 0; i < nthreads; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+
+    ~BandEncoder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+        }
+        cond.notify_all();
+        for (auto& w: workers)
+            w.join();
+    }
+
+    /**
+     * Wait for the next band to be encoded, and return it.
+     *
+     * Returns nullptr and raises a CPLError if encoding failed.
+     */
+    EncodedBand* next()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        EncodedBand& band = bands[next_out];
+        cond.wait(lock, [&] { return band.done; });
+        if (!band.ok)
+        {
+            CPLError(CE_Failure, band.err_no == CPLE_None ? CPLE_AppDefined : band.err_no,
+                    "band %zd: %s", next_out + 1, band.error.empty() ? "cannot encode GRIB message" : band.error.c_str());
+            return nullptr;
+        }
+        return &band;
+    }
+
+    /// Release the memory of the band returned by next(), and move on
+    void written()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bands[next_out].grib = Grib(nullptr);
+            ++next_out;
+        }
+        cond.notify_all();
+    }
+};
+
+/// Number of encoding threads from the NUM_THREADS creation option, or the GDAL_NUM_THREADS configuration option
+unsigned num_threads(char** papszOptions)
+{
+    const char* val = CSLFetchNameValue(papszOptions, "NUM_THREADS");
+    if (val == NULL)
+        val = CPLGetConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
+    if (EQUAL(val, "ALL_CPUS"))
+        return CPLGetNumCPUs();
+    int res = atoi(val);
+    return res > 0 ? res : 1;
+}
 
 }
 
@@ -838,35 +1267,85 @@ GDALDataset* GRIBCreateCopy(const char* pszFilename, GDALDataset* src,
                               int bStrict, char** papszOptions,
                               GDALProgressFunc pfnProgress, void* pProgressData)
 {
-    try {
-        const char* templateName = CSLFetchNameValue(papszOptions, "TEMPLATE");
-        if (templateName == NULL)
-            templateName = "msat/wmo";
+    const char* templateName = CSLFetchNameValue(papszOptions, "TEMPLATE");
+    if (templateName == NULL)
+        templateName = "msat/wmo";
 
+    {
         Grib grib;
-        if (strcmp(templateName, "msat/wmo") == 0)
-        {
-            CreateGribWMO c(grib, src);
-            if (!c.create()) return nullptr;
-        } else if (strcmp(templateName, "msat/ecmwf") == 0) {
-            CreateGribECMWF c(grib, src);
-            if (!c.create()) return nullptr;
-        } else if (strcmp(templateName, "msat/msat") == 0) {
-            CreateGribMsat c(grib, src);
-            if (!c.create()) return nullptr;
-        }
-        else
+        if (!make_creator(templateName, grib, src, 1, papszOptions))
         {
             CPLError(CE_Failure, CPLE_AppDefined, "Unsupported template name '%s'", templateName);
             return nullptr;
         }
+    }
 
-        grib.write(pszFilename);
+    const char* packing = CSLFetchNameValue(papszOptions, "PACKING");
+    if (packing != NULL && packing_type(packing) == NULL)
+    {
+        CPLError(CE_Failure, CPLE_IllegalArg, "Unsupported packing '%s'", packing);
+        return nullptr;
+    }
+    const char* nbits = CSLFetchNameValue(papszOptions, "NBITS");
+    if (nbits != NULL && (atoi(nbits) < 1 || atoi(nbits) > 32))
+    {
+        CPLError(CE_Failure, CPLE_IllegalArg, "NBITS must be between 1 and 32, got '%s'", nbits);
+        return nullptr;
+    }
+    if ((packing != NULL || nbits != NULL) && strcmp(templateName, "msat/wmo") != 0)
+        CPLError(CE_Warning, CPLE_NotSupported, "PACKING and NBITS are only supported by the msat/wmo template");
 
-        return (GDALDataset*)GDALOpen(pszFilename, GA_ReadOnly);
-    } catch (griberror& e) {
+    int count = src->GetRasterCount();
+    if (count == 0)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Source dataset has no raster bands");
+        return nullptr;
+    }
+
+    if (pfnProgress == NULL)
+        pfnProgress = GDALDummyProgress;
+
+    FILE* out = fopen(pszFilename, "wb");
+    if (out == NULL)
+    {
+        CPLError(CE_Failure, CPLE_OpenFailed, "cannot open file %s for writing", pszFilename);
         return nullptr;
     }
+
+    // Write one message per band, in band order
+    bool ok = true;
+    {
+        BandEncoder encoder(templateName, src, papszOptions, num_threads(papszOptions));
+        for (int i = 0; ok && i < count; ++i)
+        {
+            EncodedBand* band = encoder.next();
+            if (!band || band->grib.write(out, pszFilename) != CE_None)
+            {
+                ok = false;
+                break;
+            }
+            encoder.written();
+            if (!pfnProgress((double)(i + 1) / count, NULL, pProgressData))
+            {
+                CPLError(CE_Failure, CPLE_UserInterrupt, "User terminated");
+                ok = false;
+            }
+        }
+    }
+
+    if (fclose(out) != 0 && ok)
+    {
+        CPLError(CE_Failure, CPLE_FileIO, "cannot write to file %s", pszFilename);
+        ok = false;
+    }
+
+    if (!ok)
+    {
+        unlink(pszFilename);
+        return nullptr;
+    }
+
+    return (GDALDataset*)GDALOpen(pszFilename, GA_ReadOnly);
 }
 
 }
@@ -887,6 +1366,23 @@ void GDALRegister_MsatGRIB()
         //driver->SetMetadataItem(GDAL_DMD_HELPTOPIC, "frmt_various.html#JDEM");
         driver->SetMetadataItem(GDAL_DMD_EXTENSION, "grib");
         driver->pfnOpen = msat::grib::GRIBOpen;
+        driver->SetMetadataItem(GDAL_DMD_CREATIONOPTIONLIST,
+"<CreationOptionList>"
+"   <Option name='TEMPLATE' type='string-select' default='msat/wmo'>"
+"       <Value>msat/wmo</Value>"
+"       <Value>msat/ecmwf</Value>"
+"       <Value>msat/msat</Value>"
+"   </Option>"
+"   <Option name='PACKING' type='string-select' description='Packing of the values, for the msat/wmo template' default='SIMPLE'>"
+"       <Value>SIMPLE</Value>"
+"       <Value>COMPLEX</Value>"
+"       <Value>CCSDS</Value>"
+"       <Value>JPEG</Value>"
+"       <Value>PNG</Value>"
+"   </Option>"
+"   <Option name='NBITS' type='int' description='Bits per value, for the msat/wmo template. Defaults to what is needed by the significant digits of the channel when PACKING is given'/>"
+"   <Option name='NUM_THREADS' type='string' description='Number of threads used to encode bands, or ALL_CPUS' default='ALL_CPUS'/>"
+"</CreationOptionList>");
         driver->pfnCreateCopy = msat::grib::GRIBCreateCopy;
         GetGDALDriverManager()->RegisterDriver(driver.release());
     }
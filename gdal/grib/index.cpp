@@ -0,0 +1,265 @@
+#include "index.h"
+#include "utils.h"
+#include <msat/facts.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace msat {
+namespace grib {
+
+namespace {
+
+/// Find the next "GRIB" signature at or after \a pos, returning -1 if there is none
+int64_t find_signature(FILE* in, uint64_t pos)
+{
+    char buf[65536];
+    while (true)
+    {
+        if (fseeko(in, pos, SEEK_SET) != 0) return -1;
+        size_t len = fread(buf, 1, sizeof(buf), in);
+        if (len < 4) return -1;
+        for (size_t i = 0; i + 4 <= len; ++i)
+            if (memcmp(buf + i, "GRIB", 4) == 0)
+                return pos + i;
+        // Keep the last 3 bytes, in case the signature is across buffers
+        pos += len - 3;
+    }
+}
+
+/// Get the length of a message using grib_api, for messages that do not
+/// store it in section 0
+bool decoded_length(FILE* in, uint64_t pos, uint64_t& length)
+{
+    if (fseeko(in, pos, SEEK_SET) != 0) return false;
+    int err;
+    grib_handle* gh = grib_handle_new_from_file(0, in, &err);
+    if (gh == NULL) return false;
+    const void* buf;
+    size_t size;
+    bool res = grib_get_message(gh, &buf, &size) == GRIB_SUCCESS;
+    length = size;
+    grib_handle_delete(gh);
+    return res;
+}
+
+}
+
+void MessageInfo::describe(Grib& grib)
+{
+    nx = grib.get_long("numberOfPointsAlongXAxis");
+    ny = grib.get_long("numberOfPointsAlongYAxis");
+
+    char buf[25];
+    grib.formatTime(buf);
+    datetime = buf;
+
+    spacecraft_id = (int)grib.get_long_oneof("satelliteNumber", "satelliteIdentifier", "indicatorOfTypeOfLevel", NULL);
+
+    long channel;
+    if (!grib.get_long_ifexists("channelNumber", &channel))
+        if (!grib.get_long_ifexists("level", &channel))
+        {
+            long cw_scale = grib.get_long("scaleFactorOfCentralWaveNumber");
+            long cw_val = grib.get_long("scaledValueOfCentralWaveNumber");
+
+            double central_vave_number = (double)cw_val * exp10(-cw_scale);
+            channel = facts::channel_from_central_wave_number(spacecraft_id, central_vave_number);
+        }
+    channel_id = channel;
+}
+
+std::string index_pathname(const std::string& pathname)
+{
+    return pathname + ".msatidx";
+}
+
+bool MessageIndex::read(const std::string& pathname)
+{
+    bool use_sidecar = CPLTestBool(CPLGetConfigOption("MSAT_GRIB_INDEX", "NO"));
+    if (use_sidecar && load(pathname))
+        return true;
+
+    if (!scan(pathname)) return false;
+    if (!describe(pathname)) return false;
+
+    // Failing to write the cache is not an error
+    if (use_sidecar && !save(pathname))
+        CPLDebug("MsatGRIB", "cannot write index file %s", index_pathname(pathname).c_str());
+    return true;
+}
+
+bool MessageIndex::scan(const std::string& pathname)
+{
+    messages.clear();
+
+    FILE* in = fopen(pathname.c_str(), "rb");
+    if (!in)
+    {
+        CPLError(CE_Failure, CPLE_OpenFailed, "%s cannot be opened: %s", pathname.c_str(), strerror(errno));
+        return false;
+    }
+
+    uint64_t pos = 0;
+    while (true)
+    {
+        int64_t found = find_signature(in, pos);
+        if (found < 0) break;
+        pos = found;
+
+        // Section 0: "GRIB", 3 bytes of length in GRIB1 or 2 reserved bytes
+        // and the discipline in GRIB2, then the edition number, then 8 bytes
+        // of length in GRIB2
+        unsigned char hdr[16];
+        if (fseeko(in, pos, SEEK_SET) != 0 || fread(hdr, 1, 16, in) != 16)
+            break;
+
+        MessageInfo info;
+        info.offset = pos;
+        switch (hdr[7])
+        {
+            case 1:
+                info.length = (hdr[4] << 16) | (hdr[5] << 8) | hdr[6];
+                // Messages longer than 8Mb use a different encoding for
+                // the length, which needs decoding the message
+                if ((info.length & 0x800000) && !decoded_length(in, pos, info.length))
+                {
+                    CPLError(CE_Failure, CPLE_AppDefined, "%s: cannot read the length of the GRIB message at offset %llu",
+                            pathname.c_str(), (unsigned long long)pos);
+                    fclose(in);
+                    return false;
+                }
+                break;
+            case 2:
+                info.length = 0;
+                for (int i = 8; i < 16; ++i)
+                    info.length = (info.length << 8) | hdr[i];
+                break;
+            default:
+                // Not a message: skip the signature
+                pos += 4;
+                continue;
+        }
+
+        messages.push_back(info);
+        pos += info.length;
+    }
+
+    fclose(in);
+
+    if (messages.empty())
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: no GRIB messages found", pathname.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MessageIndex::describe(const std::string& pathname)
+{
+    FILE* in = fopen(pathname.c_str(), "rb");
+    if (!in)
+    {
+        CPLError(CE_Failure, CPLE_OpenFailed, "%s cannot be opened: %s", pathname.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Only the sections before the data are read: values are decoded by
+    // IReadBlock when needed
+    bool res = true;
+    for (auto& info: messages)
+    {
+        Grib grib;
+        if (grib.new_headers_from_file(NULL, in, pathname.c_str(), info.offset, info.length) != CE_None)
+        {
+            res = false;
+            break;
+        }
+        try {
+            info.describe(grib);
+        } catch (griberror& e) {
+            res = false;
+            break;
+        }
+    }
+    fclose(in);
+    return res;
+}
+
+bool MessageIndex::load(const std::string& pathname)
+{
+    struct stat st;
+    if (stat(pathname.c_str(), &st) != 0) return false;
+
+    FILE* in = fopen(index_pathname(pathname).c_str(), "rt");
+    if (!in) return false;
+
+    bool res = false;
+    unsigned long long size, mtime;
+    if (fscanf(in, "msat-grib-index 1 %llu %llu\n", &size, &mtime) == 2
+            && size == (unsigned long long)st.st_size && mtime == (unsigned long long)st.st_mtime)
+    {
+        messages.clear();
+        res = true;
+        while (true)
+        {
+            MessageInfo info;
+            unsigned long long offset, length;
+            char datetime[20];
+            int count = fscanf(in, "%llu %llu %d %d %d %d %10c %8c\n",
+                    &offset, &length, &info.nx, &info.ny, &info.spacecraft_id, &info.channel_id,
+                    datetime, datetime + 11);
+            if (count == EOF) break;
+            if (count != 8)
+            {
+                res = false;
+                break;
+            }
+            datetime[10] = ' ';
+            datetime[19] = 0;
+            info.offset = offset;
+            info.length = length;
+            info.datetime = datetime;
+            messages.push_back(info);
+        }
+        if (messages.empty()) res = false;
+    }
+
+    fclose(in);
+    return res;
+}
+
+bool MessageIndex::save(const std::string& pathname) const
+{
+    struct stat st;
+    if (stat(pathname.c_str(), &st) != 0) return false;
+
+    // Write to a temporary file and rename, so that concurrent readers never
+    // see a partial index
+    std::string dest = index_pathname(pathname);
+    std::string tmp = dest + ".tmp";
+    FILE* out = fopen(tmp.c_str(), "wt");
+    if (!out) return false;
+
+    fprintf(out, "msat-grib-index 1 %llu %llu\n", (unsigned long long)st.st_size, (unsigned long long)st.st_mtime);
+    for (const auto& info: messages)
+        fprintf(out, "%llu %llu %d %d %d %d %s\n",
+                (unsigned long long)info.offset, (unsigned long long)info.length,
+                info.nx, info.ny, info.spacecraft_id, info.channel_id, info.datetime.c_str());
+
+    if (fclose(out) != 0 || rename(tmp.c_str(), dest.c_str()) != 0)
+    {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+}
@@ -0,0 +1,72 @@
+#ifndef MSAT_GDALDRIVER_GRIB_INDEX_H
+#define MSAT_GDALDRIVER_GRIB_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace msat {
+namespace grib {
+
+struct Grib;
+
+/// Position and summary of a GRIB message in a file
+struct MessageInfo
+{
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    int nx = 0;
+    int ny = 0;
+    int spacecraft_id = 0;
+    int channel_id = 0;
+    /// Image time as YYYY-MM-DD HH:MM:SS
+    std::string datetime;
+
+    /// Fill in the summary from a decoded message
+    void describe(Grib& grib);
+
+    /// Check if two messages can be bands of the same dataset
+    bool same_image(const MessageInfo& o) const
+    {
+        return nx == o.nx && ny == o.ny && spacecraft_id == o.spacecraft_id && datetime == o.datetime;
+    }
+};
+
+/**
+ * Index of all the messages in a GRIB file.
+ *
+ * If the MSAT_GRIB_INDEX configuration option is set to YES, the index is
+ * cached in a .msatidx file next to the GRIB file, and reused as long as
+ * the size and modification time of the GRIB file do not change.
+ */
+struct MessageIndex
+{
+    std::vector<MessageInfo> messages;
+
+    /**
+     * Build the index for \a pathname, from the sidecar file if available.
+     *
+     * Returns false and raises a CPLError on failure.
+     */
+    bool read(const std::string& pathname);
+
+    /// Find the messages in the file, without decoding them
+    bool scan(const std::string& pathname);
+
+    /// Decode the headers of all messages to fill in their summaries
+    bool describe(const std::string& pathname);
+
+    /// Load the index from a sidecar file, returning false if it is missing or stale
+    bool load(const std::string& pathname);
+
+    /// Write the index to a sidecar file
+    bool save(const std::string& pathname) const;
+};
+
+/// Pathname of the sidecar index file for a GRIB file
+std::string index_pathname(const std::string& pathname);
+
+}
+}
+
+#endif
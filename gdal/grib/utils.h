@@ -4,7 +4,11 @@
 #include <grib_api.h>
 #include "msat/gdal/clean_cpl_error.h"
 #include <string>
+#include <vector>
 #include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
 
 // Define this if you want to create a foile /tmp/trace-gribapi with a trace of
 // all grib_api operations
@@ -41,6 +45,69 @@ static inline void checked(int error, const char* context = NULL, const char* fu
     }
 }
 
+/**
+ * Read from \a in the sections of the GRIB message of \a length bytes at
+ * \a offset that come before its bitmap and data.
+ *
+ * For GRIB1 these are sections 0 to 2, for GRIB2 sections 0 to 4. Only the
+ * section lengths are read beyond that.
+ */
+static inline bool read_message_headers(FILE* in, uint64_t offset, uint64_t length, std::vector<unsigned char>& buf)
+{
+    buf.clear();
+    // Append \a size bytes found at \a pos in the message
+    auto read_at = [&](uint64_t pos, uint64_t size) {
+        if (pos + size > length) return false;
+        size_t old = buf.size();
+        buf.resize(old + size);
+        return fseeko(in, offset + pos, SEEK_SET) == 0 && fread(buf.data() + old, 1, size, in) == size;
+    };
+    auto get_u24 = [&](size_t pos) { return ((uint64_t)buf[pos] << 16) | (buf[pos + 1] << 8) | buf[pos + 2]; };
+
+    if (!read_at(0, 8)) return false;
+    switch (buf[7])
+    {
+        case 1:
+        {
+            // Section 1, then section 2 if its presence is flagged in section 1
+            uint64_t pos = 8;
+            if (!read_at(pos, 3)) return false;
+            uint64_t len = get_u24(pos);
+            if (len < 8 || !read_at(pos + 3, len - 3)) return false;
+            bool has_gds = buf[pos + 7] & 0x80;
+            pos += len;
+            if (has_gds)
+            {
+                if (!read_at(pos, 3)) return false;
+                len = get_u24(pos);
+                if (len < 3 || !read_at(pos + 3, len - 3)) return false;
+            }
+            return true;
+        }
+        case 2:
+        {
+            uint64_t pos = 16;
+            if (!read_at(8, 8)) return false;
+            while (true)
+            {
+                // Section length and number
+                if (!read_at(pos, 5)) return false;
+                size_t start = buf.size() - 5;
+                uint64_t len = ((uint64_t)buf[start] << 24) | (buf[start + 1] << 16) | (buf[start + 2] << 8) | buf[start + 3];
+                if (buf[start + 4] >= 5)
+                {
+                    buf.resize(start);
+                    return true;
+                }
+                if (len < 5 || !read_at(pos + 5, len - 5)) return false;
+                pos += len;
+            }
+        }
+        default:
+            return false;
+    }
+}
+
 // Little abstraction layer on top of grib_api
 struct Grib
 {
@@ -58,6 +125,8 @@ struct Grib
 
     grib_handle* gh = nullptr;
     FILE* fp = nullptr;
+    /// Message sections read by new_headers_from_file, which gh points into
+    std::vector<unsigned char> headers;
 
     Grib()
     {
@@ -73,7 +142,7 @@ struct Grib
     }
     Grib(const Grib&) = delete;
     Grib(Grib&& o)
-        : gh(o.gh), fp(o.fp)
+        : gh(o.gh), fp(o.fp), headers(std::move(o.headers))
     {
         o.gh = nullptr;
         o.fp = nullptr;
@@ -101,6 +170,7 @@ struct Grib
         if (fp) fclose(fp);
         fp = o.fp;
         o.fp = nullptr;
+        headers = std::move(o.headers);
 #ifdef TRACE_GRIBAPI
         if (trace) fclose(trace);
         trace = o.trace;
@@ -163,6 +233,72 @@ struct Grib
         return CE_None;
     }
 
+    /// Load the message of \a length bytes found at \a offset in file \a name
+    CPLErr new_from_file_offset(grib_context* c, const char* name, uint64_t offset, uint64_t length)
+    {
+        FILE* in = fopen(name, "rb");
+        if (!in)
+        {
+            CPLError(CE_Failure, CPLE_OpenFailed, "%s cannot be opened: %s", name, strerror(errno));
+            return CE_Failure;
+        }
+        std::vector<unsigned char> buf(length);
+        bool ok = fseeko(in, offset, SEEK_SET) == 0 && fread(buf.data(), 1, length, in) == length;
+        fclose(in);
+        if (!ok)
+        {
+            CPLError(CE_Failure, CPLE_FileIO, "%s: cannot read %llu bytes at offset %llu",
+                name, (unsigned long long)length, (unsigned long long)offset);
+            return CE_Failure;
+        }
+        gh = grib_handle_new_from_message_copy(c, buf.data(), buf.size());
+        trace("h = grib_handle_new_from_message_copy(%p, buf, %zu); /* %p, from %s:%llu */", static_cast<const void*>(c), buf.size(), static_cast<const void*>(gh), name, (unsigned long long)offset);
+        if (gh == NULL)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: cannot decode GRIB message at offset %llu", name, (unsigned long long)offset);
+            return CE_Failure;
+        }
+        return CE_None;
+    }
+
+    /**
+     * Load only the sections of the message of \a length bytes at \a offset
+     * in \a in that come before its data, as read_message_headers().
+     *
+     * This is enough to read grid, time and satellite keys, but not values.
+     */
+    CPLErr new_headers_from_file(grib_context* c, FILE* in, const char* name, uint64_t offset, uint64_t length)
+    {
+        if (!read_message_headers(in, offset, length, headers))
+        {
+            CPLError(CE_Failure, CPLE_FileIO, "%s: cannot read the headers of the GRIB message at offset %llu",
+                name, (unsigned long long)offset);
+            return CE_Failure;
+        }
+        gh = grib_handle_new_from_partial_message(c, headers.data(), headers.size());
+        trace("h = grib_handle_new_from_partial_message(%p, buf, %zu); /* %p, from %s:%llu */", static_cast<const void*>(c), headers.size(), static_cast<const void*>(gh), name, (unsigned long long)offset);
+        if (gh == NULL)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: cannot decode the headers of the GRIB message at offset %llu", name, (unsigned long long)offset);
+            return CE_Failure;
+        }
+        return CE_None;
+    }
+
+    /// Same as new_headers_from_file(c, in, ...), opening the file \a name
+    CPLErr new_headers_from_file(grib_context* c, const char* name, uint64_t offset, uint64_t length)
+    {
+        FILE* in = fopen(name, "rb");
+        if (!in)
+        {
+            CPLError(CE_Failure, CPLE_OpenFailed, "%s cannot be opened: %s", name, strerror(errno));
+            return CE_Failure;
+        }
+        CPLErr res = new_headers_from_file(c, in, name, offset, length);
+        fclose(in);
+        return res;
+    }
+
     long get_long(const char* key)
     {
         long res;
@@ -311,6 +447,22 @@ struct Grib
     CPLErr write(const std::string& filename)
     {
         //fprintf(stderr, "WRITEGRIB TO %s\n", filename.c_str());
+        FILE* out = fopen(filename.c_str(), "w");
+        if (out == NULL)
+        {
+            CPLError(CE_Failure, CPLE_OpenFailed, "cannot open file %s for writing", filename.c_str());
+            return CE_Failure;
+        }
+
+        CPLErr res = write(out, filename);
+        fclose(out);
+        trace("flushed");
+        return res;
+    }
+
+    /// Append the encoded message to \a out, which is open on \a filename
+    CPLErr write(FILE* out, const std::string& filename)
+    {
         const void* buffer;
         size_t size;
 
@@ -323,24 +475,13 @@ struct Grib
         }
         trace("encoded to %zd bytes", size);
 
-        FILE* out = fopen(filename.c_str(), "w");
-        if (out == NULL)
-        {
-            CPLError(CE_Failure, CPLE_OpenFailed, "cannot open file %s for writing", filename.c_str());
-            return CE_Failure;
-        }
-
         /* write the buffer in a file*/
         if (fwrite(buffer, 1, size, out) != size) 
         {
-            fclose(out);
             CPLError(CE_Failure, CPLE_FileIO, "cannot write to file %s", filename.c_str());
             return CE_Failure;
         }
         trace("written to file %s", filename.c_str());
-
-        fclose(out);
-        trace("flushed");
         return CE_None;
     }
 
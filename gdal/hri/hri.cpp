@@ -0,0 +1,349 @@
+#include "hri.h"
+#include <msat/gdal/const.h>
+#include <msat/gdal/dataset.h>
+#include <msat/hri/HRI.h>
+#include <msat/facts.h>
+#include <gdal/gdal_priv.h>
+#include <gdal/ogr_spatialref.h>
+#include "gdal/utils.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+namespace msat {
+namespace hri {
+
+GDALDataset* HRIOpen(GDALOpenInfo* info);
+
+namespace {
+
+/// Offset of the first frame in Tecnavia files
+const int tecnavia_offset = 512;
+
+/**
+ * Check if \a f looks like the first frame of an HRI file, with the
+ * same sync marker check used by Hri, and with a format and a satellite
+ * that Hri can read
+ */
+bool is_hri_first_frame(const unsigned char* f)
+{
+    unsigned short chk_sync[2];
+    memcpy(chk_sync, f, 4);
+    if (chk_sync[0] != 0x0C05 && (chk_sync[1] & 255) != 0xDF)
+        return false;
+
+    // Frame id: A or B/X format
+    if (f[3] != 112 && f[3] != 48)
+        return false;
+
+    // Format indicator in the label subframe
+    if (f[16] != 0 && f[16] != 255 && f[16] != 15)
+        return false;
+
+    // Satellite indicator in the identification subframe
+    if (f[36] != 212 && !(f[36] == 0 && f[37] <= 3))
+        return false;
+
+    return true;
+}
+
+}
+
+class HRIDataset : public GDALDataset
+{
+public:
+    string pathname;
+    Hri hri;
+    double geotransform[6];
+    OGRSpatialReference osr;
+
+    HRIDataset(const string& pathname) : pathname(pathname) {}
+
+    bool init(bool tecnavia);
+    bool init_bands(const std::vector<int>& images);
+
+    const OGRSpatialReference* GetSpatialRef() const override
+    {
+        return &osr;
+    }
+
+    CPLErr GetGeoTransform(double* tr) override
+    {
+        memcpy(tr, geotransform, 6 * sizeof(double));
+        return CE_None;
+    }
+};
+
+/**
+ * Raster band with one of the images of an HRI file.
+ *
+ * Lines are decoded from the file mapping when a block is requested, and
+ * calibrated with the 256-entry table of the image, if it has one.
+ */
+class HRIRasterBand : public GDALRasterBand
+{
+public:
+    HRIDataset* hds;
+    int nimage;
+    bool calibrated = false;
+    float calibration[256];
+    string unit;
+    /// Raw counts of a line, for calibrated reads
+    vector<unsigned char> line;
+
+    HRIRasterBand(HRIDataset* ds, int idx, int nimage);
+
+    const char* GetUnitType() override { return unit.c_str(); }
+
+    double GetNoDataValue(int* pbSuccess=NULL) override
+    {
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 0;
+    }
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
+HRIRasterBand::HRIRasterBand(HRIDataset* ds, int idx, int nimage)
+    : hds(ds), nimage(nimage)
+{
+    poDS = ds;
+    nBand = idx;
+    nBlockXSize = ds->GetRasterXSize();
+    nBlockYSize = 1;
+
+    HRI_image& image = ds->hri.image[nimage];
+    char buf[25];
+    snprintf(buf, 25, "%d", image.get_image_band());
+    SetMetadataItem(MD_MSAT_CHANNEL_ID, buf, MD_DOMAIN_MSAT);
+    SetMetadataItem(MD_MSAT_CHANNEL, image.name.c_str(), MD_DOMAIN_MSAT);
+    SetDescription(image.name.c_str());
+
+    // HRI_image gives a table of 1.0 when it cannot calibrate
+    memcpy(calibration, image.get_calibration(), 256 * sizeof(float));
+    for (int i = 0; i < 256; ++i)
+        if (calibration[i] != 1.0)
+            calibrated = true;
+
+    if (calibrated)
+    {
+        eDataType = GDT_Float32;
+        unit = image.units;
+        line.resize(nBlockXSize);
+    } else
+        // Without a calibration, give access to the raw counts
+        eDataType = GDT_Byte;
+}
+
+CPLErr HRIRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0 || yblock < 0 || yblock >= nRasterYSize)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    // Lines missing from truncated files are left as nodata
+    if (calibrated)
+    {
+        float* dst = (float*)buf;
+        if (hds->hri.read_line(nimage, yblock, line.data()))
+            for (int x = 0; x < nBlockXSize; ++x)
+                dst[x] = calibration[line[x]];
+        else
+            memset(dst, 0, nBlockXSize * sizeof(float));
+    } else
+        hds->hri.read_line(nimage, yblock, (unsigned char*)buf);
+
+    return CE_None;
+}
+
+bool HRIDataset::init(bool tecnavia)
+{
+    // Hri::open only reads the headers, and indexes the data lines
+    try {
+        hri.open(pathname.c_str(), tecnavia);
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", pathname.c_str(), e.what());
+        return false;
+    }
+
+    /// Image time
+    char buf[25];
+    strftime(buf, 25, "%Y-%m-%d %H:%M:00", hri.get_datetime());
+    if (SetMetadataItem(MD_MSAT_DATETIME, buf, MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    /// Spacecraft
+    if (SetMetadataItem(MD_MSAT_SPACECRAFT, hri.get_satellite_name(), MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    return true;
+}
+
+bool HRIDataset::init_bands(const std::vector<int>& images)
+{
+    const HRI_image& first = hri.image[images[0]];
+    nRasterXSize = first.npixels;
+    nRasterYSize = first.nlines;
+
+    /// Projection and geotransform matrix, with the grid of the format
+    /// used by HRI2NetCDF, scaled by the sampling of the image
+    const geolocation* geo = hri.get_geolocation();
+    dataset::set_spaceview(osr, hri.get_satellite_longitude());
+    const double psx = facts::pixelHSizeFromCFAC(labs(geo->CFAC) * exp2(-16));
+    const double psy = facts::pixelVSizeFromLFAC(labs(geo->LFAC) * exp2(-16));
+    geotransform[0] = -geo->COFF * psx;
+    geotransform[3] = geo->LOFF * psy;
+    geotransform[1] = psx * first.samplex;
+    geotransform[5] = -psy * first.sampley;
+    geotransform[2] = 0.0;
+    geotransform[4] = 0.0;
+
+    for (size_t i = 0; i < images.size(); ++i)
+        SetBand(i + 1, new HRIRasterBand(this, i + 1, images[i]));
+
+    return true;
+}
+
+GDALDataset* HRIOpen(GDALOpenInfo* info)
+{
+    // Subdataset with a subset of the images: MSATHRI:n,n,...:pathname
+    string filename;
+    std::vector<int> selected;
+    if (STARTS_WITH_CI(info->pszFilename, "MSATHRI:"))
+    {
+        const char* s = info->pszFilename + 8;
+        while (true)
+        {
+            char* end;
+            long idx = strtol(s, &end, 10);
+            if (end == s) return NULL;
+            selected.push_back(idx);
+            s = end;
+            if (*s == ',') ++s;
+            else if (*s == ':') { ++s; break; }
+            else return NULL;
+        }
+        filename = s;
+    } else {
+        // We want a real file
+        if (info->fpL == NULL) return NULL;
+        filename = info->pszFilename;
+    }
+
+    // Look for the first frame at the start of the file, or after the
+    // header of Tecnavia files
+    unsigned char header[tecnavia_offset + 64];
+    {
+        unique_ptr<FILE, decltype(&fclose)> in(fopen(filename.c_str(), "rb"), fclose);
+        if (!in || fread(header, sizeof(header), 1, in.get()) != 1)
+            return NULL;
+    }
+    bool tecnavia;
+    if (is_hri_first_frame(header))
+        tecnavia = false;
+    else if (is_hri_first_frame(header + tecnavia_offset))
+        tecnavia = true;
+    else
+        return NULL;
+
+    unique_ptr<HRIDataset> ds(new HRIDataset(filename));
+    if (!ds->init(tecnavia)) return NULL;
+    Hri& hri = ds->hri;
+
+    // Group images with the same size, since they can become bands of the
+    // same dataset
+    std::vector<std::vector<int>> groups;
+    for (int i = 0; i < hri.nimages; ++i)
+    {
+        auto g = groups.begin();
+        for ( ; g != groups.end(); ++g)
+            if (hri.image[(*g)[0]].npixels == hri.image[i].npixels
+             && hri.image[(*g)[0]].nlines == hri.image[i].nlines)
+                break;
+        if (g == groups.end())
+            groups.emplace_back(1, i);
+        else
+            g->push_back(i);
+    }
+
+    // By default, use the first group of images as bands
+    if (selected.empty())
+        selected = groups[0];
+
+    for (auto i: selected)
+    {
+        if (i < 0 || i >= hri.nimages)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s has no image %d", filename.c_str(), i);
+            return NULL;
+        }
+        if (hri.image[i].npixels != hri.image[selected[0]].npixels
+         || hri.image[i].nlines != hri.image[selected[0]].nlines)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: image %d does not have the same size as image %d", filename.c_str(), i, selected[0]);
+            return NULL;
+        }
+    }
+
+    if (!ds->init_bands(selected)) return NULL;
+
+    // If the file contains images of different sizes, list them as
+    // subdatasets
+    if (groups.size() > 1 && info->pszFilename == filename)
+    {
+        char** subdatasets = nullptr;
+        for (size_t i = 0; i < groups.size(); ++i)
+        {
+            string name = "MSATHRI:";
+            string desc;
+            for (size_t j = 0; j < groups[i].size(); ++j)
+            {
+                if (j)
+                {
+                    name += ",";
+                    desc += ",";
+                }
+                name += to_string(groups[i][j]);
+                desc += hri.image[groups[i][j]].name;
+            }
+            name += ":" + filename;
+            const HRI_image& first = hri.image[groups[i][0]];
+            subdatasets = CSLSetNameValue(subdatasets, CPLSPrintf("SUBDATASET_%zu_NAME", i + 1), name.c_str());
+            subdatasets = CSLSetNameValue(subdatasets, CPLSPrintf("SUBDATASET_%zu_DESC", i + 1),
+                    CPLSPrintf("%s %dx%d", desc.c_str(), first.npixels, first.nlines));
+        }
+        ds->SetMetadata(subdatasets, "SUBDATASETS");
+        CSLDestroy(subdatasets);
+    }
+
+    return msat::gdal::add_extras(ds.release(), info);
+}
+
+}
+}
+
+extern "C" {
+
+void GDALRegister_MsatHRI()
+{
+    if (!GDAL_CHECK_VERSION("MsatHRI"))
+        return;
+
+    if (GDALGetDriverByName("MsatHRI") == NULL)
+    {
+        unique_ptr<GDALDriver> driver(new GDALDriver());
+        driver->SetDescription("MsatHRI");
+        driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Meteosat HRI (via Meteosatlib)");
+        driver->pfnOpen = msat::hri::HRIOpen;
+        GetGDALDriverManager()->RegisterDriver(driver.release());
+    }
+}
+
+}
@@ -0,0 +1,8 @@
+#ifndef MSAT_GDALDRIVER_HRI_H
+#define MSAT_GDALDRIVER_HRI_H
+
+extern "C" {
+void GDALRegister_MsatHRI(void);
+}
+
+#endif
@@ -20,11 +20,26 @@
  * Author: Enrico Zini <enrico@enricozini.org>
  */
 
+#include "config.h"
 #include "xrit/xrit.h"
+#include "xrit/series.h"
 #include "netcdf/netcdf.h"
 #include "netcdf/netcdf24.h"
 #include "grib/grib.h"
 #include "reflectance/reflectance.h"
+#include "composite/composite.h"
+#ifdef HAVE_OPENMTP
+#include "openmtp/openmtp.h"
+#endif
+#ifdef HAVE_OMTP_IDS
+#include "omtp-ids/omtp-ids.h"
+#endif
+#ifdef HAVE_THORNSDS_DB1
+#include "thornsds_db1/thornsds_db1.h"
+#endif
+#ifdef HAVE_HRI
+#include "hri/hri.h"
+#endif
 
 extern "C" {
 void GDALRegister_Meteosatlib(void);
@@ -32,8 +47,22 @@ void GDALRegister_Meteosatlib(void);
 void GDALRegister_Meteosatlib(void)
 {
     GDALRegister_MsatXRIT();
+    GDALRegister_MsatXRITSeries();
     GDALRegister_MsatNetCDF();
     GDALRegister_MsatNetCDF24();
     GDALRegister_MsatGRIB();
+    GDALRegister_MsatComposite();
+#ifdef HAVE_OPENMTP
+    GDALRegister_MsatOpenMTP();
+#endif
+#ifdef HAVE_OMTP_IDS
+    GDALRegister_MsatOpenMTPIDS();
+#endif
+#ifdef HAVE_THORNSDS_DB1
+    GDALRegister_MsatThornsdsDB1();
+#endif
+#ifdef HAVE_HRI
+    GDALRegister_MsatHRI();
+#endif
 }
 }
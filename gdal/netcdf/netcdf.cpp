@@ -81,7 +81,7 @@ class MsatNetCDFRasterBand : public NetCDFRasterBand
 public:
     bool offset1bug;
 
-    MsatNetCDFRasterBand(NetCDFDataset* ds, int idx, NcVar* var) : NetCDFRasterBand(ds, idx, var), offset1bug(false)
+    MsatNetCDFRasterBand(NetCDFDataset* ds, int idx, NcVar* var) : NetCDFRasterBand(ds, idx, *ds->nc, var), offset1bug(false)
     {
         /// Channel
         NcAtt* a = var->get_att("chnum");
@@ -260,8 +260,12 @@ GDALDataset* NetCDFCreateCopy(const char* pszFilename, GDALDataset* src,
 {
         NcError nce(NcError::silent_nonfatal);
 
+        StorageOptions storage;
+        if (!storage.parse(papszOptions, src->GetRasterXSize(), src->GetRasterYSize()))
+                return NULL;
+
         // Build up output NetCDF file name and open it
-        NcFile ncf(pszFilename, NcFile::Replace);
+        NcFile ncf(pszFilename, NcFile::Replace, NULL, 0, storage.format);
         if (!ncf.is_valid())
         {
                 CPLError(CE_Failure, CPLE_AppDefined, "Cannot create NetCDF file %s: %s", pszFilename, nce.get_errmsg());
@@ -504,10 +508,15 @@ GDALDataset* NetCDFCreateCopy(const char* pszFilename, GDALDataset* src,
                 return NULL;
         }
 
-        for (int i = 1; i <= src->GetRasterCount(); ++i)
+        if (!pfnProgress) pfnProgress = GDALDummyProgress;
+        int nbands = src->GetRasterCount();
+        for (int i = 1; i <= nbands; ++i)
         {
                 GDALRasterBand* rb = src->GetRasterBand(i);
-                NcVar* ivar = rasterBandToNcVar(rb, ncf, tdim, ldim, cdim);
+                void* progress = GDALCreateScaledProgress((double)(i - 1) / nbands, (double)i / nbands, pfnProgress, pProgressData);
+                NcVar* ivar = rasterBandToNcVar(rb, ncf, tdim, ldim, cdim, GDALScaledProgress, progress, &storage);
+                GDALDestroyScaledProgress(progress);
+                if (!ivar) return NULL;
 
                 sval = rb->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT);
                 if (sval != NULL)
@@ -539,6 +548,7 @@ void GDALRegister_MsatNetCDF()
         driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Meteosatlib NetCDF");
         //driver->SetMetadataItem(GDAL_DMD_HELPTOPIC, "frmt_various.html#JDEM");
         driver->SetMetadataItem(GDAL_DMD_EXTENSION, "nc");
+        driver->SetMetadataItem(GDAL_DMD_CREATIONOPTIONLIST, msat::netcdf::storage_creation_options);
         driver->pfnOpen = msat::netcdf::NetCDFOpen;
         driver->pfnCreateCopy = msat::netcdf::NetCDFCreateCopy;
         GetGDALDriverManager()->RegisterDriver(driver.release());
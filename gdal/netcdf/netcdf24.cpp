@@ -76,7 +76,7 @@ public:
 class NetCDF24RasterBand : public NetCDFRasterBand
 {
 public:
-    NetCDF24RasterBand(NetCDF24Dataset* ds, int idx, NcVar* var) : NetCDFRasterBand(ds, idx, var)
+    NetCDF24RasterBand(NetCDF24Dataset* ds, int idx, NcVar* var) : NetCDFRasterBand(ds, idx, *ds->nc, var)
     {
         /// Channel
         if (NcAtt* a = var->get_att("L1"))
@@ -533,10 +533,15 @@ GDALDataset* NetCDF24CreateCopy(const char* pszFilename, GDALDataset* src,
                 return NULL;
         }
 
-        for (int i = 1; i <= src->GetRasterCount(); ++i)
+        if (!pfnProgress) pfnProgress = GDALDummyProgress;
+        int nbands = src->GetRasterCount();
+        for (int i = 1; i <= nbands; ++i)
         {
                 GDALRasterBand* rb = src->GetRasterBand(i);
-                NcVar* ivar = rasterBandToNcVar(rb, ncf, tdim, ldim, cdim);
+                void* progress = GDALCreateScaledProgress((double)(i - 1) / nbands, (double)i / nbands, pfnProgress, pProgressData);
+                NcVar* ivar = rasterBandToNcVar(rb, ncf, tdim, ldim, cdim, GDALScaledProgress, progress);
+                GDALDestroyScaledProgress(progress);
+                if (!ivar) return NULL;
 
                 const char* sval = rb->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT);
                 if (sval != NULL)
@@ -19,13 +19,48 @@
 
 #include "utils.h"
 #include <msat/facts.h>
+#include <msat/gdal/dataset.h>
+#include <msat/Progress.h>
+#include <cpl_string.h>
+#include <netcdf.h>
+#include <cstring>
+#include <cstdint>
 #include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <future>
 
 using namespace std;
 
 namespace msat {
 namespace netcdf {
 
+std::mutex library_mutex;
+
+// Size in bytes of each of the two buffers used when copying image data
+static const size_t copy_strip_size = 16 * 1024 * 1024;
+
+// Default chunk height: one segment of a non-HRV SEVIRI image
+static const int default_chunk_lines = 464;
+
+const char* storage_creation_options =
+"<CreationOptionList>"
+"   <Option name='FORMAT' type='string-select' default='NC'>"
+"       <Value>NC</Value>"
+"       <Value>NC4</Value>"
+"       <Value>NC4C</Value>"
+"   </Option>"
+"   <Option name='COMPRESS' type='string-select' default='NONE'>"
+"       <Value>NONE</Value>"
+"       <Value>DEFLATE</Value>"
+"   </Option>"
+"   <Option name='ZLEVEL' type='int' description='DEFLATE compression level 1-9' default='1'/>"
+"   <Option name='SHUFFLE' type='boolean' description='Shuffle bytes before compressing' default='YES'/>"
+"   <Option name='BLOCKXSIZE' type='int' description='Chunk width in columns (NC4 only)'/>"
+"   <Option name='BLOCKYSIZE' type='int' description='Chunk height in lines (NC4 only)' default='464'/>"
+"</CreationOptionList>";
+
 time_t forecastSeconds2000(const char* timestr)
 {
         const time_t s_epoch_2000 = 946684800;
@@ -59,13 +94,25 @@ time_t forecastSeconds2000(const char* timestr)
 }
 
 
-NetCDFRasterBand::NetCDFRasterBand(GDALDataset* ds, int idx, NcVar* var) : var(var), _unsigned(false), channel_id(0)
+NetCDFRasterBand::NetCDFRasterBand(GDALDataset* ds, int idx, NcFile& ncf, NcVar* var) : var(var), _unsigned(false), channel_id(0)
 {
         poDS = ds;
         nBand = idx;
 
-        nBlockXSize = var->get_dim(2)->size();
-        nBlockYSize = var->get_dim(1)->size();
+        nRasterXSize = var->get_dim(2)->size();
+        nRasterYSize = var->get_dim(1)->size();
+
+        // Use chunks as blocks, or single lines for contiguous variables
+        int storage = NC_CONTIGUOUS;
+        size_t chunks[3];
+        if (nc_inq_var_chunking(ncf.id(), var->id(), &storage, chunks) == NC_NOERR && storage == NC_CHUNKED)
+        {
+                nBlockXSize = chunks[2];
+                nBlockYSize = chunks[1];
+        } else {
+                nBlockXSize = nRasterXSize;
+                nBlockYSize = 1;
+        }
 
         // Choose data type
         string _Unsigned = getAttr(*var, "_Unsigned", "false");
@@ -155,29 +202,29 @@ double NetCDFRasterBand::GetNoDataValue(int* pbSuccess)
         return facts::defaultPackedMissing(channel_id);
 }
 
-CPLErr NetCDFRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+CPLErr NetCDFRasterBand::read_window(int x, int y, int sx, int sy, void* buf)
 {
         NcError nce(NcError::silent_nonfatal);
-        if (xblock != 0 || yblock != 0)
+        bool res = false;
+
+        std::lock_guard<std::mutex> lock(library_mutex);
+        if (!var->set_cur(0, y, x))
         {
-                CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+                CPLError(CE_Failure, CPLE_AppDefined, "cannot seek to image pixels %d,%d", x, y);
                 return CE_Failure;
         }
-        
-        bool res = false;
-
         switch (eDataType)
         {
-                case GDT_Byte:    res = var->get((ncbyte*)buf, 1, nBlockYSize, nBlockXSize); break;
+                case GDT_Byte:    res = var->get((ncbyte*)buf, 1, sy, sx); break;
                 case GDT_Int16:
-                case GDT_UInt16:  res = var->get( (short*)buf, 1, nBlockYSize, nBlockXSize); break;
+                case GDT_UInt16:  res = var->get( (short*)buf, 1, sy, sx); break;
                 case GDT_Int32:
-                case GDT_UInt32:  res = var->get(  (long*)buf, 1, nBlockYSize, nBlockXSize); break;
-                case GDT_Float32: res = var->get( (float*)buf, 1, nBlockYSize, nBlockXSize); break;
-                case GDT_Float64: res = var->get((double*)buf, 1, nBlockYSize, nBlockXSize); break;
+                case GDT_UInt32:  res = var->get(   (int*)buf, 1, sy, sx); break;
+                case GDT_Float32: res = var->get( (float*)buf, 1, sy, sx); break;
+                case GDT_Float64: res = var->get((double*)buf, 1, sy, sx); break;
                 default:
                         CPLError(CE_Failure, CPLE_AppDefined, "Unsupported raster band data type %d", (int)eDataType);
-                        break;
+                        return CE_Failure;
         }
 
         if (!res)
@@ -189,28 +236,230 @@ CPLErr NetCDFRasterBand::IReadBlock(int xblock, int yblock, void *buf)
         return CE_None;
 }
 
-template<typename DTYPE>
-bool copy_data(NcVar& dst, GDALRasterBand& src, GDALDataType outType)
+CPLErr NetCDFRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+        int x = xblock * nBlockXSize;
+        int y = yblock * nBlockYSize;
+        if (x >= nRasterXSize || y >= nRasterYSize)
+        {
+                CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+                return CE_Failure;
+        }
+
+        // Blocks at the right and bottom edges may be partial
+        int sx = min(nBlockXSize, nRasterXSize - x);
+        int sy = min(nBlockYSize, nRasterYSize - y);
+        CPLErr err = read_window(x, y, sx, sy, buf);
+        if (err != CE_None) return err;
+
+        // Spread the lines of partial blocks to the block width
+        if (sx < nBlockXSize)
+        {
+                int size = GDALGetDataTypeSizeBytes(eDataType);
+                uint8_t* dest = (uint8_t*)buf;
+                for (int line = sy - 1; line > 0; --line)
+                        memmove(dest + (size_t)line * nBlockXSize * size, dest + (size_t)line * sx * size, (size_t)sx * size);
+        }
+
+        return CE_None;
+}
+
+CPLErr NetCDFRasterBand::IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                   void* pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                   GSpacing nPixelSpace, GSpacing nLineSpace, GDALRasterIOExtraArg* psExtraArg)
+{
+        // Read windows at full resolution and in the variable's own data type
+        // with a single hyperslab read
+        int size = GDALGetDataTypeSizeBytes(eDataType);
+        if (eRWFlag == GF_Read
+                && nXSize == nBufXSize && nYSize == nBufYSize
+                && eBufType == eDataType
+                && nPixelSpace == size && nLineSpace == nPixelSpace * nBufXSize)
+                return read_window(nXOff, nYOff, nXSize, nYSize, pData);
+
+        return GDALRasterBand::IRasterIO(eRWFlag, nXOff, nYOff, nXSize, nYSize,
+                                         pData, nBufXSize, nBufYSize, eBufType,
+                                         nPixelSpace, nLineSpace, psExtraArg);
+}
+
+bool StorageOptions::parse(char** options, int sx, int sy)
 {
-    DTYPE* pixels = new DTYPE[src.GetXSize()*src.GetYSize()];
-    if (src.RasterIO(GF_Read, 0, 0, src.GetXSize(), src.GetYSize(), pixels, src.GetXSize(), src.GetYSize(), outType, 0, 0) != CE_None)
+    const char* compress = CSLFetchNameValueDef(options, "COMPRESS", "NONE");
+    if (EQUAL(compress, "DEFLATE"))
+        deflate_level = atoi(CSLFetchNameValueDef(options, "ZLEVEL", "1"));
+    else if (!EQUAL(compress, "NONE"))
+    {
+        CPLError(CE_Failure, CPLE_NotSupported, "Unsupported COMPRESS value '%s'", compress);
+        return false;
+    }
+    if (EQUAL(compress, "DEFLATE") && (deflate_level < 1 || deflate_level > 9))
+    {
+        CPLError(CE_Failure, CPLE_IllegalArg, "ZLEVEL must be between 1 and 9");
+        return false;
+    }
+    shuffle = deflate_level && CPLFetchBool(options, "SHUFFLE", true);
+
+    // Compression needs NetCDF-4
+    const char* fmt = CSLFetchNameValueDef(options, "FORMAT", deflate_level ? "NC4" : "NC");
+    if (EQUAL(fmt, "NC"))
+        format = NcFile::Classic;
+    else if (EQUAL(fmt, "NC4"))
+        format = NcFile::Netcdf4;
+    else if (EQUAL(fmt, "NC4C"))
+        format = NcFile::Netcdf4Classic;
+    else
+    {
+        CPLError(CE_Failure, CPLE_NotSupported, "Unsupported FORMAT value '%s'", fmt);
+        return false;
+    }
+
+    if (format == NcFile::Classic)
     {
-        delete[] pixels;
+        if (deflate_level)
+        {
+            CPLError(CE_Failure, CPLE_NotSupported, "Compression requires FORMAT=NC4 or FORMAT=NC4C");
+            return false;
+        }
+        return true;
+    }
+
+    chunk_columns = atoi(CSLFetchNameValueDef(options, "BLOCKXSIZE", "0"));
+    chunk_lines = atoi(CSLFetchNameValueDef(options, "BLOCKYSIZE", "0"));
+    if (chunk_columns < 0 || chunk_lines < 0)
+    {
+        CPLError(CE_Failure, CPLE_IllegalArg, "BLOCKXSIZE and BLOCKYSIZE cannot be negative");
         return false;
     }
-    if (!dst.put(pixels, 1, src.GetYSize(), src.GetXSize()))
+    if (chunk_columns == 0 || chunk_columns > sx) chunk_columns = sx;
+    if (chunk_lines == 0) chunk_lines = default_chunk_lines;
+    if (chunk_lines > sy) chunk_lines = sy;
+    return true;
+}
+
+bool StorageOptions::apply(NcFile& ncf, NcVar& var) const
+{
+    if (chunk_columns && chunk_lines)
+    {
+        size_t chunks[3] = { 1, (size_t)chunk_lines, (size_t)chunk_columns };
+        int res = nc_def_var_chunking(ncf.id(), var.id(), NC_CHUNKED, chunks);
+        if (res != NC_NOERR)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "Cannot set chunking of variable '%s': %s", var.name(), nc_strerror(res));
+            return false;
+        }
+    }
+
+    if (deflate_level)
+    {
+        int res = nc_def_var_deflate(ncf.id(), var.id(), shuffle ? 1 : 0, 1, deflate_level);
+        if (res != NC_NOERR)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "Cannot set compression of variable '%s': %s", var.name(), nc_strerror(res));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename DTYPE>
+bool copy_data(NcVar& dst, GDALRasterBand& src, GDALDataType outType, DTYPE fill, GDALProgressFunc pfnProgress, void* pProgressData)
+{
+    int sx = src.GetXSize();
+    int sy = src.GetYSize();
+    int strip_lines = max<size_t>(1, copy_strip_size / (sizeof(DTYPE) * sx));
+    std::vector<DTYPE> buffers[2];
+    buffers[0].resize((size_t)strip_lines * sx);
+    buffers[1].resize((size_t)strip_lines * sx);
+
+    std::shared_ptr<const msat::dataset::EarthDisk> disk = msat::dataset::earth_disk_mask(&src);
+
+    // Read lines [y, y + lines) into pixels
+    auto read_strip = [&](int y, int lines, DTYPE* pixels) {
+        if (!disk)
+            return src.RasterIO(GF_Read, 0, y, sx, lines, pixels, sx, lines, outType, 0, 0) == CE_None;
+
+        // Only read the part of each line that sees the Earth, and write
+        // space as _FillValue
+        std::fill(pixels, pixels + (size_t)lines * sx, fill);
+        for (int iy = 0; iy < lines; ++iy)
+        {
+            int start = disk->starts[y + iy];
+            int end = disk->ends[y + iy];
+            if (start >= end) continue;
+            if (src.RasterIO(GF_Read, start, y + iy, end - start, 1, pixels + (size_t)iy * sx + start, end - start, 1, outType, 0, 0) != CE_None)
+                return false;
+        }
+        return true;
+    };
+
+    // GDAL errors are kept per thread: strips read in the background keep the
+    // last error raised, to report it again from this thread
+    struct StripError
     {
-        delete[] pixels;
-        CPLError(CE_Failure, CPLE_AppDefined, "Cannot write image values");
+        CPLErr type = CE_None;
+        CPLErrorNum no = CPLE_None;
+        std::string msg;
+    };
+    auto read_strip_async = [&](int y, int lines, DTYPE* pixels, StripError* err) {
+        CPLPushErrorHandler(CPLQuietErrorHandler);
+        CPLErrorReset();
+        bool res = read_strip(y, lines, pixels);
+        err->type = CPLGetLastErrorType();
+        err->no = CPLGetLastErrorNo();
+        err->msg = CPLGetLastErrorMsg();
+        CPLPopErrorHandler();
+        return res;
+    };
+
+    if (!read_strip(0, min(strip_lines, sy), buffers[0].data()))
         return false;
+
+    for (int y = 0, cur = 0; y < sy; y += strip_lines, cur = 1 - cur)
+    {
+        int lines = min(strip_lines, sy - y);
+
+        // Read the next strip while this one is written
+        std::future<bool> next;
+        StripError next_error;
+        if (y + lines < sy)
+            next = std::async(std::launch::async, read_strip_async, y + lines, min(strip_lines, sy - y - lines), buffers[1 - cur].data(), &next_error);
+
+        bool written;
+        {
+            std::lock_guard<std::mutex> lock(library_mutex);
+            written = dst.set_cur(0, y, 0) && dst.put(buffers[cur].data(), 1, lines, sx);
+        }
+        bool read = next.valid() ? next.get() : true;
+        if (next_error.type != CE_None)
+            CPLError(next_error.type, next_error.no, "%s", next_error.msg.c_str());
+
+        if (!written)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "Cannot write image values");
+            return false;
+        }
+        if (!read)
+            return false;
+
+        if (!pfnProgress((double)(y + lines) / sy, nullptr, pProgressData))
+        {
+            CPLError(CE_Failure, CPLE_UserInterrupt, "User terminated");
+            return false;
+        }
     }
-    delete[] pixels;
+
     return true;
 }
 
-NcVar* rasterBandToNcVar(GDALRasterBand* rb, NcFile& ncf, NcDim* tdim, NcDim* ldim, NcDim* cdim)
+NcVar* rasterBandToNcVar(GDALRasterBand* rb, NcFile& ncf, NcDim* tdim, NcDim* ldim, NcDim* cdim,
+                         GDALProgressFunc pfnProgress, void* pProgressData,
+                         const StorageOptions* storage)
 {
     NcError nce(NcError::silent_nonfatal);
+    ProgressSpan span("encode");
+    span.add_pixels((uint64_t)rb->GetXSize() * rb->GetYSize());
+    if (!pfnProgress) pfnProgress = GDALDummyProgress;
     GDALDataType dtype = rb->GetRasterDataType();
     NcType dtdst;
     GDALDataType gdaldst;
@@ -250,6 +499,7 @@ NcVar* rasterBandToNcVar(GDALRasterBand* rb, NcFile& ncf, NcDim* tdim, NcDim* ld
     if (!ncfAddAttr(*ivar, "units", rb->GetUnitType())) return NULL;
     if (_Unsigned)
         if (!ncfAddAttr(*ivar, "_Unsigned", "true")) return NULL;
+    if (storage && !storage->apply(ncf, *ivar)) return NULL;
 
     // Write output values
     //cerr << "output." << endl;
@@ -258,23 +508,23 @@ NcVar* rasterBandToNcVar(GDALRasterBand* rb, NcFile& ncf, NcDim* tdim, NcDim* ld
     {
         case ncByte:
             if (!ncfAddAttr(*ivar, "_FillValue", (int8_t)rb->GetNoDataValue())) return NULL;
-            res = copy_data<ncbyte>(*ivar, *rb, gdaldst);
+            res = copy_data<ncbyte>(*ivar, *rb, gdaldst, (int8_t)rb->GetNoDataValue(), pfnProgress, pProgressData);
             break;
         case ncShort:
             if (!ncfAddAttr(*ivar, "_FillValue", (int16_t)rb->GetNoDataValue())) return NULL;
-            res = copy_data<int16_t>(*ivar, *rb, gdaldst);
+            res = copy_data<int16_t>(*ivar, *rb, gdaldst, (int16_t)rb->GetNoDataValue(), pfnProgress, pProgressData);
             break;
         case ncInt:
             if (!ncfAddAttr(*ivar, "_FillValue", (int32_t)rb->GetNoDataValue())) return NULL;
-            res = copy_data<int32_t>(*ivar, *rb, gdaldst);
+            res = copy_data<int32_t>(*ivar, *rb, gdaldst, (int32_t)rb->GetNoDataValue(), pfnProgress, pProgressData);
             break;
         case ncFloat:
             if (!ncfAddAttr(*ivar, "_FillValue", (float)rb->GetNoDataValue())) return NULL;
-            res = copy_data<float>(*ivar, *rb, gdaldst);
+            res = copy_data<float>(*ivar, *rb, gdaldst, (float)rb->GetNoDataValue(), pfnProgress, pProgressData);
             break;
         case ncDouble:
             if (!ncfAddAttr(*ivar, "_FillValue", (double)rb->GetNoDataValue())) return NULL;
-            res = copy_data<double>(*ivar, *rb, gdaldst);
+            res = copy_data<double>(*ivar, *rb, gdaldst, (double)rb->GetNoDataValue(), pfnProgress, pProgressData);
             break;
         default:
             CPLError(CE_Failure, CPLE_AppDefined, "programming error: an unsupported target data type has been selected");
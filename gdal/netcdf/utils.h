@@ -23,6 +23,7 @@
 #include <netcdfcpp.h>
 #include <stdexcept>
 #include <gdal_priv.h>
+#include <mutex>
 
 namespace msat {
 namespace netcdf {
@@ -61,6 +62,19 @@ static int ncfAddAttr(NCObject& ncf, const char* name, const T& val)
 
 time_t forecastSeconds2000(const char* timestr);
 
+/**
+ * Serialise image data access to the NetCDF library, which is not thread
+ * safe, between readers and the writer thread of rasterBandToNcVar
+ */
+extern std::mutex library_mutex;
+
+/**
+ * Raster band for a (time, line, column) image variable.
+ *
+ * Blocks match the chunks of chunked variables, and are single lines
+ * otherwise. Reads of windows at full resolution go straight to the
+ * variable as hyperslabs, bypassing the block cache.
+ */
 class NetCDFRasterBand : public GDALRasterBand
 {
 public:
@@ -68,16 +82,63 @@ public:
         bool _unsigned;
         int channel_id;
 
-        NetCDFRasterBand(GDALDataset* ds, int idx, NcVar* var);
+        NetCDFRasterBand(GDALDataset* ds, int idx, NcFile& ncf, NcVar* var);
 
         const char* GetUnitType() override;
         double GetOffset(int* pbSuccess=NULL) override;
         double GetScale(int* pbSuccess=NULL) override;
         double GetNoDataValue(int* pbSuccess=NULL) override;
         CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+        CPLErr IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                         void* pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                         GSpacing nPixelSpace, GSpacing nLineSpace, GDALRasterIOExtraArg* psExtraArg) override;
+
+protected:
+        /// Read the window x, y, sx, sy into buf, as sy lines of sx samples
+        CPLErr read_window(int x, int y, int sx, int sy, void* buf);
 };
 
-NcVar* rasterBandToNcVar(GDALRasterBand* rb, NcFile& ncf, NcDim* tdim, NcDim* ldim, NcDim* cdim);
+/**
+ * File format and storage layout of the image variables of a new NetCDF file.
+ *
+ * Chunking and compression require a NetCDF-4 file format.
+ */
+struct StorageOptions
+{
+    NcFile::FileFormat format = NcFile::Classic;
+    /// Chunk width in columns, or 0 for contiguous storage
+    int chunk_columns = 0;
+    /// Chunk height in lines, or 0 for contiguous storage
+    int chunk_lines = 0;
+    /// Deflate compression level from 1 to 9, or 0 for no compression
+    int deflate_level = 0;
+    /// Shuffle bytes before compressing
+    bool shuffle = false;
+
+    /**
+     * Read the FORMAT, COMPRESS, ZLEVEL, SHUFFLE, BLOCKXSIZE and BLOCKYSIZE
+     * creation options for an image of sx × sy pixels.
+     *
+     * Returns false and raises a CPLError if an option is invalid.
+     */
+    bool parse(char** options, int sx, int sy);
+
+    /// Set chunking and compression on a newly created image variable
+    bool apply(NcFile& ncf, NcVar& var) const;
+};
+
+/// GDAL_DMD_CREATIONOPTIONLIST documentation of StorageOptions
+extern const char* storage_creation_options;
+
+/**
+ * Add a variable for \a rb to \a ncf, and copy its image data.
+ *
+ * The image is copied in strips of lines, reading the next strip in a
+ * separate thread while the current one is being written.
+ */
+NcVar* rasterBandToNcVar(GDALRasterBand* rb, NcFile& ncf, NcDim* tdim, NcDim* ldim, NcDim* cdim,
+                         GDALProgressFunc pfnProgress=nullptr, void* pProgressData=nullptr,
+                         const StorageOptions* storage=nullptr);
 
 }
 }
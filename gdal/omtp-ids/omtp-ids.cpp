@@ -0,0 +1,315 @@
+#include "omtp-ids.h"
+#include <msat/gdal/const.h>
+#include <msat/omtp-ids/Constants.hh>
+#include <msat/omtp-ids/FileHeader.hh>
+#include <msat/omtp-ids/ByteSex.hh>
+#include <msat/utils/sys.h>
+#include <gdal/gdal_priv.h>
+#include "gdal/utils.h"
+#include <map>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace msat {
+namespace openmtp_ids {
+
+GDALDataset* OpenMTPIDSOpen(GDALOpenInfo* info);
+
+namespace {
+
+/// Offset of the satellite name in the file header
+const size_t satellite_offset = 28;
+
+const char* channel_name(int channel_id)
+{
+    switch (channel_id)
+    {
+        case omtp_ids::VIS_1:
+        case omtp_ids::VIS_2:
+        case omtp_ids::VIS_1_2:
+        case omtp_ids::VIS_3:
+        case omtp_ids::VIS_4:
+        case omtp_ids::VIS_2_3:
+        case omtp_ids::VIS_2_4:
+        case omtp_ids::VIS_3_4: return "VIS";
+        case omtp_ids::IR_1:
+        case omtp_ids::IR_2: return "IR";
+        case omtp_ids::WV_1:
+        case omtp_ids::WV_2: return "WV";
+        default: return "unknown";
+    }
+}
+
+const char* spacecraft_name(int satellite_id)
+{
+    switch (satellite_id)
+    {
+        case omtp_ids::METEOSAT_3: return "METEOSAT 3";
+        case omtp_ids::METEOSAT_4: return "METEOSAT 4";
+        case omtp_ids::METEOSAT_5: return "METEOSAT 5";
+        case omtp_ids::METEOSAT_6: return "METEOSAT 6";
+        case omtp_ids::MTP_1: return "MTP 1";
+        case omtp_ids::MTP_2: return "MTP 2";
+        default: return "METEOSAT";
+    }
+}
+
+}
+
+/// Position of the pixels of a scan line in the file
+struct LineIndex
+{
+    size_t offset;
+    int no_pixels;
+};
+
+class OpenMTPIDSDataset : public GDALDataset
+{
+public:
+    string pathname;
+    FileHeader fileheader;
+    /// The whole file mapped in memory
+    unique_ptr<sys::MMap> data;
+    /// Scan lines of each channel, in file order
+    map<int, vector<LineIndex>> lines;
+
+    OpenMTPIDSDataset(const string& pathname) : pathname(pathname) {}
+
+    bool init();
+
+    /**
+     * Scan the record and line headers, indexing the position of the scan
+     * lines of each channel without reading their pixels
+     */
+    bool index();
+};
+
+/**
+ * Raster band with the raw counts of one channel of an OpenMTP-IDS image.
+ *
+ * Scan lines are read from the file mapping when a block is requested.
+ */
+class OpenMTPIDSRasterBand : public GDALRasterBand
+{
+public:
+    OpenMTPIDSDataset* ids;
+    const vector<LineIndex>& lines;
+
+    OpenMTPIDSRasterBand(OpenMTPIDSDataset* ds, int idx, int channel_id);
+
+    double GetNoDataValue(int* pbSuccess=NULL) override
+    {
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 0;
+    }
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
+OpenMTPIDSRasterBand::OpenMTPIDSRasterBand(OpenMTPIDSDataset* ds, int idx, int channel_id)
+    : ids(ds), lines(ds->lines[channel_id])
+{
+    poDS = ds;
+    nBand = idx;
+    eDataType = GDT_Byte;
+    nBlockXSize = ds->GetRasterXSize();
+    nBlockYSize = 1;
+
+    char buf[25];
+    snprintf(buf, 25, "%d", channel_id);
+    SetMetadataItem(MD_MSAT_CHANNEL_ID, buf, MD_DOMAIN_MSAT);
+    const char* name = channel_name(channel_id);
+    SetMetadataItem(MD_MSAT_CHANNEL, name, MD_DOMAIN_MSAT);
+    SetDescription(name);
+}
+
+CPLErr OpenMTPIDSRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0 || yblock < 0 || yblock >= nRasterYSize)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    // Channels with fewer or shorter lines than the dataset are padded
+    // with nodata
+    memset(buf, 0, nBlockXSize);
+    if ((size_t)yblock < lines.size())
+    {
+        const LineIndex& line = lines[yblock];
+        const unsigned char* base = *ids->data;
+        memcpy(buf, base + line.offset, min(line.no_pixels, nBlockXSize));
+    }
+
+    return CE_None;
+}
+
+bool OpenMTPIDSDataset::index()
+{
+    using namespace omtp_ids;
+
+    const unsigned char* base = *data;
+    const size_t size = data->size();
+
+    // The file header fills the first record
+    size_t pos = max(FILEHEADER_LEN, fileheader.record_length() + FORTRAN_LEN);
+    const int no_records = fileheader.no_records() - 1;
+    for (int r = 0; r < no_records; ++r)
+    {
+        if (pos + FORTRAN_LEN + RECORDHEADER_LEN > size)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: file truncated in record %d header", pathname.c_str(), r);
+            return false;
+        }
+        const int no_scanlines = ByteSex::big::get2(base + pos + FORTRAN_LEN + 2);
+        pos += FORTRAN_LEN + RECORDHEADER_LEN;
+
+        for (int l = 0; l < no_scanlines; ++l)
+        {
+            if (pos + LINEHEADER_LEN > size)
+            {
+                CPLError(CE_Failure, CPLE_AppDefined, "%s: file truncated in record %d line %d header", pathname.c_str(), r, l);
+                return false;
+            }
+            const unsigned char* h = base + pos;
+            const size_t length = ByteSex::big::get2(h);
+            const int no_pixels = ByteSex::big::get2(h + 6);
+            const int channel_id = ByteSex::big::get2(h + 8);
+            if (length < LINEHEADER_LEN + (size_t)no_pixels || pos + length > size)
+            {
+                CPLError(CE_Failure, CPLE_AppDefined, "%s: invalid length of record %d line %d", pathname.c_str(), r, l);
+                return false;
+            }
+
+            // Filler lines have no channel
+            if (channel_id != NO_DATA)
+                lines[channel_id].push_back(LineIndex{pos + LINEHEADER_LEN, no_pixels});
+            pos += length;
+        }
+    }
+
+    return true;
+}
+
+bool OpenMTPIDSDataset::init()
+{
+    try {
+        sys::File in(std::filesystem::path(pathname), O_RDONLY);
+        struct stat st;
+        in.fstat(st);
+        data.reset(new sys::MMap(in.mmap(st.st_size, PROT_READ, MAP_SHARED)));
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", pathname.c_str(), e.what());
+        return false;
+    }
+
+    // Parse the file header with the omtp-ids library: the record length
+    // is 16 bits, so the header is in the first 64Kb of the file
+    const char* base = *data;
+    istringstream in(string(base, min(data->size(), (size_t)(omtp_ids::FORTRAN_LEN + 0xffff))));
+    in >> fileheader;
+    if (!in.good())
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: file truncated in file header", pathname.c_str());
+        return false;
+    }
+
+    if (!index()) return false;
+    if (lines.empty())
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: file has no scan lines", pathname.c_str());
+        return false;
+    }
+
+    nRasterXSize = 0;
+    nRasterYSize = 0;
+    for (const auto& channel: lines)
+    {
+        nRasterYSize = max(nRasterYSize, (int)channel.second.size());
+        for (const auto& line: channel.second)
+            nRasterXSize = max(nRasterXSize, line.no_pixels);
+    }
+    if (nRasterXSize == 0)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: file has no pixels", pathname.c_str());
+        return false;
+    }
+
+    /// Image time
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    t.tm_year = fileheader.year() - 1900;
+    t.tm_mday = fileheader.julian_day();
+    t.tm_hour = fileheader.hour();
+    t.tm_min = fileheader.minute();
+    time_t ts = timegm(&t);
+    gmtime_r(&ts, &t);
+    char buf[25];
+    strftime(buf, 25, "%Y-%m-%d %H:%M:00", &t);
+    if (SetMetadataItem(MD_MSAT_DATETIME, buf, MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    /// Spacecraft
+    if (SetMetadataItem(MD_MSAT_SPACECRAFT, spacecraft_name(fileheader.satellite_id()), MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    /// One raster band per channel
+    int idx = 1;
+    for (const auto& channel: lines)
+    {
+        SetBand(idx, new OpenMTPIDSRasterBand(this, idx, channel.first));
+        ++idx;
+    }
+
+    return true;
+}
+
+GDALDataset* OpenMTPIDSOpen(GDALOpenInfo* info)
+{
+    // We want a real file
+    if (info->fpL == NULL) return NULL;
+
+    // Look for the Fortran record marker and the satellite name in the file
+    // header
+    if (info->nHeaderBytes < omtp_ids::FILEHEADER_LEN)
+        return NULL;
+    if (memcmp(info->pabyHeader, omtp_ids::FORTRAN, omtp_ids::FORTRAN_LEN) != 0)
+        return NULL;
+    if (memcmp(info->pabyHeader + satellite_offset, omtp_ids::SATELLITE, omtp_ids::SATELLITE_LEN) != 0)
+        return NULL;
+
+    unique_ptr<OpenMTPIDSDataset> ds(new OpenMTPIDSDataset(info->pszFilename));
+    if (!ds->init()) return NULL;
+
+    return msat::gdal::add_extras(ds.release(), info);
+}
+
+}
+}
+
+extern "C" {
+
+void GDALRegister_MsatOpenMTPIDS()
+{
+    if (!GDAL_CHECK_VERSION("MsatOpenMTPIDS"))
+        return;
+
+    if (GDALGetDriverByName("MsatOpenMTPIDS") == NULL)
+    {
+        unique_ptr<GDALDriver> driver(new GDALDriver());
+        driver->SetDescription("MsatOpenMTPIDS");
+        driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Meteosat OpenMTP-IDS (via Meteosatlib)");
+        driver->pfnOpen = msat::openmtp_ids::OpenMTPIDSOpen;
+        GetGDALDriverManager()->RegisterDriver(driver.release());
+    }
+}
+
+}
@@ -0,0 +1,8 @@
+#ifndef MSAT_GDALDRIVER_OMTP_IDS_H
+#define MSAT_GDALDRIVER_OMTP_IDS_H
+
+extern "C" {
+void GDALRegister_MsatOpenMTPIDS(void);
+}
+
+#endif
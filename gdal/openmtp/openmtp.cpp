@@ -0,0 +1,309 @@
+#include "openmtp.h"
+#include <msat/gdal/const.h>
+#include <msat/gdal/dataset.h>
+#include <msat/openmtp/OpenMTP_binary_header.h>
+#include <msat/openmtp/OpenMTP_image.h>
+#include <msat/openmtp/OpenMTP_machine.h>
+#include <msat/utils/sys.h>
+#include <msat/facts.h>
+#include <gdal/gdal_priv.h>
+#include <gdal/ogr_spatialref.h>
+#include "gdal/utils.h"
+#include <fstream>
+#include <memory>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace msat {
+namespace openmtp {
+
+GDALDataset* OpenMTPOpen(GDALOpenInfo* info);
+
+namespace {
+
+// Sizes of the parts of an OpenMTP file, from the Eumetsat EUM-FG-1 Format
+// Guide, as read by OpenMTP_ascii_header, OpenMTP_binary_header and
+// OpenMTP_image_line
+const size_t ascii_header_length = 1345;
+const size_t binary_header_first_section_length = 5175;
+const size_t binary_header_second_section_length = 2636;
+const size_t binary_header_third_section_normal_length = 136704;
+const size_t binary_header_third_section_vis_cmp_length = 185188;
+const size_t line_header_length = 32;
+const int max_pixels = 5000;
+
+}
+
+class OpenMTPDataset : public GDALDataset
+{
+public:
+    string pathname;
+    OpenMTP_binary_header header;
+    /// The whole file mapped in memory
+    unique_ptr<sys::MMap> data;
+    /// Offset of the first image line in the file
+    size_t data_offset = 0;
+    bool georeferenced = false;
+    double geotransform[6];
+    OGRSpatialReference osr;
+
+    OpenMTPDataset(const string& pathname) : pathname(pathname) {}
+
+    bool init();
+
+    /// Size of a line record in the file
+    size_t line_length() const { return line_header_length + nRasterXSize; }
+
+    /// Pixel values of line \a y
+    const unsigned char* line(int y) const
+    {
+        const unsigned char* base = *data;
+        return base + data_offset + y * line_length() + line_header_length;
+    }
+
+    const OGRSpatialReference* GetSpatialRef() const override
+    {
+        return georeferenced ? &osr : nullptr;
+    }
+
+    CPLErr GetGeoTransform(double* tr) override
+    {
+        if (!georeferenced) return CE_Failure;
+        memcpy(tr, geotransform, 6 * sizeof(double));
+        return CE_None;
+    }
+};
+
+/**
+ * Raster band of an OpenMTP image.
+ *
+ * Lines are read from the file mapping when a block is requested, and
+ * calibrated with the 256-entry table computed from the binary header.
+ */
+class OpenMTPRasterBand : public GDALRasterBand
+{
+public:
+    OpenMTPDataset* ods;
+    bool calibrated;
+    float calibration[256];
+    string unit;
+
+    OpenMTPRasterBand(OpenMTPDataset* ds, int idx);
+
+    const char* GetUnitType() override { return unit.c_str(); }
+
+    double GetNoDataValue(int* pbSuccess=NULL) override
+    {
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 0;
+    }
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
+OpenMTPRasterBand::OpenMTPRasterBand(OpenMTPDataset* ds, int idx)
+    : ods(ds)
+{
+    poDS = ds;
+    nBand = idx;
+    nBlockXSize = ds->GetRasterXSize();
+    nBlockYSize = 1;
+
+    OpenMTP_binary_header& h = ds->header;
+    const char* channel;
+    if (h.is_vis_data())
+    {
+        channel = "VIS";
+        unit = "%";
+    } else if (h.is_ir_data()) {
+        channel = "IR";
+        unit = "K";
+    } else {
+        channel = "WV";
+        unit = "K";
+    }
+    char buf[25];
+    snprintf(buf, 25, "%d", h.chan());
+    SetMetadataItem(MD_MSAT_CHANNEL_ID, buf, MD_DOMAIN_MSAT);
+    SetMetadataItem(MD_MSAT_CHANNEL, channel, MD_DOMAIN_MSAT);
+    SetDescription(channel);
+
+    calibrated = OpenMTP_image::calibration_table(h, calibration);
+    if (calibrated)
+        eDataType = GDT_Float32;
+    else
+    {
+        // Without a calibration, give access to the raw counts
+        eDataType = GDT_Byte;
+        unit.clear();
+    }
+}
+
+CPLErr OpenMTPRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0 || yblock < 0 || yblock >= nRasterYSize)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    const unsigned char* src = ods->line(yblock);
+    if (calibrated)
+    {
+        float* dst = (float*)buf;
+        for (int x = 0; x < nBlockXSize; ++x)
+            dst[x] = calibration[src[x]];
+    } else
+        memcpy(buf, src, nBlockXSize);
+
+    return CE_None;
+}
+
+bool OpenMTPDataset::init()
+{
+    try {
+        sys::File in(std::filesystem::path(pathname), O_RDONLY);
+        struct stat st;
+        in.fstat(st);
+        data.reset(new sys::MMap(in.mmap(st.st_size, PROT_READ, MAP_SHARED)));
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", pathname.c_str(), e.what());
+        return false;
+    }
+
+    // OpenMTPOpen already checked that the file has the size described by
+    // the header, so reading the header cannot fail
+    ifstream in(pathname, ios::binary | ios::in);
+    in.seekg(ascii_header_length);
+    header.read(in);
+    data_offset = (size_t)in.tellg();
+
+    nRasterXSize = header.npixels();
+    nRasterYSize = header.nlines();
+
+    /// Image time
+    int date = header.date() % 10000;
+    int time = header.time();
+    char buf[25];
+    snprintf(buf, 25, "%04d-%02d-%02d %02d:%02d:00",
+            header.year(), date / 100, date % 100, time / 100, time % 100);
+    if (SetMetadataItem(MD_MSAT_DATETIME, buf, MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    /// Spacecraft
+    const char* satellite = header.satellite_name();
+    snprintf(buf, 25, "METEOSAT %s", satellite + 1);
+    if (SetMetadataItem(MD_MSAT_SPACECRAFT, buf, MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    /// Projection and geotransform matrix, for the A and B formats, with
+    /// the same grids used by OpenMTP_to_NetCDF
+    int cfac = 0, coff = 0, loff = 0, scale = 1;
+    bool ir_or_wv = header.is_ir_data() || header.is_wv_data();
+    if (ir_or_wv && nRasterXSize == 2500 && nRasterYSize == 2500)
+    {
+        cfac = -9102222;
+        coff = 1248;
+        loff = 1249;
+    } else if (header.is_visible_composite() && nRasterXSize == 5000 && nRasterYSize == 5000) {
+        cfac = -18204444;
+        coff = 2500;
+        loff = 2500;
+    } else if ((ir_or_wv && nRasterXSize == 1250 && nRasterYSize == 625 && header.first_line() == 1810)
+            || (header.is_visible_composite() && nRasterXSize == 2500 && nRasterYSize == 1250 && header.first_line() == 3620)) {
+        cfac = -18204444;
+        coff = 1248;
+        loff = -1118;
+        scale = 2;
+    }
+
+    if (cfac != 0)
+    {
+        dataset::set_spaceview(osr, header.subsatellite_point());
+        const double ps = facts::pixelHSizeFromCFAC(abs(cfac) * exp2(-16));
+        geotransform[0] = -coff * ps;
+        geotransform[3] = loff * ps;
+        geotransform[1] = ps * scale;
+        geotransform[5] = -ps * scale;
+        geotransform[2] = 0.0;
+        geotransform[4] = 0.0;
+        georeferenced = true;
+    }
+
+    SetBand(1, new OpenMTPRasterBand(this, 1));
+
+    return true;
+}
+
+GDALDataset* OpenMTPOpen(GDALOpenInfo* info)
+{
+    // We want a real file
+    if (info->fpL == NULL) return NULL;
+
+    // Look for a plausible binary header after the ASCII header, using the
+    // bytes GDAL already read. Files shorter than the default 1024 header
+    // bytes are rejected before reading more
+    const size_t headers_length = ascii_header_length + binary_header_first_section_length;
+    if (info->nHeaderBytes < 1024)
+        return NULL;
+    if (!info->TryToIngest(headers_length) || (size_t)info->nHeaderBytes < headers_length)
+        return NULL;
+    unsigned char* first = info->pabyHeader + ascii_header_length;
+
+    // Satellite name, like "M7"
+    if (first[32] != 'M' || !isdigit(first[33]))
+        return NULL;
+
+    OpenMTP_machine m;
+    int chan = m.int4(first + 40);
+    int nlines = m.int4(first + 131);
+    int npixels = m.int4(first + 135);
+    if (chan < 1 || chan > 7)
+        return NULL;
+    if (nlines < 1 || nlines > max_pixels || npixels < 1 || npixels > max_pixels)
+        return NULL;
+
+    // The file needs to be exactly as long as the headers and the lines
+    // they describe
+    size_t expected = ascii_header_length
+        + binary_header_first_section_length
+        + binary_header_second_section_length
+        + (chan == 3 ? binary_header_third_section_vis_cmp_length
+                     : binary_header_third_section_normal_length)
+        + (size_t)nlines * (line_header_length + npixels);
+    VSIStatBufL st;
+    if (VSIStatL(info->pszFilename, &st) != 0 || (size_t)st.st_size != expected)
+        return NULL;
+
+    unique_ptr<OpenMTPDataset> ds(new OpenMTPDataset(info->pszFilename));
+    if (!ds->init()) return NULL;
+
+    return msat::gdal::add_extras(ds.release(), info);
+}
+
+}
+}
+
+extern "C" {
+
+void GDALRegister_MsatOpenMTP()
+{
+    if (!GDAL_CHECK_VERSION("MsatOpenMTP"))
+        return;
+
+    if (GDALGetDriverByName("MsatOpenMTP") == NULL)
+    {
+        unique_ptr<GDALDriver> driver(new GDALDriver());
+        driver->SetDescription("MsatOpenMTP");
+        driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Meteosat OpenMTP (via Meteosatlib)");
+        driver->pfnOpen = msat::openmtp::OpenMTPOpen;
+        GetGDALDriverManager()->RegisterDriver(driver.release());
+    }
+}
+
+}
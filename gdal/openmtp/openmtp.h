@@ -0,0 +1,8 @@
+#ifndef MSAT_GDALDRIVER_OPENMTP_H
+#define MSAT_GDALDRIVER_OPENMTP_H
+
+extern "C" {
+void GDALRegister_MsatOpenMTP(void);
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "reflectance.h"
 #include <msat/gdal/const.h>
+#include <msat/gdal/dataset.h>
 #include <string>
 #include <stdexcept>
 
@@ -9,6 +10,7 @@ namespace msat {
 namespace utils {
 
 ProxyDataset::~ProxyDataset() {
+    delete earth_mask;
     delete osr;
 }
 
@@ -68,6 +70,25 @@ CPLErr ProxyDataset::GetGeoTransform(double* tr)
     return CE_None;
 }
 
+char** ProxyDataset::GetMetadataDomainList()
+{
+    return BuildMetadataDomainList(GDALDataset::GetMetadataDomainList(), TRUE, MD_DOMAIN_MSAT_STATS, NULL);
+}
+
+char** ProxyDataset::GetMetadata(const char* domain)
+{
+    if (domain && EQUAL(domain, MD_DOMAIN_MSAT_STATS))
+        dataset::set_stats_metadata(this, stats, stats_sources);
+    return GDALDataset::GetMetadata(domain);
+}
+
+const char* ProxyDataset::GetMetadataItem(const char* name, const char* domain)
+{
+    if (domain && EQUAL(domain, MD_DOMAIN_MSAT_STATS))
+        dataset::set_stats_metadata(this, stats, stats_sources);
+    return GDALDataset::GetMetadataItem(name, domain);
+}
+
 void ProxyRasterBand::add_info(GDALRasterBand* rb, const std::string& rbname)
 {
     rb->GetBlockSize(&nBlockXSize, &nBlockYSize);
@@ -80,5 +101,22 @@ void ProxyRasterBand::add_info(GDALRasterBand* rb, const std::string& rbname)
         throw std::runtime_error(rbname + ": cannot set metadata from source raster band");
 }
 
+GDALRasterBand* ProxyRasterBand::GetMaskBand()
+{
+    ProxyDataset* ds = static_cast<ProxyDataset*>(poDS);
+    if (!ds->earth_mask)
+        ds->earth_mask = new dataset::EarthMaskRasterBand(ds);
+    return ds->earth_mask;
+}
+
+int ProxyRasterBand::GetMaskFlags()
+{
+    // Report the flags that GDAL would report without the Earth mask, so
+    // that CreateCopy does not write it as an extra mask band
+    int has_nodata = FALSE;
+    GetNoDataValue(&has_nodata);
+    return has_nodata ? GMF_NODATA : GMF_ALL_VALID;
+}
+
 }
 }
@@ -2,10 +2,16 @@
 #define MSAT_GDALDRIVER_REFLECTANCE_BASE_H
 
 #include <gdal/gdal_priv.h>
+#include <msat/stats.h>
 #include <memory>
 #include <set>
+#include <vector>
 
 namespace msat {
+namespace dataset {
+class EarthMaskRasterBand;
+}
+
 namespace utils {
 
 class ProxyDataset : public GDALDataset
@@ -23,6 +29,15 @@ public:
     /// Datetime metadata string
     std::string datetime;
 
+    /// Time spent computing the bands of this dataset
+    Stats stats;
+
+    /// Datasets whose MSAT_STATS counters are added to those of this dataset
+    std::vector<GDALDataset*> stats_sources;
+
+    /// Mask band shared by all the raster bands
+    dataset::EarthMaskRasterBand* earth_mask = nullptr;
+
     ~ProxyDataset();
 
     /**
@@ -33,13 +48,27 @@ public:
 
     const OGRSpatialReference* GetSpatialRef() const override;
     CPLErr GetGeoTransform(double* tr) override;
+
+    // The MSAT_STATS domain has the current counters of this dataset and of
+    // stats_sources
+    char** GetMetadataDomainList() override;
+    char** GetMetadata(const char* domain="") override;
+    const char* GetMetadataItem(const char* name, const char* domain="") override;
 };
 
 class ProxyRasterBand : public GDALRasterBand
 {
 public:
+
     /// Add information from the given raster band
     void add_info(GDALRasterBand* rb, const std::string& rbname);
+
+    /// Counters of the dataset of this band
+    Stats& stats() { return static_cast<ProxyDataset*>(poDS)->stats; }
+
+    /// Mask out the pixels in space
+    GDALRasterBand* GetMaskBand() override;
+    int GetMaskFlags() override;
 };
 
 }
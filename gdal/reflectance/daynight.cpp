@@ -0,0 +1,120 @@
+#include "daynight.h"
+#include "pixeltolatlon.h"
+#include <msat/facts.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace msat {
+namespace utils {
+
+namespace {
+
+/**
+ * Append a run, merging it with the previous one if they have the same kind.
+ *
+ * Runs between samples share their end points: when two runs of different
+ * kinds overlap, the overlapping pixel has been proven to be night.
+ */
+void append_run(std::vector<DayNightClassifier::Run>& runs, int start, int end, DayNightClassifier::Kind kind)
+{
+    if (!runs.empty())
+    {
+        DayNightClassifier::Run& last = runs.back();
+        if (last.kind == kind && last.end >= start)
+        {
+            last.end = max(last.end, end);
+            return;
+        }
+        if (last.end > start)
+        {
+            if (last.kind == DayNightClassifier::NIGHT)
+                start = last.end;
+            else
+                last.end = start;
+        }
+    }
+    if (start < end)
+        runs.push_back(DayNightClassifier::Run{start, end, kind});
+}
+
+/// Distance between two points on the unit sphere
+double chord(double lat1, double lon1, double lat2, double lon2)
+{
+    const double rpd = M_PI / 180.0;
+    double cosd = sin(lat1 * rpd) * sin(lat2 * rpd)
+                + cos(lat1 * rpd) * cos(lat2 * rpd) * cos((lon1 - lon2) * rpd);
+    return sqrt(max(0.0, 2.0 - 2.0 * cosd));
+}
+
+}
+
+DayNightClassifier::DayNightClassifier(PixelToLatlon& p2ll, int jday, double daytime, double cos_night)
+    : p2ll(p2ll), jday(jday), daytime(daytime), cos_night(cos_night)
+{
+}
+
+bool DayNightClassifier::classify(int x, int sx, int y, std::vector<Run>& runs) const
+{
+    runs.clear();
+
+    const msat::dataset::EarthDisk& disk = *p2ll.disk;
+    int start = max(x, disk.starts[y]);
+    int end = min(x + sx, disk.ends[y]);
+    if (start >= end)
+    {
+        runs.push_back(Run{x, x + sx, SPACE});
+        return false;
+    }
+    if (start > x)
+        runs.push_back(Run{x, start, SPACE});
+
+    // Georeference a sparse sample of the part of the line that sees the Earth
+    std::vector<int> xs;
+    for (int i = start; i < end - 1; i += sample_step)
+        xs.push_back(i);
+    xs.push_back(end - 1);
+    std::vector<int> ys(xs.size(), y);
+    std::vector<double> lats(xs.size());
+    std::vector<double> lons(xs.size());
+    p2ll.compute(xs.size(), xs.data(), ys.data(), lats.data(), lons.data());
+
+    std::vector<double> cossza(xs.size());
+    for (size_t i = 0; i < xs.size(); ++i)
+    {
+        if (isfinite(lats[i]) && isfinite(lons[i]))
+            cossza[i] = facts::cos_sol_za(jday, daytime, lats[i], lons[i]);
+        else
+            cossza[i] = NAN;
+    }
+
+    if (xs.size() == 1)
+        append_run(runs, start, end, cossza[0] < cos_night ? NIGHT : DAY);
+
+    for (size_t i = 0; i + 1 < xs.size(); ++i)
+    {
+        Kind kind = DAY;
+        // cos_sol_za is the dot product of the unit vectors of the pixel and
+        // of the subsolar point, so between two samples it cannot grow more
+        // than the distance between them
+        if (!isnan(cossza[i]) && !isnan(cossza[i + 1]))
+        {
+            double dist = chord(lats[i], lons[i], lats[i + 1], lons[i + 1]);
+            if (max(cossza[i], cossza[i + 1]) + dist < cos_night)
+                kind = NIGHT;
+        }
+        append_run(runs, xs[i], xs[i + 1] + 1, kind);
+    }
+
+    if (end < x + sx)
+        runs.push_back(Run{end, x + sx, SPACE});
+
+    for (const auto& run: runs)
+        if (run.kind == DAY)
+            return true;
+    return false;
+}
+
+}
+}
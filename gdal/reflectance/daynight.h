@@ -0,0 +1,60 @@
+#ifndef MSAT_GDALDRIVER_REFLECTANCE_DAYNIGHT_H
+#define MSAT_GDALDRIVER_REFLECTANCE_DAYNIGHT_H
+
+#include <vector>
+
+namespace msat {
+namespace utils {
+
+struct PixelToLatlon;
+
+/**
+ * Split scanlines into runs of pixels that are in space, in darkness, or
+ * possibly lit by the sun.
+ *
+ * Georeferencing is only computed on a sparse sample of each line. The pixels
+ * between two samples are classified as night only when the cosine of the
+ * solar zenith angle at both samples is below the night threshold by more
+ * than the distance between the samples, so that no lit pixel can be in
+ * between.
+ */
+class DayNightClassifier
+{
+public:
+    enum Kind { SPACE, NIGHT, DAY };
+
+    struct Run
+    {
+        /// First column of the run
+        int start;
+        /// One past the last column of the run
+        int end;
+        Kind kind;
+    };
+
+    /// Distance in pixels between georeferenced samples
+    static const int sample_step = 32;
+
+    DayNightClassifier(PixelToLatlon& p2ll, int jday, double daytime, double cos_night);
+
+    /**
+     * Classify the pixels [x, x + sx) of line y, replacing the contents of
+     * runs.
+     *
+     * Returns true if at least one of the runs is DAY.
+     */
+    bool classify(int x, int sx, int y, std::vector<Run>& runs) const;
+
+protected:
+    PixelToLatlon& p2ll;
+    // Julian day
+    int jday;
+    // Time of day in fractional hours
+    double daytime;
+    // Cosine of the solar zenith angle below which a pixel is night
+    double cos_night;
+};
+
+}
+}
+#endif
@@ -42,6 +42,8 @@ public:
 
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override
     {
+        StatsTimer timer(stats().derived_time);
+
         // Return the same julian day for every pixel
         int16_t* dest = (int16_t*) buf;
         for (int i = 0; i < nBlockXSize * nBlockYSize; ++i)
@@ -1,5 +1,7 @@
 #include "pixeltolatlon.h"
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
 
 using namespace std;
 
@@ -22,6 +24,8 @@ PixelToLatlon::PixelToLatlon(GDALDataset* ds)
 #if GDAL_VERSION_MAJOR >= 3
     toLatLon->SetEmitErrors(false);
 #endif
+
+    disk = msat::dataset::earth_disk(ds);
 }
 
 PixelToLatlon::~PixelToLatlon()
@@ -33,36 +37,85 @@ PixelToLatlon::~PixelToLatlon()
 
 void PixelToLatlon::compute(int x, int y, int sx, int sy, double* lats, double* lons)
 {
-    int idx = 0;
+    if (!cache_rows || sy != 1 || x < 0 || x + sx > disk->width || y < 0 || y >= (int)disk->starts.size())
+    {
+        compute_rows(x, y, sx, sy, lats, lons);
+        return;
+    }
+
+    if (cached_row != y)
+    {
+        cached_lats.resize(disk->width);
+        cached_lons.resize(disk->width);
+        compute_rows(0, y, disk->width, 1, cached_lats.data(), cached_lons.data());
+        cached_row = y;
+    }
+    std::copy(cached_lats.begin() + x, cached_lats.begin() + x + sx, lats);
+    std::copy(cached_lons.begin() + x, cached_lons.begin() + x + sx, lons);
+}
+
+void PixelToLatlon::compute_rows(int x, int y, int sx, int sy, double* lats, double* lons)
+{
+    int height = disk->starts.size();
+    bool inside = x >= 0 && x + sx <= disk->width;
 
-    // Pixels to projected coordinates
     for (int iy = y; iy < y + sy; ++iy)
     {
+        double* row_lats = lats + (iy - y) * sx;
+        double* row_lons = lons + (iy - y) * sx;
+
+        // Only georeference the part of the line that sees the Earth
+        int start = x;
+        int end = x + sx;
+        if (inside && iy >= 0 && iy < height)
+        {
+            start = max(x, disk->starts[iy]);
+            end = max(start, min(x + sx, disk->ends[iy]));
+        }
+
+        // Pixels to projected coordinates
         for (int ix = x; ix < x + sx; ++ix)
         {
+            if (ix < start || ix >= end)
+            {
+                row_lats[ix - x] = HUGE_VAL;
+                row_lons[ix - x] = HUGE_VAL;
+                continue;
+            }
+
             // Projected y
-            lats[idx] = geoTransform[3]
+            row_lats[ix - x] = geoTransform[3]
                 + geoTransform[4] * ix
                 + geoTransform[5] * iy;
 
             // Projected x
-            lons[idx] = geoTransform[0]
+            row_lons[ix - x] = geoTransform[0]
                 + geoTransform[1] * ix
                 + geoTransform[2] * iy;
-
-            ++idx;
         }
+
+        // Projected coordinates to latlon
+        if (start < end)
+            toLatLon->Transform(end - start, row_lons + start - x, row_lats + start - x);
+        // Ignore errors, since there can still be points at the edge of the
+        // disk that fail to transform
     }
+}
 
-    // Projected coordinates to latlon
-    toLatLon->Transform(sx * sy, lons, lats);
-    // Ignore errors, since there usually are points in space that fail to
-    // transform
+void PixelToLatlon::compute(int count, const int* xs, const int* ys, double* lats, double* lons)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        lats[i] = geoTransform[3]
+            + geoTransform[4] * xs[i]
+            + geoTransform[5] * ys[i];
+        lons[i] = geoTransform[0]
+            + geoTransform[1] * xs[i]
+            + geoTransform[2] * ys[i];
+    }
 
-    // if (!toLatLon->Transform(sx * sy, lons, lats))
-    // {
-    //     throw std::runtime_error("points failed to transform to lat,lon");
-    // }
+    // Points that fail to transform are left as HUGE_VAL
+    toLatLon->Transform(count, lons, lats);
 }
 
 }
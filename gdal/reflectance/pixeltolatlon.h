@@ -3,6 +3,9 @@
 
 #include <gdal/gdal_priv.h>
 #include <ogr_spatialref.h>
+#include <msat/gdal/dataset.h>
+#include <memory>
+#include <vector>
 
 namespace msat {
 namespace utils {
@@ -13,11 +16,34 @@ struct PixelToLatlon
     OGRSpatialReference* proj = nullptr;
     OGRSpatialReference* latlon = nullptr;
     OGRCoordinateTransformation* toLatLon = nullptr;
+    /// Pixels in space are not georeferenced
+    std::shared_ptr<const msat::dataset::EarthDisk> disk;
+
+    /**
+     * If true, single rows are georeferenced in full and the last one is
+     * kept, so that bands sharing this object and reading the same rows in
+     * turn only compute each row once
+     */
+    bool cache_rows = false;
+    int cached_row = -1;
+    std::vector<double> cached_lats;
+    std::vector<double> cached_lons;
 
     PixelToLatlon(GDALDataset* ds);
     ~PixelToLatlon();
 
+    /**
+     * Compute lat,lon for all pixels in the rectangle x, y, sx, sy.
+     *
+     * Pixels in space are set to HUGE_VAL.
+     */
     void compute(int x, int y, int sx, int sy, double* lats, double* lons);
+
+    /// Compute lat,lon for \a count arbitrary pixels
+    void compute(int count, const int* xs, const int* ys, double* lats, double* lons);
+
+protected:
+    void compute_rows(int x, int y, int sx, int sy, double* lats, double* lons);
 };
 
 }
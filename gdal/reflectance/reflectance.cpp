@@ -1,5 +1,6 @@
 #include "reflectance.h"
 #include "pixeltolatlon.h"
+#include "daynight.h"
 #include <msat/auto_arr_ptr.h>
 #include <msat/gdal/const.h>
 #include <msat/facts.h>
@@ -9,6 +10,7 @@
 #include <string>
 #include <stdexcept>
 #include <stdint.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -42,6 +44,8 @@ void ReflectanceDataset::add_source(GDALDataset* ds, bool take_ownership)
         sources[id - 1] = rb;
         if (take_ownership)
             owned_datasets.insert(ds);
+        if (std::find(stats_sources.begin(), stats_sources.end(), ds) == stats_sources.end())
+            stats_sources.push_back(ds);
     }
 }
 
@@ -49,6 +53,10 @@ void ReflectanceDataset::add_source(GDALDataset* ds, bool take_ownership)
 // cos(80deg)
 #define cos80 0.173648178
 
+// cos(96deg): the sun is more than 6° below the horizon, past civil twilight,
+// and there is no reflected sunlight to measure
+#define cos96 -0.104528463
+
 ReflectanceRasterBand::ReflectanceRasterBand(ReflectanceDataset* ds, int idx)
 {
     poDS = ds;
@@ -63,12 +71,13 @@ ReflectanceRasterBand::ReflectanceRasterBand(ReflectanceDataset* ds, int idx)
     jday = msat::facts::jday(ye, mo, da);
     daytime = (double)ho + ((double)mi) / 60.0;
 
-    p2ll = new PixelToLatlon(ds);
+    if (!ds->p2ll)
+        ds->p2ll = std::make_shared<PixelToLatlon>(ds);
+    p2ll = ds->p2ll;
 }
 
 ReflectanceRasterBand::~ReflectanceRasterBand()
 {
-    delete p2ll;
 }
 
 const char* ReflectanceRasterBand::GetUnitType()
@@ -121,46 +130,87 @@ SingleChannelReflectanceRasterBand::SingleChannelReflectanceRasterBand(Reflectan
         case MSG_SEVIRI_1_5_HRV:     tr = 25.11 / (esd*esd); break;
         default: throw std::runtime_error("SingleChannelReflectanceRasterBand: computing reflectance for channel " + std::to_string(ds->channel_id) + " is not implemented");
     }
+
+    daynight = new DayNightClassifier(*p2ll, jday, daytime, cos96);
 }
 
 SingleChannelReflectanceRasterBand::~SingleChannelReflectanceRasterBand()
 {
+    delete daynight;
 }
 
 CPLErr SingleChannelReflectanceRasterBand::IReadBlock(int xblock, int yblock, void *buf)
 {
-    // Read the raw data
-    std::vector<double> raw(nBlockXSize * nBlockYSize);
-    if (source_rb->RasterIO(GF_Read, xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, raw.data(), nBlockXSize, nBlockYSize, GDT_Float64, 0, 0) == CE_Failure)
-        return CE_Failure;
-
-    // Precompute pixel georeferentiation
-    std::vector<double> lats(nBlockXSize * nBlockYSize);
-    std::vector<double> lons(nBlockXSize * nBlockYSize);
-    p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
-
-    // Compute reflectances
+    StatsTimer timer(stats().derived_time);
+    int x0 = xblock * nBlockXSize;
+    int y0 = yblock * nBlockYSize;
+    int sx = min(nBlockXSize, nRasterXSize - x0);
+    int sy = min(nBlockYSize, nRasterYSize - y0);
+
+    // Space and night pixels are 0: only the runs of pixels that can be lit
+    // by the sun are read and computed
     float* dest = (float*)buf;
-    for (int i = 0; i < nBlockXSize * nBlockYSize; ++i)
+    std::fill(dest, dest + nBlockXSize * nBlockYSize, 0.0f);
+
+    std::vector<DayNightClassifier::Run> runs;
+    std::vector<double> raw;
+    std::vector<double> lats;
+    std::vector<double> lons;
+    for (int iy = 0; iy < sy; ++iy)
     {
-        // From counts to radiance
-        double radiance = raw[i] * rad_slope + rad_offset;
-        double cossza = facts::cos_sol_za(jday, daytime, lats[i], lons[i]);
-        // Use cos(80°) as lower bound, to avoid division by zero
-        if (cossza < cos80) cossza = cos80;
-        // From radiance to reflectance
-        dest[i] = 100.0 * radiance / tr / cossza;
-        // Normalise outliars
-        switch (fpclassify(dest[i]))
         {
-            case FP_NAN:
-            case FP_SUBNORMAL:
-            case FP_ZERO: dest[i] = 0.0; break;
-            case FP_INFINITE:
-            case FP_NORMAL:
-                if (dest[i] < 0.0) dest[i] = 0.0;
-                if (dest[i] > 100.0) dest[i] = 100.0;
-                break;
+            StatsTimer geo_timer(stats().geolocation_time);
+            if (!daynight->classify(x0, sx, y0 + iy, runs))
+                continue;
+        }
+
+        for (const auto& run: runs)
+        {
+            if (run.kind != DayNightClassifier::DAY) continue;
+            int len = run.end - run.start;
+
+            // Read the raw data
+            raw.resize(len);
+            if (source_rb->RasterIO(GF_Read, run.start, y0 + iy, len, 1, raw.data(), len, 1, GDT_Float64, 0, 0) == CE_Failure)
+                return CE_Failure;
+
+            // Precompute pixel georeferentiation
+            lats.resize(len);
+            lons.resize(len);
+            {
+                StatsTimer geo_timer(stats().geolocation_time);
+                p2ll->compute(run.start, y0 + iy, len, 1, lats.data(), lons.data());
+            }
+
+            // Compute reflectances
+            float* row = dest + iy * nBlockXSize + (run.start - x0);
+            for (int i = 0; i < len; ++i)
+            {
+                double cossza = facts::cos_sol_za(jday, daytime, lats[i], lons[i]);
+                if (cossza < cos96)
+                {
+                    row[i] = 0.0;
+                    continue;
+                }
+                // From counts to radiance
+                double radiance = raw[i] * rad_slope + rad_offset;
+                // Use cos(80°) as lower bound, to avoid division by zero
+                if (cossza < cos80) cossza = cos80;
+                // From radiance to reflectance
+                row[i] = 100.0 * radiance / tr / cossza;
+                // Normalise outliars
+                switch (fpclassify(row[i]))
+                {
+                    case FP_NAN:
+                    case FP_SUBNORMAL:
+                    case FP_ZERO: row[i] = 0.0; break;
+                    case FP_INFINITE:
+                    case FP_NORMAL:
+                        if (row[i] < 0.0) row[i] = 0.0;
+                        if (row[i] > 100.0) row[i] = 100.0;
+                        break;
+                }
+            }
         }
     }
 
@@ -208,6 +258,16 @@ Reflectance39RasterBand::~Reflectance39RasterBand()
 
 CPLErr Reflectance39RasterBand::IReadBlock(int xblock, int yblock, void *buf)
 {
+    StatsTimer timer(stats().derived_time);
+    // Blocks entirely in space do not need reading the sources
+    int x0 = xblock * nBlockXSize;
+    int y0 = yblock * nBlockYSize;
+    if (p2ll->disk->is_space(x0, y0, min(nBlockXSize, nRasterXSize - x0), min(nBlockYSize, nRasterYSize - y0)))
+    {
+        memset(buf, 0, nBlockXSize * nBlockYSize * sizeof(float));
+        return CE_None;
+    }
+
     // Read the IR 3.9 data
     std::vector<double> raw039(nBlockXSize * nBlockYSize);
     if (source_ir039->RasterIO(GF_Read, xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, raw039.data(), nBlockXSize, nBlockYSize, GDT_Float64, 0, 0) == CE_Failure)
@@ -226,7 +286,10 @@ CPLErr Reflectance39RasterBand::IReadBlock(int xblock, int yblock, void *buf)
     // Precompute pixel georeferentiation
     std::vector<double> lats(nBlockXSize * nBlockYSize);
     std::vector<double> lons(nBlockXSize * nBlockYSize);
-    p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+    {
+        StatsTimer geo_timer(stats().geolocation_time);
+        p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+    }
 
     // Based on: [MMKM2010]
     //   "Cloud-Top Properties of Growing Cumulus prior to Convective Initiation as Measured
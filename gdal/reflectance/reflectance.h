@@ -9,6 +9,8 @@
 namespace msat {
 namespace utils {
 
+struct PixelToLatlon;
+
 class ReflectanceDataset : public ProxyDataset
 {
 public:
@@ -26,6 +28,12 @@ public:
      */
     std::array<GDALRasterBand*, 12> sources{};
 
+    /**
+     * Georeferencing for the raster band. If set before init_rasterband(),
+     * it can be shared with other datasets of the same area.
+     */
+    std::shared_ptr<PixelToLatlon> p2ll;
+
     ReflectanceDataset(int channel_id);
     ~ReflectanceDataset();
 
@@ -48,13 +56,13 @@ public:
     void init_rasterband();
 };
 
-struct PixelToLatlon;
+class DayNightClassifier;
 
 class ReflectanceRasterBand : public ProxyRasterBand
 {
 public:
     // Utility class that converts pixel coordinates to lat,lon
-    PixelToLatlon* p2ll = nullptr;
+    std::shared_ptr<PixelToLatlon> p2ll;
 
     // Julian day
     int jday;
@@ -84,6 +92,9 @@ public:
     /// Cached offset of the source raster band
     double rad_offset;
 
+    /// Skips space and night pixels without reading or georeferencing them
+    DayNightClassifier* daynight = nullptr;
+
     SingleChannelReflectanceRasterBand(ReflectanceDataset* ds, int idx);
     ~SingleChannelReflectanceRasterBand();
 
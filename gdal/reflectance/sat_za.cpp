@@ -38,10 +38,15 @@ public:
 
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override
     {
+        StatsTimer timer(stats().derived_time);
+
         // Precompute pixel georeferentiation
         std::vector<double> lats(nBlockXSize * nBlockYSize);
         std::vector<double> lons(nBlockXSize * nBlockYSize);
-        p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+        {
+            StatsTimer geo_timer(stats().geolocation_time);
+            p2ll->compute(xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize, lats.data(), lons.data());
+        }
 
         // Compute satellite zenith angles
         double* dest = (double*) buf;
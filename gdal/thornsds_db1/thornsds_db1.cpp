@@ -0,0 +1,260 @@
+#include "thornsds_db1.h"
+#include <msat/gdal/const.h>
+#include <msat/gdal/dataset.h>
+#include <msat/thornsds_db1/thornsds_db1.h>
+#include <msat/utils/sys.h>
+#include <msat/facts.h>
+#include <gdal/gdal_priv.h>
+#include <gdal/ogr_spatialref.h>
+#include "gdal/utils.h"
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+namespace msat {
+namespace thornsds_db1 {
+
+GDALDataset* ThornsdsDB1Open(GDALOpenInfo* info);
+
+/**
+ * A DB1 directory, with the AoI and INFO.DBI metadata parsed once for all
+ * its channels
+ */
+class ThornsdsDB1Dataset : public GDALDataset
+{
+public:
+    string dirname;
+    MSG_db1_data db1;
+    bool georeferenced = false;
+    double geotransform[6];
+    OGRSpatialReference osr;
+
+    ThornsdsDB1Dataset(const string& dirname) : dirname(dirname) {}
+
+    bool init();
+
+    const OGRSpatialReference* GetSpatialRef() const override
+    {
+        return georeferenced ? &osr : nullptr;
+    }
+
+    CPLErr GetGeoTransform(double* tr) override
+    {
+        if (!georeferenced) return CE_Failure;
+        memcpy(tr, geotransform, 6 * sizeof(double));
+        return CE_None;
+    }
+};
+
+/**
+ * Raster band with one channel of a DB1 directory.
+ *
+ * Lines are read from the mapping of the RAW file when a block is
+ * requested, and calibrated with the table of the channel Calibration file
+ * if there is one.
+ */
+class ThornsdsDB1RasterBand : public GDALRasterBand
+{
+public:
+    const MSG_db1_channel* channel;
+    bool calibrated;
+    string unit;
+
+    ThornsdsDB1RasterBand(ThornsdsDB1Dataset* ds, int idx, const string& name);
+
+    const char* GetUnitType() override { return unit.c_str(); }
+
+    double GetNoDataValue(int* pbSuccess=NULL) override
+    {
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 0;
+    }
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
+ThornsdsDB1RasterBand::ThornsdsDB1RasterBand(ThornsdsDB1Dataset* ds, int idx, const string& name)
+{
+    poDS = ds;
+    nBand = idx;
+    nBlockXSize = ds->GetRasterXSize();
+    nBlockYSize = 1;
+
+    MSG_db1_data& db1 = ds->db1;
+    db1.set_channel((char*)name.c_str());
+    channel = db1.get_channel();
+
+    char buf[25];
+    snprintf(buf, 25, "%d", db1.chname_to_chnum((char*)name.c_str()));
+    SetMetadataItem(MD_MSAT_CHANNEL_ID, buf, MD_DOMAIN_MSAT);
+    SetMetadataItem(MD_MSAT_CHANNEL, name.c_str(), MD_DOMAIN_MSAT);
+    SetDescription(name.c_str());
+
+    calibrated = channel->Calibration != 0;
+    if (calibrated)
+    {
+        eDataType = GDT_Float32;
+        unit = db1.get_channel_INFO_units();
+    } else {
+        // Without a calibration, give access to the raw counts
+        CPLError(CE_Warning, CPLE_AppDefined, "%s: no Calibration file for channel %s, reading raw counts",
+                ds->dirname.c_str(), name.c_str());
+        eDataType = GDT_UInt16;
+    }
+}
+
+CPLErr ThornsdsDB1RasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0 || yblock < 0 || yblock >= nRasterYSize)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    const unsigned short* src = *channel->raw;
+    src += (size_t)yblock * nBlockXSize;
+    if (calibrated)
+    {
+        float* dst = (float*)buf;
+        for (int x = 0; x < nBlockXSize; ++x)
+            dst[x] = src[x] < channel->ncalval ? channel->cal_values[src[x]] : 0;
+    } else
+        memcpy(buf, src, nBlockXSize * sizeof(unsigned short));
+
+    return CE_None;
+}
+
+bool ThornsdsDB1Dataset::init()
+{
+    if (!db1.open((char*)dirname.c_str()))
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: cannot read AoI and INFO.DBI", dirname.c_str());
+        return false;
+    }
+
+    vector<string> names = db1.get_channel_names();
+    if (names.empty())
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: no channels found", dirname.c_str());
+        return false;
+    }
+
+    // Map all the channels, checking that their RAW files have all the
+    // pixels of the image
+    for (const auto& name: names)
+    {
+        db1.set_channel((char*)name.c_str());
+        if (!db1.is_data_ok())
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: cannot read channel %s", dirname.c_str(), name.c_str());
+            return false;
+        }
+        nRasterXSize = db1.get_INFO_image_pixels();
+        nRasterYSize = db1.get_INFO_image_lines();
+        if (nRasterXSize < 1 || nRasterYSize < 1
+         || (size_t)db1.get_raw_data_nvals() < (size_t)nRasterXSize * nRasterYSize)
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: RAW file of channel %s is too short for a %dx%d image",
+                    dirname.c_str(), name.c_str(), nRasterXSize, nRasterYSize);
+            return false;
+        }
+    }
+
+    /// Image time, from the schedule start as "dd/mm/yyyy HH:MM:SS.000"
+    int year, month, day, hour, minute, second;
+    if (sscanf(db1.get_INFO_schedule_start(), "%d/%d/%d %d:%d:%d",
+                &day, &month, &year, &hour, &minute, &second) == 6)
+    {
+        char buf[25];
+        snprintf(buf, 25, "%04d-%02d-%02d %02d:%02d:%02d", year, month, day, hour, minute, second);
+        if (SetMetadataItem(MD_MSAT_DATETIME, buf, MD_DOMAIN_MSAT) != CE_None)
+            return false;
+    }
+
+    /// Spacecraft
+    if (SetMetadataItem(MD_MSAT_SPACECRAFT, db1.get_INFO_satellite_name(), MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    /// Projection and geotransform matrix, computed as db1_to_netcdf and
+    /// the MsatNetCDF driver did, including the swap of the offsets in the
+    /// AoI file
+    const long cfac = db1.get_AoI_cfac();
+    const long lfac = db1.get_AoI_lfac();
+    if (cfac != 0 && lfac != 0)
+    {
+        const long coff = db1.get_AoI_loff();
+        const long loff = db1.get_AoI_coff();
+        dataset::set_spaceview(osr, 0.0);
+        const double psx = facts::pixelHSizeFromCFAC(labs(cfac) * exp2(-16));
+        const double psy = facts::pixelVSizeFromLFAC(labs(lfac) * exp2(-16));
+        geotransform[0] = -coff * psx;
+        geotransform[3] = loff * psy;
+        geotransform[1] = psx;
+        geotransform[5] = -psy;
+        geotransform[2] = 0.0;
+        geotransform[4] = 0.0;
+        georeferenced = true;
+    }
+
+    /// One raster band per channel
+    int idx = 1;
+    for (const auto& name: names)
+    {
+        SetBand(idx, new ThornsdsDB1RasterBand(this, idx, name));
+        ++idx;
+    }
+
+    return true;
+}
+
+GDALDataset* ThornsdsDB1Open(GDALOpenInfo* info)
+{
+    // Open either the DB1 directory, or its INFO.DBI file
+    std::filesystem::path dirname;
+    std::filesystem::path path(info->pszFilename);
+    if (info->bIsDirectory)
+        dirname = path;
+    else if (info->fpL != NULL && path.filename() == "INFO.DBI")
+        dirname = path.parent_path();
+    else
+        return NULL;
+    if (dirname.empty())
+        dirname = ".";
+
+    if (!std::filesystem::exists(dirname / "INFO.DBI") || !std::filesystem::exists(dirname / "AoI"))
+        return NULL;
+
+    unique_ptr<ThornsdsDB1Dataset> ds(new ThornsdsDB1Dataset(dirname));
+    if (!ds->init()) return NULL;
+
+    return msat::gdal::add_extras(ds.release(), info);
+}
+
+}
+}
+
+extern "C" {
+
+void GDALRegister_MsatThornsdsDB1()
+{
+    if (!GDAL_CHECK_VERSION("MsatThornsdsDB1"))
+        return;
+
+    if (GDALGetDriverByName("MsatThornsdsDB1") == NULL)
+    {
+        unique_ptr<GDALDriver> driver(new GDALDriver());
+        driver->SetDescription("MsatThornsdsDB1");
+        driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Thornsds DB1 directory (via Meteosatlib)");
+        driver->pfnOpen = msat::thornsds_db1::ThornsdsDB1Open;
+        GetGDALDriverManager()->RegisterDriver(driver.release());
+    }
+}
+
+}
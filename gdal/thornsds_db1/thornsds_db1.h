@@ -0,0 +1,8 @@
+#ifndef MSAT_GDALDRIVER_THORNSDS_DB1_H
+#define MSAT_GDALDRIVER_THORNSDS_DB1_H
+
+extern "C" {
+void GDALRegister_MsatThornsdsDB1(void);
+}
+
+#endif
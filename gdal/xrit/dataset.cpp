@@ -17,6 +17,11 @@ XRITDataset::XRITDataset(const xrit::FileAccess& fa)
 {
 }
 
+XRITDataset::~XRITDataset()
+{
+    delete earth_mask;
+}
+
 const OGRSpatialReference* XRITDataset::GetSpatialRef() const {
     return &osr;
 }
@@ -27,15 +32,38 @@ CPLErr XRITDataset::GetGeoTransform(double* tr)
     return CE_None;
 }
 
-bool XRITDataset::init()
+char** XRITDataset::GetMetadataDomainList()
 {
-    char buf[25];
+    return BuildMetadataDomainList(GDALDataset::GetMetadataDomainList(), TRUE, MD_DOMAIN_MSAT_STATS, NULL);
+}
+
+char** XRITDataset::GetMetadata(const char* domain)
+{
+    if (domain && EQUAL(domain, MD_DOMAIN_MSAT_STATS))
+        dataset::set_stats_metadata(this, da.stats);
+    return GDALDataset::GetMetadata(domain);
+}
 
+const char* XRITDataset::GetMetadataItem(const char* name, const char* domain)
+{
+    if (domain && EQUAL(domain, MD_DOMAIN_MSAT_STATS))
+        dataset::set_stats_metadata(this, da.stats);
+    return GDALDataset::GetMetadataItem(name, domain);
+}
+
+bool XRITDataset::init()
+{
     // Scan segment headers
     MSG_data PRO_data;
     MSG_data EPI_data;
     MSG_header header;
     da.scan(fa, PRO_data, EPI_data, header);
+    return init(PRO_data, EPI_data, header);
+}
+
+bool XRITDataset::init(const MSG_data& PRO_data, const MSG_data& EPI_data, const MSG_header& header)
+{
+    char buf[25];
 
     if (da.hrv)
     {
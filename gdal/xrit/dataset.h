@@ -7,6 +7,10 @@
 #include <string>
 
 namespace msat {
+namespace dataset {
+class EarthMaskRasterBand;
+}
+
 namespace xrit {
 
 class XRITDataset : public GDALDataset
@@ -18,13 +22,27 @@ public:
     double geotransform[6];
     OGRSpatialReference osr;
 
+    /// Mask band shared by all the raster bands
+    dataset::EarthMaskRasterBand* earth_mask = nullptr;
+
     explicit XRITDataset(const xrit::FileAccess& fa);
+    ~XRITDataset();
 
     virtual bool init();
 
+    /**
+     * Initialize the dataset once da has been scanned, with the prologue and
+     * epilogue of the image and the header of one of its segments
+     */
+    bool init(const MSG_data& PRO_data, const MSG_data& EPI_data, const MSG_header& header);
+
     const OGRSpatialReference* GetSpatialRef() const override;
     CPLErr GetGeoTransform(double* tr) override;
 
+    // The MSAT_STATS domain has the current counters of da
+    char** GetMetadataDomainList() override;
+    char** GetMetadata(const char* domain="") override;
+    const char* GetMetadataItem(const char* name, const char* domain="") override;
 };
 
 }
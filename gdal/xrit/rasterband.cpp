@@ -1,12 +1,25 @@
 #include "rasterband.h"
 #include "dataset.h"
 #include <msat/gdal/const.h>
+#include <msat/gdal/dataset.h>
 #include <msat/facts.h>
+#include <msat/Progress.h>
 #include <stdint.h>
+#include <vector>
 
 namespace msat {
 namespace xrit {
 
+namespace {
+
+/// Largest overview reduction factor
+const int overview_max_factor = 16;
+
+/// Number of overview strips kept in memory
+const size_t overview_cache_size = 2;
+
+}
+
 XRITRasterBand::XRITRasterBand(XRITDataset* ds, int idx)
     : xds(ds), calibration(0)
 {
@@ -19,7 +32,7 @@ XRITRasterBand::~XRITRasterBand()
     if (calibration) delete[] calibration;
 }
 
-bool XRITRasterBand::init(MSG_data& PRO_data, MSG_data& EPI_data, MSG_header& header)
+bool XRITRasterBand::init(const MSG_data& PRO_data, const MSG_data& EPI_data, const MSG_header& header)
 {
     if (xds->da.hrv)
     {
@@ -60,6 +73,11 @@ bool XRITRasterBand::init(MSG_data& PRO_data, MSG_data& EPI_data, MSG_header& he
         offset = 0;
     }
 
+    // Overviews, as long as the reduction factor divides a segment into
+    // whole lines
+    for (int factor = 2; factor <= overview_max_factor && xds->da.seglines % factor == 0; factor *= 2)
+        overviews.emplace_back(new XRITOverviewBand(this, overviews.size(), factor));
+
     return true;
 }
 
@@ -101,6 +119,21 @@ CPLErr XRITRasterBand::IReadBlock(int xblock, int yblock, void *buf)
     return CE_None;
 }
 
+CPLErr XRITRasterBand::IRasterIO(GDALRWFlag rw, int xoff, int yoff, int xsize, int ysize,
+                 void* data, int buf_xsize, int buf_ysize, GDALDataType buf_type,
+                 GSpacing pixel_space, GSpacing line_space,
+                 GDALRasterIOExtraArg* extra)
+{
+    if (linear || rw != GF_Read)
+        return GDALRasterBand::IRasterIO(rw, xoff, yoff, xsize, ysize, data, buf_xsize, buf_ysize, buf_type, pixel_space, line_space, extra);
+
+    // One span for the whole request rather than one per scanline: the
+    // "segment" spans nested in it account for the decoding time
+    ProgressSpan span("calibrate");
+    span.add_pixels((uint64_t)xsize * ysize);
+    return GDALRasterBand::IRasterIO(rw, xoff, yoff, xsize, ysize, data, buf_xsize, buf_ysize, buf_type, pixel_space, line_space, extra);
+}
+
 double XRITRasterBand::GetOffset(int* pbSuccess)
 {
     if (pbSuccess) *pbSuccess = TRUE;
@@ -119,5 +152,153 @@ double XRITRasterBand::GetNoDataValue(int* pbSuccess)
     return 0.0;
 }
 
+GDALRasterBand* XRITRasterBand::GetMaskBand()
+{
+    if (!xds->earth_mask)
+        xds->earth_mask = new dataset::EarthMaskRasterBand(xds);
+    return xds->earth_mask;
+}
+
+int XRITRasterBand::GetMaskFlags()
+{
+    // Report the flags that GDAL would report without the Earth mask, so
+    // that CreateCopy does not write it as an extra mask band: space pixels
+    // are already marked by the nodata value. Writers that skip space find
+    // the mask with dataset::earth_disk_mask
+    return GMF_NODATA;
+}
+
+int XRITRasterBand::GetOverviewCount()
+{
+    return overviews.size();
+}
+
+GDALRasterBand* XRITRasterBand::GetOverview(int idx)
+{
+    if (idx < 0 || (size_t)idx >= overviews.size())
+        return nullptr;
+    return overviews[idx].get();
+}
+
+const XRITRasterBand::OverviewStrip* XRITRasterBand::overview_strip(int strip)
+{
+    for (auto i = overview_cache.begin(); i != overview_cache.end(); ++i)
+        if (i->strip == strip)
+        {
+            if (i != overview_cache.begin())
+            {
+                OverviewStrip tmp = std::move(*i);
+                overview_cache.erase(i);
+                overview_cache.push_front(std::move(tmp));
+            }
+            return &overview_cache.front();
+        }
+
+    int height = xds->da.seglines;
+    OverviewStrip res;
+    res.strip = strip;
+    std::vector<std::vector<unsigned>> counts;
+    for (const auto& ov: overviews)
+    {
+        size_t size = (size_t)ov->GetXSize() * (height / ov->factor);
+        res.levels.emplace_back(size, 0.0);
+        counts.emplace_back(size, 0);
+    }
+
+    // Accumulate all levels in one pass over the lines, which go through
+    // each segment once
+    std::vector<uint16_t> ibuf(eDataType == GDT_UInt16 ? nBlockXSize : 0);
+    std::vector<float> fbuf(eDataType == GDT_Float32 ? nBlockXSize : 0);
+    for (int y = strip * height; y < (strip + 1) * height && y < nRasterYSize; ++y)
+    {
+        CPLErr err = eDataType == GDT_UInt16 ? IReadBlock(0, y, ibuf.data()) : IReadBlock(0, y, fbuf.data());
+        if (err != CE_None) return nullptr;
+
+        for (size_t l = 0; l < overviews.size(); ++l)
+        {
+            int factor = overviews[l]->factor;
+            size_t row = (size_t)((y - strip * height) / factor) * overviews[l]->GetXSize();
+            double* sums = res.levels[l].data() + row;
+            unsigned* cnt = counts[l].data() + row;
+            for (int x = 0; x < nBlockXSize; ++x)
+            {
+                double val = eDataType == GDT_UInt16 ? ibuf[x] : fbuf[x];
+                if (val == 0) continue;
+                sums[x / factor] += val;
+                ++cnt[x / factor];
+            }
+        }
+    }
+
+    for (size_t l = 0; l < res.levels.size(); ++l)
+        for (size_t i = 0; i < res.levels[l].size(); ++i)
+            if (counts[l][i])
+                res.levels[l][i] /= counts[l][i];
+
+    overview_cache.push_front(std::move(res));
+    if (overview_cache.size() > overview_cache_size)
+        overview_cache.pop_back();
+    return &overview_cache.front();
+}
+
+
+XRITOverviewBand::XRITOverviewBand(XRITRasterBand* parent, int level, int factor)
+    : parent(parent), level(level), factor(factor)
+{
+    poDS = nullptr;
+    nBand = parent->GetBand();
+    eDataType = parent->GetRasterDataType();
+    nRasterXSize = (parent->GetXSize() + factor - 1) / factor;
+    nRasterYSize = (parent->GetYSize() + factor - 1) / factor;
+    nBlockXSize = nRasterXSize;
+    nBlockYSize = 1;
+}
+
+CPLErr XRITOverviewBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    int strip_lines = parent->xds->da.seglines / factor;
+    const XRITRasterBand::OverviewStrip* strip = parent->overview_strip(yblock / strip_lines);
+    if (!strip) return CE_Failure;
+
+    const double* src = strip->levels[level].data() + (size_t)(yblock % strip_lines) * nRasterXSize;
+    if (eDataType == GDT_UInt16)
+    {
+        uint16_t* dst = (uint16_t*)buf;
+        for (int x = 0; x < nRasterXSize; ++x)
+            dst[x] = (uint16_t)lround(src[x]);
+    } else {
+        float* dst = (float*)buf;
+        for (int x = 0; x < nRasterXSize; ++x)
+            dst[x] = src[x];
+    }
+    return CE_None;
+}
+
+const char* XRITOverviewBand::GetUnitType()
+{
+    return parent->GetUnitType();
+}
+
+double XRITOverviewBand::GetOffset(int* pbSuccess)
+{
+    return parent->GetOffset(pbSuccess);
+}
+
+double XRITOverviewBand::GetScale(int* pbSuccess)
+{
+    return parent->GetScale(pbSuccess);
+}
+
+double XRITOverviewBand::GetNoDataValue(int* pbSuccess)
+{
+    return parent->GetNoDataValue(pbSuccess);
+}
+
 }
 }
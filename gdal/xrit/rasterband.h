@@ -3,31 +3,88 @@
 
 #include <gdal/gdal_priv.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <deque>
+#include <memory>
+#include <vector>
 
 namespace msat {
+namespace dataset {
+class EarthMaskRasterBand;
+}
+
 namespace xrit {
 
 class XRITDataset;
+class XRITOverviewBand;
 
 class XRITRasterBand : public GDALRasterBand
 {
 public:
+    /**
+     * Box averages of a strip of lines as high as a segment, for all
+     * overview levels. Nodata pixels are not counted in the averages.
+     */
+    struct OverviewStrip
+    {
+        int strip;
+        std::vector<std::vector<double>> levels;
+    };
+
     XRITDataset* xds;
     double slope;
     double offset;
     bool linear;
     int channel_id;
     float* calibration;
+    std::vector<std::unique_ptr<XRITOverviewBand>> overviews;
+    /// Most recently computed overview strips
+    std::deque<OverviewStrip> overview_cache;
 
     XRITRasterBand(XRITDataset* ds, int idx);
     ~XRITRasterBand();
 
-    bool init(MSG_data& PRO_data, MSG_data& EPI_data, MSG_header& header);
+    bool init(const MSG_data& PRO_data, const MSG_data& EPI_data, const MSG_header& header);
 
     const char* GetUnitType() override;
 
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+    CPLErr IRasterIO(GDALRWFlag rw, int xoff, int yoff, int xsize, int ysize,
+                     void* data, int buf_xsize, int buf_ysize, GDALDataType buf_type,
+                     GSpacing pixel_space, GSpacing line_space,
+                     GDALRasterIOExtraArg* extra) override;
+
+    double GetOffset(int* pbSuccess=NULL) override;
+    double GetScale(int* pbSuccess=NULL) override;
+    double GetNoDataValue(int* pbSuccess=NULL) override;
+    GDALRasterBand* GetMaskBand() override;
+    int GetMaskFlags() override;
+    int GetOverviewCount() override;
+    GDALRasterBand* GetOverview(int idx) override;
+
+    /**
+     * Return the overview strip \a strip, computing all its levels in one
+     * pass over the full resolution lines if it is not cached.
+     */
+    const OverviewStrip* overview_strip(int strip);
+};
+
+/**
+ * Overview of a XRIT raster band, reduced by an integer factor with box
+ * averages computed from the full resolution data
+ */
+class XRITOverviewBand : public GDALRasterBand
+{
+public:
+    XRITRasterBand* parent;
+    /// Index in the parent overviews
+    int level;
+    int factor;
+
+    XRITOverviewBand(XRITRasterBand* parent, int level, int factor);
+
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
 
+    const char* GetUnitType() override;
     double GetOffset(int* pbSuccess=NULL) override;
     double GetScale(int* pbSuccess=NULL) override;
     double GetNoDataValue(int* pbSuccess=NULL) override;
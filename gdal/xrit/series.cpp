@@ -0,0 +1,350 @@
+#include "series.h"
+#include "dataset.h"
+#include "rasterband.h"
+#include <msat/gdal/const.h>
+#include <cpl_conv.h>
+#include <cpl_string.h>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+namespace {
+
+/// Parse a XRIT timing (YYYYMMDDHHMM) as a UTC time
+bool parse_timing(const std::string& timing, time_t& res)
+{
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    if (timing.size() != 12 || sscanf(timing.c_str(), "%4d%2d%2d%2d%2d",
+                &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min) != 5)
+        return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    res = timegm(&t);
+    return true;
+}
+
+}
+
+SeriesDataset::SeriesDataset(const FileAccess& first, unsigned count, unsigned step)
+{
+    time_t start;
+    if (!parse_timing(first.timing, start))
+        throw std::runtime_error(first.timing + " is not a valid XRIT timing");
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        time_t t = start + (time_t)i * step * 60;
+        char buf[16];
+        strftime(buf, 16, "%Y%m%d%H%M", gmtime(&t));
+        FileAccess fa(first);
+        fa.timing = buf;
+        accesses.push_back(fa);
+    }
+
+    missing.resize(count, false);
+    pending.resize(count);
+    prefetch_count = atoi(CPLGetConfigOption("MSAT_SERIES_PREFETCH", "1"));
+    // Keep the timeslot being read and the prefetched ones
+    max_open_slots = std::max(2u, prefetch_count + 1);
+}
+
+SeriesDataset::~SeriesDataset()
+{
+    // Wait for background threads before deallocating what they use
+    for (auto& p: pending)
+        if (p.valid())
+            delete p.get();
+}
+
+bool SeriesDataset::init()
+{
+    unique_ptr<XRITDataset> first(new XRITDataset(accesses[0]));
+    MSG_header header;
+    first->da.scan(accesses[0], pro, epi, header);
+    if (!first->init(pro, epi, header)) return false;
+
+    nRasterXSize = first->GetRasterXSize();
+    nRasterYSize = first->GetRasterYSize();
+    osr = first->osr;
+    memcpy(geotransform, first->geotransform, 6 * sizeof(double));
+    data_type = first->GetRasterBand(1)->GetRasterDataType();
+    unit_type = first->GetRasterBand(1)->GetUnitType();
+    hrv = first->da.hrv;
+    if (SetMetadata(first->GetMetadata(MD_DOMAIN_MSAT), MD_DOMAIN_MSAT) != CE_None)
+        return false;
+
+    // Describe each band with the time of its timeslot
+    for (unsigned i = 0; i < accesses.size(); ++i)
+    {
+        time_t t;
+        parse_timing(accesses[i].timing, t);
+        char buf[25];
+        strftime(buf, 25, "%Y-%m-%d %H:%M:00", gmtime(&t));
+        SetBand(i + 1, new SeriesRasterBand(this, i + 1, buf));
+    }
+
+    open_slots.push_front(OpenSlot{0, move(first)});
+    return true;
+}
+
+const OGRSpatialReference* SeriesDataset::GetSpatialRef() const
+{
+    return &osr;
+}
+
+CPLErr SeriesDataset::GetGeoTransform(double* tr)
+{
+    memcpy(tr, geotransform, 6 * sizeof(double));
+    return CE_None;
+}
+
+XRITDataset* SeriesDataset::open_slot(unsigned idx, int xoff, int yoff, int xsize, int ysize) const
+{
+    const FileAccess& fa = accesses[idx];
+    unique_ptr<XRITDataset> ds;
+    try {
+        ds.reset(new XRITDataset(fa));
+        // Only scan the segments, with the prologue of the first timeslot
+        MSG_header header;
+        bool ok;
+        if (hrv)
+        {
+            MSG_data slot_epi;
+            MSG_header epi_header;
+            ds->da.read_file(fa.epilogueFile(), epi_header, slot_epi);
+            ds->da.scan(fa, slot_epi, header);
+            ok = ds->init(pro, slot_epi, header);
+        } else {
+            ds->da.scan(fa, epi, header);
+            ok = ds->init(pro, epi, header);
+        }
+        if (!ok)
+        {
+            CPLDebug("MsatXRITSeries", "%s: cannot open timeslot, reading it as nodata", fa.toString().c_str());
+            return nullptr;
+        }
+    } catch (std::exception& e) {
+        CPLDebug("MsatXRITSeries", "%s: %s, reading it as nodata", fa.toString().c_str(), e.what());
+        return nullptr;
+    }
+
+    if (ds->GetRasterXSize() != nRasterXSize || ds->GetRasterYSize() != nRasterYSize
+            || memcmp(ds->geotransform, geotransform, 6 * sizeof(double)) != 0)
+    {
+        CPLDebug("MsatXRITSeries", "%s: grid differs from the first timeslot, reading it as nodata", fa.toString().c_str());
+        return nullptr;
+    }
+
+    // Decode the window into the block cache, so that reading it later
+    // costs a copy
+    if (ysize > 0)
+    {
+        GDALRasterBand* rb = ds->GetRasterBand(1);
+        int bx, by;
+        rb->GetBlockSize(&bx, &by);
+        for (int y = yoff / by; y <= (yoff + ysize - 1) / by; ++y)
+            for (int x = xoff / bx; x <= (xoff + xsize - 1) / bx; ++x)
+                if (GDALRasterBlock* block = rb->GetLockedBlockRef(x, y))
+                    block->DropLock();
+    }
+
+    return ds.release();
+}
+
+bool SeriesDataset::is_open(unsigned idx) const
+{
+    for (const auto& s: open_slots)
+        if (s.idx == idx)
+            return true;
+    return false;
+}
+
+XRITDataset* SeriesDataset::slot(unsigned idx)
+{
+    if (missing[idx]) return nullptr;
+
+    for (auto i = open_slots.begin(); i != open_slots.end(); ++i)
+        if (i->idx == idx)
+        {
+            if (i != open_slots.begin())
+            {
+                OpenSlot tmp = move(*i);
+                open_slots.erase(i);
+                open_slots.push_front(move(tmp));
+            }
+            return open_slots.front().ds.get();
+        }
+
+    XRITDataset* ds = nullptr;
+    if (pending[idx].valid())
+        ds = pending[idx].get();
+    // Try again if the background opening failed, in case files have
+    // arrived since
+    if (!ds)
+        ds = open_slot(idx);
+    if (!ds)
+    {
+        missing[idx] = true;
+        return nullptr;
+    }
+
+    // Close the least recently used timeslot, which is opened again if it is
+    // read later
+    if (open_slots.size() >= max_open_slots)
+        open_slots.pop_back();
+    open_slots.push_front(OpenSlot{idx, unique_ptr<XRITDataset>(ds)});
+    return ds;
+}
+
+void SeriesDataset::prefetch(unsigned idx, int xoff, int yoff, int xsize, int ysize)
+{
+    for (unsigned i = idx + 1; i <= idx + prefetch_count && i < accesses.size(); ++i)
+    {
+        if (missing[i] || pending[i].valid() || is_open(i)) continue;
+        pending[i] = std::async(std::launch::async, [=] {
+            // Errors are reported when the timeslot is used
+            CPLPushErrorHandler(CPLQuietErrorHandler);
+            XRITDataset* res = open_slot(i, xoff, yoff, xsize, ysize);
+            CPLPopErrorHandler();
+            return res;
+        });
+    }
+}
+
+
+SeriesRasterBand::SeriesRasterBand(SeriesDataset* ds, int idx, const std::string& datetime)
+    : sds(ds)
+{
+    poDS = ds;
+    nBand = idx;
+    eDataType = ds->data_type;
+    // Same as XRIT raster bands
+    nBlockXSize = ds->GetRasterXSize();
+    nBlockYSize = 1;
+
+    SetDescription(datetime.c_str());
+    SetMetadataItem(MD_MSAT_DATETIME, datetime.c_str(), MD_DOMAIN_MSAT);
+}
+
+CPLErr SeriesRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    XRITDataset* ds = sds->slot(nBand - 1);
+    if (!ds)
+    {
+        memset(buf, 0, GDALGetDataTypeSizeBytes(eDataType) * nBlockXSize * nBlockYSize);
+        return CE_None;
+    }
+
+    return ds->GetRasterBand(1)->RasterIO(GF_Read,
+            xblock * nBlockXSize, yblock * nBlockYSize, nBlockXSize, nBlockYSize,
+            buf, nBlockXSize, nBlockYSize, eDataType, 0, 0);
+}
+
+CPLErr SeriesRasterBand::IRasterIO(GDALRWFlag rw, int xoff, int yoff, int xsize, int ysize,
+                 void* data, int buf_xsize, int buf_ysize, GDALDataType buf_type,
+                 GSpacing pixel_space, GSpacing line_space,
+                 GDALRasterIOExtraArg* extra)
+{
+    // Decode the same window of the next timeslots while this one is read
+    if (rw == GF_Read)
+        sds->prefetch(nBand - 1, xoff, yoff, xsize, ysize);
+    return GDALRasterBand::IRasterIO(rw, xoff, yoff, xsize, ysize, data, buf_xsize, buf_ysize, buf_type, pixel_space, line_space, extra);
+}
+
+const char* SeriesRasterBand::GetUnitType()
+{
+    return sds->unit_type.c_str();
+}
+
+double SeriesRasterBand::GetOffset(int* pbSuccess)
+{
+    XRITDataset* ds = sds->slot(nBand - 1);
+    if (!ds)
+    {
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 0.0;
+    }
+    return ds->GetRasterBand(1)->GetOffset(pbSuccess);
+}
+
+double SeriesRasterBand::GetScale(int* pbSuccess)
+{
+    XRITDataset* ds = sds->slot(nBand - 1);
+    if (!ds)
+    {
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 1.0;
+    }
+    return ds->GetRasterBand(1)->GetScale(pbSuccess);
+}
+
+double SeriesRasterBand::GetNoDataValue(int* pbSuccess)
+{
+    XRITDataset* ds = sds->slot(nBand - 1);
+    if (!ds)
+    {
+        // Missing timeslots are read as 0
+        if (pbSuccess) *pbSuccess = TRUE;
+        return 0.0;
+    }
+    return ds->GetRasterBand(1)->GetNoDataValue(pbSuccess);
+}
+
+
+GDALDataset* SeriesOpen(GDALOpenInfo* info)
+{
+    // MSATSERIES:count:step:xrit name
+    if (!STARTS_WITH_CI(info->pszFilename, "MSATSERIES:"))
+        return NULL;
+
+    const char* spec = info->pszFilename + 11;
+    char* endptr;
+    unsigned long count = strtoul(spec, &endptr, 10);
+    unsigned long step = 0;
+    if (*endptr == ':')
+        step = strtoul(endptr + 1, &endptr, 10);
+    if (*endptr != ':' || count == 0 || step == 0 || !isValid(endptr + 1))
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: expected MSATSERIES:count:step:xritname", info->pszFilename);
+        return NULL;
+    }
+
+    try {
+        unique_ptr<SeriesDataset> ds(new SeriesDataset(FileAccess(endptr + 1), count, step));
+        if (!ds->init()) return NULL;
+        return ds.release();
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", info->pszFilename, e.what());
+        return NULL;
+    }
+}
+
+}
+}
+
+extern "C" {
+
+void GDALRegister_MsatXRITSeries()
+{
+    if (!GDAL_CHECK_VERSION("MsatXRITSeries"))
+        return;
+
+    if (GDALGetDriverByName("MsatXRITSeries") == NULL)
+    {
+        unique_ptr<GDALDriver> driver(new GDALDriver());
+        driver->SetDescription("MsatXRITSeries");
+        driver->SetMetadataItem(GDAL_DMD_LONGNAME, "Time series of Meteosat xRIT timeslots (via Meteosatlib)");
+        driver->pfnOpen = msat::xrit::SeriesOpen;
+        GetGDALDriverManager()->RegisterDriver(driver.release());
+    }
+}
+
+}
@@ -0,0 +1,133 @@
+#ifndef MSAT_GDALDRIVER_XRIT_SERIES_H
+#define MSAT_GDALDRIVER_XRIT_SERIES_H
+
+#include <msat/xrit/fileaccess.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <gdal/gdal_priv.h>
+#include <ogr_spatialref.h>
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace msat {
+namespace xrit {
+
+class XRITDataset;
+
+/**
+ * Time series of a XRIT channel, with one raster band for each timeslot.
+ *
+ * It is opened as MSATSERIES:count:step:name, where name is the XRIT name
+ * of the first timeslot, and step is the time between timeslots in minutes.
+ *
+ * All timeslots share the grid and georeferencing of the first one, and use
+ * its prologue for calibration: only their segment headers are scanned when
+ * they are opened. Non-HRV timeslots also use the epilogue of the first one,
+ * while HRV timeslots read their own, since it has the coverage of the HRV
+ * image, which changes between timeslots.
+ *
+ * Timeslots are opened when first read, and missing or inconsistent ones
+ * read as nodata. Only the most recently used timeslots are kept open.
+ * Reading a window of a band opens the following timeslots and decodes the
+ * same window in background threads, as many as the MSAT_SERIES_PREFETCH
+ * configuration option (1 by default).
+ */
+class SeriesDataset : public GDALDataset
+{
+public:
+    struct OpenSlot
+    {
+        unsigned idx;
+        std::unique_ptr<XRITDataset> ds;
+    };
+
+    /// Names of the timeslots
+    std::vector<FileAccess> accesses;
+
+    /// Prologue and epilogue of the first timeslot
+    MSG_data pro;
+    MSG_data epi;
+
+    /// Open timeslots, most recently used first
+    std::deque<OpenSlot> open_slots;
+
+    /// Maximum number of timeslots kept open
+    unsigned max_open_slots = 2;
+
+    /// True for timeslots that are missing or cannot be read
+    std::vector<bool> missing;
+
+    /// Timeslots being opened by background threads
+    std::vector<std::future<XRITDataset*>> pending;
+
+    OGRSpatialReference osr;
+    double geotransform[6];
+    GDALDataType data_type = GDT_Unknown;
+    std::string unit_type;
+    bool hrv = false;
+    unsigned prefetch_count = 1;
+
+    SeriesDataset(const FileAccess& first, unsigned count, unsigned step);
+    ~SeriesDataset();
+
+    /// Open the first timeslot and create the raster bands
+    bool init();
+
+    const OGRSpatialReference* GetSpatialRef() const override;
+    CPLErr GetGeoTransform(double* tr) override;
+
+    /**
+     * Return timeslot \a idx, opening it or waiting for its background
+     * opening if needed. Returns nullptr if the timeslot cannot be read.
+     *
+     * The result is valid until the next call of slot().
+     */
+    XRITDataset* slot(unsigned idx);
+
+    /// Check if timeslot \a idx is open
+    bool is_open(unsigned idx) const;
+
+    /// Start opening the timeslots after \a idx, decoding the given window
+    void prefetch(unsigned idx, int xoff, int yoff, int xsize, int ysize);
+
+protected:
+    /**
+     * Open timeslot \a idx, and decode the given window if ysize is not 0.
+     *
+     * This may run in a background thread, and only reads pro and epi from
+     * the dataset.
+     *
+     * Failures are reported with CPLDebug and return nullptr.
+     */
+    XRITDataset* open_slot(unsigned idx, int xoff=0, int yoff=0, int xsize=0, int ysize=0) const;
+};
+
+class SeriesRasterBand : public GDALRasterBand
+{
+public:
+    SeriesDataset* sds;
+
+    SeriesRasterBand(SeriesDataset* ds, int idx, const std::string& datetime);
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+    CPLErr IRasterIO(GDALRWFlag rw, int xoff, int yoff, int xsize, int ysize,
+                     void* data, int buf_xsize, int buf_ysize, GDALDataType buf_type,
+                     GSpacing pixel_space, GSpacing line_space,
+                     GDALRasterIOExtraArg* extra) override;
+
+    const char* GetUnitType() override;
+    double GetOffset(int* pbSuccess=NULL) override;
+    double GetScale(int* pbSuccess=NULL) override;
+    double GetNoDataValue(int* pbSuccess=NULL) override;
+};
+
+}
+}
+
+extern "C" {
+void GDALRegister_MsatXRITSeries(void);
+}
+
+#endif
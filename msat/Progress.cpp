@@ -1,15 +1,83 @@
 #include "Progress.h"
+#include <map>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
 
 using namespace std;
 
 namespace msat {
 
-static Progress* instance = 0;
+namespace {
+
+/// Innermost span alive in the current thread
+thread_local ProgressSpan* current_span = nullptr;
+
+std::atomic<unsigned> thread_count(0);
+
+/// Number of the current thread in trace records
+unsigned thread_number()
+{
+	thread_local unsigned number = ++thread_count;
+	return number;
+}
+
+void stop_tracing_at_exit()
+{
+	Progress::get().stop_tracing();
+}
+
+/// Write \a str as a JSON string
+void write_json_string(std::ostream& out, const std::string& str)
+{
+	out << '"';
+	for (auto c: str)
+	{
+		switch (c)
+		{
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			default:
+				if ((unsigned char)c < 0x20)
+				{
+					char buf[8];
+					snprintf(buf, 8, "\\u%04x", (unsigned)c);
+					out << buf;
+				} else
+					out << c;
+		}
+	}
+	out << '"';
+}
+
+}
+
+Progress::Progress()
+	: handler(new ProgressHandler), m_tracing(false), trace_format(TRACE_CHROME)
+{
+}
 
 Progress& Progress::get()
 {
-	if (!instance)
-		instance = new Progress;
+	// Function-level static initialization is thread safe, and spans can
+	// be created by any thread
+	static Progress* instance = []{
+		Progress* res = new Progress;
+		const char* pathname = getenv("MSAT_TRACE");
+		if (pathname && *pathname)
+		{
+			const char* format = getenv("MSAT_TRACE_FORMAT");
+			if (format && strcmp(format, "summary") == 0)
+				res->start_tracing(pathname, TRACE_SUMMARY);
+			else
+				res->start_tracing(pathname, TRACE_CHROME);
+			atexit(stop_tracing_at_exit);
+		}
+		return res;
+	}();
 	return *instance;
 }
 
@@ -39,6 +107,127 @@ void Progress::popTask()
 	handler->popTask();
 }
 
+void Progress::start_tracing(const std::string& pathname, TraceFormat format)
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace_pathname = pathname;
+	trace_format = format;
+	trace.clear();
+	trace_start = std::chrono::steady_clock::now();
+	m_tracing = true;
+}
+
+bool Progress::stop_tracing()
+{
+	if (!m_tracing) return true;
+	m_tracing = false;
+
+	ofstream out(trace_pathname);
+	if (trace_format == TRACE_SUMMARY)
+		write_trace_summary(out);
+	else
+		write_chrome_trace(out);
+	out.close();
+	if (out.fail())
+	{
+		cerr << trace_pathname << ": cannot write trace file" << endl;
+		return false;
+	}
+	return true;
+}
+
+uint64_t Progress::trace_clock() const
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - trace_start).count();
+}
+
+void Progress::record(ProgressSpanRecord&& rec)
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	trace.emplace_back(std::move(rec));
+}
+
+std::vector<ProgressSpanRecord> Progress::records() const
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	return trace;
+}
+
+void Progress::write_chrome_trace(std::ostream& out) const
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+	const int pid = getpid();
+	char buf[64];
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto& rec: trace)
+	{
+		out << (first ? "\n" : ",\n");
+		first = false;
+		out << "{\"name\":";
+		write_json_string(out, rec.name);
+		// Timestamps are in microseconds
+		snprintf(buf, 64, "%.3f", rec.start / 1000.0);
+		out << ",\"cat\":\"msat\",\"ph\":\"X\",\"ts\":" << buf;
+		snprintf(buf, 64, "%.3f", rec.duration / 1000.0);
+		out << ",\"dur\":" << buf;
+		out << ",\"pid\":" << pid << ",\"tid\":" << rec.thread;
+		out << ",\"args\":{\"path\":";
+		write_json_string(out, rec.path);
+		out << ",\"bytes\":" << rec.bytes << ",\"pixels\":" << rec.pixels << "}}";
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Progress::write_trace_summary(std::ostream& out) const
+{
+	struct Total
+	{
+		unsigned count = 0;
+		uint64_t duration = 0;
+		uint64_t bytes = 0;
+		uint64_t pixels = 0;
+	};
+
+	// Sorting by path lists every span right after the span it is nested in
+	std::map<std::string, Total> totals;
+	{
+		std::lock_guard<std::mutex> lock(trace_mutex);
+		for (const auto& rec: trace)
+		{
+			Total& t = totals[rec.path];
+			++t.count;
+			t.duration += rec.duration;
+			t.bytes += rec.bytes;
+			t.pixels += rec.pixels;
+		}
+	}
+
+	char buf[256];
+	snprintf(buf, 256, "%-32s %8s %12s %12s %14s %14s %10s %10s",
+			"span", "calls", "total_s", "mean_ms", "bytes", "pixels", "MB/s", "Mpix/s");
+	out << buf << endl;
+	for (const auto& i: totals)
+	{
+		// Indent the span name by its nesting level
+		size_t pos = i.first.rfind('/');
+		size_t depth = 0;
+		for (auto c: i.first)
+			if (c == '/') ++depth;
+		string name = string(depth * 2, ' ') + (pos == string::npos ? i.first : i.first.substr(pos + 1));
+
+		const Total& t = i.second;
+		double secs = t.duration / 1e9;
+		snprintf(buf, 256, "%-32s %8u %12.6f %12.6f %14llu %14llu %10.2f %10.2f",
+				name.c_str(), t.count, secs, secs * 1000.0 / t.count,
+				(unsigned long long)t.bytes, (unsigned long long)t.pixels,
+				secs > 0 ? t.bytes / secs / 1e6 : 0.0,
+				secs > 0 ? t.pixels / secs / 1e6 : 0.0);
+		out << buf << endl;
+	}
+}
+
 
 ProgressTask::ProgressTask(const std::string& desc) : p(Progress::get())
 {
@@ -55,6 +244,36 @@ void ProgressTask::activity(const std::string& str, int perc, int tot)
 	p.activity(str, perc, tot);
 }
 
+ProgressSpan::ProgressSpan(const char* name)
+	: name(name), active(Progress::get().tracing())
+{
+	if (!active) return;
+	parent = current_span;
+	current_span = this;
+	start = Progress::get().trace_clock();
+}
+
+ProgressSpan::~ProgressSpan()
+{
+	if (!active) return;
+	Progress& p = Progress::get();
+	uint64_t end = p.trace_clock();
+	current_span = parent;
+	if (!p.tracing()) return;
+
+	ProgressSpanRecord rec;
+	rec.name = name;
+	rec.path = name;
+	for (ProgressSpan* s = parent; s; s = s->parent)
+		rec.path = string(s->name) + "/" + rec.path;
+	rec.start = start;
+	rec.duration = end - start;
+	rec.thread = thread_number();
+	rec.bytes = m_bytes;
+	rec.pixels = m_pixels;
+	p.record(std::move(rec));
+}
+
 void StreamProgressHandler::outputIndent()
 {
 	for (int i = 0; i < indent; ++i)
@@ -3,6 +3,11 @@
 
 #include <string>
 #include <ostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
 namespace msat {
 
@@ -14,13 +19,56 @@ struct ProgressHandler
 	virtual void popTask() {}
 };
 
+/// Timing of a ProgressSpan, recorded when the span ends
+struct ProgressSpanRecord
+{
+	/// Name of the span
+	const char* name;
+	/// Names of the enclosing spans and of this span, separated by '/'
+	std::string path;
+	/// Start time, in nanoseconds since tracing started
+	uint64_t start;
+	/// Duration, in nanoseconds
+	uint64_t duration;
+	/// Number of the thread that ran the span, starting from 1
+	unsigned thread;
+	/// Bytes processed by the span
+	uint64_t bytes;
+	/// Pixels processed by the span
+	uint64_t pixels;
+};
+
 // Singleton class handling progress notification
 class Progress
 {
 	ProgressHandler* handler;
 
 public:
-	Progress() : handler(new ProgressHandler) {}
+	enum TraceFormat {
+		/// JSON trace event file, as read by chrome://tracing and Perfetto
+		TRACE_CHROME,
+		/// Plain text table with the totals of each span path
+		TRACE_SUMMARY,
+	};
+
+protected:
+	std::atomic<bool> m_tracing;
+	std::string trace_pathname;
+	TraceFormat trace_format;
+	std::chrono::steady_clock::time_point trace_start;
+	mutable std::mutex trace_mutex;
+	std::vector<ProgressSpanRecord> trace;
+
+public:
+	/**
+	 * Create a Progress without tracing.
+	 *
+	 * Progress::get() also starts tracing if the MSAT_TRACE environment
+	 * variable is set, writing the trace to the file it names when the
+	 * program exits. MSAT_TRACE_FORMAT can be "chrome" (the default) or
+	 * "summary".
+	 */
+	Progress();
 	~Progress();
 
 	static Progress& get();
@@ -32,6 +80,67 @@ public:
 
 	void pushTask(const std::string& desc);
 	void popTask();
+
+	/// Check if spans are being recorded
+	bool tracing() const { return m_tracing.load(std::memory_order_relaxed); }
+
+	/// Start recording spans, to be written to \a pathname by stop_tracing()
+	void start_tracing(const std::string& pathname, TraceFormat format=TRACE_CHROME);
+
+	/**
+	 * Stop recording spans and write the trace file.
+	 *
+	 * Returns false, after printing an error to stderr, if the file could
+	 * not be written.
+	 */
+	bool stop_tracing();
+
+	/// Nanoseconds elapsed since tracing started
+	uint64_t trace_clock() const;
+
+	/// Add the timing of a span that ended
+	void record(ProgressSpanRecord&& rec);
+
+	/// Return a copy of the spans recorded so far
+	std::vector<ProgressSpanRecord> records() const;
+
+	/// Write the spans recorded so far as a Chrome trace event file
+	void write_chrome_trace(std::ostream& out) const;
+
+	/// Write a table with the totals of the spans recorded so far
+	void write_trace_summary(std::ostream& out) const;
+};
+
+/**
+ * Timed section of code.
+ *
+ * The span lasts from construction to destruction. Spans created while
+ * another span of the same thread is alive are nested inside it.
+ *
+ * When tracing is off, a span only costs a check of Progress::tracing(),
+ * so spans can stay in the hot paths.
+ */
+class ProgressSpan
+{
+	const char* name;
+	ProgressSpan* parent = nullptr;
+	uint64_t start = 0;
+	uint64_t m_bytes = 0;
+	uint64_t m_pixels = 0;
+	bool active;
+
+public:
+	/// Start a span. \a name must outlive the span, like a string literal.
+	explicit ProgressSpan(const char* name);
+	ProgressSpan(const ProgressSpan&) = delete;
+	ProgressSpan& operator=(const ProgressSpan&) = delete;
+	~ProgressSpan();
+
+	/// Account for \a count more bytes processed
+	void add_bytes(uint64_t count) { m_bytes += count; }
+
+	/// Account for \a count more pixels processed
+	void add_pixels(uint64_t count) { m_pixels += count; }
 };
 
 class ProgressTask
@@ -29,5 +29,8 @@
 #define MD_MSAT_INSTITUTION     "MSAT_INSTITUTION"
 #define MD_MSAT_PRODUCT_TYPE    "MSAT_PRODUCT_TYPE"
 
+// Performance counters of a dataset, as set by msat::dataset::set_stats_metadata
+#define MD_DOMAIN_MSAT_STATS    "MSAT_STATS"
+
 // vim:set sw=2:
 #endif
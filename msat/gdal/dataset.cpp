@@ -19,10 +19,17 @@
 
 #include "dataset.h"
 #include "gdaltranslate.h"
+#include "const.h"
 #include <gdal/vrtdataset.h>
 #include <gdal/ogr_spatialref.h>
 #include <msat/facts.h>
+#include <msat/Progress.h>
+#include <msat/stats.h>
 #include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <cstring>
 
 using namespace std;
 
@@ -131,6 +138,8 @@ GDALDataset* recode(
 	if (!opt2.empty()) options = CSLAddString(options, opt2.c_str());
 	if (!opt3.empty()) options = CSLAddString(options, opt3.c_str());
 
+        ProgressSpan span("export");
+        span.add_pixels((uint64_t)vds->GetRasterXSize() * vds->GetRasterYSize() * vds->GetRasterCount());
         GDALDataset* res = (GDALDataset*)GDALCreateCopy(driver, fileName.c_str(), (GDALDatasetH)vds,
                               TRUE, options, NULL, NULL );
                               //TRUE, options, pfnProgress, NULL );
@@ -260,6 +269,179 @@ CPLErr GeoReferencer::latlonToProjected(double lat, double lon, double& px, doub
 	return CE_None;
 }
 
+void EarthDisk::init(GDALDataset* ds)
+{
+    width = ds->GetRasterXSize();
+    int height = ds->GetRasterYSize();
+    starts.assign(height, 0);
+    ends.assign(height, width);
+
+    double gt[6];
+    if (ds->GetGeoTransform(gt) != CE_None) return;
+    // Rotated grids are not supported
+    if (gt[1] == 0.0 || gt[2] != 0.0 || gt[4] != 0.0) return;
+
+    const OGRSpatialReference* osr = ds->GetSpatialRef();
+    if (!osr) return;
+    const char* projname = osr->GetAttrValue("PROJECTION");
+    if (!projname || !EQUAL(projname, SRS_PT_GEOSTATIONARY_SATELLITE)) return;
+
+    double a = osr->GetSemiMajor();
+    double b = osr->GetSemiMinor();
+    double h = osr->GetNormProjParm(SRS_PP_SATELLITE_HEIGHT, ORBIT_RADIUS_FOR_GDAL);
+    double fe = osr->GetNormProjParm(SRS_PP_FALSE_EASTING, 0.0);
+    double fn = osr->GetNormProjParm(SRS_PP_FALSE_NORTHING, 0.0);
+
+    // Same test as the inverse geos projection in PROJ: with x and y scaled
+    // by the semi-major axis, the view ray hits the ellipsoid when
+    //   (1 + tan²(y/rg1) / rp²) * (1 + tan²(x/rg1)) <= rg² / (rg² - 1)
+    // which can be solved for the maximum |x| of each line
+    double rg1 = h / a;
+    double rg = 1.0 + rg1;
+    double rp = b / a;
+    double limit = rg * rg / (rg * rg - 1.0);
+
+    for (int y = 0; y < height; ++y)
+    {
+        double py = (gt[3] + gt[5] * y - fn) / a;
+        double tz = tan(py / rg1);
+        double k = limit / (1.0 + tz * tz / (rp * rp)) - 1.0;
+        if (k < 0)
+        {
+            starts[y] = ends[y] = 0;
+            continue;
+        }
+
+        double xmax = rg1 * atan(sqrt(k)) * a;
+        double c0 = (fe - xmax - gt[0]) / gt[1];
+        double c1 = (fe + xmax - gt[0]) / gt[1];
+        if (c0 > c1) swap(c0, c1);
+        long start = max(0L, lrint(ceil(c0)));
+        long end = min((long)width, lrint(floor(c1)) + 1);
+        if (start >= end)
+            starts[y] = ends[y] = 0;
+        else
+        {
+            starts[y] = start;
+            ends[y] = end;
+        }
+    }
+}
+
+bool EarthDisk::is_space(int x, int y, int sx, int sy) const
+{
+    for (int iy = y; iy < y + sy; ++iy)
+        if (starts[iy] < ends[iy] && starts[iy] < x + sx && ends[iy] > x)
+            return false;
+    return true;
+}
+
+std::shared_ptr<const EarthDisk> earth_disk(GDALDataset* ds)
+{
+    static std::mutex cache_mutex;
+    static std::map<std::string, std::weak_ptr<const EarthDisk>> cache;
+
+    // Identify the grid by size, geotransform and projection
+    std::string key;
+    int size[2] = { ds->GetRasterXSize(), ds->GetRasterYSize() };
+    key.append((const char*)size, sizeof(size));
+    double gt[6];
+    if (ds->GetGeoTransform(gt) == CE_None)
+        key.append((const char*)gt, sizeof(gt));
+    key += "|";
+    if (const OGRSpatialReference* osr = ds->GetSpatialRef())
+    {
+        char* wkt = nullptr;
+        if (osr->exportToWkt(&wkt) == OGRERR_NONE && wkt)
+            key += wkt;
+        CPLFree(wkt);
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto i = cache.find(key);
+    if (i != cache.end())
+        if (auto res = i->second.lock())
+            return res;
+
+    // Drop entries whose grids are no longer in use
+    for (auto j = cache.begin(); j != cache.end(); )
+        if (j->second.expired())
+            j = cache.erase(j);
+        else
+            ++j;
+
+    auto res = std::make_shared<EarthDisk>();
+    res->init(ds);
+    cache[key] = res;
+    return res;
+}
+
+EarthMaskRasterBand::EarthMaskRasterBand(GDALDataset* ds)
+    : disk(earth_disk(ds))
+{
+    poDS = ds;
+    nBand = 0;
+    nRasterXSize = ds->GetRasterXSize();
+    nRasterYSize = ds->GetRasterYSize();
+    nBlockXSize = nRasterXSize;
+    nBlockYSize = 1;
+    eDataType = GDT_Byte;
+}
+
+CPLErr EarthMaskRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    if (xblock != 0)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "Invalid block number");
+        return CE_Failure;
+    }
+
+    uint8_t* dest = (uint8_t*)buf;
+    memset(dest, 0, nBlockXSize);
+    int start = disk->starts[yblock];
+    int end = disk->ends[yblock];
+    if (start < end)
+        memset(dest + start, 255, end - start);
+    return CE_None;
+}
+
+std::shared_ptr<const EarthDisk> earth_disk_mask(GDALRasterBand* rb)
+{
+    EarthMaskRasterBand* mask = dynamic_cast<EarthMaskRasterBand*>(rb->GetMaskBand());
+    if (!mask)
+        return nullptr;
+    if (mask->disk->width != rb->GetXSize() || (int)mask->disk->starts.size() != rb->GetYSize())
+        return nullptr;
+    return mask->disk;
+}
+
+void set_stats_metadata(GDALDataset* ds, const Stats& stats, const std::vector<GDALDataset*>& sources)
+{
+    std::vector<std::pair<std::string, double>> values = stats.values();
+    for (auto src: sources)
+    {
+        char** md = src->GetMetadata(MD_DOMAIN_MSAT_STATS);
+        for (char** s = md; md && *s; ++s)
+        {
+            char* key = nullptr;
+            const char* val = CPLParseNameValue(*s, &key);
+            if (!key) continue;
+            for (auto& v: values)
+                if (v.first == key)
+                    v.second += CPLAtof(val);
+            CPLFree(key);
+        }
+    }
+
+    CPLStringList md;
+    for (const auto& v: values)
+    {
+        bool is_time = v.first.size() > 5 && v.first.compare(v.first.size() - 5, 5, "_TIME") == 0;
+        md.SetNameValue(v.first.c_str(), CPLSPrintf(is_time ? "%.6f" : "%.0f", v.second));
+    }
+    ds->SetMetadata(md.List(), MD_DOMAIN_MSAT_STATS);
+}
+
 
 ProxyDataset::ProxyDataset(GDALDataset& ds)
     : ds(ds)
@@ -317,6 +499,8 @@ double ProxyRasterBand::GetScale(int *pbSuccess) { return rb.GetScale(pbSuccess)
 const char* ProxyRasterBand::GetUnitType() { return rb.GetUnitType(); }
 GDALColorInterp ProxyRasterBand::GetColorInterpretation() { return rb.GetColorInterpretation(); }
 GDALColorTable* ProxyRasterBand::GetColorTable() { return rb.GetColorTable(); }
+GDALRasterBand* ProxyRasterBand::GetMaskBand() { return rb.GetMaskBand(); }
+int ProxyRasterBand::GetMaskFlags() { return rb.GetMaskFlags(); }
 CPLErr ProxyRasterBand::IReadBlock(int xblock, int yblock, void *buf)
 {
     return rb.ReadBlock(xblock, yblock, buf);
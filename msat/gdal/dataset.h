@@ -22,11 +22,15 @@
 
 #include <msat/gdal/clean_gdal_priv.h>
 #include <msat/gdal/points.h>
+#include <vector>
+#include <memory>
 
 struct OGRSpatialReference;
 struct OGRCoordinateTransformation;
 
 namespace msat {
+struct Stats;
+
 namespace dataset {
 
 /// Get the WKT description for the Spaceview projection
@@ -103,6 +107,82 @@ public:
 	}
 };
 
+/**
+ * Portion of a geostationary satellite image that sees the Earth.
+ *
+ * The Earth disk is convex, so every line intersects it in at most one span
+ * of columns, stored as [start, end). Pixel coordinates are mapped to
+ * projected coordinates as GeoReferencer does.
+ *
+ * Datasets that are not in a geostationary projection are considered to see
+ * the Earth everywhere.
+ */
+struct EarthDisk
+{
+    /// Image width in pixels
+    int width = 0;
+
+    /// First column of each line that sees the Earth
+    std::vector<int> starts;
+
+    /**
+     * One past the last column of each line that sees the Earth.
+     *
+     * Lines entirely in space have start == end.
+     */
+    std::vector<int> ends;
+
+    /// Compute the Earth disk for the raster grid of \a ds
+    void init(GDALDataset* ds);
+
+    /// Check if the pixel at x, y sees the Earth
+    bool is_earth(int x, int y) const { return x >= starts[y] && x < ends[y]; }
+
+    /// Check if the rectangle x, y, sx, sy is entirely in space
+    bool is_space(int x, int y, int sx, int sy) const;
+};
+
+/**
+ * Return the Earth disk of the raster grid of \a ds.
+ *
+ * The result is cached and shared by all datasets with the same size,
+ * geotransform and projection, so that it is computed only once for all the
+ * bands of an image and for the datasets derived from it.
+ */
+std::shared_ptr<const EarthDisk> earth_disk(GDALDataset* ds);
+
+/**
+ * Mask band marking as valid (255) the pixels that see the Earth, and as
+ * invalid (0) the pixels in space.
+ */
+class EarthMaskRasterBand : public GDALRasterBand
+{
+public:
+    std::shared_ptr<const EarthDisk> disk;
+
+    EarthMaskRasterBand(GDALDataset* ds);
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+};
+
+/**
+ * Return the Earth disk that \a rb uses as mask band, or nullptr if \a rb is
+ * not masked with an EarthMaskRasterBand.
+ *
+ * The mask is found from GetMaskBand, since the bands report the mask flags
+ * of their nodata value.
+ */
+std::shared_ptr<const EarthDisk> earth_disk_mask(GDALRasterBand* rb);
+
+/**
+ * Set the MD_DOMAIN_MSAT_STATS metadata of \a ds to the counters of \a stats,
+ * adding the MD_DOMAIN_MSAT_STATS counters of \a sources.
+ *
+ * Datasets call this each time their MSAT_STATS metadata is queried, so that
+ * it has the current values.
+ */
+void set_stats_metadata(GDALDataset* ds, const Stats& stats, const std::vector<GDALDataset*>& sources=std::vector<GDALDataset*>());
+
 /**
  * Proxy all virtual methods to another dataset.
  *
@@ -161,6 +241,8 @@ public:
     const char* GetUnitType() override;
     GDALColorInterp GetColorInterpretation() override;
     GDALColorTable* GetColorTable() override;
+    GDALRasterBand* GetMaskBand() override;
+    int GetMaskFlags() override;
     CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
 };
 
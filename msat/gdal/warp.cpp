@@ -0,0 +1,563 @@
+/*
+ * Copyright (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "warp.h"
+#include "dataset.h"
+#include "const.h"
+#include <msat/stats.h>
+#include <msat/Progress.h>
+#include <gdal/ogr_spatialref.h>
+#include <algorithm>
+#include <filesystem>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace msat {
+namespace dataset {
+
+namespace {
+
+const char file_magic[8] = { 'M', 'S', 'A', 'T', 'W', 'A', 'R', 'P' };
+const uint32_t file_version = 1;
+
+/**
+ * Header of saved tables.
+ *
+ * It is followed by the WKT of the source projection, padded to a multiple
+ * of 8 bytes, by the indices, and by the weights if the table is bilinear.
+ * Numbers are stored in host byte order, as tables are meant as a local
+ * cache.
+ */
+struct FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t bilinear;
+    double lat_north;
+    double lon_west;
+    double step;
+    int32_t width;
+    int32_t height;
+    int32_t src_width;
+    int32_t src_height;
+    double src_geotransform[6];
+    int32_t win_x;
+    int32_t win_y;
+    int32_t win_width;
+    int32_t win_height;
+    uint32_t wkt_size;
+    uint32_t pad;
+};
+
+size_t padded(size_t size)
+{
+    return (size + 7) / 8 * 8;
+}
+
+/**
+ * Check that the source window of a loaded table is inside the source grid,
+ * and that all its indices, and their bilinear neighbours, are inside the
+ * window. Throws std::runtime_error if they are not.
+ */
+void check_indices(const FileHeader& h, const uint32_t* indices, size_t count)
+{
+    if (h.win_x < 0 || h.win_y < 0 || h.win_width < 0 || h.win_height < 0
+            || (int64_t)h.win_x + h.win_width > h.src_width
+            || (int64_t)h.win_y + h.win_height > h.src_height)
+        throw std::runtime_error("source window of the warp table is outside the source grid");
+
+    uint64_t win_size = (uint64_t)h.win_width * h.win_height;
+    // Bilinear interpolation also reads the pixels to the right and below
+    uint64_t extent = h.bilinear ? (uint64_t)h.win_width + 2 : 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (indices[i] == WarpTable::none) continue;
+        if (indices[i] + extent > win_size || (h.bilinear && indices[i] % h.win_width == (uint32_t)h.win_width - 1))
+            throw std::runtime_error("warp table index " + std::to_string(indices[i]) + " is outside the source window");
+    }
+}
+
+std::string to_wkt(const OGRSpatialReference& osr)
+{
+    char* wkt = nullptr;
+    osr.exportToWkt(&wkt);
+    string res = wkt ? wkt : "";
+    CPLFree(wkt);
+    return res;
+}
+
+}
+
+bool LatLonGrid::parse(const std::string& spec)
+{
+    double latmin, latmax, lonmin, lonmax;
+    if (sscanf(spec.c_str(), "%lf,%lf,%lf,%lf,%lf", &latmin, &latmax, &lonmin, &lonmax, &step) != 5)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: grid should be in the format latmin,latmax,lonmin,lonmax,step", spec.c_str());
+        return false;
+    }
+    if (step <= 0 || latmax < latmin || lonmax < lonmin)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: grid has an empty area or a non-positive step", spec.c_str());
+        return false;
+    }
+
+    lat_north = latmax;
+    lon_west = lonmin;
+    // Allow for rounding errors in the extremes
+    height = floor((latmax - latmin) / step + 1e-6) + 1;
+    width = floor((lonmax - lonmin) / step + 1e-6) + 1;
+    return true;
+}
+
+void LatLonGrid::geotransform(double* gt) const
+{
+    gt[0] = lon_west - step / 2;
+    gt[1] = step;
+    gt[2] = 0.0;
+    gt[3] = lat_north + step / 2;
+    gt[4] = 0.0;
+    gt[5] = -step;
+}
+
+bool LatLonGrid::operator==(const LatLonGrid& o) const
+{
+    return lat_north == o.lat_north && lon_west == o.lon_west && step == o.step
+        && width == o.width && height == o.height;
+}
+
+
+bool WarpTable::compute(GDALDataset* ds, const LatLonGrid& grid, bool bilinear)
+{
+    ProgressSpan trace("geolocate");
+    if (grid.width <= 0 || grid.height <= 0 || grid.step <= 0)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "target grid is empty");
+        return false;
+    }
+
+    double gt[6], inv[6];
+    if (ds->GetGeoTransform(gt) != CE_None)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "no geotransform found in input dataset");
+        return false;
+    }
+    if (invertGeoTransform(gt, inv) != CE_None)
+        return false;
+
+    const OGRSpatialReference* osr = ds->GetSpatialRef();
+    if (!osr)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "no projection name found in input dataset");
+        return false;
+    }
+
+    int sw = ds->GetRasterXSize();
+    int sh = ds->GetRasterYSize();
+    if (bilinear && (sw < 2 || sh < 2))
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "input dataset is too small for bilinear interpolation");
+        return false;
+    }
+
+    OGRSpatialReference proj(*osr);
+    proj.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    unique_ptr<OGRSpatialReference> latlon(proj.CloneGeogCS());
+    latlon->SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    unique_ptr<OGRCoordinateTransformation> fromLatLon(OGRCreateCoordinateTransformation(latlon.get(), &proj));
+    if (!fromLatLon) return false;
+
+    // Source pixel of each target pixel (the top left one of the 4 around
+    // it, if bilinear), or -1
+    size_t count = (size_t)grid.width * grid.height;
+    trace.add_pixels(count);
+    vector<int> xs(count, -1);
+    vector<int> ys(count, -1);
+    vector<float> weights;
+    if (bilinear)
+        weights.resize(count * 4, 0.0f);
+
+    int xmin = sw, ymin = sh, xmax = -1, ymax = -1;
+    int span = bilinear ? 1 : 0;
+    vector<double> px(grid.width);
+    vector<double> py(grid.width);
+    vector<int> ok(grid.width);
+    for (int y = 0; y < grid.height; ++y)
+    {
+        double lat = grid.lat_north - y * grid.step;
+        for (int x = 0; x < grid.width; ++x)
+        {
+            px[x] = grid.lon_west + x * grid.step;
+            py[x] = lat;
+        }
+
+        // Transform a whole row at once. Points that cannot be projected,
+        // like those not visible from a satellite, are expected: they are
+        // flagged in ok, and should not be reported as errors
+        CPLPushErrorHandler(CPLQuietErrorHandler);
+        fromLatLon->Transform(grid.width, px.data(), py.data(), nullptr, ok.data());
+        CPLPopErrorHandler();
+
+        for (int x = 0; x < grid.width; ++x)
+        {
+            if (!ok[x] || !std::isfinite(px[x]) || !std::isfinite(py[x])) continue;
+
+            // Fractional pixel coordinates, with pixel centers on integers
+            // as in GeoReferencer::projectedToPixel
+            double fx = inv[0] + px[x] * inv[1] + py[x] * inv[2];
+            double fy = inv[3] + px[x] * inv[4] + py[x] * inv[5];
+            if (fx < -0.5 || fy < -0.5 || fx >= sw - 0.5 || fy >= sh - 0.5) continue;
+
+            size_t i = (size_t)y * grid.width + x;
+            int sx, sy;
+            if (bilinear)
+            {
+                sx = std::min(std::max((int)floor(fx), 0), sw - 2);
+                sy = std::min(std::max((int)floor(fy), 0), sh - 2);
+                double wx = std::min(std::max(fx - sx, 0.0), 1.0);
+                double wy = std::min(std::max(fy - sy, 0.0), 1.0);
+                weights[i * 4] = (1 - wx) * (1 - wy);
+                weights[i * 4 + 1] = wx * (1 - wy);
+                weights[i * 4 + 2] = (1 - wx) * wy;
+                weights[i * 4 + 3] = wx * wy;
+            } else {
+                sx = std::min((int)lrint(fx), sw - 1);
+                sy = std::min((int)lrint(fy), sh - 1);
+            }
+            xs[i] = sx;
+            ys[i] = sy;
+            xmin = std::min(xmin, sx);
+            ymin = std::min(ymin, sy);
+            xmax = std::max(xmax, sx + span);
+            ymax = std::max(ymax, sy + span);
+        }
+    }
+
+    this->grid = grid;
+    this->bilinear = bilinear;
+    src_width = sw;
+    src_height = sh;
+    memcpy(src_geotransform, gt, 6 * sizeof(double));
+    src_wkt = to_wkt(*osr);
+
+    if (xmax < 0)
+    {
+        // The target grid is outside the source grid
+        win_x = win_y = win_width = win_height = 0;
+    } else {
+        win_x = xmin;
+        win_y = ymin;
+        win_width = xmax - xmin + 1;
+        win_height = ymax - ymin + 1;
+    }
+
+    own_indices.resize(count);
+    for (size_t i = 0; i < count; ++i)
+        if (xs[i] < 0)
+            own_indices[i] = none;
+        else
+            own_indices[i] = (uint32_t)(ys[i] - win_y) * win_width + (xs[i] - win_x);
+    own_weights = move(weights);
+
+    map.reset();
+    index_data = own_indices.data();
+    weight_data = bilinear ? own_weights.data() : nullptr;
+    return true;
+}
+
+bool WarpTable::save(const std::string& pathname) const
+{
+    FileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, file_magic, 8);
+    h.version = file_version;
+    h.bilinear = bilinear ? 1 : 0;
+    h.lat_north = grid.lat_north;
+    h.lon_west = grid.lon_west;
+    h.step = grid.step;
+    h.width = grid.width;
+    h.height = grid.height;
+    h.src_width = src_width;
+    h.src_height = src_height;
+    memcpy(h.src_geotransform, src_geotransform, 6 * sizeof(double));
+    h.win_x = win_x;
+    h.win_y = win_y;
+    h.win_width = win_width;
+    h.win_height = win_height;
+    h.wkt_size = src_wkt.size();
+
+    size_t count = (size_t)grid.width * grid.height;
+    string buf((const char*)&h, sizeof(h));
+    buf += src_wkt;
+    buf.resize(sizeof(h) + padded(src_wkt.size()), 0);
+    buf.append((const char*)index_data, count * sizeof(uint32_t));
+    if (weight_data)
+        buf.append((const char*)weight_data, count * 4 * sizeof(float));
+
+    try {
+        // Write atomically, as other processes may be loading the table
+        sys::write_file_atomically(pathname.c_str(), buf, 0666);
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", pathname.c_str(), e.what());
+        return false;
+    }
+    return true;
+}
+
+bool WarpTable::load(const std::string& pathname)
+{
+    unique_ptr<sys::MMap> m;
+    try {
+        sys::File in(std::filesystem::path(pathname), O_RDONLY);
+        struct stat st;
+        in.fstat(st);
+        if ((size_t)st.st_size < sizeof(FileHeader))
+        {
+            CPLError(CE_Failure, CPLE_AppDefined, "%s: file is too short for a warp table", pathname.c_str());
+            return false;
+        }
+        m.reset(new sys::MMap(in.mmap(st.st_size, PROT_READ, MAP_SHARED)));
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", pathname.c_str(), e.what());
+        return false;
+    }
+
+    const char* data = *m;
+    const FileHeader* h = (const FileHeader*)data;
+    if (memcmp(h->magic, file_magic, 8) != 0 || h->version != file_version)
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: file is not a version %u warp table", pathname.c_str(), (unsigned)file_version);
+        return false;
+    }
+
+    size_t count = h->width > 0 && h->height > 0 ? (size_t)h->width * h->height : 0;
+    size_t indices_ofs = sizeof(FileHeader) + padded(h->wkt_size);
+    size_t size = indices_ofs + count * sizeof(uint32_t);
+    if (h->bilinear)
+        size += count * 4 * sizeof(float);
+    if (count == 0 || size != m->size())
+    {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: warp table is truncated or corrupted", pathname.c_str());
+        return false;
+    }
+
+    try {
+        check_indices(*h, (const uint32_t*)(data + indices_ofs), count);
+    } catch (std::exception& e) {
+        CPLError(CE_Failure, CPLE_AppDefined, "%s: %s", pathname.c_str(), e.what());
+        return false;
+    }
+
+    grid.lat_north = h->lat_north;
+    grid.lon_west = h->lon_west;
+    grid.step = h->step;
+    grid.width = h->width;
+    grid.height = h->height;
+    bilinear = h->bilinear != 0;
+    src_width = h->src_width;
+    src_height = h->src_height;
+    memcpy(src_geotransform, h->src_geotransform, 6 * sizeof(double));
+    src_wkt.assign(data + sizeof(FileHeader), h->wkt_size);
+    win_x = h->win_x;
+    win_y = h->win_y;
+    win_width = h->win_width;
+    win_height = h->win_height;
+
+    own_indices.clear();
+    own_weights.clear();
+    index_data = (const uint32_t*)(data + indices_ofs);
+    weight_data = bilinear ? (const float*)(data + indices_ofs + count * sizeof(uint32_t)) : nullptr;
+    map = move(m);
+    return true;
+}
+
+bool WarpTable::matches(GDALDataset* ds) const
+{
+    if (ds->GetRasterXSize() != src_width || ds->GetRasterYSize() != src_height)
+        return false;
+
+    double gt[6];
+    if (ds->GetGeoTransform(gt) != CE_None)
+        return false;
+    for (int i = 0; i < 6; ++i)
+        if (gt[i] != src_geotransform[i])
+            return false;
+
+    const OGRSpatialReference* osr = ds->GetSpatialRef();
+    if (!osr) return false;
+    return to_wkt(*osr) == src_wkt;
+}
+
+CPLErr WarpTable::apply(GDALRasterBand* src, float* dst, float nodata) const
+{
+    size_t count = (size_t)grid.width * grid.height;
+    if (win_width == 0)
+    {
+        std::fill(dst, dst + count, nodata);
+        return CE_None;
+    }
+
+    // Read all the source pixels needed at once, then gather them
+    vector<float> win((size_t)win_width * win_height);
+    CPLErr res = src->RasterIO(GF_Read, win_x, win_y, win_width, win_height,
+            win.data(), win_width, win_height, GDT_Float32, 0, 0);
+    if (res != CE_None) return res;
+
+    int has_nodata = FALSE;
+    float src_nodata = src->GetNoDataValue(&has_nodata);
+    double scale = src->GetScale();
+    double offset = src->GetOffset();
+
+    if (!weight_data)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            uint32_t idx = index_data[i];
+            if (idx == none)
+            {
+                dst[i] = nodata;
+                continue;
+            }
+            float v = win[idx];
+            if (has_nodata && v == src_nodata)
+                dst[i] = nodata;
+            else
+                dst[i] = v * scale + offset;
+        }
+        return CE_None;
+    }
+
+    const size_t neighbours[4] = { 0, 1, (size_t)win_width, (size_t)win_width + 1 };
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t idx = index_data[i];
+        if (idx == none)
+        {
+            dst[i] = nodata;
+            continue;
+        }
+        // Interpolate the valid pixels only, renormalising their weights
+        double sum = 0, wsum = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            float v = win[idx + neighbours[k]];
+            if (has_nodata && v == src_nodata) continue;
+            float w = weight_data[i * 4 + k];
+            sum += v * w;
+            wsum += w;
+        }
+        if (wsum > 0)
+            dst[i] = sum / wsum * scale + offset;
+        else
+            dst[i] = nodata;
+    }
+    return CE_None;
+}
+
+
+WarpedDataset::WarpedDataset(GDALDataset& src, std::shared_ptr<const WarpTable> table)
+    : src(src), table(table)
+{
+    nRasterXSize = table->grid.width;
+    nRasterYSize = table->grid.height;
+
+    // Use the geographic coordinate system of the source projection
+    OGRSpatialReference proj;
+    proj.importFromWkt(table->src_wkt.c_str());
+    unique_ptr<OGRSpatialReference> latlon(proj.CloneGeogCS());
+    if (latlon)
+        osr = *latlon;
+    else
+        osr.SetWellKnownGeogCS("WGS84");
+    osr.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+
+    SetDescription(src.GetDescription());
+    SetMetadata(src.GetMetadata(MD_DOMAIN_MSAT), MD_DOMAIN_MSAT);
+
+    for (int i = 1; i <= src.GetRasterCount(); ++i)
+        SetBand(i, new WarpedRasterBand(*this, *src.GetRasterBand(i), i));
+}
+
+const OGRSpatialReference* WarpedDataset::GetSpatialRef() const
+{
+    return &osr;
+}
+
+CPLErr WarpedDataset::GetGeoTransform(double* gt)
+{
+    table->grid.geotransform(gt);
+    return CE_None;
+}
+
+char** WarpedDataset::GetMetadataDomainList()
+{
+    return BuildMetadataDomainList(GDALDataset::GetMetadataDomainList(), TRUE, MD_DOMAIN_MSAT_STATS, NULL);
+}
+
+char** WarpedDataset::GetMetadata(const char* domain)
+{
+    if (domain && EQUAL(domain, MD_DOMAIN_MSAT_STATS))
+        set_stats_metadata(this, Stats(), { &src });
+    return GDALDataset::GetMetadata(domain);
+}
+
+const char* WarpedDataset::GetMetadataItem(const char* name, const char* domain)
+{
+    if (domain && EQUAL(domain, MD_DOMAIN_MSAT_STATS))
+        set_stats_metadata(this, Stats(), { &src });
+    return GDALDataset::GetMetadataItem(name, domain);
+}
+
+WarpedRasterBand::WarpedRasterBand(WarpedDataset& ds, GDALRasterBand& src, int idx)
+    : src(src)
+{
+    poDS = &ds;
+    nBand = idx;
+    eDataType = GDT_Float32;
+    // The table is applied to the whole grid at once
+    nBlockXSize = ds.GetRasterXSize();
+    nBlockYSize = ds.GetRasterYSize();
+
+    SetDescription(src.GetDescription());
+    SetMetadata(src.GetMetadata(MD_DOMAIN_MSAT), MD_DOMAIN_MSAT);
+}
+
+CPLErr WarpedRasterBand::IReadBlock(int xblock, int yblock, void *buf)
+{
+    WarpedDataset* ds = (WarpedDataset*)poDS;
+    return ds->table->apply(&src, (float*)buf, GetNoDataValue());
+}
+
+double WarpedRasterBand::GetNoDataValue(int* pbSuccess)
+{
+    if (pbSuccess) *pbSuccess = TRUE;
+    return 0.0;
+}
+
+const char* WarpedRasterBand::GetUnitType()
+{
+    return src.GetUnitType();
+}
+
+}
+}
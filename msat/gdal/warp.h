@@ -0,0 +1,184 @@
+#ifndef MSAT_GDAL_WARP_H
+#define MSAT_GDAL_WARP_H
+
+/*
+ * Copyright (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <msat/gdal/clean_gdal_priv.h>
+#include <msat/utils/sys.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <gdal/ogr_spatialref.h>
+
+namespace msat {
+namespace dataset {
+
+/// Regular latitude/longitude grid, with pixel centers on multiples of step
+struct LatLonGrid
+{
+    /// Latitude and longitude of the center of the north-west pixel
+    double lat_north = 0;
+    double lon_west = 0;
+    /// Size of a pixel in degrees
+    double step = 0;
+    int width = 0;
+    int height = 0;
+
+    /**
+     * Parse latmin,latmax,lonmin,lonmax,step.
+     *
+     * Returns false and raises a CPLError on failure.
+     */
+    bool parse(const std::string& spec);
+
+    /// Fill in a GDAL geotransform matrix for the grid
+    void geotransform(double* gt) const;
+
+    bool operator==(const LatLonGrid& o) const;
+    bool operator!=(const LatLonGrid& o) const { return !operator==(o); }
+};
+
+/**
+ * Lookup table mapping each pixel of a LatLonGrid to the pixels of a source
+ * raster grid.
+ *
+ * The mapping only depends on the source grid and on the target grid, so it
+ * can be computed once and applied to all the bands of all the images on
+ * the same source grid. Tables can be saved to a file, and loaded back by
+ * mapping the file in memory.
+ */
+class WarpTable
+{
+public:
+    /// Marks target pixels that are outside the source grid
+    static const uint32_t none = 0xffffffff;
+
+    /// Target grid
+    LatLonGrid grid;
+
+    /// If true, interpolate the 4 source pixels around each target pixel
+    bool bilinear = false;
+
+    /// Source grid
+    int src_width = 0;
+    int src_height = 0;
+    double src_geotransform[6];
+    std::string src_wkt;
+
+    /// Bounding box of the source pixels used by the table
+    int win_x = 0;
+    int win_y = 0;
+    int win_width = 0;
+    int win_height = 0;
+
+    WarpTable() = default;
+    WarpTable(const WarpTable&) = delete;
+    WarpTable& operator=(const WarpTable&) = delete;
+
+    /**
+     * Compute the table from the grid of \a ds to \a grid.
+     *
+     * Returns false and raises a CPLError on failure.
+     */
+    bool compute(GDALDataset* ds, const LatLonGrid& grid, bool bilinear=false);
+
+    /**
+     * Save the table to a file.
+     *
+     * Returns false and raises a CPLError on failure.
+     */
+    bool save(const std::string& pathname) const;
+
+    /**
+     * Map a table saved with save() in memory.
+     *
+     * Returns false and raises a CPLError on failure.
+     */
+    bool load(const std::string& pathname);
+
+    /// Check if the table can be applied to the grid of \a ds
+    bool matches(GDALDataset* ds) const;
+
+    /**
+     * Reproject \a src to grid.width * grid.height physical values in \a dst.
+     *
+     * Scale and offset of \a src are applied. Target pixels outside the
+     * source grid, or whose source pixels are all nodata, are set to
+     * \a nodata.
+     */
+    CPLErr apply(GDALRasterBand* src, float* dst, float nodata) const;
+
+    /// Index in the source window of each target pixel, or none
+    const uint32_t* indices() const { return index_data; }
+
+    /**
+     * Weights of the 4 source pixels around each target pixel (top left,
+     * top right, bottom left, bottom right), only for bilinear tables
+     */
+    const float* weights() const { return weight_data; }
+
+protected:
+    /// Storage for computed tables
+    std::vector<uint32_t> own_indices;
+    std::vector<float> own_weights;
+    /// Storage for loaded tables
+    std::unique_ptr<sys::MMap> map;
+
+    const uint32_t* index_data = nullptr;
+    const float* weight_data = nullptr;
+};
+
+/**
+ * Dataset reprojecting all the bands of another dataset to a LatLonGrid,
+ * as Float32 physical values.
+ */
+class WarpedDataset : public GDALDataset
+{
+public:
+    GDALDataset& src;
+    std::shared_ptr<const WarpTable> table;
+    OGRSpatialReference osr;
+
+    WarpedDataset(GDALDataset& src, std::shared_ptr<const WarpTable> table);
+
+    const OGRSpatialReference* GetSpatialRef() const override;
+    CPLErr GetGeoTransform(double*) override;
+
+    // The MSAT_STATS domain has the current counters of src
+    char** GetMetadataDomainList() override;
+    char** GetMetadata(const char* domain="") override;
+    const char* GetMetadataItem(const char* name, const char* domain="") override;
+};
+
+class WarpedRasterBand : public GDALRasterBand
+{
+public:
+    GDALRasterBand& src;
+
+    WarpedRasterBand(WarpedDataset& ds, GDALRasterBand& src, int idx);
+
+    CPLErr IReadBlock(int xblock, int yblock, void *buf) override;
+    double GetNoDataValue(int* pbSuccess=NULL) override;
+    const char* GetUnitType() override;
+};
+
+}
+}
+
+#endif
@@ -30,25 +30,74 @@
 #include <fstream>
 #include <cstring>
 #include <ctime>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <msat/hri/HRI.h>
+#include <msat/utils/sys.h>
 
-Hri::Hri( char *hri_filename, bool IS_TECNAVIA )
+Hri::Hri( ) : nimages(0) { }
+
+Hri::Hri( char *hri_filename, bool IS_TECNAVIA ) : nimages(0)
 {
   readfrom( hri_filename, IS_TECNAVIA );
 }
 
+Hri::~Hri( ) { }
+
 void Hri::readfrom( char *hri_filename, bool IS_TECNAVIA )
 {
-  char id;
-  char interpretation_buffer[interpsize];
+  open(hri_filename, IS_TECNAVIA);
+
+  cout << "Format is : " << label.format_code( ) << std::endl;
+
+  for (int n = 0; n < nimages; n ++)
+  {
+    std::vector<unsigned char> line(image[n].npixels);
+    image[n].allocate( );
+    for (int i = 0; i < image[n].nlines; i ++)
+    {
+      read_line(n, i, line.data( ));
+      image[n].put_line(line.data( ), image[n].npixels, i);
+    }
+  }
+}
 
+void Hri::open( const char *hri_filename, bool IS_TECNAVIA )
+{
   std::ifstream hri(hri_filename, (ios_base::binary | ios_base::in));
   if (hri.fail())
-  {
-    std::cerr << "Cannot open input hri file " << hri_filename << std::endl;
-    throw;
+    throw std::runtime_error(std::string("cannot open input hri file ")
+                             + hri_filename);
+
+  int id = read_header(hri, IS_TECNAVIA);
+  data_offset = hri.tellg( );
+  hri.close( );
+
+  std::string format = label.format_code( );
+  set_layout(format, id);
+  geo.set_format(format);
+
+  try {
+    msat::sys::File in(std::filesystem::path(hri_filename), O_RDONLY);
+    struct stat st;
+    in.fstat(st);
+    data.reset(new msat::sys::MMap(in.mmap(st.st_size, PROT_READ, MAP_SHARED)));
+  } catch (std::exception& e) {
+    throw std::runtime_error(std::string(hri_filename) + ": " + e.what());
   }
 
+  index( );
+}
+
+int Hri::read_header( std::ifstream &hri, bool IS_TECNAVIA )
+{
+  char id;
+  char interpretation_buffer[interpsize];
+
+  tecnavia = IS_TECNAVIA;
+
   if (IS_TECNAVIA)
   {
     int offset = 512;
@@ -90,10 +139,7 @@ void Hri::readfrom( char *hri_filename, bool IS_TECNAVIA )
       memcpy(keybuff, mod_framebuff + 84 + offset + 1360, 92);
       hri.read(mod_framebuff, 1536);
       if (hri.fail())
-      {
-        std::cerr << "Read failed." << std::endl;
-        return;
-      }
+        throw std::runtime_error("cannot read hri key slots");
       memcpy(keybuff, mod_framebuff, 1440-92);
     }
     else
@@ -110,98 +156,101 @@ void Hri::readfrom( char *hri_filename, bool IS_TECNAVIA )
     }
   }
 
-  if (false)
-  {
-    if (label.is_A_format( ) || label.is_B_format( ))
-      hri.seekg(122304, ios::beg);
-    else if (label.is_X_format( ))
-      hri.seekg(131040, ios::beg);
-  }
-
-  std::string format = label.format_code( );
-  calibration_coefficients coeff;
+  if (hri.fail())
+    throw std::runtime_error("hri file truncated in the headers");
 
-  cout << "Format is : " << format << std::endl;
+  return id;
+}
 
-  if (format == "AV")
+void Hri::set_layout( const std::string& format, int id )
+{
+  // Position of the pixels in the frames of a data line, as they were
+  // read by the subframe by subframe decoder
+  chunks.clear( );
+  if (id == HRI_A_FORMAT)
   {
-    image[0].set_format_band(METEOSAT, A_FORMAT, VIS_BAND);
-    nimages = 1;
-    int mlines = image[0].nlines/2;
-    int mpixels = image[0].npixels/2;
-    for (int i = 0; i < mlines; i ++)
+    if (tecnavia)
     {
-      if (IS_TECNAVIA)
-      {
-        image[0].put_halfline(mod_get_dataline(hri, id), mpixels, i*2, true);
-        image[0].put_halfline(mod_get_dataline(hri, id), mpixels, i*2, false);
-        image[0].put_halfline(mod_get_dataline(hri, id), mpixels, i*2+1, true);
-        image[0].put_halfline(mod_get_dataline(hri, id), mpixels, i*2+1, false);
-      }
-      else
-      {
-        image[0].put_halfline(get_dataline(hri, id), mpixels, i*2, true);
-        image[0].put_halfline(get_dataline(hri, id), mpixels, i*2, false);
-        image[0].put_halfline(get_dataline(hri, id), mpixels, i*2+1, true);
-        image[0].put_halfline(get_dataline(hri, id), mpixels, i*2+1, false);
-      }
+      record_size = mod_framesize + 1024;
+      record_frames = 1;
+      chunks.push_back({68+320, 1660});
+      chunks.push_back({mod_framesize, 840});
+    }
+    else
+    {
+      record_size = 8 * framesize;
+      record_frames = 8;
+      chunks.push_back({68, 296});
+      for (int i = 1; i < 7; i ++)
+        chunks.push_back({i * framesize + 4, 360});
+      chunks.push_back({7 * framesize + 4, 44});
     }
-    image[0].set_calibration(&coeff);
   }
-  else if (format == "AVH")
+  else if (id == HRI_BX_FORMAT)
   {
-    image[0].set_format_band(METEOSAT, A_FORMAT, VH_BAND);
-    nimages = 1;
-    if (IS_TECNAVIA)
+    if (tecnavia)
     {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
+      record_size = framesize + 1172;
+      record_frames = 1;
+      chunks.push_back({36+160, 168});
+      chunks.push_back({framesize, 1082});
     }
     else
     {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
+      record_size = 4 * framesize;
+      record_frames = 4;
+      chunks.push_back({36, 328});
+      chunks.push_back({framesize + 4, 360});
+      chunks.push_back({2 * framesize + 4, 360});
+      chunks.push_back({3 * framesize + 4, 202});
     }
-    coeff.mpef_absolute = interp.cal.calwv;
-    coeff.space_count   = interp.cal.wvspc;
-    image[0].set_calibration(&coeff);
   }
-  else if (format == "AW")
+  else
+    throw std::runtime_error("invalid HRI format " + std::to_string(id));
+
+  // Sequence of data lines for each format: full lines have half set to -1,
+  // half lines to 0 for the first half and 1 for the second
+  calibration_coefficients coeff;
+  coeff.mpef_absolute = 0;
+  coeff.space_count = 0;
+
+  HRI_image_satellite sat;
+  if (ident.is_GOES_E( )) sat = GOES_E;
+  else if (ident.is_GOES_W( )) sat = GOES_W;
+  else if (ident.is_GMS( )) sat = GMS;
+  else sat = INDOX;
+
+  group.clear( );
+  group_lines[0] = group_lines[1] = group_lines[2] = 1;
+  if (format == "AV")
   {
-    image[0].set_format_band(METEOSAT, A_FORMAT, WV_BAND);
+    image[0].describe(METEOSAT, A_FORMAT, VIS_BAND);
     nimages = 1;
-    if (IS_TECNAVIA)
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-    }
+    group = { {0, 0, 0}, {0, 0, 1}, {0, 1, 0}, {0, 1, 1} };
+    group_lines[0] = 2;
+    image[0].set_calibration(&coeff);
+  }
+  else if (format == "AVH" || format == "AW" || format == "BW")
+  {
+    if (format == "AVH")
+      image[0].describe(METEOSAT, A_FORMAT, VH_BAND);
+    else if (format == "AW")
+      image[0].describe(METEOSAT, A_FORMAT, WV_BAND);
     else
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-    }
+      image[0].describe(METEOSAT, B_FORMAT, WV_BAND);
+    nimages = 1;
+    group = { {0, 0, -1} };
     coeff.mpef_absolute = interp.cal.calwv;
     coeff.space_count   = interp.cal.wvspc;
     image[0].set_calibration(&coeff);
   }
-  else if (format == "AIW")
+  else if (format == "AIW" || format == "BIW")
   {
-    image[0].set_format_band(METEOSAT, A_FORMAT, IR_BAND);
-    image[1].set_format_band(METEOSAT, A_FORMAT, WV_BAND);
+    HRI_image_format f = format == "AIW" ? A_FORMAT : B_FORMAT;
+    image[0].describe(METEOSAT, f, IR_BAND);
+    image[1].describe(METEOSAT, f, WV_BAND);
     nimages = 2;
-    for (int i = 0; i < image[0].nlines; i ++)
-    {
-      if (IS_TECNAVIA)
-      {
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_line(mod_get_dataline(hri, id), image[1].npixels, i); 
-      }
-      else
-      {
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_line(get_dataline(hri, id), image[1].npixels, i); 
-      }
-    }
+    group = { {0, 0, -1}, {1, 0, -1} };
     coeff.mpef_absolute = interp.cal.calir;
     coeff.space_count   = interp.cal.irspc;
     image[0].set_calibration(&coeff);
@@ -211,175 +260,118 @@ void Hri::readfrom( char *hri_filename, bool IS_TECNAVIA )
   }
   else if (format == "AIVH")
   {
-    image[0].set_format_band(METEOSAT, A_FORMAT, IR_BAND);
-    image[1].set_format_band(METEOSAT, A_FORMAT, VH_BAND);
+    image[0].describe(METEOSAT, A_FORMAT, IR_BAND);
+    image[1].describe(METEOSAT, A_FORMAT, VH_BAND);
     nimages = 2;
-    for (int i = 0; i < image[0].nlines; i ++)
-    {
-      if (IS_TECNAVIA)
-      {
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_line(mod_get_dataline(hri, id), image[1].npixels, i); 
-      }
-      else
-      {
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_line(get_dataline(hri, id), image[1].npixels, i); 
-      }
-    }
+    group = { {0, 0, -1}, {1, 0, -1} };
     coeff.mpef_absolute = interp.cal.calir;
     coeff.space_count   = interp.cal.irspc;
     image[0].set_calibration(&coeff);
   }
-  else if (format == "BW")
-  {
-    image[0].set_format_band(METEOSAT, B_FORMAT, WV_BAND);
-    nimages = 1;
-    if (IS_TECNAVIA)
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-    }
-    else
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-    }
-    coeff.mpef_absolute = interp.cal.calwv;
-    coeff.space_count   = interp.cal.wvspc;
-    image[0].set_calibration(&coeff);
-  }
   else if (format == "BIV" || format == "BIVH")
   {
-    image[0].set_format_band(METEOSAT, B_FORMAT, IR_BAND);
-    image[1].set_format_band(METEOSAT, B_FORMAT, VIS_BAND);
+    image[0].describe(METEOSAT, B_FORMAT, IR_BAND);
+    image[1].describe(METEOSAT, B_FORMAT, VIS_BAND);
     nimages = 2;
-    int mlines = image[1].nlines/2;
-    int mpixels = image[1].npixels/2;
-    for (int i = 0; i < mlines; i ++)
-    {
-      if (IS_TECNAVIA)
-      {
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_halfline(mod_get_dataline(hri, id), mpixels, i*2, true);
-        image[1].put_halfline(mod_get_dataline(hri, id), mpixels, i*2, false);
-        image[1].put_halfline(mod_get_dataline(hri, id), mpixels, i*2+1, true);
-        image[1].put_halfline(mod_get_dataline(hri, id), mpixels, i*2+1, false);
-      }
-      else
-      {
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_halfline(get_dataline(hri, id), mpixels, i*2, true);
-        image[1].put_halfline(get_dataline(hri, id), mpixels, i*2, false);
-        image[1].put_halfline(get_dataline(hri, id), mpixels, i*2+1, true);
-        image[1].put_halfline(get_dataline(hri, id), mpixels, i*2+1, false);
-      }
-    }
+    group = { {0, 0, -1}, {1, 0, 0}, {1, 0, 1}, {1, 1, 0}, {1, 1, 1} };
+    group_lines[1] = 2;
     coeff.mpef_absolute = interp.cal.calir;
     coeff.space_count   = interp.cal.irspc;
     image[0].set_calibration(&coeff);
   }
-  else if (format == "BIW")
-  {
-    image[0].set_format_band(METEOSAT, B_FORMAT, IR_BAND);
-    image[1].set_format_band(METEOSAT, B_FORMAT, WV_BAND);
-    nimages = 2;
-    for (int i = 0; i < image[0].nlines; i ++)
-    {
-      if (IS_TECNAVIA)
-      {
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-      }
-      else
-      {
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-        image[1].put_line(get_dataline(hri, id), image[0].npixels, i); 
-      }
-    }
-    coeff.mpef_absolute = interp.cal.calir;
-    coeff.space_count   = interp.cal.irspc;
-    image[0].set_calibration(&coeff);
-    coeff.mpef_absolute = interp.cal.calwv;
-    coeff.space_count   = interp.cal.wvspc;
-    image[1].set_calibration(&coeff);
-  }
   else if (format == "XI")
   {
-    HRI_image_satellite sat;
-    if (ident.is_GOES_E( )) sat = GOES_E;
-    else if (ident.is_GOES_W( )) sat = GOES_W;
-    else if (ident.is_GMS( )) sat = GMS;
-    else sat = INDOX;
-    image[0].set_format_band(sat, X_FORMAT, IR_BAND);
+    image[0].describe(sat, X_FORMAT, IR_BAND);
     nimages = 1;
-    if (IS_TECNAVIA)
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-    }
-    else
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-    }
+    group = { {0, 0, -1} };
     coeff.mpef_absolute = interp.cal.calir;
     coeff.space_count   = interp.cal.irspc;
     image[0].set_calibration(&coeff);
   }
   else if (format == "XW")
   {
-    HRI_image_satellite sat;
-    if (ident.is_GOES_E( )) sat = GOES_E;
-    else if (ident.is_GOES_W( )) sat = GOES_W;
-    else if (ident.is_GMS( )) sat = GMS;
-    else sat = INDOX;
-    image[0].set_format_band(sat, X_FORMAT, WV_BAND);
+    image[0].describe(sat, X_FORMAT, WV_BAND);
     nimages = 1;
-    if (IS_TECNAVIA)
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-    }
-    else
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-    }
+    group = { {0, 0, -1} };
     image[0].set_calibration(&coeff);
   }
   else if (format == "XVH")
   {
-    HRI_image_satellite sat;
-    if (ident.is_GOES_E( )) sat = GOES_E;
-    else if (ident.is_GOES_W( )) sat = GOES_W;
-    else if (ident.is_GMS( )) sat = GMS;
-    else sat = INDOX;
-    image[0].set_format_band(sat, X_FORMAT, VH_BAND);
+    image[0].describe(sat, X_FORMAT, VH_BAND);
     nimages = 1;
-    if (IS_TECNAVIA)
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(mod_get_dataline(hri, id), image[0].npixels, i); 
-    }
-    else
-    {
-      for (int i = 0; i < image[0].nlines; i ++)
-        image[0].put_line(get_dataline(hri, id), image[0].npixels, i); 
-    }
+    group = { {0, 0, -1} };
     coeff.mpef_absolute = interp.cal.calwv;
     coeff.space_count   = interp.cal.wvspc;
     image[0].set_calibration(&coeff);
   }
   else
+    throw std::runtime_error("invalid format or non disseminated image: "
+                             + format);
+}
+
+void Hri::index( )
+{
+  // Walk the data lines once, checking the sync marker of all their frames,
+  // to find how many complete lines the file has
+  const unsigned char *base = *data;
+  size_t expected = (size_t) (image[0].nlines / group_lines[0]) * group.size( );
+  nrecords = 0;
+  for (size_t pos = data_offset; nrecords < expected &&
+       pos + record_size <= data->size( ); pos += record_size)
   {
-    std::cerr << "Invalid format or non disseminated image : "
-              << format << std::endl;
-    throw;
+    for (size_t f = 0; f < record_frames; f ++)
+    {
+      unsigned short chk_sync[2];
+      memcpy(chk_sync, base + pos + f * framesize, 4);
+      if (chk_sync[0] != 0x0C05 && (chk_sync[1] & 255) != 0xDF)
+        throw std::runtime_error("sync error in input hri file at position "
+                                 + std::to_string(pos + f * framesize));
+    }
+    nrecords ++;
   }
+}
 
-  geo.set_format(format);
-  hri.close();
+bool Hri::read_line( int nimage, int linenum, unsigned char *line )
+{
+  HRI_image &img = image[nimage];
+  memset(line, 0, img.npixels);
+  if (linenum < 0 || linenum >= img.nlines) return false;
+
+  const unsigned char *base = *data;
+  int halfsize = img.npixels / 2;
+  size_t g = linenum / group_lines[nimage];
+  int gline = linenum % group_lines[nimage];
+  bool found = true;
+  for (size_t k = 0; k < group.size( ); k ++)
+  {
+    const record_slot &slot = group[k];
+    if (slot.nimage != nimage || slot.line != gline) continue;
+
+    size_t record = g * group.size( ) + k;
+    if (record >= nrecords)
+    {
+      found = false;
+      continue;
+    }
+
+    // Half lines overlap by two pixels, as in HRI_image::put_halfline
+    unsigned char *dst = line;
+    int size = img.npixels;
+    if (slot.half >= 0)
+      size = halfsize;
+    if (slot.half == 1)
+      dst += halfsize - 2;
+
+    const unsigned char *src = base + data_offset + record * record_size;
+    for (size_t c = 0; c < chunks.size( ) && size > 0; c ++)
+    {
+      int len = std::min(chunks[c].size, size);
+      memcpy(dst, src + chunks[c].offset, len);
+      dst += len;
+      size -= len;
+    }
+  }
+  return found;
 }
 
 char * Hri::get_format( )
@@ -430,84 +422,6 @@ char *Hri::get_area_name( )
   return areanames[2];
 }
 
-unsigned char * Hri::get_dataline( ifstream &hri, int format )
-{
-  static unsigned char linebuff[2500];
-
-  if (format == HRI_A_FORMAT)
-  {
-    getbuff(hri);
-    memcpy(linebuff, framebuff+68, 296);
-    getbuff(hri);
-    memcpy(linebuff+296, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+656, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+1016, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+1376, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+1736, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+2096, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+2456, framebuff+4, 44);
-  }
-  else if (format == HRI_BX_FORMAT)
-  {
-    getbuff(hri);
-    memcpy(linebuff, framebuff+36, 328);
-    getbuff(hri);
-    memcpy(linebuff+328, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+688, framebuff+4, 360);
-    getbuff(hri);
-    memcpy(linebuff+1048, framebuff+4, 202);
-  }
-  else
-  {
-    std::cerr << "Invalid HRI format : " << format << std::endl;
-    throw;
-  }
-  return linebuff;
-}
-
-unsigned char * Hri::mod_get_dataline( ifstream &hri, int format )
-{
-  static unsigned char linebuff[2500];
-
-  if (format == HRI_A_FORMAT)
-  {
-    mod_getbuff(hri, 0);
-    memcpy(linebuff, mod_framebuff+68+320, 1660);
-    hri.read(mod_framebuff, 1024);
-    if (hri.fail())
-    {
-      std::cerr << "Read failed." << std::endl;
-      throw;
-    }
-    memcpy(linebuff+1660, mod_framebuff, 840);
-  }
-  else if (format == HRI_BX_FORMAT)
-  {
-    getbuff(hri);
-    memcpy(linebuff, framebuff+36+160, 168);
-    hri.read(mod_framebuff, 1172);
-    if (hri.fail())
-    {
-      std::cerr << "Read failed." << std::endl;
-      throw;
-    }
-    memcpy(linebuff+168, mod_framebuff, 1082);
-  }
-  else
-  {
-    std::cerr << "Invalid HRI format : " << format << std::endl;
-    throw;
-  }
-  return linebuff;
-}
-
 void Hri::mod_getbuff( ifstream &hri, int offset )
 {
   unsigned short chk_sync[2];
@@ -524,12 +438,8 @@ void Hri::mod_getbuff( ifstream &hri, int offset )
   memcpy(chk_sync, mod_framebuff+offset, 4);
 
   if (chk_sync[0] != 0x0C05 && (chk_sync[1] & 255) != 0xDF)
-  {
-    std::cerr << "Sync error in input hri file." << std::endl;
-    std::cerr << "Position is : " << std::hex
-         << hri.tellg( ) << " - " << mod_framesize << std::endl;
-    throw;
-  }
+    throw std::runtime_error("sync error in input hri file at position "
+                             + std::to_string(hri.tellg( )));
   return;
 }
 
@@ -547,12 +457,8 @@ void Hri::getbuff( ifstream &hri )
   }
   memcpy(chk_sync, framebuff, 4);
   if (chk_sync[0] != 0x0C05 && (chk_sync[1] & 255) != 0xDF)
-  {
-    std::cerr << "Sync error in input hri file." << std::endl;
-    std::cerr << "Position is : " << std::hex
-         << hri.tellg( ) << " - " << framesize << std::endl;
-    throw;
-  }
+    throw std::runtime_error("sync error in input hri file at position "
+                             + std::to_string(hri.tellg( )));
   return;
 }
 
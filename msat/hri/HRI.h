@@ -31,6 +31,8 @@
 #define __HRI_H__
 
 #include <ctime>
+#include <memory>
+#include <vector>
 #include <msat/hri/HRI_subframe_label.h>
 #include <msat/hri/HRI_subframe_identification.h>
 #include <msat/hri/HRI_subframe_interpretation.h>
@@ -38,13 +40,30 @@
 #include <msat/hri/HRI_geolocation.h>
 #include <msat/hri/HRI_image.h>
 
+namespace msat {
+namespace sys {
+class MMap;
+}
+}
+
 class Hri {
   public:
-    Hri( ) { }
+    Hri( );
     Hri( char *hri_filename, bool IS_TECNAVIA );
-    ~Hri( ) { }
+    ~Hri( );
+    // Read and decode all the images in the file
     void readfrom( char *hrifile, bool IS_TECNAVIA );
 
+    // Read the headers and index the position of the data lines in the
+    // file, without decoding them. The images are described but not
+    // allocated: use read_line to decode their lines.
+    void open( const char *hrifile, bool IS_TECNAVIA );
+
+    // Decode line linenum of image[nimage] into line, which must hold
+    // image[nimage].npixels values. Returns false if the line is missing
+    // from the file, leaving the missing pixels to 0.
+    bool read_line( int nimage, int linenum, unsigned char *line );
+
     // Interface
     char * get_format( );
     struct tm *get_datetime( );
@@ -85,10 +104,23 @@ class Hri {
     HRI_image image[3];
     unsigned char seed[8];
   private:
+    // Position in a group of data lines of the line, or half line, of one
+    // of the images
+    struct record_slot {
+      int nimage;
+      int line;
+      int half;
+    };
+    // Position and size of a chunk of pixels in a data line
+    struct record_chunk {
+      int offset;
+      int size;
+    };
+    int read_header( std::ifstream &hri, bool IS_TECNAVIA );
+    void set_layout( const std::string& format, int id );
+    void index( );
     void getbuff( ifstream &hri );
     void mod_getbuff( ifstream &hri, int offset );
-    unsigned char *get_dataline( ifstream &hri, int format );
-    unsigned char *mod_get_dataline( ifstream &hri, int format );
     static const int framesize     = 364;
     static const int mod_framesize = 2048;
     static const int interpsize    = 1360;
@@ -101,6 +133,22 @@ class Hri {
     HRI_subframe_interpretation interp;
     HRI_subframe_keyslot keys;
     HRI_geolocation geo;
+    // The whole file mapped in memory
+    std::unique_ptr<msat::sys::MMap> data;
+    bool tecnavia;
+    // Offset of the first data line in the file
+    size_t data_offset;
+    // Size of a data line in the file, and the chunks with its pixels
+    size_t record_size;
+    std::vector<record_chunk> chunks;
+    // Number of frames in a data line, each starting with a sync marker
+    size_t record_frames;
+    // Sequence of data lines repeated through the file, and number of
+    // lines of each image in one sequence
+    std::vector<record_slot> group;
+    int group_lines[3];
+    // Number of complete data lines found in the file
+    size_t nrecords;
 };
 
 #endif
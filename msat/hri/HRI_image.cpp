@@ -49,6 +49,8 @@ HRI_image::HRI_image( HRI_image_satellite s,
                       HRI_image_format f,
 		      HRI_image_band b )
 {
+  data = 0;
+  aline = 0;
   set_format_band(s, f, b);
 }
 
@@ -61,9 +63,18 @@ HRI_image::~HRI_image( )
 void HRI_image::set_format_band( HRI_image_satellite s,
                                  HRI_image_format f,
 				 HRI_image_band b )
+{
+  describe(s, f, b);
+  allocate( );
+}
+
+void HRI_image::describe( HRI_image_satellite s,
+                          HRI_image_format f,
+                          HRI_image_band b )
 {
   sat = s;
   band = b;
+  calibrated = false;
   switch (f)
   {
     case A_FORMAT:
@@ -230,6 +241,13 @@ void HRI_image::set_format_band( HRI_image_satellite s,
       std::cerr << "Undefined format in HRI_image" << std::endl;
       throw;
   }
+  return;
+}
+
+void HRI_image::allocate( )
+{
+  if (data)  delete [ ] data;
+  if (aline) delete [ ] aline;
   data  = new unsigned char[size];
   aline = new unsigned char[npixels];
   assert(data);
@@ -67,6 +67,11 @@ class HRI_image {
     void set_format_band( HRI_image_satellite s,
 	                  HRI_image_format f,
 			  HRI_image_band b );
+    // Set name, size and calibration band without allocating the image
+    void describe( HRI_image_satellite s,
+                   HRI_image_format f,
+                   HRI_image_band b );
+    void allocate( );
     void set_calibration( calibration_coefficients *c );
     void put_line( unsigned char *dataline, int linesize, int linenum );
     void put_halfline( unsigned char *dataline, int linesize,
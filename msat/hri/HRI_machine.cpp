@@ -141,9 +141,9 @@ float HRI_machine::r4f_from_char5( const char *buff )
   return tmp;
 }
 
-static inline void leftshift(unsigned long *pnt, int n)
+static inline void leftshift(uint32_t *pnt, int n)
 {
-   register unsigned long hiw, low;
+   uint32_t hiw, low;
 
    hiw = pnt[0];
    low = pnt[1];
@@ -159,9 +159,9 @@ static inline void leftshift(unsigned long *pnt, int n)
    return;
 }
 
-static inline void rightshift(unsigned long *pnt, int n)
+static inline void rightshift(uint32_t *pnt, int n)
 {
-   register unsigned long hiw, low;
+   uint32_t hiw, low;
 
    hiw = pnt[0];
    low = pnt[1];
@@ -183,19 +183,19 @@ float HRI_machine::r4_from_buff( const unsigned char *buff )
         uint32_t i;
         float f;
     } uval;
-    unsigned long *pnt, sign, fraction;
+    uint32_t *pnt, sign, fraction;
     long exponent;
     unsigned char swp[4];
 
    if (isbig)
-     pnt = (unsigned long *) buff;
+     pnt = (uint32_t *) buff;
    else
    {
      swp[3] = buff[0];
      swp[2] = buff[1];
      swp[1] = buff[2];
      swp[0] = buff[3];
-     pnt = (unsigned long *) swp;
+     pnt = (uint32_t *) swp;
    }
 
    if ((pnt[0] & 0x7FFFFFFF) == 0)
@@ -234,7 +234,7 @@ float HRI_machine::r4_from_buff( const unsigned char *buff )
 double HRI_machine::r8_from_buff( const unsigned char *buff )
 {
     int idxh, idxl;
-    unsigned long tmp, sign, fraction[2], *pnt;
+    uint32_t tmp, sign, fraction[2], *pnt;
     union {
         uint32_t i[2];
         double d;
@@ -243,7 +243,7 @@ double HRI_machine::r8_from_buff( const unsigned char *buff )
     unsigned char swp[8];
 
    if (isbig)
-     pnt = (unsigned long *) buff;
+     pnt = (uint32_t *) buff;
    else
    {
      swp[3] = buff[0];
@@ -254,7 +254,7 @@ double HRI_machine::r8_from_buff( const unsigned char *buff )
      swp[6] = buff[5];
      swp[5] = buff[6];
      swp[4] = buff[7];
-     pnt = (unsigned long *) swp;
+     pnt = (uint32_t *) swp;
    }
 
    if (isbig) { idxl = 0; idxh = 1; }
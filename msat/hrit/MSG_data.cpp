@@ -29,6 +29,7 @@
 
 #include <string>
 #include <fstream>
+#include <stdexcept>
 #include <msat/hrit/MSG_data.h>
 
 std::ostream& operator<< ( std::ostream& os, MSG_data_level_15_header &h )
@@ -104,9 +105,31 @@ void MSG_data::read_from( std::ifstream &in, MSG_header &header )
 
       if (header.image_structure->compression_flag == MSG_NO_COMPRESSION)
       {
-        image->len = dsize;
-        image->data = (MSG_SAMPLE *) ( new char[dsize] );
-        memcpy(image->data, dbuff, dsize);
+        // Uncompressed samples are packed most significant bit first,
+        // number_of_bits_per_pixel bits each
+        size_t npix = header.image_structure->image_pixels;
+        unsigned bpp = header.image_structure->number_of_bits_per_pixel;
+        if (bpp == 0 || bpp > 16 || dsize < header.image_structure->image_size)
+        {
+          delete [ ] dbuff;
+          throw std::runtime_error("uncompressed image data field is too short or has an invalid number of bits per pixel");
+        }
+        image->len = npix;
+        image->data = new MSG_SAMPLE[npix];
+        uint_4 acc = 0;
+        unsigned bits = 0;
+        unsigned char_1 *src = dbuff;
+        MSG_SAMPLE mask = (1 << bpp) - 1;
+        for (size_t i = 0; i < npix; ++i)
+        {
+          while (bits < bpp)
+          {
+            acc = (acc << 8) | *src++;
+            bits += 8;
+          }
+          bits -= bpp;
+          image->data[i] = (acc >> bits) & mask;
+        }
       }
       else
       {
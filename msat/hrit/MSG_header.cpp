@@ -28,6 +28,9 @@
 //-----------------------------------------------------------------------------
 
 #include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
 
 #include <msat/hrit/MSG_header.h>
 
@@ -60,74 +63,91 @@ MSG_header::MSG_header( std::ifstream &in )
 
 MSG_header::~MSG_header( )
 {
-  if (image_structure) delete image_structure;
-  if (image_navigation) delete image_navigation;
-  if (image_data_function) delete image_data_function;
-  if (annotation) delete annotation;
-  if (timestamp) delete timestamp;
-  if (ancillary_text) delete ancillary_text;
-  if (key) delete key;
-  if (segment_id) delete segment_id;
-  if (segment_quality) delete segment_quality;
 }
 
 void MSG_header::read_from( std::ifstream &in )
 {
   unsigned char_1 primary_header[MSG_HEADER_PRIMARY_LEN];
-  unsigned char_1 *hbuff;
 
-  check_endianess( );
   in.read((char_1 *) primary_header, MSG_HEADER_PRIMARY_LEN);
   if (in.fail( ))
   {
-    std::cerr << "Read error from HRIT file: Primary Header." << std::endl;
-    throw;
+    throw std::runtime_error("Read error from HRIT file: Primary Header");
   }
-  if (primary_header[0] != MSG_HEADER_PRIMARY)
+  size_t hsize = header_length(primary_header, MSG_HEADER_PRIMARY_LEN);
+
+  // Segment headers fit on the stack, larger ones go on the heap
+  unsigned char_1 stack_buff[8192];
+  std::vector<unsigned char_1> heap_buff;
+  unsigned char_1 *hbuff = stack_buff;
+  if (hsize > sizeof(stack_buff))
   {
-    std::cerr << "Error: First header type value is not primary." << std::endl;
-    throw;
+    heap_buff.resize(hsize);
+    hbuff = heap_buff.data();
   }
-  if (get_ui2(primary_header+1) != MSG_HEADER_PRIMARY_LEN)
+  memcpy(hbuff, primary_header, MSG_HEADER_PRIMARY_LEN);
+  in.read((char_1 *) hbuff+MSG_HEADER_PRIMARY_LEN, hsize-MSG_HEADER_PRIMARY_LEN);
+  if (in.fail( ))
   {
-    std::cerr << "Error: Primary Header Length mismatch." << std::endl;
-    std::cerr << "Header Length: " << get_ui2(primary_header+1) << std::endl;
-    throw;
+    throw std::runtime_error("Read error from HRIT file: Header body");
   }
-  f_typecode = (t_enum_MSG_filetype) *(primary_header+3);
-  total_header_length = get_ui4(primary_header+4);
-  data_field_length   = get_ui8(primary_header+8);
-  filesize = data_field_length/8+total_header_length;
-  size_t hsize = total_header_length-MSG_HEADER_PRIMARY_LEN;
-  hbuff = new unsigned char_1[hsize];
-  if (!hbuff)
+  read_from(hbuff, hsize);
+}
+
+uint_4 MSG_header::header_length( unsigned const char_1 *buff, size_t len )
+{
+  if (len < MSG_HEADER_PRIMARY_LEN)
+    throw std::runtime_error("xRIT primary header is truncated");
+  if (buff[0] != MSG_HEADER_PRIMARY)
   {
-    std::cerr << "Memory allocation error in MSG_header." << std::endl
-              << "Requested allocation of " << hsize << " bytes." << std::endl;
-    throw;
+    throw std::runtime_error("First header type value is not primary");
   }
-  in.read((char_1 *) hbuff, hsize);
-  if (in.fail( ))
+  if (get_ui2(buff+1) != MSG_HEADER_PRIMARY_LEN)
   {
-    std::cerr << "Read error from HRIT file: Header body" << std::endl;
-    throw;
+    throw std::runtime_error("Primary Header Length mismatch, header length: " + std::to_string(get_ui2(buff+1)));
   }
-  unsigned char_1 *pnt = hbuff;
-  size_t left = hsize;
+  uint_4 res = get_ui4(buff+4);
+  if (res < MSG_HEADER_PRIMARY_LEN)
+    throw std::runtime_error("xRIT total header length is shorter than the primary header");
+  return res;
+}
+
+void MSG_header::read_from( unsigned const char_1 *buff, size_t len )
+{
+  total_header_length = header_length(buff, len);
+  if (len < total_header_length)
+    throw std::runtime_error("xRIT header is truncated");
+  f_typecode = (t_enum_MSG_filetype) *(buff+3);
+  data_field_length   = get_ui8(buff+8);
+  filesize = data_field_length/8+total_header_length;
+
+  // Forget the sub-headers of the previous header read, if any
+  image_structure = 0;
+  image_navigation = 0;
+  image_data_function = 0;
+  annotation = 0;
+  timestamp = 0;
+  ancillary_text = 0;
+  key = 0;
+  segment_id = 0;
+  segment_quality = 0;
+
+  unsigned const char_1 *pnt = buff + MSG_HEADER_PRIMARY_LEN;
+  size_t left = total_header_length - MSG_HEADER_PRIMARY_LEN;
   size_t hunk_size = 0;
   size_t hqlen = 0;
   while (left)
   {
+    if (left < 3 || get_ui2(pnt+1) < 3 || get_ui2(pnt+1) > left)
+      throw std::runtime_error("xRIT secondary header is truncated");
     switch(*pnt)
     {
       case MSG_HEADER_IMAGE_STRUCTURE:
         if (get_ui2(pnt+1) != MSG_IMAGE_STRUCTURE_LEN)
         {
-          std::cerr << "Error: Image Structure Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error("Image Structure Header mismatch, header length: " + std::to_string(get_ui2(pnt+1)));
         }
-        image_structure = new MSG_header_image_struct;
+        image_structure = &image_structure_storage;
         image_structure->read_from(pnt);
         pnt = pnt + MSG_IMAGE_STRUCTURE_LEN;
         left = left - MSG_IMAGE_STRUCTURE_LEN;
@@ -135,18 +155,16 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_IMAGE_NAVIGATION:
         if (get_ui2(pnt+1) != MSG_IMAGE_NAVIGATION_LEN)
         {
-          std::cerr << "Error: Image Navigation Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error("Image Navigation Header mismatch, header length: " + std::to_string(get_ui2(pnt+1)));
         }
-        image_navigation = new MSG_header_image_navig;
+        image_navigation = &image_navigation_storage;
         image_navigation->read_from(pnt);
         pnt = pnt + MSG_IMAGE_NAVIGATION_LEN;
         left = left - MSG_IMAGE_NAVIGATION_LEN;
         break;
       case MSG_HEADER_IMAGE_DATA_FUNCTION:
         hunk_size = (size_t) get_ui2(pnt+1);
-        image_data_function = new MSG_header_image_datafunc;
+        image_data_function = &image_data_function_storage;
         image_data_function->read_from(pnt);
         pnt = pnt + hunk_size;
         left = left - hunk_size;
@@ -154,11 +172,9 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_ANNOTATION:
         if (get_ui2(pnt+1) != MSG_ANNOTATION_LEN)
         {
-          std::cerr << "Error: Annotation Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error("Annotation Header mismatch, header length: " + std::to_string(get_ui2(pnt+1)));
         }
-        annotation = new MSG_header_annotation;
+        annotation = &annotation_storage;
         annotation->read_from(pnt);
         pnt = pnt + MSG_ANNOTATION_LEN;
         left = left - MSG_ANNOTATION_LEN;
@@ -166,18 +182,16 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_TIMESTAMP:
         if (get_ui2(pnt+1) != MSG_TIMESTAMP_LEN)
         {
-          std::cerr << "Error: Timestamp Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error("Timestamp Header mismatch, header length: " + std::to_string(get_ui2(pnt+1)));
         }
-        timestamp = new MSG_header_timestamp;
+        timestamp = &timestamp_storage;
         timestamp->read_from(pnt);
         pnt = pnt + MSG_TIMESTAMP_LEN;
         left = left - MSG_TIMESTAMP_LEN;
         break;
       case MSG_HEADER_ANCILLARY_TEXT:
         hunk_size = (size_t) get_ui2(pnt+1);
-        ancillary_text = new MSG_header_ancillary_text;
+        ancillary_text = &ancillary_text_storage;
         ancillary_text->read_from(pnt);
         pnt = pnt + hunk_size;
         left = left - hunk_size;
@@ -185,11 +199,9 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_KEY:
         if (get_ui2(pnt+1) != MSG_KEY_LEN)
         {
-          std::cerr << "Error: Key Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error("Key Header mismatch, header length: " + std::to_string(get_ui2(pnt+1)));
         }
-        key = new MSG_header_key;
+        key = &key_storage;
         key->read_from(pnt);
         pnt = pnt + MSG_KEY_LEN;
         left = left - MSG_KEY_LEN;
@@ -197,30 +209,28 @@ void MSG_header::read_from( std::ifstream &in )
       case MSG_HEADER_SEGMENT_IDENTIFICATION:
         if (get_ui2(pnt+1) != MSG_SEGMENT_ID_LEN)
         {
-          std::cerr << "Error: Segment Id Header mismatch." << std::endl;
-          std::cerr << "Header Length: " << get_ui2(pnt+1) << std::endl;
-          throw;
+          throw std::runtime_error("Segment Id Header mismatch, header length: " + std::to_string(get_ui2(pnt+1)));
         }
-        segment_id = new MSG_header_segment_id;
+        segment_id = &segment_id_storage;
         segment_id->read_from(pnt);
         pnt = pnt + MSG_SEGMENT_ID_LEN;
         left = left - MSG_SEGMENT_ID_LEN;
         break;
       case MSG_HEADER_IMAGE_SEGMENT_LINE_QUALITY:
-        segment_quality = new MSG_header_segment_quality;
-        segment_quality->read_from(pnt, image_structure->number_of_lines);
         hqlen = get_ui2(pnt+1);
+        if (!image_structure ||
+            3 + (size_t) image_structure->number_of_lines * MSG_SEGMENT_QUALITY_RECORD_LEN > hqlen)
+          throw std::runtime_error("xRIT line quality header does not match the image structure");
+        segment_quality = &segment_quality_storage;
+        segment_quality->read_from(pnt, image_structure->number_of_lines);
         pnt = pnt + hqlen;
         left = left - hqlen;
         break;
       default:
-        std::cerr << "Unknown header type: " << (uint_2) *pnt << std::endl;
-        std::cerr << "Unparsed " << left << " bytes." << std::endl;
-        throw;
+        throw std::runtime_error("Unknown header type " + std::to_string((uint_2) *pnt) + ", with " + std::to_string(left) + " bytes unparsed");
         break;
       }
    }
-   delete [ ] hbuff;
    return;
 }
 
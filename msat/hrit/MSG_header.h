@@ -76,8 +76,20 @@ class MSG_header {
     MSG_header( std::ifstream &in );
     ~MSG_header( );
 
+    // The sub-header pointers point inside the object itself
+    MSG_header( const MSG_header& ) = delete;
+    MSG_header& operator=( const MSG_header& ) = delete;
+
     void read_from( std::ifstream &in );
 
+    // Read a header from a buffer holding at least its first len bytes, as
+    // read with pread or mapped with mmap. A header object can be reused to
+    // read many headers without allocating memory again.
+    void read_from( unsigned const char_1 *buff, size_t len );
+
+    // Total header length from the primary header at the start of buff
+    static uint_4 header_length( unsigned const char_1 *buff, size_t len );
+
     // Overloaded << operator
     friend std::ostream& operator<< ( std::ostream& os, MSG_header &h );
 
@@ -94,6 +106,18 @@ class MSG_header {
     MSG_header_key *key;
     MSG_header_segment_id *segment_id;
     MSG_header_segment_quality *segment_quality;
+
+  private:
+    // Storage of the sub-headers, which are set to point here when present
+    MSG_header_image_struct image_structure_storage;
+    MSG_header_image_navig image_navigation_storage;
+    MSG_header_image_datafunc image_data_function_storage;
+    MSG_header_annotation annotation_storage;
+    MSG_header_timestamp timestamp_storage;
+    MSG_header_ancillary_text ancillary_text_storage;
+    MSG_header_key key_storage;
+    MSG_header_segment_id segment_id_storage;
+    MSG_header_segment_quality segment_quality_storage;
 };
 
 #endif
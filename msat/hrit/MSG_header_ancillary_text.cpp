@@ -58,6 +58,8 @@ void MSG_header_ancillary_text::read_from( unsigned const char_1 *buff )
     std::cerr << "Header Length : " << h_length << std::endl;
     throw;
   }
+  if (ancillary_text)
+    delete [ ] ancillary_text;
   ancillary_text = new char_1[h_length];
   if (!ancillary_text)
   {
@@ -47,15 +47,16 @@ void MSG_header_annotation::read_from( unsigned const char_1 *buff )
   char_1 tmp[62];
   memcpy(tmp, buff+3, 61);
   tmp[61] = 0;
-  annotation = tmp;
-  xrit_channel_id = annotation.substr(0,1);
-  annotation_version = annotation.substr(2,3);
-  disseminating_s_c = annotation.substr(6,6);
-  product_id_1 = annotation.substr(13,12);
-  product_id_2 = annotation.substr(26,9);
-  product_id_3 = annotation.substr(36,9);
-  product_id_4 = annotation.substr(46,12);
-  flags = annotation.substr(59,2);
+  // assign() reuses the memory of the strings when reading many headers
+  annotation.assign(tmp);
+  xrit_channel_id.assign(annotation, 0, 1);
+  annotation_version.assign(annotation, 2, 3);
+  disseminating_s_c.assign(annotation, 6, 6);
+  product_id_1.assign(annotation, 13, 12);
+  product_id_2.assign(annotation, 26, 9);
+  product_id_3.assign(annotation, 36, 9);
+  product_id_4.assign(annotation, 46, 12);
+  flags.assign(annotation, 59, 2);
   return;
 }
 
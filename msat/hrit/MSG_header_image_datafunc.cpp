@@ -51,17 +51,8 @@ void MSG_header_image_datafunc::read_from( unsigned const char_1 *buff )
     std::cerr << "Header Length : " << h_length - 1 << std::endl;
     throw;
   }
-  char_1 *tmpchar = new char_1[h_length];
-  if (!tmpchar)
-  {
-    std::cerr << "Memory error in MSG_header_image_datafunc." << std::endl;
-    std::cerr << "Header Length : " << h_length - 1 << std::endl;
-    throw;
-  }
-  memcpy(tmpchar, buff+3, h_length-1);
-  tmpchar[h_length-1] = 0;
-  data_definition_block = tmpchar;
-  delete [ ] tmpchar;
+  data_definition_block.assign((const char_1 *) buff+3,
+                               strnlen((const char_1 *) buff+3, h_length-1));
   return;
 }
 
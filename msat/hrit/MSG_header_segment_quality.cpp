@@ -35,6 +35,7 @@ MSG_header_segment_quality::MSG_header_segment_quality( )
 {
   nlines  = 0;
   lq      = 0;
+  lq_size = 0;
 }
 
 MSG_header_segment_quality::MSG_header_segment_quality(
@@ -42,6 +43,7 @@ MSG_header_segment_quality::MSG_header_segment_quality(
       uint_2 nlines )
 {
   lq            = 0;
+  lq_size       = 0;
   this->nlines  = 0;
   this->read_from(buff, nlines);
 }
@@ -50,6 +52,7 @@ MSG_header_segment_quality::~MSG_header_segment_quality( )
 {
   if (lq) delete [ ] lq;
   lq = 0;
+  lq_size = 0;
   nlines = 0;
 }
 
@@ -57,7 +60,12 @@ void MSG_header_segment_quality::read_from( unsigned const char_1 *buff ,
                                             uint_2 nlines)
 {
   this->nlines  = (int) nlines;
-  lq            = new MSG_segment_quality[this->nlines];
+  if (this->nlines > lq_size)
+  {
+    if (lq) delete [ ] lq;
+    lq          = new MSG_segment_quality[this->nlines];
+    lq_size     = this->nlines;
+  }
   unsigned char_1 *pnt = (unsigned char_1 *) buff+3;
   for (int i = 0; i < this->nlines; i ++)
   {
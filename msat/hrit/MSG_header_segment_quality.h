@@ -73,6 +73,10 @@ class MSG_header_segment_quality {
 
     MSG_segment_quality *lq;
 
+  private:
+    // Number of elements allocated in lq, kept across reads
+    int_4  lq_size;
+
 };
 
 #endif
@@ -30,9 +30,7 @@
 #include <cstring>
 #include <msat/hrit/MSG_machine.h>
 
-static bool isbig = false;
-
-void check_endianess()
+static bool compute_isbig()
 {
   union {
     unsigned char_1 byte[4];
@@ -40,12 +38,12 @@ void check_endianess()
   } word;
   word.val = 0;
   word.byte[3] = 0x1;
-  if (word.val != 1)
-    isbig = false;
-  else
-    isbig = true;
+  return word.val == 1;
 }
 
+// Computed once at startup, as headers can be read by many threads at once
+static const bool isbig = compute_isbig();
+
 bool is_big( )
 {
   return isbig;
@@ -49,8 +49,6 @@
 #define real_4 float
 #define real_8 double
 
-void check_endianess();
-
 int_1 get_i1(const unsigned char_1 *buff);
 int_2 get_i2(const unsigned char_1 *buff);
 int_4 get_i4(const unsigned char_1 *buff);
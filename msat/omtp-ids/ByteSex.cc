@@ -46,6 +46,13 @@ uint16_t
 ByteSex::big::read2(std::istream& is,
 		    const int bytes)
 {
+	if (bytes == 2) {
+		// one stream call instead of one per byte
+		unsigned char buf[2] = { 0, 0 };
+		is.read(reinterpret_cast<char*>(buf), 2);
+		return get2(buf);
+	}
+
 	uint16_t u16 = 0;
 
 	switch (bytes) {
@@ -65,6 +72,13 @@ uint32_t
 ByteSex::big::read4(std::istream& is,
 		    const int bytes)
 {
+	if (bytes == 4) {
+		// one stream call instead of one per byte
+		unsigned char buf[4] = { 0, 0, 0, 0 };
+		is.read(reinterpret_cast<char*>(buf), 4);
+		return get4(buf);
+	}
+
 	uint32_t u32 = 0;
 
 	switch (bytes) {
@@ -85,6 +99,14 @@ uint64_t
 ByteSex::big::read8(std::istream& is,
 		    const int bytes)
 {
+	if (bytes == 8) {
+		// one stream call instead of one per byte
+		unsigned char buf[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+		is.read(reinterpret_cast<char*>(buf), 8);
+		return (static_cast<uint64_t>(get4(buf)) << 0x20)
+			| get4(buf + 4);
+	}
+
 	uint64_t u64 = 0;
 
 	switch (bytes) {
@@ -60,6 +60,10 @@ namespace ByteSex
 {
 	struct big
 	{
+		// decode from memory
+		static uint16_t get2(const unsigned char* buf);
+		static uint32_t get4(const unsigned char* buf);
+
 		static uint16_t read2(std::istream& is, int bytes = 2);
 		static uint32_t read4(std::istream& is, int bytes = 4);
 #ifdef DSM_64BIT
@@ -104,4 +108,22 @@ namespace ByteSex
 // EXTERNAL REFERENCES
 //
 
+inline
+uint16_t
+ByteSex::big::get2(const unsigned char* buf)
+{
+	return (static_cast<uint16_t>(buf[0]) << 0x08)
+		| buf[1];
+}
+
+inline
+uint32_t
+ByteSex::big::get4(const unsigned char* buf)
+{
+	return (static_cast<uint32_t>(buf[0]) << 0x18)
+		| (static_cast<uint32_t>(buf[1]) << 0x10)
+		| (static_cast<uint32_t>(buf[2]) << 0x08)
+		| buf[3];
+}
+
 #endif // DSM_BYTESEX_HH
@@ -176,10 +176,9 @@ operator>>(std::istream& is,
 
 	if (offset < 0) {
 		is.setstate(std::ios::failbit);
-	}
-	// no seekg() available on gzstream
-	for (int i = 0; i < offset; i++) {
-		is.get();
+	} else if (offset > 0) {
+		// skip without seeking, so that it works on compressed streams
+		is.ignore(offset);
 	}
 
 	return is;
@@ -82,15 +82,20 @@ operator>>(std::istream& is,
 {
 	lineheader = LineHeader();
 
-	lineheader.m_length               = ByteSex::big::read2(is);
-	lineheader.m_line                 = ByteSex::big::read2(is);
-	lineheader.m_start                = ByteSex::big::read2(is);
-	lineheader.m_no_pixels            = ByteSex::big::read2(is);
-	lineheader.m_channel_id           = ByteSex::big::read2(is);
-	lineheader.m_quality              = ByteSex::big::read2(is);
+	// read the whole header at once, then decode it
+	unsigned char buf[LINEHEADER_LEN];
+	memset(buf, 0, LINEHEADER_LEN);
+	is.read(reinterpret_cast<char*>(buf), LINEHEADER_LEN);
+
+	lineheader.m_length               = ByteSex::big::get2(buf     );
+	lineheader.m_line                 = ByteSex::big::get2(buf +  2);
+	lineheader.m_start                = ByteSex::big::get2(buf +  4);
+	lineheader.m_no_pixels            = ByteSex::big::get2(buf +  6);
+	lineheader.m_channel_id           = ByteSex::big::get2(buf +  8);
+	lineheader.m_quality              = ByteSex::big::get2(buf + 10);
 
 	for (int i = 0; i < PAD; i++) {
-		lineheader.m_pad[i] = ByteSex::big::read2(is);
+		lineheader.m_pad[i] = ByteSex::big::get2(buf + 12 + 2 * i);
 	}
 
 	return is;
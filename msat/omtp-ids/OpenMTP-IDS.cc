@@ -23,6 +23,7 @@
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <stdexcept>
 #include <algorithm>
 
 // PROJECT INCLUDES
@@ -30,6 +31,7 @@
 #include "ByteSex.hh"
 #include "FileHeader.hh"
 #include "Record.hh"
+#include "StreamBuf.hh"
 
 // LOCAL INCLUDES
 //
@@ -74,7 +76,7 @@ operator>>(std::istream& is,
 
 	is >> openmtp_ids.m_fileheader;
 	if (!is.good()) {
-		throw "failure while reading file header\n";
+		throw std::runtime_error("failure while reading file header");
 	}
 
 	// the first record was just read..
@@ -85,7 +87,7 @@ operator>>(std::istream& is,
 	for (unsigned i = 0; i < no_records; i++) {
 		is >> openmtp_ids.m_record[i];
 		if (!is.good()) {
-			throw "failure while reading record\n";
+			throw std::runtime_error("failure while reading record");
 		}
 	}
 
@@ -97,26 +99,40 @@ operator>>(std::istream& is,
 bool
 OpenMTP_IDS::read(const char* filename)
 {
-	std::ifstream is(filename);
-	if (!is) {
-		std::string err;
-		err += "could not open ";
-		err += filename;
-		err += " for reading";
-		throw err.c_str();
+	// Plain files are mapped in memory, gzipped files are decompressed
+	// as they are read: either way the parser reads from memory
+	MappedStreamBuf mapped;
+#ifdef HAVE_ZLIB
+	GzipStreamBuf gzipped;
+#endif // def HAVE_ZLIB
+	std::streambuf* buf = 0;
+
+	if (is_gzipped(filename)) {
+#ifdef HAVE_ZLIB
+		if (gzipped.open(filename)) {
+			buf = &gzipped;
+		}
+#else // def HAVE_ZLIB
+		throw std::runtime_error(std::string(filename)
+			+ ": reading gzipped files is not supported");
+#endif // def HAVE_ZLIB
+	} else if (mapped.open(filename)) {
+		buf = &mapped;
 	}
 
+	if (!buf) {
+		throw std::runtime_error(std::string("could not open ")
+			+ filename + " for reading");
+	}
+
+	std::istream is(buf);
 	is >> *this;
 
 	if (!is.good()) {
-		std::string err;
-		err += "error while reading ";
-		err += filename;
-		throw err.c_str();
+		throw std::runtime_error(std::string("error while reading ")
+			+ filename);
 	}
 
-	is.close();
-
 	return true;
 }
 
@@ -129,7 +145,7 @@ OpenMTP_IDS::write(const char* filename)
 		err += "could not open ";
 		err += filename;
 		err += " for writing";
-		throw err.c_str();
+		throw std::runtime_error(err);
 	}
 
 	os << *this;
@@ -138,7 +154,7 @@ OpenMTP_IDS::write(const char* filename)
 		std::string err;
 		err += "error while writing ";
 		err += filename;
-		throw err.c_str();
+		throw std::runtime_error(err);
 	}
 
 	os.close();
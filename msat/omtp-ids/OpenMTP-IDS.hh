@@ -33,6 +33,8 @@
 // SYSTEM INCLUDES
 //
 #include <iosfwd>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 // PROJECT INCLUDES
@@ -122,7 +124,7 @@ inline
 OpenMTP_IDS::OpenMTP_IDS(const char* filename)
 {
 	if (!read(filename)) {
-		throw "read failure";
+		throw std::runtime_error(std::string(filename) + ": read failure");
 	}
 }
 
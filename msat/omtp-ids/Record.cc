@@ -21,6 +21,7 @@
 // SYSTEM INCLUDES
 //
 #include <iostream>
+#include <stdexcept>
 
 // PROJECT INCLUDES
 //
@@ -65,7 +66,7 @@ operator>>(std::istream& is,
 
 	is >> record.m_recordheader;
 	if (!is.good()) {
-		throw "failure while reading record header\n";
+		throw std::runtime_error("failure while reading record header");
 	}
 
 	const int no_scanlines = record.m_recordheader.no_scanlines();
@@ -74,7 +75,7 @@ operator>>(std::istream& is,
 	for (int i = 0; i < no_scanlines; i++) {
 		is >> record.m_scanline[i];
 		if (!is.good()) {
-			throw "failure while reading scan line\n";
+			throw std::runtime_error("failure while reading scan line");
 		}
 	}
 
@@ -21,6 +21,7 @@
 // SYSTEM INCLUDES
 //
 #include <iostream>
+#include <stdexcept>
 
 // PROJECT INCLUDES
 //
@@ -72,16 +73,17 @@ operator>>(std::istream& is,
 
 	is >> scanline.m_lineheader;
 	if (!is.good()) {
-		throw "failure while reading line header\n";
+		throw std::runtime_error("failure while reading line header");
 	}
 
 	const int no_pixels = scanline.m_lineheader.no_pixels();
 	scanline.m_linepixel.resize(no_pixels);
 
-	for (int i = 0; i < no_pixels; i++) {
-		scanline.m_linepixel[i] = is.get();
+	if (no_pixels > 0) {
+		is.read(reinterpret_cast<char*>(&scanline.m_linepixel[0]),
+			no_pixels);
 		if (!is.good()) {
-			throw "failure while reading line pixel\n";
+			throw std::runtime_error("failure while reading line pixel");
 		}
 	}
 
@@ -90,10 +92,9 @@ operator>>(std::istream& is,
 
 	if (offset < 0) {
 		is.setstate(std::ios::failbit);
-	}
-	// no seekg() available on gzstream
-	for (int i = 0; i < offset; i++) {
-		is.get();
+	} else if (offset > 0) {
+		// skip without seeking, so that it works on compressed streams
+		is.ignore(offset);
 	}
 
 	return is;
@@ -0,0 +1,190 @@
+/*
+ * Copyright: (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ * USA.
+ */
+
+// SYSTEM INCLUDES
+//
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// PROJECT INCLUDES
+//
+#include "sysdep.h"
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif // def HAVE_ZLIB
+
+// LOCAL INCLUDES
+//
+#include "StreamBuf.hh" // class implemented
+
+// FORWARD REFERENCES
+//
+
+// *********************************************************************
+
+// **************************** PRIVATE    *****************************
+
+// **************************** PROTECTED  *****************************
+
+#ifdef HAVE_ZLIB
+GzipStreamBuf::int_type
+GzipStreamBuf::underflow()
+{
+	if (gptr() < egptr()) {
+		return traits_type::to_int_type(*gptr());
+	}
+
+	if (!m_file) {
+		return traits_type::eof();
+	}
+
+	const int len = gzread(static_cast<gzFile>(m_file),
+			       m_buffer, BUFFER_LEN);
+	if (len <= 0) {
+		return traits_type::eof();
+	}
+
+	setg(m_buffer, m_buffer, m_buffer + len);
+	return traits_type::to_int_type(*gptr());
+}
+#endif // def HAVE_ZLIB
+
+// **************************** PUBLIC     *****************************
+
+// ============================ LIFECYCLE  =============================
+
+MappedStreamBuf::MappedStreamBuf() :
+	m_addr(0),
+	m_size(0)
+{
+	// empty
+}
+
+MappedStreamBuf::~MappedStreamBuf()
+{
+	close();
+}
+
+#ifdef HAVE_ZLIB
+GzipStreamBuf::GzipStreamBuf() :
+	m_file(0)
+{
+	// empty
+}
+
+GzipStreamBuf::~GzipStreamBuf()
+{
+	close();
+}
+#endif // def HAVE_ZLIB
+
+// ============================ OPERATIONS =============================
+
+bool
+MappedStreamBuf::open(const char* filename)
+{
+	close();
+
+	const int fd = ::open(filename, O_RDONLY);
+	if (fd == -1) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		::close(fd);
+		return false;
+	}
+
+	m_size = st.st_size;
+	if (m_size > 0) {
+		m_addr = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m_addr == MAP_FAILED) {
+			m_addr = 0;
+			m_size = 0;
+			::close(fd);
+			return false;
+		}
+		// the file is read from start to end
+		madvise(m_addr, m_size, MADV_SEQUENTIAL);
+	}
+	::close(fd);
+
+	char* begin = static_cast<char*>(m_addr);
+	setg(begin, begin, begin + m_size);
+	return true;
+}
+
+void
+MappedStreamBuf::close()
+{
+	if (m_addr) {
+		munmap(m_addr, m_size);
+	}
+	m_addr = 0;
+	m_size = 0;
+	setg(0, 0, 0);
+}
+
+#ifdef HAVE_ZLIB
+bool
+GzipStreamBuf::open(const char* filename)
+{
+	close();
+
+	m_file = gzopen(filename, "rb");
+	if (!m_file) {
+		return false;
+	}
+	gzbuffer(static_cast<gzFile>(m_file), BUFFER_LEN);
+	return true;
+}
+
+void
+GzipStreamBuf::close()
+{
+	if (m_file) {
+		gzclose(static_cast<gzFile>(m_file));
+	}
+	m_file = 0;
+	setg(0, 0, 0);
+}
+#endif // def HAVE_ZLIB
+
+bool
+is_gzipped(const char* filename)
+{
+	FILE* in = fopen(filename, "rb");
+	if (!in) {
+		return false;
+	}
+
+	unsigned char magic[2] = { 0, 0 };
+	const size_t len = fread(magic, 1, 2, in);
+	fclose(in);
+
+	return len == 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+}
+
+// ============================ INQUIRY    =============================
+
+// ============================ ACCESS     =============================
@@ -0,0 +1,111 @@
+/*
+ * Copyright: (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307,
+ * USA.
+ */
+/*
+ * StreamBuf - input stream buffers for reading OpenMTP-IDS files
+ *
+ * MappedStreamBuf maps a whole file in memory, so reading from it never
+ * needs a system call.  GzipStreamBuf decompresses a gzipped file as it
+ * is read, a buffer at a time.
+ */
+#ifndef DSM_STREAMBUF_HH
+#define DSM_STREAMBUF_HH
+
+// SYSTEM INCLUDES
+//
+#include <streambuf>
+#include <cstddef>
+
+// PROJECT INCLUDES
+//
+#include "sysdep.h"
+
+// LOCAL INCLUDES
+//
+
+// FORWARD REFERENCES
+//
+
+// *********************************************************************
+
+class MappedStreamBuf : public std::streambuf
+{
+private:
+
+	MappedStreamBuf(const MappedStreamBuf&);
+	MappedStreamBuf& operator=(const MappedStreamBuf&);
+
+protected:
+
+	void* m_addr;
+	size_t m_size;
+
+public:
+
+	// LIFECYCLE
+
+	MappedStreamBuf();
+	~MappedStreamBuf();
+
+	// OPERATIONS
+
+	// map the file in memory, returns false if it cannot be opened
+	// or mapped
+	bool open(const char* filename);
+	void close();
+};
+
+#ifdef HAVE_ZLIB
+class GzipStreamBuf : public std::streambuf
+{
+private:
+
+	GzipStreamBuf(const GzipStreamBuf&);
+	GzipStreamBuf& operator=(const GzipStreamBuf&);
+
+protected:
+
+	static const int BUFFER_LEN = 65536; // bytes
+
+	void* m_file;
+	char m_buffer[BUFFER_LEN];
+
+	int_type underflow();
+
+public:
+
+	// LIFECYCLE
+
+	GzipStreamBuf();
+	~GzipStreamBuf();
+
+	// OPERATIONS
+
+	// returns false if the file cannot be opened
+	bool open(const char* filename);
+	void close();
+};
+#endif // def HAVE_ZLIB
+
+// returns true if the file starts with the gzip magic number
+bool is_gzipped(const char* filename);
+
+// EXTERNAL REFERENCES
+//
+
+#endif // DSM_STREAMBUF_HH
@@ -43,9 +43,6 @@ OpenMTP_image::~OpenMTP_image( ) { if (image) delete image; }
 
 void OpenMTP_image::read( std::ifstream &file, OpenMTP_binary_header &h )
 {
-  float rad = 0.0;
-  float cc, sc;
-  
   nlines = h.nlines( );
   npixels = h.npixels( );
 
@@ -58,29 +55,43 @@ void OpenMTP_image::read( std::ifstream &file, OpenMTP_binary_header &h )
     memcpy(image+i*npixels, line.linevals( ), npixels);
   }
 
-  for (int i = 0; i < 256; i ++)
-    calibration[i] = 1.0;
-
-  if (strcmp(h.satellite_name( ), "M7"))
+  if (! calibration_table(h, calibration))
   {
-    cerr << "Warning: OpenMTP calibration only for Meteosat 7." << endl;
+    if (strcmp(h.satellite_name( ), "M7"))
+      cerr << "Warning: OpenMTP calibration only for Meteosat 7." << endl;
     cerr << "Cannot calibrate data. Set calibration to 1.0" << endl;
     return;
   }
 
+  cout << "Calibration Coefficient : "
+       << h.mpef_calibration_coefficient( ) << endl;
+  cout << "Space Count             : "
+       << h.mpef_calibration_space_count( ) << endl;
+
+  return;
+}
+
+bool OpenMTP_image::calibration_table( OpenMTP_binary_header &h, float *table )
+{
+  float rad = 0.0;
+  float cc, sc;
+
+  for (int i = 0; i < 256; i ++)
+    table[i] = 1.0;
+
+  if (strcmp(h.satellite_name( ), "M7"))
+    return false;
+
   cc = h.mpef_calibration_coefficient( );
   sc = h.mpef_calibration_space_count( );
 
-  cout << "Calibration Coefficient : " << cc << endl;
-  cout << "Space Count             : " << sc << endl;
-
   if (h.is_ir_data( ))
   {
     for (int i = 0; i < 256; i ++)
     {
       if (i < sc) rad = 0.0;
       else rad = cc * ((float) i - sc);
-      calibration[i] = -1255.5465/(log(rad) - 6.9618);
+      table[i] = -1255.5465/(log(rad) - 6.9618);
     }
   }
   else if (h.is_wv_data( ))
@@ -89,18 +100,18 @@ void OpenMTP_image::read( std::ifstream &file, OpenMTP_binary_header &h )
     {
       if (i < sc) rad = 0.0;
       else rad = cc * ((float) i - sc);
-      calibration[i] = -2233.4882/(log(rad) - 9.2477);
+      table[i] = -2233.4882/(log(rad) - 9.2477);
     }
   }
   else if (h.is_vis_data( ))
   {
     for (int i = 0; i < 256; i ++)
-      calibration[i] = 100.0 * ((float) i / 255.0);
+      table[i] = 100.0 * ((float) i / 255.0);
   }
   else
-    cerr << "Cannot calibrate data. Set calibration to 1.0" << endl;
+    return false;
 
-  return;
+  return true;
 }
 
 unsigned char *OpenMTP_image::data( ) { return image; }
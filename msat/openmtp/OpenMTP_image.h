@@ -48,6 +48,11 @@ class OpenMTP_image {
 
     float *cal( );
 
+    // Fill the 256 entries of table with the calibrated value of each
+    // count, returns false (and a table of 1.0) if the data cannot be
+    // calibrated
+    static bool calibration_table( OpenMTP_binary_header &h, float *table );
+
     // Overloaded << operator
     friend std::ostream& operator<< ( std::ostream& os, OpenMTP_image &im )
     {
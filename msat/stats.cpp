@@ -0,0 +1,22 @@
+#include "stats.h"
+
+using namespace std;
+
+namespace msat {
+
+std::vector<std::pair<std::string, double>> Stats::values() const
+{
+	return {
+		{ "SEGMENTS_DECODED", (double)segments_decoded },
+		{ "CACHE_HITS", (double)cache_hits },
+		{ "CACHE_MISSES", (double)cache_misses },
+		{ "BYTES_READ", (double)bytes_read },
+		{ "DECODE_TIME", decode_time / 1e9 },
+		{ "GEOLOCATION_TIME", geolocation_time / 1e9 },
+		{ "DERIVED_TIME", derived_time / 1e9 },
+	};
+}
+
+}
+
+// vim:set ts=2 sw=2:
@@ -0,0 +1,64 @@
+#ifndef MSAT_STATS_H
+#define MSAT_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace msat {
+
+/**
+ * Performance counters of a dataset.
+ *
+ * Counters can be updated from any thread. Times are in nanoseconds.
+ */
+struct Stats
+{
+	/// Image segments read and decoded
+	std::atomic<uint64_t> segments_decoded{0};
+	/// Segment requests served by the segment cache
+	std::atomic<uint64_t> cache_hits{0};
+	/// Segment requests that needed reading a segment file
+	std::atomic<uint64_t> cache_misses{0};
+	/// Bytes read from data files
+	std::atomic<uint64_t> bytes_read{0};
+	/// Time spent reading and decoding data
+	std::atomic<uint64_t> decode_time{0};
+	/// Time spent computing latitude and longitude of pixels
+	std::atomic<uint64_t> geolocation_time{0};
+	/// Time spent computing derived bands, including reading their sources
+	std::atomic<uint64_t> derived_time{0};
+
+	/**
+	 * Names and values of the counters, with times in seconds.
+	 *
+	 * Names of time counters end in "_TIME".
+	 */
+	std::vector<std::pair<std::string, double>> values() const;
+};
+
+/// Add the time elapsed during its lifetime to a Stats time counter
+class StatsTimer
+{
+	std::atomic<uint64_t>& counter;
+	std::chrono::steady_clock::time_point start;
+
+public:
+	explicit StatsTimer(std::atomic<uint64_t>& counter)
+		: counter(counter), start(std::chrono::steady_clock::now()) {}
+	StatsTimer(const StatsTimer&) = delete;
+	StatsTimer& operator=(const StatsTimer&) = delete;
+	~StatsTimer()
+	{
+		counter += std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count();
+	}
+};
+
+}
+
+// vim:set ts=2 sw=2:
+#endif
@@ -27,7 +27,10 @@
 #include <cstdio>
 #include <cmath>
 #include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <msat/iniparser.h>
+#include <msat/utils/sys.h>
 #include "thornsds_db1.h"
 
 static char vname[NVAR][VARLEN] = { "V", "N", "T", "U" };
@@ -40,8 +43,7 @@ MSG_db1_data::MSG_db1_data( )
   AoI         = 0;
   INFO        = 0;
   Calibration = 0;
-  rawdata     = 0;
-  cal_values  = 0;
+  current     = 0;
 }
 
 MSG_db1_data::~MSG_db1_data( ) { this->close( ); }
@@ -51,26 +53,31 @@ void MSG_db1_data::close( )
   if (dirname) { free(dirname); dirname = 0; }
   if (AoI) { iniparser_free(AoI); AoI = 0; }
   if (INFO) { iniparser_free(INFO); INFO = 0; }
-  if (Calibration) { iniparser_free(Calibration); Calibration = 0; }
-  if (rawdata) { delete [ ] rawdata; rawdata = 0; }
-  if (cal_values) { delete [ ] cal_values; cal_values = 0; }
+  for (std::map<std::string, MSG_db1_channel *>::iterator i = channels.begin();
+       i != channels.end(); ++ i)
+  {
+    MSG_db1_channel *ch = i->second;
+    if (ch->Calibration) iniparser_free(ch->Calibration);
+    delete ch->raw;
+    delete [ ] ch->cal_values;
+    delete ch;
+  }
+  channels.clear( );
+  Calibration = 0;
+  current = 0;
   chnum = 0;
   ncalval = -1;
 }
 
-void MSG_db1_data::open( char *directory )
+bool MSG_db1_data::open( char *directory )
 {
   char iname[PATH_MAX];
   this->dirname = strdup(directory);
   snprintf(iname, PATH_MAX, "%s/%s", directory, "AoI");
   AoI = iniparser_new(iname);
-  if (AoI == 0)
-    std::cerr << "No such file: " << iname << std::endl;
   snprintf(iname, PATH_MAX, "%s/%s", directory, "INFO.DBI");
   INFO = iniparser_new(iname);
-  if (INFO == 0)
-    std::cerr << "No such file: " << iname << std::endl;
-  return;
+  return AoI != 0 && INFO != 0;
 }
 
 bool MSG_db1_data::has_channel(char *chname)
@@ -89,43 +96,93 @@ bool MSG_db1_data::has_channel(char *chname)
 
 void MSG_db1_data::set_channel(char *chname)
 {
+  // The RAW file and the calibration of a channel are loaded only the first
+  // time the channel is selected
+  std::map<std::string, MSG_db1_channel *>::iterator i = channels.find(chname);
+  if (i != channels.end())
+  {
+    current = i->second;
+    chnum = current->chnum;
+    Calibration = current->Calibration;
+    ncalval = current->ncalval;
+    return;
+  }
+
+  current = 0;
+  chnum = 0;
+  Calibration = 0;
+  ncalval = -1;
+
   if (! this->has_channel(chname))
   {
     if (dirname)
       std::cerr << "Channel not present in " << dirname << std::endl;
+    return;
   }
-  char iname[PATH_MAX];
-  sprintf(iname, "%s/%s.Calibration", dirname, chname);
-  Calibration = iniparser_new(iname);
-  if (Calibration == 0)
-  {
-    std::cerr << "No such file: " << iname << std::endl;
-    std::cerr << "No Calibration performed for " << chname << std::endl;
-  }
-  sprintf(iname, "%s/%s.RAW", dirname, chname);
-  FILE *fp = fopen(iname, "r");
-  if (! fp)
+  if (chfstat.st_size == 0)
   {
-    std::cerr << "Cannot open file: " << iname << std::endl;
+    std::cerr << "Empty RAW file for channel " << chname << std::endl;
     return;
   }
-  rawdata = (unsigned short *) (new unsigned char[chfstat.st_size]);
-  if (fread(rawdata, chfstat.st_size, 1, fp) != 1)
-  {
-    std::cerr << "Cannot read file: " << iname << std::endl;
+
+  MSG_db1_channel *ch = new MSG_db1_channel;
+  ch->chnum = 0;
+  ch->Calibration = 0;
+  ch->raw = 0;
+  ch->ncalval = -1;
+  ch->cal_values = 0;
+
+  // Map the RAW file instead of reading it: pages are loaded on demand, and
+  // shared with other processes reading the same channel
+  char iname[PATH_MAX];
+  snprintf(iname, PATH_MAX, "%s/%s.RAW", dirname, chname);
+  try {
+    msat::sys::File in(std::filesystem::path(iname), O_RDONLY);
+    ch->raw = new msat::sys::MMap(in.mmap(chfstat.st_size, PROT_READ, MAP_SHARED));
+  } catch (std::exception& e) {
+    std::cerr << "Cannot read file: " << iname << ": " << e.what() << std::endl;
+    delete ch;
     return;
   }
-  fclose(fp);
-  this->chnum = get_channel_number(chname);
+
+  snprintf(iname, PATH_MAX, "%s/%s.Calibration", dirname, chname);
+  ch->Calibration = iniparser_new(iname);
+  ch->chnum = get_channel_number(chname);
+  channels[chname] = ch;
+
+  current = ch;
+  chnum = ch->chnum;
+  Calibration = ch->Calibration;
   ncalval = (int) (pow(2.0, (double) get_INFO_image_bitsperpixel( )));
-  cal_values = new float[ncalval];
+  ch->ncalval = ncalval;
+  ch->cal_values = new float[ncalval];
 
   for (int i = 0; i < ncalval; i ++)
-    cal_values[i] = get_channel_Calibration_value_calibrated(i);
+    ch->cal_values[i] = get_channel_Calibration_value_calibrated(i);
 
   return;
 }
 
+MSG_db1_channel *MSG_db1_data::get_channel( )
+{
+  if (! is_data_ok( )) return 0;
+  return current;
+}
+
+std::vector<std::string> MSG_db1_data::get_channel_names( )
+{
+  std::vector<std::string> res;
+  char *iname;
+  for (int ich = 1; ich <= MAXCH; ich ++)
+  {
+    snprintf(infochuse, INFOCHLEN, "Channel%d:Name", ich);
+    iname = iniparser_getstring(INFO, infochuse, 0);
+    if (iname && has_channel(iname))
+      res.push_back(iname);
+  }
+  return res;
+}
+
 int MSG_db1_data::get_channel_number(char *chname)
 {
   int ich = 0;
@@ -160,7 +217,7 @@ int MSG_db1_data::chname_to_chnum(char *chname)
 
 bool MSG_db1_data::is_data_ok( )
 {
-  if (chnum > 0)
+  if (current && chnum > 0)
     return true;
   return false;
 }
@@ -168,7 +225,7 @@ bool MSG_db1_data::is_data_ok( )
 int MSG_db1_data::get_AoI_npixels( )
 {
   if (! is_data_ok( )) return -1;
-  return iniparser_getint(AoI, ":nPixels", chfstat.st_size/sizeof(short));
+  return iniparser_getint(AoI, ":nPixels", get_raw_data_nvals( ));
 }
 
 int MSG_db1_data::get_AoI_nlines( )
@@ -288,7 +345,7 @@ char *MSG_db1_data::get_INFO_image_sensor( )
 int MSG_db1_data::get_INFO_image_pixels( )
 {
   if (! is_data_ok( )) return 0;
-  return iniparser_getint(INFO, "Image:Pixels", chfstat.st_size/sizeof(short));
+  return iniparser_getint(INFO, "Image:Pixels", get_raw_data_nvals( ));
 }
 
 int MSG_db1_data::get_INFO_image_lines( )
@@ -405,7 +462,7 @@ float MSG_db1_data::get_channel_Calibration_B( )
 float MSG_db1_data::get_channel_Calibration_value_calibrated( int count )
 {
   if (! is_data_ok( )) return 0;
-  if (count < 0 && count >= ncalval) return 0.0;
+  if (count < 0 || count >= ncalval) return 0.0;
   snprintf(infochuse, INFOCHLEN, "%s:%s(%d)", get_channel_INFO_variable( ),
            get_channel_INFO_variable_code( ), count);
   return (float) iniparser_getdouble(Calibration, infochuse, 0.0);
@@ -414,13 +471,13 @@ float MSG_db1_data::get_channel_Calibration_value_calibrated( int count )
 unsigned short *MSG_db1_data::get_RAW_data( )
 {
   if (! is_data_ok( )) return 0;
-  return rawdata;
+  return *current->raw;
 }
 
 float *MSG_db1_data::get_calibration( )
 {
   if (! is_data_ok( )) return 0;
-  return cal_values;
+  return current->cal_values;
 }
 
 int MSG_db1_data::get_number_of_calibration( )
@@ -432,13 +489,13 @@ int MSG_db1_data::get_number_of_calibration( )
 int MSG_db1_data::get_raw_data_size( )
 {
   if (! is_data_ok( )) return 0;
-  return chfstat.st_size;
+  return current->raw->size( );
 }
 
 int MSG_db1_data::get_raw_data_nvals( )
 {
   if (! is_data_ok( )) return 0;
-  return chfstat.st_size/sizeof(short);
+  return current->raw->size( )/sizeof(short);
 }
 
 std::ostream& operator<< ( std::ostream& os, MSG_db1_data &d )
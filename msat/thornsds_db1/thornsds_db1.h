@@ -24,6 +24,9 @@
 //
 //-----------------------------------------------------------------------------
 #include <iostream>
+#include <map>
+#include <string>
+#include <vector>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -42,16 +45,39 @@ typedef enum {
   UNDEFINED   = 3
 } t_enum_MSG_Variable;
 
+namespace msat {
+namespace sys {
+class MMap;
+}
+}
+
+//
+// Data of one channel of a DB1 directory: the RAW file is mapped in memory
+// read only, and the calibration table is computed once when the channel is
+// first selected
+//
+struct MSG_db1_channel {
+  int chnum;
+  dictionary *Calibration;
+  msat::sys::MMap *raw;
+  int ncalval;
+  float *cal_values;
+};
+
 class MSG_db1_data {
 
   public:
     MSG_db1_data( );
     ~MSG_db1_data( );
-    void open(char *directory);
+    // Returns false if the AoI or INFO.DBI files cannot be read
+    bool open(char *directory);
     void close( );
 
     bool has_channel(char *chname);
+    // A channel without a Calibration file has a null Calibration
     void set_channel(char *chname);
+    MSG_db1_channel *get_channel( );
+    std::vector<std::string> get_channel_names( );
     int chname_to_chnum(char *chname);
 
     bool is_data_ok( );
@@ -113,7 +139,7 @@ class MSG_db1_data {
     dictionary *INFO;
     dictionary *Calibration;
     int chnum;
-    unsigned short *rawdata;
     int ncalval;
-    float *cal_values;
+    MSG_db1_channel *current;
+    std::map<std::string, MSG_db1_channel *> channels;
 };
@@ -23,44 +23,82 @@
 #include <msat/xrit/dataaccess.h>
 #include <msat/xrit/fileaccess.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/Progress.h>
+#include <msat/utils/sys.h>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
 
 using namespace std;
 
 namespace msat {
 namespace xrit {
 
+/**
+ * Check if a segment has compressed data with no compression format, which
+ * cannot be decoded
+ */
+static bool is_binary_dump(const MSG_header& header)
+{
+    return header.segment_id->data_field_format == MSG_NO_FORMAT
+        && header.image_structure->compression_flag != MSG_NO_COMPRESSION;
+}
+
 DataAccess::DataAccess() : npixperseg(0)
 {
 }
 
 DataAccess::~DataAccess()
 {
-    // Delete the segment cache
-    //if (m_segment) delete m_segment;
-    for (auto& i: segcache)
-        delete i.segment;
 }
 
 void DataAccess::read_file(const std::string& file, MSG_header& head) const
 {
-    // ProgressTask p("Reading segment " + segnames[idx]);
-    std::ifstream hrit(file.c_str(), (std::ios::binary | std::ios::in));
-    if (hrit.fail()) throw std::runtime_error(file + ": cannot open");
-    head.read_from(hrit);
-    hrit.close();
+    ProgressSpan span("header");
+    sys::File in(std::filesystem::path(file), O_RDONLY);
+
+    // Segment headers are about 6KiB, and are usually read with a single
+    // pread and parsed in place
+    unsigned char buf[8192];
+    size_t len = in.pread(buf, sizeof(buf), 0);
+    size_t hlen = MSG_header::header_length(buf, len);
+    if (hlen <= len)
+        head.read_from(buf, len);
+    else {
+        std::vector<unsigned char> hbuf(hlen);
+        memcpy(hbuf.data(), buf, len);
+        len += in.pread(hbuf.data() + len, hlen - len, len);
+        head.read_from(hbuf.data(), len);
+    }
+    span.add_bytes(hlen);
+    stats.bytes_read += head.total_header_length;
 }
 
 void DataAccess::read_file(const std::string& file, MSG_header& head, MSG_data& data) const
 {
-    // ProgressTask p("Reading segment " + segnames[idx]);
+    StatsTimer timer(stats.decode_time);
     std::ifstream hrit(file.c_str(), (std::ios::binary | std::ios::in));
     if (hrit.fail())
         throw std::runtime_error(file + ": cannot open");
-    head.read_from(hrit);
-    if (head.segment_id && head.segment_id->data_field_format == MSG_NO_FORMAT)
+    {
+        ProgressSpan span("header");
+        head.read_from(hrit);
+        span.add_bytes(hrit.tellg());
+    }
+    if (head.segment_id && is_binary_dump(head))
         throw std::runtime_error(file + ": product dumped in binary format");
-    data.read_from(hrit, head);
+    {
+        // Image segments are decompressed here, while prologue and epilogue
+        // are only decoded
+        ProgressSpan span("decompress");
+        data.read_from(hrit, head);
+        span.add_bytes(head.data_field_length / 8);
+        stats.bytes_read += head.filesize;
+        if (data.image)
+            span.add_pixels(head.image_structure->number_of_columns * head.image_structure->number_of_lines);
+    }
     hrit.close();
 }
 
@@ -85,6 +123,8 @@ void DataAccess::scanSegment(const MSG_header& header)
 
 void DataAccess::scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_header& header)
 {
+    ProgressSpan span("scan");
+
     // Read prologue
     MSG_header PRO_head;
     //p.activity("Reading prologue " + opts.prologueFile());
@@ -95,13 +135,24 @@ void DataAccess::scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_he
     //p.activity("Reading epilogue " + opts.epilogueFile());
     read_file(fa.epilogueFile(), EPI_head, epi);
 
+    scanSegments(fa, epi, header);
+}
+
+void DataAccess::scan(const FileAccess& fa, const MSG_data& epi, MSG_header& header)
+{
+    ProgressSpan span("scan");
+    scanSegments(fa, epi, header);
+}
+
+void DataAccess::scanSegments(const FileAccess& fa, const MSG_data& epi, MSG_header& header)
+{
     // Sort the segment names by their index
     vector<string> segfiles = fa.segmentFiles();
     for (const auto& i: segfiles)
     {
         //p.activity("Scanning segment " + *i);
         read_file(i, header);
-        if (header.segment_id->data_field_format == MSG_NO_FORMAT)
+        if (is_binary_dump(header))
             throw std::runtime_error(i + ": product dumped in binary format");
 
         int idx = header.segment_id->sequence_number-1;
@@ -150,49 +201,79 @@ void DataAccess::scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_he
     }
 }
 
-MSG_data* DataAccess::segment(size_t idx) const
+DataAccess::Segment DataAccess::segment(size_t idx) const
 {
-    // Check to see if the segment we need is the current one
-    if (!segcache.empty() && segcache.begin()->segno == idx)
-        return segcache.begin()->segment;
-
-    // If not, check to see if we can find the segment in the cache
-    std::deque<scache>::iterator i = segcache.begin();
-    for ( ; i != segcache.end(); ++i)
-        if (i->segno == idx)
-            break;
-    if (i == segcache.end())
-    {
-        // Not in cache: we need to load it
+    // Do not load missing segments
+    if (idx >= segnames.size()) return Segment();
+    if (segnames[idx].empty()) return Segment();
 
-        // Do not load missing segments
-        if (idx >= segnames.size()) return 0;
-        if (segnames[idx].empty()) return 0;
+    std::promise<Segment> loader;
+    std::shared_future<Segment> res;
+    {
+        std::lock_guard<std::mutex> lock(segcache_mutex);
+        auto i = find_if(segcache.begin(), segcache.end(), [&](const scache& c) { return c.segno == idx; });
+        if (i != segcache.end())
+        {
+            // Bring the segment to the front of the cache
+            ++stats.cache_hits;
+            scache tmp = *i;
+            segcache.erase(i);
+            segcache.push_front(tmp);
+            return tmp.segment;
+        }
 
-        // Remove the last recently used if the cache is full
-        if (segcache.size() == 2)
+        auto l = segloading.find(idx);
+        if (l != segloading.end())
         {
-            delete segcache.rbegin()->segment;
-            segcache.pop_back();
+            // Another thread is decoding the segment: wait for it outside
+            // the lock
+            ++stats.cache_hits;
+            res = l->second;
+        } else {
+            // Decode the segment outside the lock
+            ++stats.cache_misses;
+            segloading.emplace(idx, loader.get_future().share());
         }
+    }
+    if (res.valid())
+        return res.get();
 
-        // Load the segment
-        // ProgressTask p("Reading segment " + segnames[idx]);
+    // Load the segment
+    std::shared_ptr<MSG_data> data;
+    try {
+        ProgressSpan span("segment");
         MSG_header header;
+        data = std::make_shared<MSG_data>();
+        read_file(segnames[idx].c_str(), header, *data);
+        ++stats.segments_decoded;
+    } catch (...) {
+        // Do not cache the failure, so that the next request tries again.
+        // Only this thread decodes idx while it is in segloading, so the
+        // entry is ours
+        {
+            std::lock_guard<std::mutex> lock(segcache_mutex);
+            segloading.erase(idx);
+        }
+        loader.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(segcache_mutex);
+        segloading.erase(idx);
+
+        // Remove the least recently used if the cache is full. Threads
+        // still using it keep it alive with their handles
+        if (segcache.size() == 2)
+            segcache.pop_back();
+
         scache new_scache;
-        new_scache.segment = new MSG_data;
+        new_scache.segment = data;
         new_scache.segno = idx;
-        read_file(segnames[idx].c_str(), header, *new_scache.segment);
-
-        // Put it in the front
         segcache.push_front(new_scache);
-    } else {
-        // The segment is in the cache: bring it to the front
-        scache tmp = *i;
-        segcache.erase(i);
-        segcache.push_front(tmp);
     }
-    return segcache.begin()->segment;
+    loader.set_value(data);
+    return data;
 }
 
 size_t DataAccess::line_start(size_t line) const
@@ -215,7 +296,7 @@ void DataAccess::line_read(size_t line, MSG_SAMPLE* buf) const
     size_t segnum = 0;
     size_t segline = 0;
 
-    MSG_data* d = nullptr;
+    Segment d;
 
     if (hrv)
     {
@@ -26,7 +26,12 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <future>
 #include <msat/hrit/MSG_data_image.h>
+#include <msat/stats.h>
 
 struct MSG_header;
 struct MSG_data;
@@ -38,12 +43,18 @@ struct FileAccess;
 
 /**
  * Higher level data access for xRIT files
+ *
+ * Once scan() has been called, segment(), line_start() and line_read() can be
+ * used concurrently by multiple threads.
  */
 class DataAccess
 {
 protected:
         void scanSegment(const MSG_header& header);
 
+        /// Scan the segments of \a fa, taking the HRV coverage from \a epi
+        void scanSegments(const FileAccess& fa, const MSG_data& epi, MSG_header& header);
+
 public:
         /// Number of pixels in every segment
         size_t npixperseg;
@@ -63,14 +74,31 @@ public:
         /// Pathnames of the segment files, indexed with their index
         std::vector<std::string> segnames;
 
+        /// Reference counted handle to a decoded segment
+        typedef std::shared_ptr<const MSG_data> Segment;
+
         struct scache
         {
-                MSG_data* segment;
+                Segment segment;
                 size_t segno;
         };
-        /// Segment cache
+        /// Cache of decoded segments, most recently used first
         mutable std::deque<scache> segcache;
 
+        /**
+         * Segments being decoded, by index.
+         *
+         * They are kept out of segcache so that they cannot be evicted, and
+         * other threads asking for them wait for the decode in progress.
+         */
+        mutable std::map<size_t, std::shared_future<Segment>> segloading;
+
+        /// Serializes access to segcache and segloading
+        mutable std::mutex segcache_mutex;
+
+        /// Counters of segment reads and cache use
+        mutable Stats stats;
+
         /// Length of a scanline
         size_t columns;
 
@@ -108,6 +136,12 @@ public:
          */
         void scan(const FileAccess& fa, MSG_data& pro, MSG_data& epi, MSG_header& header);
 
+        /**
+         * Scan the given segments, using an epilogue that has already been
+         * read, instead of reading the one of \a fa.
+         */
+        void scan(const FileAccess& fa, const MSG_data& epi, MSG_header& header);
+
         /**
          * Read a xRIT file (prologue, epilogue or segment)
          */
@@ -141,11 +175,14 @@ public:
         void line_read(size_t line, MSG_SAMPLE* buf) const;
 
         /**
-         * Return the MSG_data corresponding to the segment with the given index.
+         * Return the MSG_data corresponding to the segment with the given
+         * index, or an empty handle if the segment is missing.
          *
-         * The pointer could be invalidated by another call to segment()
+         * The segment stays valid as long as the handle is kept, even if it
+         * is dropped from the cache. If other threads ask for a segment while
+         * it is being decoded, they wait for it instead of decoding it again.
          */
-        MSG_data* segment(size_t idx) const;
+        Segment segment(size_t idx) const;
 };
 
 }
@@ -21,6 +21,7 @@
  */
 
 #include <msat/xrit/fileaccess.h>
+#include <msat/Progress.h>
 #include <glob.h>
 #include <stdexcept>
 #include <sstream>
@@ -241,6 +242,7 @@ std::vector<std::string> FileAccess::segmentFiles() const
         + "0?????___" + "-"
         + timing + "-" + "C_";
 
+    ProgressSpan span("glob");
     glob_t globbuf;
     globbuf.gl_offs = 1;
 
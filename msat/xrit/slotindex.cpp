@@ -0,0 +1,154 @@
+/*
+ * xrit/slotindex - Track the arrival of the files of xRIT timeslots
+ *
+ * Copyright (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <msat/xrit/slotindex.h>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+static std::string deunderscore(const std::string& str)
+{
+    size_t pos = str.find_last_not_of('_');
+    if (pos == string::npos) return string();
+    return str.substr(0, pos + 1);
+}
+
+bool SegmentName::parse(const std::string& basename)
+{
+    // resolution-nnn-xxxxxx-productid1-productid2-segment-datetime-flags
+    vector<string> parts;
+    size_t beg = 0;
+    while (true)
+    {
+        size_t end = basename.find('-', beg);
+        parts.push_back(basename.substr(beg, end == string::npos ? string::npos : end - beg));
+        if (end == string::npos) break;
+        beg = end + 1;
+    }
+    if (parts.size() != 8) return false;
+    if (parts[0].empty() || parts[3].size() != 12 || parts[4].size() != 9 || parts[5].size() != 9)
+        return false;
+
+    resolution = parts[0];
+    productid1 = deunderscore(parts[3]);
+    productid2 = deunderscore(parts[4]);
+    timing = deunderscore(parts[6]);
+    if (productid1.empty() || timing.empty()) return false;
+
+    if (parts[5] == "PRO______")
+    {
+        type = PROLOGUE;
+        segment = 0;
+        productid2.clear();
+    } else if (parts[5] == "EPI______") {
+        type = EPILOGUE;
+        segment = 0;
+        productid2.clear();
+    } else {
+        if (parts[7] != "C_" || productid2.empty()) return false;
+        char* endptr;
+        segment = strtoul(parts[5].c_str(), &endptr, 10);
+        if (segment == 0 || deunderscore(endptr) != "") return false;
+        type = SEGMENT;
+    }
+    return true;
+}
+
+
+FileAccess Slot::access(const std::string& channel) const
+{
+    FileAccess res;
+    res.directory = directory;
+    res.resolution = resolution;
+    res.productid1 = productid1;
+    res.productid2 = channel;
+    res.timing = timing;
+    return res;
+}
+
+std::string Slot::name(const std::string& channel) const
+{
+    return directory + "/" + resolution + ":" + productid1 + ":" + channel + ":" + timing;
+}
+
+std::string Slot::key() const
+{
+    return resolution + ":" + productid1 + ":" + timing;
+}
+
+
+Slot* SlotIndex::add(const std::string& basename)
+{
+    SegmentName sn;
+    if (!sn.parse(basename)) return nullptr;
+
+    Slot slot;
+    slot.directory = directory;
+    slot.resolution = sn.resolution;
+    slot.productid1 = sn.productid1;
+    slot.timing = sn.timing;
+    auto i = slots.emplace(slot.key(), slot).first;
+
+    Slot& res = i->second;
+    switch (sn.type)
+    {
+        case SegmentName::PROLOGUE: res.prologue = true; break;
+        case SegmentName::EPILOGUE: res.epilogue = true; break;
+        case SegmentName::SEGMENT: res.channels[sn.productid2].insert(sn.segment); break;
+    }
+    return &res;
+}
+
+bool SlotIndex::complete(const Slot& slot, const std::string& channel) const
+{
+    if (!slot.prologue) return false;
+
+    auto i = slot.channels.find(channel);
+    if (i == slot.channels.end()) return false;
+    if (slot.epilogue) return true;
+
+    unsigned first = first_segment ? first_segment : 1;
+    unsigned last = last_segment ? last_segment : (channel == "HRV" ? 24 : 8);
+    for (unsigned seg = first; seg <= last; ++seg)
+        if (i->second.find(seg) == i->second.end())
+            return false;
+    return true;
+}
+
+void SlotIndex::expire(unsigned keep)
+{
+    // Order by timing, as keys also contain the resolution and spacecraft
+    multimap<string, map<string, Slot>::iterator> by_time;
+    for (auto i = slots.begin(); i != slots.end(); ++i)
+        by_time.emplace(i->second.timing, i);
+
+    while (by_time.size() > keep)
+    {
+        slots.erase(by_time.begin()->second);
+        by_time.erase(by_time.begin());
+    }
+}
+
+}
+}
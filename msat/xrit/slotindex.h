@@ -0,0 +1,117 @@
+#ifndef MSAT_XRIT_SLOTINDEX_H
+#define MSAT_XRIT_SLOTINDEX_H
+
+/*
+ * xrit/slotindex - Track the arrival of the files of xRIT timeslots
+ *
+ * Copyright (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <msat/xrit/fileaccess.h>
+#include <string>
+#include <map>
+#include <set>
+
+namespace msat {
+namespace xrit {
+
+/**
+ * Parsed name of a disseminated xRIT file, like
+ * H-000-MSG1__-MSG1________-IR_039___-000001___-200611130800-C_
+ */
+struct SegmentName
+{
+    enum Type { SEGMENT, PROLOGUE, EPILOGUE };
+
+    std::string resolution;
+    std::string productid1;
+    /// Channel name, empty for prologue and epilogue
+    std::string productid2;
+    std::string timing;
+    Type type = SEGMENT;
+    /// Segment number, 0 for prologue and epilogue
+    unsigned segment = 0;
+
+    /// Parse a file name without directory, returning false if it is not a xRIT file
+    bool parse(const std::string& basename);
+};
+
+/// Files received so far for a timeslot
+struct Slot
+{
+    std::string directory;
+    std::string resolution;
+    std::string productid1;
+    std::string timing;
+    bool prologue = false;
+    bool epilogue = false;
+    /// Segments received, by channel name
+    std::map<std::string, std::set<unsigned>> channels;
+
+    /// FileAccess for a channel of this timeslot
+    FileAccess access(const std::string& channel) const;
+
+    /// Shortened name of a channel of this timeslot, as accepted by FileAccess
+    std::string name(const std::string& channel) const;
+
+    /// Key of this timeslot in a SlotIndex
+    std::string key() const;
+};
+
+/**
+ * In-memory index of the xRIT files appearing in a directory, grouped by
+ * timeslot, to tell when the files of a channel are all available without
+ * going through the file system.
+ */
+struct SlotIndex
+{
+    std::string directory;
+
+    /**
+     * Segments needed for a channel to be complete. 0 means the segments of a
+     * full disk: 1 to 24 for HRV, 1 to 8 for the other channels.
+     */
+    unsigned first_segment = 0;
+    unsigned last_segment = 0;
+
+    /// Timeslots, by resolution:productid1:timing
+    std::map<std::string, Slot> slots;
+
+    explicit SlotIndex(const std::string& directory) : directory(directory) {}
+
+    /**
+     * Add a file name, without directory.
+     *
+     * Returns the timeslot of the file, or nullptr if it is not a xRIT file.
+     */
+    Slot* add(const std::string& basename);
+
+    /**
+     * Check if a channel can be read: this happens when the prologue is
+     * there, and either all the needed segments or the epilogue, which is
+     * disseminated at the end of the repeat cycle.
+     */
+    bool complete(const Slot& slot, const std::string& channel) const;
+
+    /// Forget all but the \a keep most recent timeslots
+    void expire(unsigned keep);
+};
+
+}
+}
+
+#endif
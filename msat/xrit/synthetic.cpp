@@ -0,0 +1,559 @@
+/*
+ * xrit/synthetic - Write synthetic xRIT repeat cycles
+ *
+ * Copyright (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <msat/xrit/synthetic.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/sys.h>
+#include <msat/facts.h>
+#include <filesystem>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <ctime>
+#include <fcntl.h>
+
+using namespace std;
+
+namespace msat {
+namespace xrit {
+
+namespace {
+
+const unsigned seg_lines = 464;
+const unsigned visir_size = 3712;
+const unsigned hrv_size = 11136;
+const unsigned hrv_columns = 5568;
+const unsigned bits_per_pixel = 10;
+
+// Column and line scaling factors of the reference grids
+const int visir_cfac = -13642337;
+const int hrv_cfac = -40927014;
+
+// Offsets in the data field of the prologue, which has the Level 1.5 header
+// without the IMPF configuration
+const size_t pro_image_acquisition = MSG_SATELLITE_STATUS_LEN;
+const size_t pro_image_description = pro_image_acquisition + MSG_IMAGE_ACQUISITION_LEN + MSG_CELESTIAL_EVENTS_LEN;
+const size_t pro_radiometric_proc = pro_image_description + MSG_IMAGE_DESCRIPTION_LEN;
+const size_t pro_len = pro_radiometric_proc + MSG_DATA_RADIOMETRIC_PROC_LEN + MSG_GEOMETRIC_PROCESSING_LEN;
+
+// Offsets in the data field of the epilogue, which has a version byte
+// followed by the Level 1.5 trailer
+const size_t epi_product_stats = 1;
+const size_t epi_len = epi_product_stats + MSG_IMAGE_PRODUCT_STATS_LEN
+                     + MSG_NAVIGATION_EXTR_RESULT_LEN + MSG_RADIOMETRIC_QUALITY_LEN
+                     + MSG_GEOMETRIC_QUALITY_LEN + MSG_TIMELINESS_COMPLETENESS_LEN;
+
+/// Calibration slope and offset of each channel, as sent for MSG2
+const double calibration[12][2] = {
+    { 0.020419100, -1.0413741 },
+    { 0.026167700, -1.3345527 },
+    { 0.022322200, -1.1384322 },
+    { 0.0036586669, -0.18659201 },
+    { 0.0083181112, -0.42422367 },
+    { 0.038621968, -1.9697204 },
+    { 0.12674432, -6.4639603 },
+    { 0.10396091, -5.3020064 },
+    { 0.20503568, -10.456819 },
+    { 0.22231115, -11.337868 },
+    { 0.15760690, -8.0379517 },
+    { 0.029934101, -1.5266391 },
+};
+
+/// Big endian encoder of xRIT header fields
+struct Buffer
+{
+    std::vector<uint8_t> data;
+
+    explicit Buffer(size_t size=0) : data(size) {}
+
+    uint8_t* at(size_t pos, size_t len)
+    {
+        if (data.size() < pos + len)
+            data.resize(pos + len);
+        return data.data() + pos;
+    }
+
+    void put_uint(size_t pos, uint64_t val, unsigned len)
+    {
+        uint8_t* p = at(pos, len);
+        for (unsigned i = 0; i < len; ++i)
+            p[i] = val >> (8 * (len - i - 1));
+    }
+    void put_ui1(size_t pos, unsigned val) { put_uint(pos, val, 1); }
+    void put_ui2(size_t pos, unsigned val) { put_uint(pos, val, 2); }
+    void put_i4(size_t pos, int32_t val) { put_uint(pos, (uint32_t)val, 4); }
+    void put_ui8(size_t pos, uint64_t val) { put_uint(pos, val, 8); }
+    void put_r4(size_t pos, float val)
+    {
+        uint32_t u;
+        memcpy(&u, &val, 4);
+        put_uint(pos, u, 4);
+    }
+    void put_r8(size_t pos, double val)
+    {
+        uint64_t u;
+        memcpy(&u, &val, 8);
+        put_uint(pos, u, 8);
+    }
+    void put_string(size_t pos, const std::string& val)
+    {
+        memcpy(at(pos, val.size()), val.data(), val.size());
+    }
+
+    /// Time as CCSDS day segmented code: days since 1958 and milliseconds
+    void put_cds(size_t pos, time_t t, unsigned msec=0)
+    {
+        const time_t secs_from_1958_to_1970 = 378691200;
+        uint64_t ms = (uint64_t)(t + secs_from_1958_to_1970) * 1000 + msec;
+        put_ui2(pos, ms / 86400000);
+        put_uint(pos + 2, ms % 86400000, 4);
+    }
+
+    /// Append a header record of type \a type, with the data written by \a f
+    template<typename F>
+    void add_record(unsigned type, F f)
+    {
+        size_t pos = data.size();
+        put_ui1(pos, type);
+        put_ui2(pos + 1, 0);
+        f(pos);
+        put_ui2(pos + 1, data.size() - pos);
+    }
+};
+
+/// Pad \a str with underscores up to \a len characters
+std::string underscoreit(const std::string& str, size_t len)
+{
+    std::string res = str;
+    res.resize(len, '_');
+    return res;
+}
+
+/// Parse a XRIT timing (YYYYMMDDHHMM) as a UTC time
+bool parse_timing(const std::string& timing, time_t& res)
+{
+    struct tm t;
+    memset(&t, 0, sizeof(t));
+    if (timing.size() != 12 || sscanf(timing.c_str(), "%4d%2d%2d%2d%2d",
+                &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min) != 5)
+        return false;
+    t.tm_year -= 1900;
+    t.tm_mon -= 1;
+    res = timegm(&t);
+    return true;
+}
+
+int channel_id(const std::string& channel)
+{
+    for (int id = MSG_SEVIRI_1_5_VIS_0_6; id <= MSG_SEVIRI_1_5_HRV; ++id)
+        if (channel == facts::channelName(56, id))
+            return id;
+    throw std::runtime_error(channel + " is not a SEVIRI channel");
+}
+
+/**
+ * Terms of the synthetic field that depend only on a column or only on a
+ * line, so that they can be computed once per image row and column
+ */
+struct Axis
+{
+    /// Cosine and sine of the scan angle
+    double cos_a, sin_a;
+    /// Waves along the axis
+    double wave, wave_sin, wave_cos;
+
+    Axis(unsigned pos, unsigned size, double cfac, double freq)
+    {
+        double offset = pos - (size + 1) / 2.0;
+        double angle = offset * 65536.0 / fabs(cfac) * M_PI / 180.0;
+        cos_a = cos(angle);
+        sin_a = sin(angle);
+        // Position normalised to -1..1, so that HRV and the other channels
+        // show the same features in the same places
+        double t = offset / (size / 2.0);
+        wave = sin(freq * t);
+        wave_sin = sin(freq / 5 * t);
+        wave_cos = cos(freq / 5 * t);
+    }
+};
+
+uint32_t hash(uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t h = a * 0x9e3779b1u ^ b * 0x85ebca77u ^ c * 0xc2b2ae3du;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+/// 10 bit count for a pixel, or 0 if the pixel sees space
+uint16_t field(int channel, unsigned column, unsigned line, const Axis& x, const Axis& y)
+{
+    // Line of sight intersection with the Earth, as in the geolocation
+    // formulas of the LRIT/HRIT Global Specification
+    double a = 42164.0 * x.cos_a * y.cos_a;
+    double sd = a * a - (y.cos_a * y.cos_a + 1.006739501 * y.sin_a * y.sin_a) * 1737122264.0;
+    if (sd < 0) return 0;
+
+    double noise = (hash(channel, column, line) & 0xffff) / 32768.0 - 1.0;
+    double value = 0.45 + 0.02 * channel
+                 + 0.3 * x.wave * y.wave
+                 + 0.15 * (x.wave_sin * y.wave_cos + x.wave_cos * y.wave_sin)
+                 + 0.04 * noise;
+    return max(1, min(1023, (int)lrint(value * 1023)));
+}
+
+/// Pack \a samples big endian, bits_per_pixel bits each
+void pack(const std::vector<uint16_t>& samples, uint8_t* out)
+{
+    uint32_t acc = 0;
+    unsigned bits = 0;
+    for (uint16_t s: samples)
+    {
+        acc = (acc << bits_per_pixel) | s;
+        bits += bits_per_pixel;
+        while (bits >= 8)
+        {
+            bits -= 8;
+            *out++ = acc >> bits;
+        }
+    }
+    if (bits)
+        *out = acc << (8 - bits);
+}
+
+void write_file(const std::string& pathname, const Buffer& header, const Buffer& data)
+{
+    sys::File out(pathname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    out.write_all_or_throw(header.data);
+    out.write_all_or_throw(data.data);
+    out.close();
+}
+
+}
+
+std::vector<std::string> SyntheticCycle::all_channels()
+{
+    std::vector<std::string> res;
+    for (int id = MSG_SEVIRI_1_5_VIS_0_6; id <= MSG_SEVIRI_1_5_HRV; ++id)
+        res.push_back(facts::channelName(56, id));
+    return res;
+}
+
+void SyntheticCycle::validate() const
+{
+    int id = facts::spacecraftID(spacecraft);
+    if (id != 55 && id != 56 && id != 57 && id != 70)
+        throw std::runtime_error(spacecraft + " is not one of MSG1, MSG2, MSG3 or MSG4");
+    time_t t;
+    if (!parse_timing(timing, t))
+        throw std::runtime_error(timing + " is not a valid time in the form YYYYMMDDhhmm");
+    for (const auto& c: channels)
+        channel_id(c);
+    for (const auto& m: missing)
+    {
+        if (find(channels.begin(), channels.end(), m.first) == channels.end())
+            throw std::runtime_error("missing segments are given for " + m.first + ", which is not written");
+        for (unsigned s: m.second)
+            if (s < 1 || s > segment_count(m.first))
+                throw std::runtime_error(m.first + " has no segment " + to_string(s));
+    }
+    if (hrv_lower_north_line < 1 || hrv_lower_north_line > hrv_size)
+        throw std::runtime_error("the lower HRV window must end between line 1 and " + to_string(hrv_size));
+    if (hrv_lower_west_column < hrv_columns || hrv_lower_west_column > hrv_size
+     || hrv_upper_west_column < hrv_columns || hrv_upper_west_column > hrv_size)
+        throw std::runtime_error("HRV windows must end between column " + to_string(hrv_columns) + " and " + to_string(hrv_size));
+}
+
+std::string SyntheticCycle::name(const std::string& channel) const
+{
+    return directory + "/H:" + spacecraft + ":" + channel + ":" + timing;
+}
+
+/// File name of a part of a repeat cycle, which is also its annotation
+static std::string file_name(const std::string& spacecraft, const std::string& channel,
+        const std::string& segment, const std::string& timing, const char* flags)
+{
+    return "H-000-" + underscoreit(spacecraft, 6) + "-" + underscoreit(spacecraft, 12)
+         + "-" + underscoreit(channel, 9) + "-" + underscoreit(segment, 9) + "-" + timing + "-" + flags;
+}
+
+std::string SyntheticCycle::prologue_file() const
+{
+    return directory + "/" + file_name(spacecraft, "", "PRO", timing, "__");
+}
+
+std::string SyntheticCycle::epilogue_file() const
+{
+    return directory + "/" + file_name(spacecraft, "", "EPI", timing, "__");
+}
+
+std::string SyntheticCycle::segment_file(const std::string& channel, unsigned segment) const
+{
+    char seg[7];
+    snprintf(seg, 7, "%06u", segment);
+    return directory + "/" + file_name(spacecraft, channel, seg, timing, "C_");
+}
+
+unsigned SyntheticCycle::segment_count(const std::string& channel)
+{
+    return (channel == "HRV" ? hrv_size : visir_size) / seg_lines;
+}
+
+uint16_t SyntheticCycle::sample(const std::string& channel, unsigned column, unsigned line) const
+{
+    if (channel == "HRV")
+        return field(MSG_SEVIRI_1_5_HRV, column, line,
+                Axis(column, hrv_size, hrv_cfac, 45), Axis(line, hrv_size, hrv_cfac, 28));
+    else
+        return field(channel_id(channel), column, line,
+                Axis(column, visir_size, visir_cfac, 45), Axis(line, visir_size, visir_cfac, 28));
+}
+
+/// Common prologue and epilogue headers
+static Buffer service_header(const std::string& annotation, t_enum_MSG_filetype type, time_t t, size_t data_len)
+{
+    Buffer res;
+    res.add_record(MSG_HEADER_PRIMARY, [&](size_t pos) {
+        res.put_ui1(pos + 3, type);
+        res.put_ui8(pos + 8, data_len * 8);
+    });
+    res.add_record(MSG_HEADER_ANNOTATION, [&](size_t pos) {
+        res.put_string(pos + 3, annotation);
+    });
+    res.add_record(MSG_HEADER_TIMESTAMP, [&](size_t pos) {
+        res.put_ui1(pos + 3, 0x40);
+        res.put_cds(pos + 4, t);
+    });
+    res.put_uint(4, res.data.size(), 4);
+    return res;
+}
+
+void SyntheticCycle::write_prologue() const
+{
+    time_t t;
+    parse_timing(timing, t);
+    Buffer data(pro_len);
+
+    // Satellite definition
+    data.put_ui2(0, facts::spacecraftIDToHRIT(facts::spacecraftID(spacecraft)));
+    data.put_r4(2, longitude);
+    data.put_ui1(6, 1);
+
+    // Planned repeat cycle start, forward scan end and repeat cycle end
+    data.put_cds(pro_image_acquisition, t);
+    data.put_cds(pro_image_acquisition + 10, t + 12 * 60);
+    data.put_cds(pro_image_acquisition + 20, t + 15 * 60);
+
+    // Projection, reference grids and planned coverage
+    size_t pos = pro_image_description;
+    data.put_ui1(pos, 1);
+    data.put_r4(pos + 1, longitude);
+    data.put_i4(pos + 5, visir_size);
+    data.put_i4(pos + 9, visir_size);
+    data.put_r4(pos + 13, 3.0004032);
+    data.put_r4(pos + 17, 3.0004032);
+    data.put_ui1(pos + 21, 2);
+    data.put_i4(pos + 22, hrv_size);
+    data.put_i4(pos + 26, hrv_size);
+    data.put_r4(pos + 30, 1.0001343);
+    data.put_r4(pos + 34, 1.0001343);
+    data.put_ui1(pos + 38, 2);
+    data.put_i4(pos + 39, 1);
+    data.put_i4(pos + 43, visir_size);
+    data.put_i4(pos + 47, 1);
+    data.put_i4(pos + 51, visir_size);
+    data.put_i4(pos + 55, 1);
+    data.put_i4(pos + 59, hrv_lower_north_line);
+    data.put_i4(pos + 63, hrv_lower_west_column - hrv_columns + 1);
+    data.put_i4(pos + 67, hrv_lower_west_column);
+    if (hrv_lower_north_line < hrv_size)
+    {
+        data.put_i4(pos + 71, hrv_lower_north_line + 1);
+        data.put_i4(pos + 75, hrv_size);
+        data.put_i4(pos + 79, hrv_upper_west_column - hrv_columns + 1);
+        data.put_i4(pos + 83, hrv_upper_west_column);
+    }
+    data.put_ui1(pos + 87, 1);
+    for (const auto& c: channels)
+        data.put_ui1(pos + 88 + channel_id(c), 1);
+
+    // Calibration
+    for (unsigned i = 0; i < 12; ++i)
+    {
+        data.put_r8(pro_radiometric_proc + 72 + i * 16, calibration[i][0]);
+        data.put_r8(pro_radiometric_proc + 80 + i * 16, calibration[i][1]);
+    }
+
+    write_file(prologue_file(), service_header(file_name(spacecraft, "", "PRO", timing, "__"),
+                MSG_FILE_REPEAT_CYCLE_PROLOGUE, t, pro_len), data);
+}
+
+void SyntheticCycle::write_epilogue() const
+{
+    time_t t;
+    parse_timing(timing, t);
+    Buffer data(epi_len);
+
+    size_t pos = epi_product_stats;
+    data.put_ui2(pos, facts::spacecraftIDToHRIT(facts::spacecraftID(spacecraft)));
+
+    // Actual coverage
+    pos += MSG_IMAGE_PRODUCT_STATS_LEN - 48;
+    data.put_i4(pos, 1);
+    data.put_i4(pos + 4, visir_size);
+    data.put_i4(pos + 8, 1);
+    data.put_i4(pos + 12, visir_size);
+    data.put_i4(pos + 16, 1);
+    data.put_i4(pos + 20, hrv_lower_north_line);
+    data.put_i4(pos + 24, hrv_lower_west_column - hrv_columns + 1);
+    data.put_i4(pos + 28, hrv_lower_west_column);
+    if (hrv_lower_north_line < hrv_size)
+    {
+        data.put_i4(pos + 32, hrv_lower_north_line + 1);
+        data.put_i4(pos + 36, hrv_size);
+        data.put_i4(pos + 40, hrv_upper_west_column - hrv_columns + 1);
+        data.put_i4(pos + 44, hrv_upper_west_column);
+    }
+
+    write_file(epilogue_file(), service_header(file_name(spacecraft, "", "EPI", timing, "__"),
+                MSG_FILE_REPEAT_CYCLE_EPILOGUE, t, epi_len), data);
+}
+
+void SyntheticCycle::write_segment(const std::string& channel, unsigned segment) const
+{
+    time_t t;
+    parse_timing(timing, t);
+    int id = channel_id(channel);
+    bool hrv = id == MSG_SEVIRI_1_5_HRV;
+    unsigned size = hrv ? hrv_size : visir_size;
+    unsigned columns = hrv ? hrv_columns : visir_size;
+    int cfac = hrv ? hrv_cfac : visir_cfac;
+    unsigned first_line = (segment - 1) * seg_lines + 1;
+
+    // East column of the window of each line
+    std::vector<unsigned> east(seg_lines, 1);
+    if (hrv)
+        for (unsigned i = 0; i < seg_lines; ++i)
+            east[i] = (first_line + i <= hrv_lower_north_line ? hrv_lower_west_column : hrv_upper_west_column) - hrv_columns + 1;
+
+    char buf[33];
+    snprintf(buf, 7, "%06u", segment);
+    string annotation = file_name(spacecraft, channel, buf, timing, "C_");
+    snprintf(buf, 33, "GEOS(%+06.1f)", longitude);
+    string projection = buf;
+    projection.resize(32, ' ');
+
+    Buffer header;
+    header.add_record(MSG_HEADER_PRIMARY, [&](size_t pos) {
+        header.put_ui1(pos + 3, MSG_FILE_IMAGE_DATA);
+        header.put_ui8(pos + 8, (uint64_t)columns * seg_lines * bits_per_pixel);
+    });
+    header.add_record(MSG_HEADER_IMAGE_STRUCTURE, [&](size_t pos) {
+        header.put_ui1(pos + 3, bits_per_pixel);
+        header.put_ui2(pos + 4, columns);
+        header.put_ui2(pos + 6, seg_lines);
+        header.put_ui1(pos + 8, MSG_NO_COMPRESSION);
+    });
+    header.add_record(MSG_HEADER_IMAGE_NAVIGATION, [&](size_t pos) {
+        header.put_string(pos + 3, projection);
+        header.put_i4(pos + 35, cfac);
+        header.put_i4(pos + 39, cfac);
+        header.put_i4(pos + 43, (int)(size / 2) - (int)east[0] + 1);
+        header.put_i4(pos + 47, (int)(size / 2) - (int)first_line + 1);
+    });
+    header.add_record(MSG_HEADER_ANNOTATION, [&](size_t pos) {
+        header.put_string(pos + 3, annotation);
+    });
+    header.add_record(MSG_HEADER_TIMESTAMP, [&](size_t pos) {
+        header.put_ui1(pos + 3, 0x40);
+        header.put_cds(pos + 4, t);
+    });
+    header.add_record(MSG_HEADER_SEGMENT_IDENTIFICATION, [&](size_t pos) {
+        header.put_ui2(pos + 3, facts::spacecraftIDToHRIT(facts::spacecraftID(spacecraft)));
+        header.put_ui1(pos + 5, id);
+        header.put_ui2(pos + 6, segment);
+        header.put_ui2(pos + 8, 1);
+        header.put_ui2(pos + 10, segment_count(channel));
+        header.put_ui1(pos + 12, MSG_NO_FORMAT);
+    });
+    header.add_record(MSG_HEADER_IMAGE_SEGMENT_LINE_QUALITY, [&](size_t pos) {
+        for (unsigned i = 0; i < seg_lines; ++i)
+        {
+            size_t rec = pos + 3 + i * MSG_SEGMENT_QUALITY_RECORD_LEN;
+            header.put_i4(rec, first_line + i);
+            // Lines are scanned from south to north in 12 minutes
+            header.put_cds(rec + 4, t, (uint64_t)(first_line + i) * 720000 / size);
+            header.put_ui1(rec + 10, 1);
+            header.put_ui1(rec + 11, 1);
+            header.put_ui1(rec + 12, 1);
+        }
+    });
+    header.put_uint(4, header.data.size(), 4);
+
+    // Image data, from south to north and from east to west
+    std::vector<Axis> xs;
+    unsigned min_east = *min_element(east.begin(), east.end());
+    unsigned max_east = *max_element(east.begin(), east.end());
+    for (unsigned c = min_east; c < max_east + columns; ++c)
+        xs.emplace_back(c, size, cfac, 45);
+
+    size_t line_bytes = columns * bits_per_pixel / 8;
+    Buffer data(line_bytes * seg_lines);
+    std::vector<uint16_t> samples(columns);
+    for (unsigned i = 0; i < seg_lines; ++i)
+    {
+        unsigned line = first_line + i;
+        Axis y(line, size, cfac, 28);
+        for (unsigned x = 0; x < columns; ++x)
+        {
+            unsigned column = east[i] + x;
+            samples[x] = field(id, column, line, xs[column - min_east], y);
+        }
+        pack(samples, data.data.data() + i * line_bytes);
+    }
+
+    write_file(segment_file(channel, segment), header, data);
+}
+
+void SyntheticCycle::write() const
+{
+    validate();
+    std::filesystem::create_directories(directory);
+    write_prologue();
+    for (const auto& channel: channels)
+    {
+        auto m = missing.find(channel);
+        for (unsigned s = 1; s <= segment_count(channel); ++s)
+        {
+            if (m != missing.end() && m->second.find(s) != m->second.end())
+                continue;
+            write_segment(channel, s);
+        }
+    }
+    write_epilogue();
+}
+
+}
+}
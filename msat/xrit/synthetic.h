@@ -0,0 +1,117 @@
+#ifndef MSAT_XRIT_SYNTHETIC_H
+#define MSAT_XRIT_SYNTHETIC_H
+
+/*
+ * xrit/synthetic - Write synthetic xRIT repeat cycles
+ *
+ * Copyright (C) 2026  ARPAE-SIMC <urpsim@arpae.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <stdint.h>
+
+namespace msat {
+namespace xrit {
+
+/**
+ * Writer of full size SEVIRI xRIT repeat cycles with synthetic image data.
+ *
+ * Prologue, epilogue and segment headers are laid out as in disseminated
+ * data, with the fields that meteosatlib uses filled in; image segments are
+ * written uncompressed, with 10 bit samples.
+ *
+ * Samples are a smooth field with some noise over the Earth disk, and 0 over
+ * space. They only depend on the channel and the position of the pixel, so
+ * that the same image can be written in any order or in parts.
+ */
+struct SyntheticCycle
+{
+    /// Directory where the files are written
+    std::string directory = ".";
+
+    /// Satellite, from MSG1 to MSG4
+    std::string spacecraft = "MSG2";
+
+    /// Repeat cycle start, as YYYYMMDDhhmm
+    std::string timing = "201001191200";
+
+    /// Subsatellite longitude
+    double longitude = 0.0;
+
+    /// Channels to write, by their xRIT name, like IR_108 or HRV
+    std::vector<std::string> channels;
+
+    /// Segments not to write, by channel name
+    std::map<std::string, std::set<unsigned>> missing;
+
+    /**
+     * HRV coverage, as lines and columns of the HRV reference grid.
+     *
+     * HRV images are made of a lower window, from line 1 to
+     * hrv_lower_north_line, and an upper window above it. Each window is
+     * 5568 columns wide, ending at its west column.
+     */
+    unsigned hrv_lower_north_line = 8192;
+    unsigned hrv_lower_west_column = 5568;
+    unsigned hrv_upper_west_column = 7452;
+
+    /// All SEVIRI channel names, HRV included
+    static std::vector<std::string> all_channels();
+
+    /// Raise an exception if the settings cannot be written
+    void validate() const;
+
+    /// Shortened name of a channel, as accepted by FileAccess
+    std::string name(const std::string& channel) const;
+
+    /// Pathname of the prologue file
+    std::string prologue_file() const;
+
+    /// Pathname of the epilogue file
+    std::string epilogue_file() const;
+
+    /// Pathname of segment \a segment (starting from 1) of \a channel
+    std::string segment_file(const std::string& channel, unsigned segment) const;
+
+    /// Number of segments of a channel
+    static unsigned segment_count(const std::string& channel);
+
+    /**
+     * Sample of \a channel at \a column and \a line of the reference grid,
+     * numbered from 1 starting from the south-east corner as in xRIT
+     * headers.
+     */
+    uint16_t sample(const std::string& channel, unsigned column, unsigned line) const;
+
+    void write_prologue() const;
+    void write_epilogue() const;
+    void write_segment(const std::string& channel, unsigned segment) const;
+
+    /**
+     * Write prologue, epilogue and all the segments of all the channels,
+     * except the missing ones
+     */
+    void write() const;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,110 @@
+#include "utils.h"
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_composite");
+
+/// Write a recipe file
+void write_recipe(const std::string& pathname, const char* contents)
+{
+    FILE* out = fopen(pathname.c_str(), "wt");
+    if (!out) throw std::runtime_error("cannot create " + pathname);
+    fputs(contents, out);
+    fclose(out);
+}
+
+/// Read the physical value of a pixel
+double read_value(GDALRasterBand* rb, int x, int y)
+{
+    double val;
+    if (rb->RasterIO(GF_Read, x, y, 1, 1, &val, 1, 1, GDT_Float64, 0, 0) != CE_None)
+        throw std::runtime_error("cannot read pixel");
+    return val * rb->GetScale() + rb->GetOffset();
+}
+
+/// Render a value as the composite does
+unsigned stretch(double val, double min, double max, double gamma=1)
+{
+    double t = (val - min) / (max - min);
+    if (!(t > 0)) return 0;
+    if (t >= 1) return 255;
+    return lround(pow(t, 1.0 / gamma) * 255);
+}
+
+void Tests::register_tests()
+{
+
+add_method("rgb", []{
+    TempTestFile recipe("test-composite.rgb");
+    write_recipe(recipe.name(),
+            "# Test composite\n"
+            "\n"
+            "red   IR_039r 0 50\n"
+            "green IR_108 200 300 2\n"
+            "blue  IR_134 300 200\n");
+
+    unique_ptr<GDALDataset> ds = gdal::open_ro("MSATCOMPOSITE:" + recipe.name() + ":H:MSG2:IR_108:201001191200");
+    wassert(actual(string(GDALGetDriverShortName(ds->GetDriver()))) == "MsatComposite");
+    wassert(actual(ds->GetRasterCount()) == 3);
+    wassert(actual(ds->GetRasterXSize()) == 3712);
+    wassert(actual(ds->GetRasterYSize()) == 3712);
+
+    static const GDALColorInterp interps[] = { GCI_RedBand, GCI_GreenBand, GCI_BlueBand };
+    for (int i = 0; i < 3; ++i)
+    {
+        GDALRasterBand* rb = ds->GetRasterBand(i + 1);
+        wassert(actual(rb->GetRasterDataType()) == GDT_Byte);
+        wassert(actual(rb->GetColorInterpretation()) == interps[i]);
+    }
+    wassert(actual(ds->GetRasterBand(1)->GetDescription()) == "IR_039r");
+
+    // Space is black
+    uint8_t pixel[3];
+    wassert(actual(ds->RasterIO(GF_Read, 0, 0, 1, 1, pixel, 1, 1, GDT_Byte, 3, nullptr, 3, 0, 1)) == CE_None);
+    wassert(actual((unsigned)pixel[0]) == 0u);
+    wassert(actual((unsigned)pixel[1]) == 0u);
+    wassert(actual((unsigned)pixel[2]) == 0u);
+
+    // Earth pixels match the stretched values of the channels
+    wassert(actual(ds->RasterIO(GF_Read, 2000, 350, 1, 1, pixel, 1, 1, GDT_Byte, 3, nullptr, 3, 0, 1)) == CE_None);
+
+    unique_ptr<GDALDataset> r = gdal::open_ro("H:MSG2:IR_039r:201001191200");
+    unique_ptr<GDALDataset> g = gdal::open_ro("H:MSG2:IR_108:201001191200");
+    unique_ptr<GDALDataset> b = gdal::open_ro("H:MSG2:IR_134:201001191200");
+    wassert(actual((unsigned)pixel[0]) == stretch(read_value(r->GetRasterBand(1), 2000, 350), 0, 50));
+    wassert(actual((unsigned)pixel[1]) == stretch(read_value(g->GetRasterBand(1), 2000, 350), 200, 300, 2));
+    wassert(actual((unsigned)pixel[2]) == stretch(read_value(b->GetRasterBand(1), 2000, 350), 300, 200));
+
+    // Reading a full line fills all three bands
+    std::vector<uint8_t> line(3712 * 3);
+    wassert(actual(ds->RasterIO(GF_Read, 0, 350, 3712, 1, line.data(), 3712, 1, GDT_Byte, 3, nullptr, 3, 3712 * 3, 1)) == CE_None);
+    wassert(actual((unsigned)line[2000 * 3 + 1]) == (unsigned)pixel[1]);
+});
+
+add_method("bad_recipe", []{
+    TempTestFile recipe("test-composite-bad.rgb");
+    write_recipe(recipe.name(), "red IR_108 200 300\ngreen IR_108 200 300\n");
+
+    bool failed = false;
+    try {
+        unique_ptr<GDALDataset> ds = gdal::open_ro("MSATCOMPOSITE:" + recipe.name() + ":H:MSG2:IR_108:201001191200");
+    } catch (std::exception& e) {
+        failed = true;
+    }
+    wassert(actual(failed).istrue());
+});
+
+}
+
+}
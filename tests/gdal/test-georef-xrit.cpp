@@ -126,6 +126,51 @@ add_method("known2", [](Fixture& f) {
 #endif
 });
 
+// Test the extent of the Earth disk
+add_method("earth_disk", [](Fixture& f) {
+    msat::dataset::EarthDisk disk;
+    disk.init(f.dataset());
+    wassert(actual(disk.width) == 3712);
+    wassert(actual(disk.starts.size()) == 3712u);
+
+    // The first and last lines are all in space
+    wassert(actual(disk.starts[0]) == disk.ends[0]);
+    wassert(actual(disk.starts[3711]) == disk.ends[3711]);
+
+    wassert(actual(disk.starts[1856]) == 45);
+    wassert(actual(disk.ends[1856]) == 3668);
+    wassert(actual(disk.starts[3400]) == 916);
+    wassert(actual(disk.ends[3400]) == 2797);
+
+    wassert(actual(disk.is_earth(1856, 1856)).istrue());
+    wassert(actual(disk.is_earth(500, 3400)).isfalse());
+    wassert(actual(disk.is_space(0, 0, 3712, 10)).istrue());
+    wassert(actual(disk.is_space(0, 1800, 100, 100)).isfalse());
+});
+
+// Test the Earth disk mask band
+add_method("earth_mask", [](Fixture& f) {
+    GDALRasterBand* rb = f.dataset()->GetRasterBand(1);
+    wassert(actual(rb->GetMaskFlags()) == GMF_NODATA);
+
+    GDALRasterBand* mask = rb->GetMaskBand();
+    wassert(actual(rb->GetMaskBand() == mask).istrue());
+    wassert(actual(mask->GetDataset() == f.dataset()).istrue());
+    wassert(actual(mask->GetRasterDataType()) == GDT_Byte);
+    wassert(actual(mask->GetXSize()) == 3712);
+    wassert(actual(mask->GetYSize()) == 3712);
+    wassert(actual(gdal::read_int32(mask, 0, 0)) == 0);
+    wassert(actual(gdal::read_int32(mask, 44, 1856)) == 0);
+    wassert(actual(gdal::read_int32(mask, 45, 1856)) == 255);
+    wassert(actual(gdal::read_int32(mask, 1856, 1856)) == 255);
+    wassert(actual(gdal::read_int32(mask, 500, 3400)) == 0);
+
+    // The Earth disk is computed once per grid
+    auto disk = msat::dataset::earth_disk(f.dataset());
+    wassert(actual(msat::dataset::earth_disk(f.dataset()) == disk).istrue());
+    wassert(actual(msat::dataset::earth_disk_mask(rb) == disk).istrue());
+});
+
 }
 
 }
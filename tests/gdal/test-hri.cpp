@@ -0,0 +1,201 @@
+#include "utils.h"
+#include <config.h>
+#include <msat/facts.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <unistd.h>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+#ifdef HAVE_HRI
+const size_t frame_size = 364;
+/// B and X format files have 4 header frames, and 4 frames per data line
+const size_t bx_header_size = 4 * frame_size;
+const size_t bx_record_size = 4 * frame_size;
+
+/**
+ * Write a B or X format HRI file with \a records data lines.
+ *
+ * Pixel values are a function of their position in the file.
+ */
+string write_hri(const std::string& pathname, int format, int ir, int vis, int satellite, size_t records)
+{
+    string buf(bx_header_size + records * bx_record_size, 0);
+    for (size_t i = bx_header_size; i < buf.size(); ++i)
+        buf[i] = (i * 31 + i / 1000) & 0xff;
+    for (size_t pos = 0; pos < buf.size(); pos += frame_size)
+    {
+        // Sync marker and frame id
+        buf[pos] = 0x05;
+        buf[pos + 1] = 0x0c;
+        buf[pos + 2] = 0xdf;
+        buf[pos + 3] = 48;
+    }
+    // Label subframe
+    buf[4 + 12] = format;
+    buf[4 + 13] = vis;
+    buf[4 + 15] = ir;
+    // Identification subframe: satellite, year 2005, day 117, 12:30
+    if (satellite)
+    {
+        buf[36] = 212;
+        buf[37] = 240 + satellite;
+    } else {
+        // GOES-W
+        buf[36] = 0;
+        buf[37] = 1;
+    }
+    buf[38] = 0x07; buf[39] = 0xd5;
+    buf[40] = 0; buf[41] = 117;
+    buf[42] = 0x04; buf[43] = 0xce;
+
+    ofstream out(pathname, ios::binary);
+    out << buf;
+    return buf;
+}
+
+/// Pixel \a x of data line \a record, of 1250 pixels split across 4 frames
+unsigned char bx_pixel(const string& buf, size_t record, int x)
+{
+    static const int chunks[][2] = { { 36, 328 }, { 368, 360 }, { 732, 360 }, { 1096, 202 } };
+    size_t pos = bx_header_size + record * bx_record_size;
+    for (const auto& c: chunks)
+    {
+        if (x < c[1]) return buf[pos + c[0] + x];
+        x -= c[1];
+    }
+    return 0;
+}
+
+/**
+ * Pixel of the VIS image of a BIV file, where each IR line is followed by
+ * the halves of two VIS lines, and the second half line overlaps the first
+ * by 2 pixels
+ */
+unsigned char biv_vis_pixel(const string& buf, int x, int y)
+{
+    size_t record = (y / 2) * 5 + 1 + (y % 2) * 2;
+    if (x < 1248) return bx_pixel(buf, record, x);
+    if (x < 2498) return bx_pixel(buf, record + 1, x - 1248);
+    return 0;
+}
+#endif
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_hri");
+
+void Tests::register_tests()
+{
+
+#ifdef HAVE_HRI
+add_method("biv", []{
+    TempTestFile tf("test-hri-biv.hri");
+    string buf = write_hri(tf.name(), 255, 1, 240, 7, 625 * 5);
+
+    // The IR and VIS images have different sizes: the first is the default
+    unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+    wassert(actual(ds.get() != nullptr).istrue());
+    wassert(actual(GDALGetDriverShortName(ds->GetDriver())) == "MsatHRI");
+    wassert(actual(ds->GetRasterXSize()) == 1250);
+    wassert(actual(ds->GetRasterYSize()) == 625);
+    wassert(actual(ds->GetRasterCount()) == 1);
+    wassert(actual(ds->GetRasterBand(1)->GetDescription()) == "IR");
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == "2005-04-27 12:30:00");
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_SPACECRAFT, MD_DOMAIN_MSAT)) == "METEOSAT-7");
+
+    double gt[6];
+    wassert(actual(ds->GetGeoTransform(gt)) == CE_None);
+    double ps = msat::facts::pixelHSizeFromCFAC(18204444 * exp2(-16));
+    wassert(actual(gt[0]).almost_equal(-1248 * ps, 3));
+    wassert(actual(gt[1]).almost_equal(2 * ps, 3));
+    wassert(actual(gt[3]).almost_equal(-1118 * ps, 3));
+
+    const char* vis_name = ds->GetMetadataItem("SUBDATASET_2_NAME", "SUBDATASETS");
+    wassert(actual(vis_name) == "MSATHRI:1:" + tf.name());
+
+    unique_ptr<GDALDataset> vis = gdal::open_ro(vis_name);
+    wassert(actual(vis->GetRasterXSize()) == 2500);
+    wassert(actual(vis->GetRasterYSize()) == 1250);
+    wassert(actual(vis->GetGeoTransform(gt)) == CE_None);
+    wassert(actual(gt[1]).almost_equal(ps, 3));
+
+    GDALRasterBand* rb = vis->GetRasterBand(1);
+    wassert(actual(rb->GetDescription()) == "VIS");
+    wassert(actual(rb->GetRasterDataType()) == GDT_Float32);
+    wassert(actual(rb->GetUnitType()) == "%");
+    for (int y: { 0, 1, 2, 555, 1249 })
+        for (int x: { 0, 1247, 1248, 1249, 1250, 2497, 2498, 2499 })
+            wassert(actual((double)gdal::read_float32(rb, x, y)).almost_equal(100.0 * biv_vis_pixel(buf, x, y) / 255.0, 3));
+});
+
+add_method("xi", []{
+    TempTestFile tf("test-hri-xi.hri");
+    string buf = write_hri(tf.name(), 15, 1, 0, 0, 1250);
+
+    unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+    wassert(actual(ds.get() != nullptr).istrue());
+    wassert(actual(ds->GetRasterXSize()) == 1250);
+    wassert(actual(ds->GetRasterYSize()) == 1250);
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_SPACECRAFT, MD_DOMAIN_MSAT)) == "GOES-W");
+    wassert(actual(ds->GetMetadataItem("SUBDATASET_1_NAME", "SUBDATASETS")) == (const char*)nullptr);
+
+    // GOES-W IR is calibrated with a linear table
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    wassert(actual(rb->GetUnitType()) == "K");
+    vector<float> win(20 * 3);
+    wassert(actual(rb->RasterIO(GF_Read, 320, 700, 20, 3, win.data(), 20, 3, GDT_Float32, 0, 0)) == CE_None);
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 20; ++x)
+        {
+            double expected = (bx_pixel(buf, 700 + y, 320 + x) / 255.0) * (318.1 - 159.1) + 159.1;
+            wassert(actual((double)win[y * 20 + x]).almost_equal(expected, 2));
+        }
+});
+
+add_method("truncated", []{
+    TempTestFile tf("test-hri-xi.hri");
+    string buf = write_hri(tf.name(), 15, 1, 0, 0, 1250);
+    wassert(actual(truncate(tf.name().c_str(), bx_header_size + 600 * bx_record_size + 100)) == 0);
+
+    // Lines missing from the file are nodata
+    unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+    wassert(actual(ds->GetRasterYSize()) == 1250);
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    wassert(actual((double)gdal::read_float32(rb, 10, 599)).almost_equal((bx_pixel(buf, 599, 10) / 255.0) * (318.1 - 159.1) + 159.1, 2));
+    wassert(actual(gdal::read_float32(rb, 10, 600)) == 0);
+});
+
+add_method("sync_error", []{
+    TempTestFile tf("test-hri-xi.hri");
+    string buf = write_hri(tf.name(), 15, 1, 0, 0, 1250);
+    // Break the sync marker of a frame in the middle of a data line
+    size_t pos = bx_header_size + 600 * bx_record_size + 2 * frame_size;
+    buf[pos] = buf[pos + 1] = buf[pos + 2] = 0;
+    {
+        ofstream out(tf.name(), ios::binary);
+        out << buf;
+    }
+
+    bool failed = false;
+    try {
+        unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+        failed = !ds;
+    } catch (std::exception&) {
+        failed = true;
+    }
+    wassert(actual(failed).istrue());
+});
+#endif
+
+}
+
+}
@@ -1,5 +1,7 @@
 #include "utils.h"
 #include "msat/facts.h"
+#include <fstream>
+#include <sys/stat.h>
 
 using namespace std;
 using namespace msat::tests;
@@ -151,6 +153,15 @@ void Fixture::check_cropped_image_data(GDALDataset* dataset)
     wassert(actual((double)gdal::read_float32(b, 10, 10)).almost_equal(97.8f, 3));
 }
 
+/// Write a GRIB file with two copies of the test message
+void write_twice(const std::string& pathname)
+{
+    std::ifstream in(TESTFILE, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream out(pathname, std::ios::binary);
+    out << data << data;
+}
+
 void Tests::register_tests()
 {
     ImportTest::register_tests();
@@ -163,6 +174,126 @@ void Tests::register_tests()
         wassert(actual(b->GetOffset()).almost_equal(0, 4));
         wassert(actual(b->GetScale()).almost_equal(1, 4));
     });
+
+    this->add_method("multi_message", [](Fixture& f) {
+        // Two copies of the same message become two bands of the same image
+        TempTestFile tf;
+        write_twice(tf.name());
+
+        unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+        wassert(actual(ds->GetRasterCount()) == 2);
+        wassert(actual(ds->GetMetadata("SUBDATASETS") == nullptr).istrue());
+        GDALRasterBand* b1 = ds->GetRasterBand(1);
+        GDALRasterBand* b2 = ds->GetRasterBand(2);
+        wassert(actual(b2->GetXSize()) == b1->GetXSize());
+        wassert(actual((double)gdal::read_float32(b2, 10, 10)) == gdal::read_float32(b1, 10, 10));
+
+        // Open a single message through the subdataset syntax
+        unique_ptr<GDALDataset> sub = gdal::open_ro("MSATGRIB:1:" + tf.name());
+        wassert(actual(sub->GetRasterCount()) == 1);
+        wassert(actual((double)gdal::read_float32(sub->GetRasterBand(1), 10, 10)).almost_equal(98.1, 2));
+    });
+
+    // Test that all bands are exported, in order
+    this->add_method("recode_multiband", [](Fixture& f) {
+        TempTestFile src_file;
+        write_twice(src_file.name());
+        unique_ptr<GDALDataset> src = gdal::open_ro(src_file.name());
+
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("MsatGRIB");
+        TempTestFile tf;
+        const char* options[] = { "NUM_THREADS=2", nullptr };
+        unsigned calls = 0;
+        unique_ptr<GDALDataset> ds(driver->CreateCopy(tf.name().c_str(), src.get(), TRUE, (char**)options,
+            [](double complete, const char*, void* arg) -> int {
+                ++*(unsigned*)arg;
+                return TRUE;
+            }, &calls));
+        wassert(actual(ds.get() != nullptr).istrue());
+        wassert(actual(calls) == 2u);
+        wassert(actual(ds->GetRasterCount()) == 2);
+        for (int i = 1; i <= 2; ++i)
+        {
+            GDALRasterBand* b = ds->GetRasterBand(i);
+            wassert(actual(gdal::read_float32(b, 10, 10)) == gdal::read_float32(src->GetRasterBand(i), 10, 10));
+            wassert(actual(b->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT)) == src->GetRasterBand(i)->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT));
+        }
+    });
+
+    // Test choosing the packing, with bits per value from the channel precision
+    this->add_method("recode_packing", [](Fixture& f) {
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("MsatGRIB");
+        TempTestFile tf;
+        const char* options[] = { "PACKING=SIMPLE", nullptr };
+        unique_ptr<GDALDataset> ds(driver->CreateCopy(tf.name().c_str(), f.dataset(), TRUE, (char**)options, nullptr, nullptr));
+        wassert(actual(ds.get() != nullptr).istrue());
+        wassert(actual((double)gdal::read_float32(ds->GetRasterBand(1), 10, 10)).almost_equal(gdal::read_float32(f.dataset()->GetRasterBand(1), 10, 10), 2));
+    });
+
+    this->add_method("recode_packing_invalid", [](Fixture& f) {
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("MsatGRIB");
+        TempTestFile tf;
+        const char* options[] = { "PACKING=GZIP", nullptr };
+        bool failed = false;
+        try {
+            unique_ptr<GDALDataset> ds(driver->CreateCopy(tf.name().c_str(), f.dataset(), TRUE, (char**)options, nullptr, nullptr));
+            failed = !ds;
+        } catch (std::exception& e) {
+            failed = true;
+        }
+        wassert(actual(failed).istrue());
+    });
+
+    this->add_method("open_headers_only", [](Fixture& f) {
+        // Opening only reads the sections before the data, so a file with
+        // a truncated data section opens, and fails only when read
+        TempTestFile tf;
+        {
+            std::ifstream in(TESTFILE, std::ios::binary);
+            std::string data(4096, 0);
+            in.read(&data[0], data.size());
+            std::ofstream out(tf.name(), std::ios::binary);
+            out << data;
+        }
+
+        unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+        wassert(actual(ds->GetRasterXSize()) == f.dataset()->GetRasterXSize());
+        wassert(actual(ds->GetRasterYSize()) == f.dataset()->GetRasterYSize());
+        wassert(actual(ds->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == "2006-04-26 19:45:00");
+        wassert(actual(ds->GetRasterBand(1)->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT)) == "8");
+
+        bool failed = false;
+        try {
+            float val;
+            failed = ds->GetRasterBand(1)->RasterIO(GF_Read, 10, 10, 1, 1, &val, 1, 1, GDT_Float32, 0, 0) != CE_None;
+        } catch (std::exception& e) {
+            failed = true;
+        }
+        wassert(actual(failed).istrue());
+    });
+
+    this->add_method("sidecar_index", [](Fixture& f) {
+        TempTestFile tf;
+        {
+            std::ifstream in(TESTFILE, std::ios::binary);
+            std::ofstream out(tf.name(), std::ios::binary);
+            out << in.rdbuf();
+        }
+        TempTestFile idx(tf.name() + ".msatidx");
+
+        CPLSetConfigOption("MSAT_GRIB_INDEX", "YES");
+        unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+        struct stat st;
+        bool have_index = stat(idx.name().c_str(), &st) == 0;
+        // Reopen using the index
+        unique_ptr<GDALDataset> ds1 = gdal::open_ro(tf.name());
+        CPLSetConfigOption("MSAT_GRIB_INDEX", nullptr);
+
+        wassert(actual(have_index).istrue());
+        wassert(actual(ds1->GetRasterCount()) == 1);
+        wassert(actual(ds1->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == "2006-04-26 19:45:00");
+        wassert(actual((double)gdal::read_float32(ds1->GetRasterBand(1), 10, 10)).almost_equal(98.1, 2));
+    });
 }
 
 }
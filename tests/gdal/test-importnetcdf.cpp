@@ -148,6 +148,84 @@ void Tests::register_tests()
         wassert(actual(b->GetOffset()) == 0);
         wassert(actual(b->GetScale()) == 1);
     });
+
+    // Test windowed reads
+    this->add_method("read_window", [](Fixture& f) {
+        GDALRasterBand* b = f.dataset()->GetRasterBand(1);
+        int bx, by;
+        b->GetBlockSize(&bx, &by);
+        wassert(actual(bx) == f.dataset()->GetRasterXSize());
+        wassert(actual(by) == 1);
+
+        float window[20 * 10];
+        wassert(actual(b->RasterIO(GF_Read, 100, 200, 20, 10, window, 20, 10, GDT_Float32, 0, 0)) == CE_None);
+        // Reading as Float64 goes through the block cache instead
+        double lines[20 * 10];
+        wassert(actual(b->RasterIO(GF_Read, 100, 200, 20, 10, lines, 20, 10, GDT_Float64, 0, 0)) == CE_None);
+        for (int i = 0; i < 20 * 10; ++i)
+            wassert(actual((double)window[i]) == lines[i]);
+    });
+
+    // Test that exporting to NetCDF reports progress up to completion
+    this->add_method("recode_progress", [](Fixture& f) {
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("MsatNetCDF");
+        TempTestFile tf;
+        double last = -1;
+        unsigned calls = 0;
+        struct Progress { double* last; unsigned* calls; } progress { &last, &calls };
+        unique_ptr<GDALDataset> ds(driver->CreateCopy(tf.name().c_str(), f.dataset(), TRUE, nullptr,
+            [](double complete, const char*, void* arg) -> int {
+                Progress* p = (Progress*)arg;
+                *p->last = complete;
+                ++*p->calls;
+                return TRUE;
+            }, &progress));
+        wassert(actual(ds.get() != nullptr).istrue());
+        wassert(actual(calls) > 0u);
+        wassert(actual(last) == 1.0);
+        wassert(actual(gdal::read_float32(ds->GetRasterBand(1), 10, 10)) == gdal::read_float32(f.dataset()->GetRasterBand(1), 10, 10));
+    });
+
+    // Test exporting to chunked and compressed NetCDF-4
+    this->add_method("recode_deflate", [](Fixture& f) {
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("MsatNetCDF");
+        TempTestFile plain;
+        TempTestFile deflate;
+
+        unique_ptr<GDALDataset> ds(driver->CreateCopy(plain.name().c_str(), f.dataset(), TRUE, nullptr, nullptr, nullptr));
+        wassert(actual(ds.get() != nullptr).istrue());
+        ds.reset();
+
+        const char* options[] = { "COMPRESS=DEFLATE", "ZLEVEL=6", "BLOCKYSIZE=100", nullptr };
+        ds.reset(driver->CreateCopy(deflate.name().c_str(), f.dataset(), TRUE, (char**)options, nullptr, nullptr));
+        wassert(actual(ds.get() != nullptr).istrue());
+        wassert(actual(GDALGetDriverShortName(ds->GetDriver())) == "MsatNetCDF");
+        int bx, by;
+        ds->GetRasterBand(1)->GetBlockSize(&bx, &by);
+        wassert(actual(bx) == ds->GetRasterXSize());
+        wassert(actual(by) == 100);
+        wassert(actual(ds->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == f.dataset()->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT));
+        wassert(actual(gdal::read_float32(ds->GetRasterBand(1), 10, 10)) == gdal::read_float32(f.dataset()->GetRasterBand(1), 10, 10));
+
+        VSIStatBufL st_plain, st_deflate;
+        wassert(actual(VSIStatL(plain.name().c_str(), &st_plain)) == 0);
+        wassert(actual(VSIStatL(deflate.name().c_str(), &st_deflate)) == 0);
+        wassert(actual(st_deflate.st_size) < st_plain.st_size);
+    });
+
+    // Compression needs NetCDF-4
+    this->add_method("recode_deflate_classic", [](Fixture& f) {
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("MsatNetCDF");
+        TempTestFile tf;
+        const char* options[] = { "FORMAT=NC", "COMPRESS=DEFLATE", nullptr };
+        bool failed = false;
+        try {
+            unique_ptr<GDALDataset> ds(driver->CreateCopy(tf.name().c_str(), f.dataset(), TRUE, (char**)options, nullptr, nullptr));
+        } catch (std::exception& e) {
+            failed = true;
+        }
+        wassert(actual(failed).istrue());
+    });
 }
 
 }
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "msat/facts.h"
+#include <cmath>
 
 using namespace std;
 using namespace msat::tests;
@@ -222,6 +223,55 @@ void Tests::register_tests()
         wassert(actual(b->GetOffset()).almost_equal(-1.02691, 5));
         wassert(actual(b->GetScale()).almost_equal(0.0201355, 5));
     });
+
+    this->add_method("overviews", [](Fixture& f) {
+        GDALRasterBand* b = f.dataset()->GetRasterBand(1);
+        wassert(actual(b->GetOverviewCount()) == 4);
+        GDALRasterBand* o = b->GetOverview(0);
+        wassert(actual(o->GetXSize()) == 1856);
+        wassert(actual(o->GetYSize()) == 1856);
+        wassert(actual(o->GetRasterDataType()) == GDT_UInt16);
+        wassert(actual(o->GetScale()) == b->GetScale());
+        wassert(actual(b->GetOverview(3)->GetXSize()) == 232);
+
+        // Overview pixels are the average of the full resolution ones
+        uint16_t full[4];
+        wassert(actual(b->RasterIO(GF_Read, 2000, 3400, 2, 2, full, 2, 2, GDT_UInt16, 0, 0)) == CE_None);
+        uint16_t val;
+        wassert(actual(o->RasterIO(GF_Read, 1000, 1700, 1, 1, &val, 1, 1, GDT_UInt16, 0, 0)) == CE_None);
+        wassert(actual((unsigned)val) == (unsigned)lround((full[0] + full[1] + full[2] + full[3]) / 4.0));
+
+        // Space stays nodata
+        uint16_t space;
+        wassert(actual(o->RasterIO(GF_Read, 0, 0, 1, 1, &space, 1, 1, GDT_UInt16, 0, 0)) == CE_None);
+        wassert(actual((unsigned)space) == 0u);
+
+        // Downsampled reads go through the overviews
+        uint16_t small;
+        wassert(actual(b->RasterIO(GF_Read, 2000, 3400, 2, 2, &small, 1, 1, GDT_UInt16, 0, 0)) == CE_None);
+        wassert(actual((unsigned)small) == (unsigned)val);
+    });
+
+    this->add_method("stats", [](Fixture& f) {
+        unique_ptr<GDALDataset> ds = gdal::open_ro(TESTFILE);
+        CPLStringList domains(ds->GetMetadataDomainList(), TRUE);
+        wassert(actual(domains.FindString(MD_DOMAIN_MSAT_STATS)) != -1);
+
+        // Opening only reads headers, prologue and epilogue
+        wassert(actual(ds->GetMetadataItem("SEGMENTS_DECODED", MD_DOMAIN_MSAT_STATS)) == "0");
+        wassert(actual(atoll(ds->GetMetadataItem("BYTES_READ", MD_DOMAIN_MSAT_STATS)) > 0).istrue());
+
+        // Two lines of the same segment decode it once
+        GDALRasterBand* b = ds->GetRasterBand(1);
+        uint16_t val;
+        wassert(actual(b->RasterIO(GF_Read, 2000, 3400, 1, 1, &val, 1, 1, GDT_UInt16, 0, 0)) == CE_None);
+        wassert(actual(b->RasterIO(GF_Read, 2000, 3401, 1, 1, &val, 1, 1, GDT_UInt16, 0, 0)) == CE_None);
+        wassert(actual(ds->GetMetadataItem("SEGMENTS_DECODED", MD_DOMAIN_MSAT_STATS)) == "1");
+        wassert(actual(ds->GetMetadataItem("CACHE_MISSES", MD_DOMAIN_MSAT_STATS)) == "1");
+        wassert(actual(ds->GetMetadataItem("CACHE_HITS", MD_DOMAIN_MSAT_STATS)) == "1");
+        wassert(actual(CPLAtof(ds->GetMetadataItem("DECODE_TIME", MD_DOMAIN_MSAT_STATS)) > 0).istrue());
+        wassert(actual(ds->GetMetadataItem("GEOLOCATION_TIME", MD_DOMAIN_MSAT_STATS)) == "0.000000");
+    });
 }
 
 }
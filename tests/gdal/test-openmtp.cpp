@@ -0,0 +1,230 @@
+#include "utils.h"
+#include <config.h>
+#ifdef HAVE_OPENMTP
+#include <msat/openmtp/OpenMTP_binary_header.h>
+#include <msat/openmtp/OpenMTP_image.h>
+#endif
+#ifdef HAVE_OMTP_IDS
+#include <msat/omtp-ids/OpenMTP-IDS.hh>
+#endif
+#include <msat/facts.h>
+#include <fstream>
+#include <string>
+#include <cmath>
+#include <unistd.h>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+#ifdef HAVE_OPENMTP
+const int openmtp_lines = 625;
+const int openmtp_pixels = 1250;
+
+void put_int4(string& buf, size_t pos, int val)
+{
+    buf[pos] = (val >> 24) & 0xff;
+    buf[pos + 1] = (val >> 16) & 0xff;
+    buf[pos + 2] = (val >> 8) & 0xff;
+    buf[pos + 3] = val & 0xff;
+}
+
+/// Write a Meteosat 7 IR image in OpenMTP B format
+void write_openmtp(const std::string& pathname)
+{
+    string ascii(1345, ' ');
+    string binary(5175 + 2636 + 136704, 0);
+    binary.replace(32, 2, "M7");
+    put_int4(binary, 8, 2005);
+    put_int4(binary, 24, 20050427);
+    put_int4(binary, 28, 1230);
+    // IR1 channel
+    put_int4(binary, 40, 4);
+    // Calibration coefficient 0.075 and space count 5.0
+    binary.replace(44, 5, "07500");
+    binary.replace(49, 3, "050");
+    put_int4(binary, 123, 1810);
+    put_int4(binary, 131, openmtp_lines);
+    put_int4(binary, 135, openmtp_pixels);
+
+    ofstream out(pathname, ios::binary);
+    out << ascii << binary;
+    string line(32 + openmtp_pixels, 0);
+    for (int y = 0; y < openmtp_lines; ++y)
+    {
+        for (int x = 0; x < openmtp_pixels; ++x)
+            line[32 + x] = (y + x) & 0xff;
+        out << line;
+    }
+}
+#endif
+
+#ifdef HAVE_OMTP_IDS
+/// Write an OpenMTP-IDS image with IR lines of 100 pixels and WV lines of
+/// 50 pixels, followed by a filler line
+void write_omtp_ids(const std::string& pathname)
+{
+    OpenMTP_IDS img;
+    img.fileheader().no_records(3);
+    img.fileheader().record_length(200);
+    img.fileheader().year(2005);
+    img.fileheader().julian_day(117);
+    img.fileheader().hour(12);
+    img.fileheader().minute(30);
+    img.fileheader().satellite_id(omtp_ids::METEOSAT_5);
+
+    for (int r = 0; r < 2; ++r)
+    {
+        Record record;
+        record.recordheader().no_scanlines(r == 0 ? 4 : 5);
+        for (int l = 0; l < record.recordheader().no_scanlines(); ++l)
+        {
+            int y = (r * 4 + l) / 2;
+            ScanLine line;
+            int no_pixels = 0;
+            if (r * 4 + l < 8)
+            {
+                bool ir = l % 2 == 0;
+                no_pixels = ir ? 100 : 50;
+                line.lineheader().channel_id(ir ? omtp_ids::IR_1 : omtp_ids::WV_1);
+            }
+            line.lineheader().length(omtp_ids::LINEHEADER_LEN + no_pixels + 4);
+            line.lineheader().line(y + 1);
+            line.lineheader().no_pixels(no_pixels);
+            for (int x = 0; x < no_pixels; ++x)
+                line.linepixel().push_back(y * 7 + x + 1);
+            record.scanline().push_back(line);
+        }
+        img.record().push_back(record);
+    }
+    img.write(pathname.c_str());
+}
+#endif
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_openmtp");
+
+void Tests::register_tests()
+{
+
+#ifdef HAVE_OPENMTP
+add_method("openmtp", []{
+    TempTestFile tf("test-openmtp.bin");
+    write_openmtp(tf.name());
+
+    unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+    wassert(actual(ds.get() != nullptr).istrue());
+    wassert(actual(GDALGetDriverShortName(ds->GetDriver())) == "MsatOpenMTP");
+    wassert(actual(ds->GetRasterXSize()) == openmtp_pixels);
+    wassert(actual(ds->GetRasterYSize()) == openmtp_lines);
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == "2005-04-27 12:30:00");
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_SPACECRAFT, MD_DOMAIN_MSAT)) == "METEOSAT 7");
+
+    // B format images are georeferenced on the half resolution VIS grid
+    wassert(actual(ds->GetSpatialRef() != nullptr).istrue());
+    double gt[6];
+    wassert(actual(ds->GetGeoTransform(gt)) == CE_None);
+    double ps = msat::facts::pixelHSizeFromCFAC(18204444 * exp2(-16));
+    wassert(actual(gt[0]).almost_equal(-1248 * ps, 3));
+    wassert(actual(gt[1]).almost_equal(2 * ps, 3));
+    wassert(actual(gt[3]).almost_equal(-1118 * ps, 3));
+
+    // Counts are calibrated with the table of the binary header
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    wassert(actual(rb->GetRasterDataType()) == GDT_Float32);
+    wassert(actual(rb->GetDescription()) == "IR");
+    wassert(actual(rb->GetUnitType()) == "K");
+
+    OpenMTP_binary_header header;
+    {
+        ifstream in(tf.name(), ios::binary);
+        in.seekg(1345);
+        header.read(in);
+    }
+    float table[256];
+    wassert(actual(OpenMTP_image::calibration_table(header, table)).istrue());
+    wassert(actual((double)table[100]).almost_equal(251.2, 1));
+
+    for (int y: { 0, 99, openmtp_lines - 1 })
+        for (int x: { 0, 5, 50, 200, openmtp_pixels - 1 })
+            wassert(actual(gdal::read_float32(rb, x, y)) == table[(y + x) & 0xff]);
+
+    // Windowed reads only touch the requested lines
+    vector<float> win(10 * 3);
+    wassert(actual(rb->RasterIO(GF_Read, 100, 300, 10, 3, win.data(), 10, 3, GDT_Float32, 0, 0)) == CE_None);
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 10; ++x)
+            wassert(actual(win[y * 10 + x]) == table[(300 + y + 100 + x) & 0xff]);
+});
+
+add_method("openmtp_truncated", []{
+    TempTestFile tf("test-openmtp.bin");
+    write_openmtp(tf.name());
+    wassert(actual(truncate(tf.name().c_str(), 200000)) == 0);
+
+    // A truncated file is not recognised as OpenMTP
+    bool failed = false;
+    try {
+        unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+        failed = !ds || GDALGetDriverShortName(ds->GetDriver()) != string("MsatOpenMTP");
+    } catch (std::exception&) {
+        failed = true;
+    }
+    wassert(actual(failed).istrue());
+});
+#endif
+
+#ifdef HAVE_OMTP_IDS
+add_method("omtp_ids", []{
+    TempTestFile tf("test-omtp-ids.ids");
+    write_omtp_ids(tf.name());
+
+    unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+    wassert(actual(ds.get() != nullptr).istrue());
+    wassert(actual(GDALGetDriverShortName(ds->GetDriver())) == "MsatOpenMTPIDS");
+    wassert(actual(ds->GetRasterXSize()) == 100);
+    wassert(actual(ds->GetRasterYSize()) == 4);
+    wassert(actual(ds->GetRasterCount()) == 2);
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == "2005-04-27 12:30:00");
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_SPACECRAFT, MD_DOMAIN_MSAT)) == "METEOSAT 5");
+
+    // One band per channel, with the raw counts
+    GDALRasterBand* ir = ds->GetRasterBand(1);
+    wassert(actual(ir->GetDescription()) == "IR");
+    wassert(actual(ir->GetRasterDataType()) == GDT_Byte);
+    GDALRasterBand* wv = ds->GetRasterBand(2);
+    wassert(actual(wv->GetDescription()) == "WV");
+
+    for (int y = 0; y < 4; ++y)
+        for (int x = 0; x < 100; ++x)
+        {
+            wassert(actual(gdal::read_int32(ir, x, y)) == ((y * 7 + x + 1) & 0xff));
+            // WV lines are shorter, and padded with nodata
+            wassert(actual(gdal::read_int32(wv, x, y)) == (x < 50 ? ((y * 7 + x + 1) & 0xff) : 0));
+        }
+});
+
+add_method("omtp_ids_truncated", []{
+    TempTestFile tf("test-omtp-ids.ids");
+    write_omtp_ids(tf.name());
+    wassert(actual(truncate(tf.name().c_str(), 500)) == 0);
+
+    bool failed = false;
+    try {
+        unique_ptr<GDALDataset> ds = gdal::open_ro(tf.name());
+        failed = !ds;
+    } catch (std::exception&) {
+        failed = true;
+    }
+    wassert(actual(failed).istrue());
+});
+#endif
+
+}
+
+}
@@ -0,0 +1,181 @@
+#include "utils.h"
+#include <config.h>
+#ifdef HAVE_THORNSDS_DB1
+#include <msat/thornsds_db1/thornsds_db1.h>
+#endif
+#include <msat/utils/sys.h>
+#include <msat/facts.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <unistd.h>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+#ifdef HAVE_THORNSDS_DB1
+const int db1_pixels = 100;
+const int db1_lines = 50;
+
+/// Calibrated value of a count in the synthetic Calibration files
+float calibrated(int count) { return 200.0 + count * 0.5; }
+
+/// Pixel value of a channel in the synthetic RAW files
+unsigned short count(int channel, int x, int y) { return (channel * 100 + y * 3 + x) % 1024; }
+
+/**
+ * Write a DB1 directory with IR_108 and WV_062 channels, of which only
+ * IR_108 has a Calibration file
+ */
+void write_db1(const std::filesystem::path& dir)
+{
+    msat::sys::write_file(dir / "AoI",
+            "Name=Test\n"
+            "nPixels=100\n"
+            "nLines=50\n"
+            "Projection=GEOS\n"
+            "CFAC=-13642337\n"
+            "LFAC=-13642337\n"
+            "COFF=1800\n"
+            "LOFF=1700\n");
+    msat::sys::write_file(dir / "INFO.DBI",
+            "[Station]\nName=Test station\n"
+            "[Satellite]\nName=MSG1\nID=1\n"
+            "[Schedule]\nStart=27/04/2005 12:30:00.000\nNorthSouth=1\n"
+            "[Image]\nPixels=100\nLines=50\nBitsPerPixel=10\nnChannels=2\n"
+            "[Channel1]\nName=IR_108\nVariable=Temperature\nUnits=K\n"
+            "[Channel2]\nName=WV_062\nVariable=Temperature\nUnits=K\n");
+
+    string cal = "[Calibration]\nSlope=0.5\n[Temperature]\n";
+    for (int i = 0; i < 1024; ++i)
+        cal += "T(" + to_string(i) + ")=" + to_string(calibrated(i)) + "\n";
+    msat::sys::write_file(dir / "IR_108.Calibration", cal);
+
+    const char* names[] = { "IR_108", "WV_062" };
+    for (int c = 0; c < 2; ++c)
+    {
+        vector<unsigned short> raw(db1_pixels * db1_lines);
+        for (int y = 0; y < db1_lines; ++y)
+            for (int x = 0; x < db1_pixels; ++x)
+                raw[y * db1_pixels + x] = count(c, x, y);
+        msat::sys::write_file(dir / (string(names[c]) + ".RAW"),
+                string((const char*)raw.data(), raw.size() * sizeof(unsigned short)));
+    }
+}
+#endif
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_thornsds_db1");
+
+void Tests::register_tests()
+{
+
+#ifdef HAVE_THORNSDS_DB1
+add_method("reader", []{
+    msat::sys::Tempdir dir("test-db1");
+    write_db1(dir.path());
+
+    MSG_db1_data db1;
+    wassert(actual(db1.open((char*)dir.path().c_str())).istrue());
+    wassert(actual(db1.get_channel_names().size()) == 2u);
+
+    db1.set_channel((char*)"IR_108");
+    wassert(actual(db1.is_data_ok()).istrue());
+    MSG_db1_channel* ir = db1.get_channel();
+    wassert(actual(db1.get_raw_data_nvals()) == db1_pixels * db1_lines);
+    wassert(actual(db1.get_RAW_data()[db1_pixels + 2]) == count(0, 2, 1));
+    wassert(actual((double)db1.get_calibration()[10]).almost_equal(calibrated(10), 3));
+
+    // Switching channel keeps the channels already loaded
+    db1.set_channel((char*)"WV_062");
+    wassert(actual(db1.get_RAW_data()[db1_pixels + 2]) == count(1, 2, 1));
+    db1.set_channel((char*)"IR_108");
+    wassert(actual(db1.get_channel() == ir).istrue());
+
+    // Opening fails without the INFO.DBI file
+    std::filesystem::remove(dir.path() / "INFO.DBI");
+    MSG_db1_data missing;
+    wassert(actual(missing.open((char*)dir.path().c_str())).isfalse());
+});
+
+add_method("gdal", []{
+    msat::sys::Tempdir dir("test-db1");
+    write_db1(dir.path());
+
+    // The dataset can be opened from the directory or from its INFO.DBI
+    for (const auto& pathname: { dir.path(), dir.path() / "INFO.DBI" })
+    {
+        unique_ptr<GDALDataset> ds = gdal::open_ro(pathname);
+        wassert(actual(ds.get() != nullptr).istrue());
+        wassert(actual(GDALGetDriverShortName(ds->GetDriver())) == "MsatThornsdsDB1");
+        wassert(actual(ds->GetRasterXSize()) == db1_pixels);
+        wassert(actual(ds->GetRasterYSize()) == db1_lines);
+        wassert(actual(ds->GetRasterCount()) == 2);
+    }
+
+    // The channel without a calibration is reported as a warning
+    CPLErrorReset();
+    unique_ptr<GDALDataset> ds = gdal::open_ro(dir.path());
+    wassert(actual(CPLGetLastErrorType()) == CE_Warning);
+    wassert(actual(CPLGetLastErrorMsg()).contains("WV_062"));
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_DATETIME, MD_DOMAIN_MSAT)) == "2005-04-27 12:30:00");
+    wassert(actual(ds->GetMetadataItem(MD_MSAT_SPACECRAFT, MD_DOMAIN_MSAT)) == "MSG1");
+
+    // Georeferencing follows db1_to_netcdf, which swaps the AoI offsets
+    wassert(actual(ds->GetSpatialRef() != nullptr).istrue());
+    double gt[6];
+    wassert(actual(ds->GetGeoTransform(gt)) == CE_None);
+    double ps = msat::facts::pixelHSizeFromCFAC(13642337 * exp2(-16));
+    wassert(actual(gt[0]).almost_equal(-1700 * ps, 3));
+    wassert(actual(gt[1]).almost_equal(ps, 3));
+    wassert(actual(gt[3]).almost_equal(1800 * ps, 3));
+
+    // IR_108 has a Calibration file
+    GDALRasterBand* ir = ds->GetRasterBand(1);
+    wassert(actual(ir->GetDescription()) == "IR_108");
+    wassert(actual(ir->GetMetadataItem(MD_MSAT_CHANNEL_ID, MD_DOMAIN_MSAT)) == "9");
+    wassert(actual(ir->GetRasterDataType()) == GDT_Float32);
+    wassert(actual(ir->GetUnitType()) == "K");
+    for (int y: { 0, 17, db1_lines - 1 })
+        for (int x: { 0, 33, db1_pixels - 1 })
+            wassert(actual((double)gdal::read_float32(ir, x, y)).almost_equal(calibrated(count(0, x, y)), 3));
+
+    // WV_062 has no Calibration file, and gives raw counts
+    GDALRasterBand* wv = ds->GetRasterBand(2);
+    wassert(actual(wv->GetDescription()) == "WV_062");
+    wassert(actual(wv->GetRasterDataType()) == GDT_UInt16);
+
+    // Windowed reads only touch the requested lines
+    vector<unsigned short> win(10 * 3);
+    wassert(actual(wv->RasterIO(GF_Read, 20, 30, 10, 3, win.data(), 10, 3, GDT_UInt16, 0, 0)) == CE_None);
+    for (int y = 0; y < 3; ++y)
+        for (int x = 0; x < 10; ++x)
+            wassert(actual(win[y * 10 + x]) == count(1, 20 + x, 30 + y));
+});
+
+add_method("gdal_truncated", []{
+    msat::sys::Tempdir dir("test-db1");
+    write_db1(dir.path());
+    wassert(actual(truncate((dir.path() / "WV_062.RAW").c_str(), 1000)) == 0);
+
+    bool failed = false;
+    try {
+        unique_ptr<GDALDataset> ds = gdal::open_ro(dir.path());
+        failed = !ds;
+    } catch (std::exception&) {
+        failed = true;
+    }
+    wassert(actual(failed).istrue());
+});
+#endif
+
+}
+
+}
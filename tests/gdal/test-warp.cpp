@@ -0,0 +1,172 @@
+#include "utils.h"
+#include <msat/gdal/warp.h>
+#include <msat/utils/sys.h>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace msat::dataset;
+using namespace msat::tests;
+
+namespace {
+
+#define TESTFILE "H:MSG2:IR_108:201001191200"
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_warp");
+
+void Tests::register_tests()
+{
+
+add_method("grid", []{
+    LatLonGrid grid;
+    wassert(actual(grid.parse("58,64,-5,5,0.5")).istrue());
+    wassert(actual(grid.width) == 21);
+    wassert(actual(grid.height) == 13);
+    wassert(actual(grid.lat_north) == 64.0);
+    wassert(actual(grid.lon_west) == -5.0);
+
+    double gt[6];
+    grid.geotransform(gt);
+    wassert(actual(gt[0]) == -5.25);
+    wassert(actual(gt[1]) == 0.5);
+    wassert(actual(gt[3]) == 64.25);
+    wassert(actual(gt[5]) == -0.5);
+});
+
+add_method("nearest", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro(TESTFILE);
+    LatLonGrid grid;
+    wassert(actual(grid.parse("58,64,-5,5,0.5")).istrue());
+
+    WarpTable table;
+    wassert(actual(table.compute(ds.get(), grid)).istrue());
+    wassert(actual(table.matches(ds.get())).istrue());
+    wassert(actual(table.weights() == nullptr).istrue());
+
+    GDALRasterBand* rb = ds->GetRasterBand(1);
+    vector<float> warped(grid.width * grid.height);
+    wassert(actual(table.apply(rb, warped.data(), -1)) == CE_None);
+
+    // Each target pixel has the value of the source pixel found by
+    // GeoReferencer
+    msat::dataset::GeoReferencer gr;
+    wassert(actual(gr.init(ds.get())) == CE_None);
+    double scale = rb->GetScale();
+    double offset = rb->GetOffset();
+    unsigned valid = 0;
+    for (int y = 0; y < grid.height; ++y)
+        for (int x = 0; x < grid.width; ++x)
+        {
+            int sx, sy;
+            wassert(actual(gr.latlonToPixel(grid.lat_north - y * grid.step, grid.lon_west + x * grid.step, sx, sy)) == CE_None);
+            float raw = gdal::read_float32(rb, sx, sy);
+            float expected = raw == 0 ? -1.0f : (float)(raw * scale + offset);
+            wassert(actual(warped[y * grid.width + x]) == expected);
+            if (raw != 0) ++valid;
+        }
+    wassert(actual(valid) > 0u);
+});
+
+add_method("saveload", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro(TESTFILE);
+    LatLonGrid grid;
+    wassert(actual(grid.parse("58,64,-5,5,0.5")).istrue());
+
+    WarpTable table;
+    wassert(actual(table.compute(ds.get(), grid, true)).istrue());
+
+    TempTestFile tf("test-warp.table");
+    wassert(actual(table.save(tf.name())).istrue());
+
+    WarpTable loaded;
+    wassert(actual(loaded.load(tf.name())).istrue());
+    wassert(actual(loaded.grid == grid).istrue());
+    wassert(actual(loaded.bilinear).istrue());
+    wassert(actual(loaded.matches(ds.get())).istrue());
+    wassert(actual(loaded.win_width) == table.win_width);
+    wassert(actual(loaded.win_height) == table.win_height);
+    size_t count = grid.width * grid.height;
+    for (size_t i = 0; i < count; ++i)
+        wassert(actual(loaded.indices()[i]) == table.indices()[i]);
+    for (size_t i = 0; i < count * 4; ++i)
+        wassert(actual(loaded.weights()[i]) == table.weights()[i]);
+
+    // A table for another grid does not match
+    unique_ptr<GDALDataset> grib = gdal::open_ro("MSG_Seviri_1_5_Infrared_9_7_channel_20060426_1945.grb");
+    wassert(actual(loaded.matches(grib.get())).isfalse());
+});
+
+add_method("load_corrupted", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro(TESTFILE);
+    LatLonGrid grid;
+    wassert(actual(grid.parse("58,64,-5,5,0.5")).istrue());
+
+    WarpTable table;
+    wassert(actual(table.compute(ds.get(), grid, true)).istrue());
+    TempTestFile tf("test-warp.table");
+    wassert(actual(table.save(tf.name())).istrue());
+
+    // Indices are followed by the 4 weights of each target pixel at the end
+    // of the file
+    size_t count = grid.width * grid.height;
+    string data = msat::sys::read_file(std::filesystem::path(tf.name()));
+    size_t indices_ofs = data.size() - count * 5 * sizeof(uint32_t);
+    size_t i = 0;
+    while (table.indices()[i] == WarpTable::none) ++i;
+
+    // Indices beyond the source window are rejected
+    uint32_t idx = table.win_width * table.win_height;
+    memcpy(&data[indices_ofs + i * sizeof(uint32_t)], &idx, sizeof(idx));
+    msat::sys::write_file(std::filesystem::path(tf.name()), data);
+    WarpTable loaded;
+    wassert(actual(loaded.load(tf.name())).isfalse());
+
+    // So are bilinear indices whose neighbours are outside the window
+    idx = table.win_width * (table.win_height - 1);
+    memcpy(&data[indices_ofs + i * sizeof(uint32_t)], &idx, sizeof(idx));
+    msat::sys::write_file(std::filesystem::path(tf.name()), data);
+    wassert(actual(loaded.load(tf.name())).isfalse());
+});
+
+add_method("dataset", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro(TESTFILE);
+    LatLonGrid grid;
+    wassert(actual(grid.parse("58,64,-5,5,0.5")).istrue());
+
+    std::shared_ptr<WarpTable> table(new WarpTable);
+    wassert(actual(table->compute(ds.get(), grid, true)).istrue());
+
+    WarpedDataset warped(*ds, table);
+    wassert(actual(warped.GetRasterXSize()) == 21);
+    wassert(actual(warped.GetRasterYSize()) == 13);
+    wassert(actual(warped.GetRasterCount()) == 1);
+    wassert(actual(warped.GetSpatialRef()->IsGeographic()).istrue());
+    double gt[6];
+    wassert(actual(warped.GetGeoTransform(gt)) == CE_None);
+    wassert(actual(gt[0]) == -5.25);
+    wassert(actual(gt[3]) == 64.25);
+
+    GDALRasterBand* rb = warped.GetRasterBand(1);
+    wassert(actual(rb->GetRasterDataType()) == GDT_Float32);
+    wassert(actual(rb->GetDescription()) == ds->GetRasterBand(1)->GetDescription());
+
+    // The middle of the grid is on the Earth and is interpolated from valid
+    // pixels
+    float val = gdal::read_float32(rb, 10, 6);
+    wassert(actual(std::isfinite(val)).istrue());
+    wassert(actual(val) != 0.0f);
+
+    // Performance counters are those of the source dataset
+    wassert(actual(warped.GetMetadataItem("SEGMENTS_DECODED", MD_DOMAIN_MSAT_STATS)) != "0");
+    wassert(actual(warped.GetMetadataItem("SEGMENTS_DECODED", MD_DOMAIN_MSAT_STATS)) == ds->GetMetadataItem("SEGMENTS_DECODED", MD_DOMAIN_MSAT_STATS));
+});
+
+}
+
+}
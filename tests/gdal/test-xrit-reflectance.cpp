@@ -131,6 +131,37 @@ add_method("new_vis06", []{
     wassert(actual((double)valr).almost_equal(25.9648, 3));
 });
 
+// Derived datasets add their own counters to those of their sources
+add_method("stats", []{
+    only_on_gdal2();
+    CPLStringList opts((char**)nullptr);
+    opts.SetNameValue("MSAT_COMPUTE", "reflectance");
+    unique_ptr<GDALDataset> ds = gdal::open_ro("H:MSG2:VIS006:200807150900", opts);
+    wassert(actual(ds->GetMetadataItem("DERIVED_TIME", MD_DOMAIN_MSAT_STATS)) == "0.000000");
+
+    float val;
+    wassert(actual(ds->GetRasterBand(1)->RasterIO(GF_Read, 2000, 3400, 1, 1, &val, 1, 1, GDT_Float32, 0, 0)) == CE_None);
+    wassert(actual(ds->GetMetadataItem("SEGMENTS_DECODED", MD_DOMAIN_MSAT_STATS)) == "1");
+    wassert(actual(CPLAtof(ds->GetMetadataItem("GEOLOCATION_TIME", MD_DOMAIN_MSAT_STATS)) > 0).istrue());
+    wassert(actual(CPLAtof(ds->GetMetadataItem("DERIVED_TIME", MD_DOMAIN_MSAT_STATS)) > 0).istrue());
+});
+
+// Space and night pixels have no reflectance
+add_method("vis06_night", []{
+    only_on_gdal2();
+    CPLStringList opts((char**)nullptr);
+    opts.SetNameValue("MSAT_COMPUTE", "reflectance");
+    unique_ptr<GDALDataset> datasetr = gdal::open_ro("H:MSG2:VIS006:200807150900", opts);
+    GDALRasterBand* rb = datasetr->GetRasterBand(1);
+
+    // Space
+    wassert(actual(gdal::read_float32(rb, 500, 3400)) == 0.0f);
+    // Night, at lat -55 lon -51.6
+    wassert(actual(gdal::read_float32(rb, 1000, 3400)) == 0.0f);
+    // Daylight on the same line
+    wassert(actual((double)gdal::read_float32(rb, 2000, 3400)).almost_equal(25.9648, 3));
+});
+
 
 // Test opening channel 4 (IR 0.39), computing julian day
 add_method("new_ir039_jday", []{
@@ -0,0 +1,73 @@
+#include "utils.h"
+#include <cstdint>
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("gdal_xrit_series");
+
+void Tests::register_tests()
+{
+
+add_method("open", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro("MSATSERIES:3:15:H:MSG2:IR_108:201001191200");
+    wassert(actual(string(GDALGetDriverShortName(ds->GetDriver()))) == "MsatXRITSeries");
+    wassert(actual(ds->GetRasterCount()) == 3);
+    wassert(actual(ds->GetRasterXSize()) == 3712);
+    wassert(actual(ds->GetRasterYSize()) == 3712);
+    wassert(actual(ds->GetRasterBand(1)->GetDescription()) == "2010-01-19 12:00:00");
+    wassert(actual(ds->GetRasterBand(2)->GetDescription()) == "2010-01-19 12:15:00");
+    wassert(actual(ds->GetRasterBand(3)->GetDescription()) == "2010-01-19 12:30:00");
+
+    // The grid is the one of the timeslot
+    unique_ptr<GDALDataset> slot = gdal::open_ro("H:MSG2:IR_108:201001191200");
+    double gt[6], slot_gt[6];
+    wassert(actual(ds->GetGeoTransform(gt)) == CE_None);
+    wassert(actual(slot->GetGeoTransform(slot_gt)) == CE_None);
+    for (int i = 0; i < 6; ++i)
+        wassert(actual(gt[i]) == slot_gt[i]);
+    wassert(actual(ds->GetRasterBand(1)->GetRasterDataType()) == slot->GetRasterBand(1)->GetRasterDataType());
+});
+
+add_method("read", []{
+    unique_ptr<GDALDataset> ds = gdal::open_ro("MSATSERIES:2:15:H:MSG2:IR_108:201001191200");
+    unique_ptr<GDALDataset> slot = gdal::open_ro("H:MSG2:IR_108:201001191200");
+
+    // Read a window of both timeslots at once
+    float series[2 * 10 * 10];
+    wassert(actual(ds->RasterIO(GF_Read, 2000, 350, 10, 10, series, 10, 10, GDT_Float32, 2, nullptr, 0, 0, 0)) == CE_None);
+
+    float expected[10 * 10];
+    wassert(actual(slot->GetRasterBand(1)->RasterIO(GF_Read, 2000, 350, 10, 10, expected, 10, 10, GDT_Float32, 0, 0)) == CE_None);
+    for (int i = 0; i < 100; ++i)
+        wassert(actual(series[i]) == expected[i]);
+    wassert(actual(ds->GetRasterBand(1)->GetScale()) == slot->GetRasterBand(1)->GetScale());
+    wassert(actual(ds->GetRasterBand(1)->GetOffset()) == slot->GetRasterBand(1)->GetOffset());
+    wassert(actual(ds->GetRasterBand(1)->GetNoDataValue()) == slot->GetRasterBand(1)->GetNoDataValue());
+    wassert(actual(ds->GetRasterBand(1)->GetUnitType()) == slot->GetRasterBand(1)->GetUnitType());
+
+    // The second timeslot is missing, and reads as nodata
+    for (int i = 0; i < 100; ++i)
+        wassert(actual(series[100 + i]) == 0.0f);
+});
+
+add_method("invalid", []{
+    bool failed = false;
+    try {
+        unique_ptr<GDALDataset> ds = gdal::open_ro("MSATSERIES:2:H:MSG2:IR_108:201001191200");
+    } catch (std::exception& e) {
+        failed = true;
+    }
+    wassert(actual(failed).istrue());
+});
+
+}
+
+}
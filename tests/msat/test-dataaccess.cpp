@@ -1,7 +1,15 @@
 #include <msat/utils/tests.h>
 #include <msat/xrit/dataaccess.h>
 #include <msat/xrit/fileaccess.h>
+#include <msat/xrit/synthetic.h>
 #include <msat/hrit/MSG_HRIT.h>
+#include <msat/utils/sys.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
 
 using namespace msat::xrit;
 using namespace msat::tests;
@@ -237,6 +245,139 @@ add_method("scan_rss_hrv", []() {
     wassert(da.line_read(0, buf));
 });
 
+add_method("header_from_buffer", []() {
+    std::string pathname = DATA_DIR "/H-000-MSG2__-MSG2________-IR_108___-000008___-201001191200-C_";
+    std::string data = msat::sys::read_file(pathname);
+    const unsigned char* buf = (const unsigned char*)data.data();
+
+    MSG_header expected;
+    std::ifstream in(pathname.c_str(), std::ios::binary | std::ios::in);
+    expected.read_from(in);
+
+    wassert(actual(MSG_header::header_length(buf, data.size())) == expected.total_header_length);
+    wassert_throws(std::runtime_error, MSG_header::header_length(buf, 10));
+
+    // Buffers not starting with a primary header are rejected
+    std::string corrupted = data;
+    corrupted[0] = 1;
+    wassert_throws(std::runtime_error, MSG_header::header_length((const unsigned char*)corrupted.data(), corrupted.size()));
+    corrupted = data;
+    corrupted[2] = 17;
+    wassert_throws(std::runtime_error, MSG_header::header_length((const unsigned char*)corrupted.data(), corrupted.size()));
+
+    // The same object reads headers from a buffer over and over
+    MSG_header header;
+    for (unsigned i = 0; i < 2; ++i)
+    {
+        header.read_from(buf, expected.total_header_length);
+        wassert(actual(header.total_header_length) == expected.total_header_length);
+        wassert(actual(header.data_field_length) == expected.data_field_length);
+        wassert(actual(header.image_structure->number_of_columns) == 3712u);
+        wassert(actual(header.image_navigation->column_scaling_factor) == expected.image_navigation->column_scaling_factor);
+        wassert(actual(header.annotation->annotation) == expected.annotation->annotation);
+        wassert(actual(header.segment_id->sequence_number) == 8u);
+        wassert(actual(header.segment_quality->nlines) == 464);
+        wassert(actual(header.segment_quality->lq[463].line_number_in_grid) == expected.segment_quality->lq[463].line_number_in_grid);
+    }
+    wassert_throws(std::runtime_error, header.read_from(buf, expected.total_header_length - 1));
+
+    // DataAccess reads headers with pread
+    DataAccess da;
+    wassert(da.read_file(pathname, header));
+    wassert(actual(header.segment_id->sequence_number) == 8u);
+    wassert(actual(da.stats.bytes_read.load()) == expected.total_header_length);
+});
+
+add_method("concurrent_reads", []() {
+    msat::sys::Tempdir dir("test-dataaccess");
+    SyntheticCycle cycle;
+    cycle.directory = dir.path().string();
+    cycle.channels = {"IR_108"};
+    cycle.missing["IR_108"] = {5};
+    wassert(cycle.write());
+
+    FileAccess fa(cycle.name("IR_108"));
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+    const unsigned nthreads = 8;
+
+    // Threads asking for the same segment at the same time share one decode,
+    // also when more segments than the cache holds are decoded at once
+    for (unsigned nsegs: { 1u, 4u })
+    {
+        DataAccess da;
+        wassert(da.scan(fa, pro, epi, header));
+
+        // Serve the segments through named pipes, so that their decoding
+        // waits until all threads have asked for them
+        std::vector<std::string> contents;
+        for (unsigned i = 0; i < nsegs; ++i)
+        {
+            contents.push_back(msat::sys::read_file(std::filesystem::path(da.segnames[i])));
+            da.segnames[i] = dir.path() / ("fifo" + std::to_string(nsegs) + "_" + std::to_string(i));
+            wassert(actual(mkfifo(da.segnames[i].c_str(), 0600)) == 0);
+        }
+
+        const unsigned nreaders = nsegs * nthreads;
+        std::vector<DataAccess::Segment> segments(nreaders);
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < nreaders; ++t)
+            threads.emplace_back([&, t] { segments[t] = da.segment(t % nsegs); });
+        while (da.stats.cache_hits + da.stats.cache_misses < nreaders)
+            std::this_thread::yield();
+        for (unsigned i = 0; i < nsegs; ++i)
+        {
+            std::ofstream out(da.segnames[i], std::ios::binary);
+            out << contents[i];
+        }
+        for (auto& t: threads)
+            t.join();
+
+        wassert(actual(da.stats.segments_decoded.load()) == nsegs);
+        wassert(actual(da.stats.cache_misses.load()) == nsegs);
+        for (unsigned t = 0; t < nreaders; ++t)
+        {
+            wassert(actual(segments[t] != nullptr).istrue());
+            wassert(actual(segments[t] == segments[t % nsegs]).istrue());
+        }
+    }
+
+    DataAccess da;
+    wassert(da.scan(fa, pro, epi, header));
+
+    // Read the whole image from one thread
+    std::vector<MSG_SAMPLE> expected(da.columns * da.lines);
+    for (size_t y = 0; y < da.lines; ++y)
+        da.line_read(y, expected.data() + y * da.columns);
+
+    // Read lines all over the image from many threads, so that segments are
+    // decoded, shared and dropped from the cache while others use them
+    std::atomic<unsigned> mismatches{0};
+    std::atomic<unsigned> errors{0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < nthreads; ++t)
+        threads.emplace_back([&, t] {
+            std::vector<MSG_SAMPLE> buf(da.columns);
+            try {
+                for (size_t i = 0; i < 300; ++i)
+                {
+                    size_t y = (t * 457 + i * 1031) % da.lines;
+                    da.line_read(y, buf.data());
+                    if (memcmp(buf.data(), expected.data() + y * da.columns, da.columns * sizeof(MSG_SAMPLE)) != 0)
+                        ++mismatches;
+                }
+            } catch (std::exception&) {
+                ++errors;
+            }
+        });
+    for (auto& t: threads)
+        t.join();
+
+    wassert(actual(errors.load()) == 0u);
+    wassert(actual(mismatches.load()) == 0u);
+});
+
 }
 
 }
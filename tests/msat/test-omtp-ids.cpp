@@ -0,0 +1,139 @@
+#include <msat/utils/tests.h>
+#include <msat/omtp-ids/OpenMTP-IDS.hh>
+#include <config.h>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace std;
+using namespace msat::tests;
+
+namespace {
+
+const int no_records = 3;
+const int no_scanlines = 4;
+const int no_pixels = 100;
+const int padding = 4;
+
+/// Build a small OpenMTP-IDS image with known pixel values
+OpenMTP_IDS make_image()
+{
+    OpenMTP_IDS res;
+    res.fileheader().no_records(no_records + 1);
+    res.fileheader().record_length(200);
+    res.fileheader().year(2005);
+    res.fileheader().julian_day(117);
+
+    for (int r = 0; r < no_records; ++r)
+    {
+        Record record;
+        record.recordheader().no_scanlines(no_scanlines);
+        for (int l = 0; l < no_scanlines; ++l)
+        {
+            ScanLine line;
+            line.lineheader().length(omtp_ids::LINEHEADER_LEN + no_pixels + padding);
+            line.lineheader().line(r * no_scanlines + l + 1);
+            line.lineheader().no_pixels(no_pixels);
+            for (int x = 0; x < no_pixels; ++x)
+                line.linepixel().push_back((r * no_scanlines + l) * 7 + x);
+            record.scanline().push_back(line);
+        }
+        res.record().push_back(record);
+    }
+    return res;
+}
+
+void check_image(const OpenMTP_IDS& img)
+{
+    wassert(actual(img.fileheader().no_records()) == no_records + 1);
+    wassert(actual(img.fileheader().year()) == 2005);
+    wassert(actual(img.fileheader().julian_day()) == 117);
+    wassert(actual(img.record().size()) == (size_t)no_records);
+
+    for (int r = 0; r < no_records; ++r)
+    {
+        const vector<ScanLine>& lines = img.record()[r].scanline();
+        wassert(actual(lines.size()) == (size_t)no_scanlines);
+        for (int l = 0; l < no_scanlines; ++l)
+        {
+            int y = r * no_scanlines + l;
+            wassert(actual(lines[l].lineheader().line()) == y + 1);
+            wassert(actual(lines[l].linepixel().size()) == (size_t)no_pixels);
+            for (int x = 0; x < no_pixels; ++x)
+                wassert(actual(lines[l][x]) == ((y * 7 + x) & 0xff));
+        }
+    }
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_omtp_ids");
+
+void Tests::register_tests()
+{
+
+add_method("stream", []() {
+    OpenMTP_IDS img = make_image();
+    stringstream buf;
+    buf << img;
+
+    OpenMTP_IDS res;
+    buf >> res;
+    wassert(actual(buf.good()).istrue());
+    check_image(res);
+});
+
+add_method("file", []() {
+    OpenMTP_IDS img = make_image();
+    wassert(actual(img.write("test-omtp-ids.bin")).istrue());
+
+    OpenMTP_IDS res;
+    wassert(actual(res.read("test-omtp-ids.bin")).istrue());
+    check_image(res);
+    unlink("test-omtp-ids.bin");
+});
+
+add_method("truncated", []() {
+    OpenMTP_IDS img = make_image();
+    stringstream buf;
+    buf << img;
+    string data = buf.str();
+    {
+        ofstream out("test-omtp-ids-truncated.bin");
+        out.write(data.data(), data.size() / 2);
+    }
+
+    OpenMTP_IDS res;
+    wassert_throws(std::runtime_error, res.read("test-omtp-ids-truncated.bin"));
+    unlink("test-omtp-ids-truncated.bin");
+    wassert_throws(std::runtime_error, res.read("test-omtp-ids-truncated.bin"));
+});
+
+#ifdef HAVE_ZLIB
+add_method("gzip", []() {
+    OpenMTP_IDS img = make_image();
+    stringstream buf;
+    buf << img;
+    string data = buf.str();
+
+    gzFile out = gzopen("test-omtp-ids.bin.gz", "wb");
+    wassert(actual(out != nullptr).istrue());
+    wassert(actual(gzwrite(out, data.data(), data.size())) == (int)data.size());
+    gzclose(out);
+
+    OpenMTP_IDS res;
+    wassert(actual(res.read("test-omtp-ids.bin.gz")).istrue());
+    check_image(res);
+    unlink("test-omtp-ids.bin.gz");
+});
+#endif
+
+}
+
+}
@@ -0,0 +1,92 @@
+#include <msat/utils/tests.h>
+#include <msat/utils/sys.h>
+#include <msat/Progress.h>
+#include <thread>
+
+using namespace std;
+using namespace msat;
+using namespace msat::tests;
+
+namespace {
+
+/// Run a span with a nested span, with counters
+void nested_spans()
+{
+    ProgressSpan outer("outer");
+    outer.add_bytes(100);
+    {
+        ProgressSpan inner("inner");
+        inner.add_pixels(10);
+        inner.add_pixels(5);
+    }
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_progress");
+
+void Tests::register_tests()
+{
+
+add_method("disabled", []() {
+    Progress& p = Progress::get();
+    if (p.tracing()) p.stop_tracing();
+    size_t count = p.records().size();
+    nested_spans();
+    wassert(actual(p.records().size()) == count);
+});
+
+add_method("spans", []() {
+    sys::Tempdir td("test-progress");
+    std::filesystem::path pathname = td.path() / "trace.txt";
+    Progress& p = Progress::get();
+    p.start_tracing(pathname.string(), Progress::TRACE_SUMMARY);
+    nested_spans();
+    std::thread t(nested_spans);
+    t.join();
+
+    // Spans are recorded when they end, innermost first
+    vector<ProgressSpanRecord> recs = p.records();
+    wassert(actual(recs.size()) == 4u);
+    wassert(actual(recs[0].path) == "outer/inner");
+    wassert(actual(recs[0].name) == "inner");
+    wassert(actual(recs[0].pixels) == 15u);
+    wassert(actual(recs[0].bytes) == 0u);
+    wassert(actual(recs[1].path) == "outer");
+    wassert(actual(recs[1].bytes) == 100u);
+    wassert(actual(recs[1].start <= recs[0].start).istrue());
+    wassert(actual(recs[1].start + recs[1].duration >= recs[0].start + recs[0].duration).istrue());
+    wassert(actual(recs[2].thread != recs[0].thread).istrue());
+    wassert(actual(recs[3].thread) == recs[2].thread);
+
+    wassert(actual(p.stop_tracing()).istrue());
+    wassert(actual(p.tracing()).isfalse());
+
+    // Nested spans are indented under their parent
+    string summary = sys::read_file(pathname);
+    wassert(actual(summary).contains("\nouter "));
+    wassert(actual(summary).contains("\n  inner "));
+    wassert(actual(summary).matches("\n  inner +2 "));
+});
+
+add_method("chrome", []() {
+    sys::Tempdir td("test-progress");
+    std::filesystem::path pathname = td.path() / "trace.json";
+    Progress& p = Progress::get();
+    p.start_tracing(pathname.string());
+    nested_spans();
+    wassert(actual(p.stop_tracing()).istrue());
+
+    string trace = sys::read_file(pathname);
+    wassert(actual(trace).startswith("{\"traceEvents\":["));
+    wassert(actual(trace).contains("\"name\":\"inner\",\"cat\":\"msat\",\"ph\":\"X\""));
+    wassert(actual(trace).contains("\"args\":{\"path\":\"outer/inner\",\"bytes\":0,\"pixels\":15}"));
+    wassert(actual(trace).endswith("],\"displayTimeUnit\":\"ms\"}\n"));
+});
+
+}
+
+}
@@ -0,0 +1,94 @@
+#include <msat/utils/tests.h>
+#include <msat/xrit/slotindex.h>
+
+using namespace msat;
+using namespace msat::tests;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_slotindex");
+
+void Tests::register_tests()
+{
+
+add_method("parse", []() {
+    xrit::SegmentName sn;
+    wassert(actual(sn.parse("H-000-MSG1__-MSG1________-IR_039___-000003___-200611130800-C_")).istrue());
+    wassert(actual(sn.resolution) == "H");
+    wassert(actual(sn.productid1) == "MSG1");
+    wassert(actual(sn.productid2) == "IR_039");
+    wassert(actual(sn.timing) == "200611130800");
+    wassert(actual(sn.type) == xrit::SegmentName::SEGMENT);
+    wassert(actual(sn.segment) == 3u);
+
+    wassert(actual(sn.parse("H-000-MSG1__-MSG1________-_________-PRO______-200611130800-__")).istrue());
+    wassert(actual(sn.type) == xrit::SegmentName::PROLOGUE);
+    wassert(actual(sn.productid2) == "");
+
+    wassert(actual(sn.parse("H-000-MSG1__-MSG1________-_________-EPI______-200611130800-__")).istrue());
+    wassert(actual(sn.type) == xrit::SegmentName::EPILOGUE);
+
+    wassert(actual(sn.parse("H:MSG1:IR_039:200611130800")).isfalse());
+    wassert(actual(sn.parse("H-000-MSG1__-MSG1________-IR_039___-000003___-200611130800-C_.tmp")).isfalse());
+    wassert(actual(sn.parse("README")).isfalse());
+});
+
+add_method("complete", []() {
+    xrit::SlotIndex index("/srv/ingest");
+    wassert(actual(index.add("README") == nullptr).istrue());
+
+    xrit::Slot* slot = nullptr;
+    for (int seg = 1; seg <= 8; ++seg)
+    {
+        char name[80];
+        snprintf(name, 80, "H-000-MSG2__-MSG2________-IR_108___-%06d___-201001191200-C_", seg);
+        slot = index.add(name);
+        wassert(actual(slot != nullptr).istrue());
+        // The prologue is missing
+        wassert(actual(index.complete(*slot, "IR_108")).isfalse());
+    }
+    wassert(actual(index.slots.size()) == 1u);
+
+    index.add("H-000-MSG2__-MSG2________-_________-PRO______-201001191200-__");
+    wassert(actual(index.complete(*slot, "IR_108")).istrue());
+    wassert(actual(index.complete(*slot, "IR_134")).isfalse());
+    wassert(actual(slot->name("IR_108")) == "/srv/ingest/H:MSG2:IR_108:201001191200");
+    wassert(actual(slot->access("IR_108").productid2) == "IR_108");
+
+    // HRV needs 24 segments
+    index.add("H-000-MSG2__-MSG2________-HRV______-000001___-201001191200-C_");
+    wassert(actual(index.complete(*slot, "HRV")).isfalse());
+
+    // A subset of segments is enough if configured
+    index.add("H-000-MSG2__-MSG2________-IR_134___-000007___-201001191200-C_");
+    index.add("H-000-MSG2__-MSG2________-IR_134___-000008___-201001191200-C_");
+    wassert(actual(index.complete(*slot, "IR_134")).isfalse());
+    index.first_segment = 7;
+    index.last_segment = 8;
+    wassert(actual(index.complete(*slot, "IR_134")).istrue());
+
+    // The epilogue ends the repeat cycle
+    index.add("H-000-MSG2__-MSG2________-_________-EPI______-201001191200-__");
+    wassert(actual(index.complete(*slot, "HRV")).istrue());
+});
+
+add_method("expire", []() {
+    xrit::SlotIndex index(".");
+    index.add("H-000-MSG2__-MSG2________-_________-PRO______-201001191200-__");
+    index.add("H-000-MSG2__-MSG2________-_________-PRO______-201001191215-__");
+    index.add("H-000-MSG1__-MSG1________-_________-PRO______-201001191230-__");
+    wassert(actual(index.slots.size()) == 3u);
+    index.expire(2);
+    wassert(actual(index.slots.size()) == 2u);
+    wassert(actual(index.slots.count("H:MSG2:201001191200")) == 0u);
+    wassert(actual(index.slots.count("H:MSG1:201001191230")) == 1u);
+});
+
+}
+
+}
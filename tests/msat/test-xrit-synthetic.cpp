@@ -0,0 +1,152 @@
+#include <msat/utils/tests.h>
+#include <msat/utils/sys.h>
+#include <msat/xrit/synthetic.h>
+#include <msat/xrit/dataaccess.h>
+#include <msat/xrit/fileaccess.h>
+#include <msat/hrit/MSG_HRIT.h>
+#include <vector>
+
+using namespace std;
+using namespace msat;
+using namespace msat::xrit;
+using namespace msat::tests;
+
+namespace {
+
+/**
+ * Compare every 7th line and 5th column of an image read with DataAccess
+ * with what SyntheticCycle wrote, and return the number of Earth pixels seen
+ */
+size_t check_image(const SyntheticCycle& cycle, const std::string& channel, const DataAccess& da, unsigned size)
+{
+    const auto& missing = cycle.missing.find(channel);
+    vector<MSG_SAMPLE> buf(da.columns);
+    size_t earth = 0;
+    for (unsigned y = 0; y < size; y += 7)
+    {
+        wassert(da.line_read(y, buf.data()));
+        size_t start = da.line_start(y);
+        // Images are read north to south and west to east, while the grid
+        // is numbered from the south-east corner
+        unsigned line = size - y;
+        bool is_missing = missing != cycle.missing.end() && missing->second.count((line - 1) / 464 + 1);
+        for (unsigned x = 0; x < da.columns; x += 5)
+        {
+            MSG_SAMPLE expected = is_missing ? 0 : cycle.sample(channel, size - (start + x), line);
+            wassert(actual(buf[x]) == expected);
+            if (buf[x]) ++earth;
+        }
+    }
+    return earth;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override;
+} test("msat_xrit_synthetic");
+
+void Tests::register_tests()
+{
+
+add_method("names", []() {
+    SyntheticCycle cycle;
+    cycle.directory = "/srv/ingest";
+    wassert(actual(cycle.name("IR_108")) == "/srv/ingest/H:MSG2:IR_108:201001191200");
+    wassert(actual(cycle.prologue_file()) == "/srv/ingest/H-000-MSG2__-MSG2________-_________-PRO______-201001191200-__");
+    wassert(actual(cycle.epilogue_file()) == "/srv/ingest/H-000-MSG2__-MSG2________-_________-EPI______-201001191200-__");
+    wassert(actual(cycle.segment_file("IR_108", 3)) == "/srv/ingest/H-000-MSG2__-MSG2________-IR_108___-000003___-201001191200-C_");
+    wassert(actual(SyntheticCycle::segment_count("IR_108")) == 8u);
+    wassert(actual(SyntheticCycle::segment_count("HRV")) == 24u);
+    wassert(actual(SyntheticCycle::all_channels().size()) == 12u);
+
+    cycle.channels = {"IR_109"};
+    wassert_throws(std::runtime_error, cycle.validate());
+    cycle.channels = {"IR_108"};
+    cycle.missing["IR_108"] = {9};
+    wassert_throws(std::runtime_error, cycle.validate());
+});
+
+add_method("ir", []() {
+    sys::Tempdir dir("test-xrit-synthetic");
+    SyntheticCycle cycle;
+    cycle.directory = dir.path().string();
+    cycle.spacecraft = "MSG3";
+    cycle.timing = "201501011215";
+    cycle.longitude = 9.5;
+    cycle.channels = {"IR_108"};
+    cycle.missing["IR_108"] = {3};
+    wassert(cycle.write());
+
+    FileAccess fa(cycle.name("IR_108"));
+    DataAccess da;
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+    wassert(da.scan(fa, pro, epi, header));
+
+    wassert(actual(da.hrv) == false);
+    wassert(actual(da.swapX) == true);
+    wassert(actual(da.swapY) == true);
+    wassert(actual(da.segnames.size()) == 8u);
+    wassert(actual(da.segnames[2]) == "");
+    wassert(actual(da.columns) == 3712u);
+    wassert(actual(da.lines) == 3712u);
+    wassert(actual(header.image_navigation->subsatellite_longitude) == 9.5);
+
+    wassert(actual(pro.prologue->sat_status.SatelliteDefinition.SatelliteId) == 323);
+    struct tm* t = pro.prologue->image_acquisition.PlannedAquisitionTime.TrueRepeatCycleStart.get_timestruct();
+    wassert(actual(t->tm_year) == 115);
+    wassert(actual(t->tm_hour) == 12);
+    wassert(actual(t->tm_min) == 15);
+
+    double slope, offset;
+    bool scales_to_int;
+    pro.prologue->radiometric_proc.get_slope_offset(header.segment_id->spectral_channel_id, slope, offset, scales_to_int);
+    wassert(actual(slope) > 0);
+    wassert(actual(offset) < 0);
+
+    size_t earth = check_image(cycle, "IR_108", da, 3712);
+    wassert(actual(earth) > 0u);
+});
+
+add_method("hrv", []() {
+    sys::Tempdir dir("test-xrit-synthetic");
+    SyntheticCycle cycle;
+    cycle.directory = dir.path().string();
+    cycle.channels = {"HRV"};
+    cycle.hrv_lower_north_line = 5000;
+    cycle.hrv_lower_west_column = 6000;
+    cycle.hrv_upper_west_column = 8000;
+    wassert(cycle.write());
+
+    FileAccess fa(cycle.name("HRV"));
+    DataAccess da;
+    MSG_data pro;
+    MSG_data epi;
+    MSG_header header;
+    wassert(da.scan(fa, pro, epi, header));
+
+    wassert(actual(da.hrv) == true);
+    wassert(actual(da.segnames.size()) == 24u);
+    wassert(actual(da.columns) == 5568u);
+    wassert(actual(da.LowerNorthLineActual) == 5000u);
+    wassert(actual(da.LowerWestColumnActual) == 6000u);
+    wassert(actual(da.UpperWestColumnActual) == 8000u);
+
+    // Scanning with an epilogue already read gives the same image
+    DataAccess da1;
+    MSG_header header1;
+    da1.scan(fa, epi, header1);
+    wassert(actual(da1.segnames == da.segnames).istrue());
+    wassert(actual(da1.LowerNorthLineActual) == 5000u);
+    wassert(actual(da1.UpperWestColumnActual) == 8000u);
+
+    size_t earth = check_image(cycle, "HRV", da, 11136);
+    wassert(actual(earth) > 0u);
+});
+
+}
+
+}
@@ -88,7 +88,7 @@ static void do_dump(const char* name)
         for (size_t i = 0; i < da.segnames.size(); ++i)
         {
                 cout << "Segment " << i << ": ";
-                MSG_data* d = da.segment(i);
+                DataAccess::Segment d = da.segment(i);
                 MSG_SAMPLE min = 0xffff, max = 0;
                 if (!d)
                 {
@@ -0,0 +1,163 @@
+//---------------------------------------------------------------------------
+//
+//  File        :   xritgen.cpp
+//  Description :   Write synthetic xRIT repeat cycles for testing
+//  Author      :   ARPAE-SIMC <urpsim@arpae.it>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+//---------------------------------------------------------------------------
+
+#include <config.h>
+
+#include <msat/xrit/synthetic.h>
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <iostream>
+#include <cstdlib>
+
+#include <getopt.h>
+
+using namespace std;
+using namespace msat::xrit;
+
+static void do_help(const char* argv0, ostream& out)
+{
+        out << "Usage: " << argv0 << " [options] directory" << endl << endl
+            << "Write a synthetic xRIT repeat cycle in the given directory, with prologue," << endl
+            << "epilogue and all the image segments of the chosen channels. The names of" << endl
+            << "the images written are printed to standard output." << endl << endl
+            << "Options are:" << endl
+            << "  --help                  Print this help message" << endl
+            << "  --spacecraft=NAME       Satellite, from MSG1 to MSG4 (default: MSG2)" << endl
+            << "  --time=YYYYMMDDhhmm     Repeat cycle start (default: 201001191200)" << endl
+            << "  --longitude=DEG         Subsatellite longitude (default: 0)" << endl
+            << "  --channels=LIST         Comma separated channel names, like IR_108,HRV" << endl
+            << "                          (default: all channels)" << endl
+            << "  --missing=[CHAN:]N,...  Do not write the given segments, of CHAN only or of" << endl
+            << "                          all channels; can be given more than once" << endl
+            << "  --hrv-split=LINE        Last line of the lower HRV window (default: 8192)" << endl
+            << "  --hrv-lower-west=COL    West column of the lower HRV window (default: 5568)" << endl
+            << "  --hrv-upper-west=COL    West column of the upper HRV window (default: 7452)" << endl;
+}
+
+static vector<string> split(const string& str)
+{
+        vector<string> res;
+        size_t beg = 0;
+        while (true)
+        {
+                size_t end = str.find(',', beg);
+                res.push_back(str.substr(beg, end == string::npos ? string::npos : end - beg));
+                if (end == string::npos) break;
+                beg = end + 1;
+        }
+        return res;
+}
+
+static unsigned parse_unsigned(const string& str)
+{
+        char* end;
+        unsigned long res = strtoul(str.c_str(), &end, 10);
+        if (str.empty() || *end)
+                throw std::runtime_error(str + " is not a number");
+        return res;
+}
+
+int main( int argc, char* argv[] )
+{
+        static struct option longopts[] = {
+                { "help", 0, NULL, 'H' },
+                { "spacecraft", 1, 0, 's' },
+                { "time", 1, 0, 't' },
+                { "longitude", 1, 0, 'l' },
+                { "channels", 1, 0, 'c' },
+                { "missing", 1, 0, 'm' },
+                { "hrv-split", 1, 0, 'S' },
+                { "hrv-lower-west", 1, 0, 'L' },
+                { "hrv-upper-west", 1, 0, 'U' },
+                { 0, 0, 0, 0 },
+        };
+
+        SyntheticCycle cycle;
+        vector<string> missing;
+
+        try
+        {
+                bool done = false;
+                while (!done) {
+                        int c = getopt_long(argc, argv, "", longopts, (int*)0);
+                        switch (c) {
+                                case 'H': // --help
+                                        do_help(argv[0], cout);
+                                        return 0;
+                                case 's': cycle.spacecraft = optarg; break;
+                                case 't': cycle.timing = optarg; break;
+                                case 'l': cycle.longitude = strtod(optarg, NULL); break;
+                                case 'c': cycle.channels = split(optarg); break;
+                                case 'm': missing.push_back(optarg); break;
+                                case 'S': cycle.hrv_lower_north_line = parse_unsigned(optarg); break;
+                                case 'L': cycle.hrv_lower_west_column = parse_unsigned(optarg); break;
+                                case 'U': cycle.hrv_upper_west_column = parse_unsigned(optarg); break;
+                                case -1:
+                                        done = true;
+                                        break;
+                                default:
+                                        cerr << "Error parsing commandline." << endl;
+                                        do_help(argv[0], cerr);
+                                        return 1;
+                        }
+                }
+
+                if (optind != argc - 1)
+                {
+                        do_help(argv[0], cerr);
+                        return 1;
+                }
+                cycle.directory = argv[optind];
+
+                if (cycle.channels.empty())
+                        cycle.channels = SyntheticCycle::all_channels();
+
+                for (const auto& m: missing)
+                {
+                        size_t pos = m.find(':');
+                        vector<string> channels;
+                        if (pos == string::npos)
+                                channels = cycle.channels;
+                        else
+                                channels.push_back(m.substr(0, pos));
+                        for (const auto& s: split(pos == string::npos ? m : m.substr(pos + 1)))
+                                for (const auto& c: channels)
+                                        cycle.missing[c].insert(parse_unsigned(s));
+                }
+
+                cycle.write();
+        }
+        catch (std::exception& e)
+        {
+                cerr << e.what() << endl;
+                return 1;
+        }
+
+        for (const auto& c: cycle.channels)
+                cout << cycle.name(c) << endl;
+
+        return 0;
+}
+
+// vim:set ts=2 sw=2:
@@ -2,6 +2,7 @@
 #include <msat/facts.h>
 #include <msat/gdal/const.h>
 #include <msat/gdal/gdaltranslate.h>
+#include <msat/gdal/warp.h>
 
 #include "config.h"
 
@@ -16,11 +17,28 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <map>
+#include <set>
+#include <functional>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 
 #include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
 #include <getopt.h>
+#ifdef HAVE_HRIT
+#include <msat/xrit/slotindex.h>
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <climits>
+#endif
 
 using namespace std;
 
@@ -51,12 +69,33 @@ static void do_help(const char* argv0, ostream& out)
             << "  --resize='xx%,yy%'       Scale the output image by a given percentage." << endl
             << "  -b, --band='idx|name'    Raster band to process. Prefix with '!' to force interpretation as a name. Can be given multiple times." << endl
             << "  --force-calibration      Always calibrate, even if it would result in larger-than-needed output images" << endl
+            << "  --warp='latmin,latmax,lonmin,lonmax,step[,bilinear]'  Reproject the source image(s) to a" << endl
+            << "                   regular latitude/longitude grid with the given step in degrees." << endl
+            << "  --warp-table=FILE  With --warp, load the reprojection lookup table from FILE if it" << endl
+            << "                   matches the source grid, else compute it and save it to FILE." << endl
+            << "  --jobs=N         Process N input files in parallel (0 for one per CPU)." << endl
+            << "  --job-cache=MB   GDAL block cache size for each parallel job, in megabytes." << endl
+            << "  --composite=FILE Render the XRIT timeslot of each input file as the RGB composite" << endl
+            << "                   described in FILE (see examples/false-colour.rgb). Can be given" << endl
+            << "                   multiple times. --recipe is an alias." << endl
+#ifdef HAVE_HRIT
+            << "  --watch=DIR      Keep running, and convert xRIT timeslots arriving in DIR as soon" << endl
+            << "                   as the channels they need are complete." << endl
+            << "  --segments=F[-L] With --watch, convert channels as soon as segments F to L" << endl
+            << "                   are available (default: the full disk)." << endl
+#endif
             << endl
             << "Examples:" << endl
             << endl
             << " $ msat --display --Area=30,60,-10,40 file.grb" << endl
             << " $ msat --jpg file.grb" << endl
             << " $ msat --conv=MsatGRIB dir/H:MSG1:HRV:200611130800" << endl
+            << " $ msat --jobs=8 --conv=MsatNetCDF archive/*.grb" << endl
+            << " $ msat --warp=30,60,-10,40,0.05 --warp-table=europe.warp --conv=GTiff archive/*.grb" << endl
+            << " $ msat --composite=natural.rgb --conv=PNG dir/H:MSG2:VIS006:201001191200" << endl
+#ifdef HAVE_HRIT
+            << " $ msat --watch=/srv/ingest --recipe=natural.rgb --conv=GTiff" << endl
+#endif
             << endl
         ;
 }
@@ -97,23 +136,23 @@ static const char* known_md_domains[] = {
         NULL
 };
 
-static bool dumpMetadata(GDALMajorObject* o, const char* prefix = "")
+static bool dumpMetadata(ostream& out, GDALMajorObject* o, const char* prefix = "")
 {
         // Default domain
         if (char **md = o->GetMetadata())
         {
-                cout << prefix << "Metadata:" << endl;
+                out << prefix << "Metadata:" << endl;
                 for (char** s = md; md && *s; ++s)
-                        cout << prefix << "  " << *s << endl;
+                        out << prefix << "  " << *s << endl;
         }
         // Known domains
         for (const char** d = known_md_domains; *d; ++d)
         {
                 if (char** md = o->GetMetadata(*d))
                 {
-                        cout << prefix << "Metadata (" << *d << "):" << endl;
+                        out << prefix << "Metadata (" << *d << "):" << endl;
                         for (char** s = md; md && *s; ++s)
-                                cout << prefix << "  " << *s << endl;
+                                out << prefix << "  " << *s << endl;
                 }
         }
         return true;
@@ -139,16 +178,16 @@ static const char* gdalTypeName(GDALDataType dt)
         }
 }
 
-static bool printRasterBand(GDALRasterBand* band, bool withContents=false, const char* prefix="")
+static bool printRasterBand(ostream& out, GDALRasterBand* band, bool withContents=false, const char* prefix="")
 {
-        cout << prefix << "Size: " << band->GetXSize() << "x" << band->GetYSize() << endl;
-        cout << prefix << "Type: " << gdalTypeName(band->GetRasterDataType()) << endl;
-        cout << prefix << "Offset: " << band->GetOffset() << endl;
-        cout << prefix << "Scale: " << band->GetScale() << endl;
-        cout << prefix << "Unit: " << band->GetUnitType() << endl;
-        //cout << "Default filename: " << defaultFilename(*band) << endl;
-
-        if (!dumpMetadata(band, prefix))
+        out << prefix << "Size: " << band->GetXSize() << "x" << band->GetYSize() << endl;
+        out << prefix << "Type: " << gdalTypeName(band->GetRasterDataType()) << endl;
+        out << prefix << "Offset: " << band->GetOffset() << endl;
+        out << prefix << "Scale: " << band->GetScale() << endl;
+        out << prefix << "Unit: " << band->GetUnitType() << endl;
+        //out << "Default filename: " << defaultFilename(*band) << endl;
+
+        if (!dumpMetadata(out, band, prefix))
                 return false;
 
         double pixmin, pixmax, pixmean, pixstddev;
@@ -157,22 +196,22 @@ static bool printRasterBand(GDALRasterBand* band, bool withContents=false, const
 
         if (res == CE_None)
         {
-            cout << prefix << "Pixel range: min " << pixmin << " max " << pixmax
+            out << prefix << "Pixel range: min " << pixmin << " max " << pixmax
                  << " mean " << pixmean << " stddev " << pixstddev << endl;
         }
 
         return true;
 }
 
-static bool printDataset(GDALDataset* ds, bool withContents=false)
+static bool printDataset(ostream& out, GDALDataset* ds, bool withContents=false)
 {
-        cout << "Dataset: " << ds->GetDescription() << endl;
-        cout << "Size: " << ds->GetRasterXSize() << "x" << ds->GetRasterYSize() << endl;
-        cout << "Projection: " << ds->GetProjectionRef() << endl;
+        out << "Dataset: " << ds->GetDescription() << endl;
+        out << "Size: " << ds->GetRasterXSize() << "x" << ds->GetRasterYSize() << endl;
+        out << "Projection: " << ds->GetProjectionRef() << endl;
 
         double geoTransform[6];
         ds->GetGeoTransform(geoTransform);
-        cout << "Geotransform matrix: " << endl
+        out << "Geotransform matrix: " << endl
                  << "  "
                  << setw(10) << geoTransform[0] << ",\t" << setw(10) << geoTransform[1] << ",\t" << setw(10) << geoTransform[2]
                  << endl
@@ -180,7 +219,7 @@ static bool printDataset(GDALDataset* ds, bool withContents=false)
                  << setw(10) << geoTransform[3] << ",\t" << setw(10) << geoTransform[4] << ",\t" << setw(10) << geoTransform[5]
                  << endl;
 
-        if (!dumpMetadata(ds))
+        if (!dumpMetadata(out, ds))
                 return false;
 
 #if 0
@@ -188,25 +227,36 @@ static bool printDataset(GDALDataset* ds, bool withContents=false)
         GeoReferencer georef(&img);
         double lat, lon;
         georef.pixelToLatlon(0, 0, lat, lon);
-        cout << "Coordinates of the top left pixel " << lat << "," << lon << endl;
+        out << "Coordinates of the top left pixel " << lat << "," << lon << endl;
         georef.pixelToLatlon(ds->GetRasterXSize(), ds->GetRasterYSize(), lat, lon);
-        cout << "Coordinates of the bottom right pixel " << lat << "," << lon << endl;
-        cout << "Default filename: " << defaultFilename(img) << endl;
+        out << "Coordinates of the bottom right pixel " << lat << "," << lon << endl;
+        out << "Default filename: " << defaultFilename(img) << endl;
 #endif
 
         for (int i = 1; i <= ds->GetRasterCount(); ++i)
         {
                 GDALRasterBand* rb = ds->GetRasterBand(i);
-                cout << "Raster band "
+                out << "Raster band "
                      << i << "/" << ds->GetRasterCount()
                      << ": " << rb->GetDescription() << endl;
-                if (!printRasterBand(rb, withContents, "  "))
+                if (!printRasterBand(out, rb, withContents, "  "))
                         return false;
         }
 
         return true;
 }
 
+// Print the performance counters of a dataset. They are printed after
+// everything else, to account for the data read to compute the statistics
+static void printStats(ostream& out, GDALDataset* ds)
+{
+        char** md = ds->GetMetadata(MD_DOMAIN_MSAT_STATS);
+        if (!md) return;
+        out << "Metadata (" MD_DOMAIN_MSAT_STATS "):" << endl;
+        for (char** s = md; *s; ++s)
+                out << "  " << *s << endl;
+}
+
 static void escapeSpacesAndDots(std::string& str)
 {
         for (string::iterator i = str.begin(); i != str.end(); ++i)
@@ -281,6 +331,70 @@ static std::string output_file_name(GDALDataset* ds, GDALRasterBand* rb = NULL)
         return res;
 }
 
+/// Name to open the composite of \a recipe for the XRIT file \a pathname
+static std::string composite_name(const std::string& recipe, const std::string& pathname)
+{
+        return "MSATCOMPOSITE:" + recipe + ":" + pathname;
+}
+
+/// Recipe file of a composite name, or an empty string for other names
+static std::string composite_recipe(const std::string& pathname)
+{
+        if (pathname.compare(0, 14, "MSATCOMPOSITE:") != 0)
+                return string();
+        return pathname.substr(14, pathname.find(':', 14) - 14);
+}
+
+/// Name of a recipe for output files: its file name without extension
+static std::string recipe_name(const std::string& recipe)
+{
+        size_t pos = recipe.rfind('/');
+        string res = pos == string::npos ? recipe : recipe.substr(pos + 1);
+        pos = res.rfind('.');
+        if (pos != string::npos && pos > 0)
+                res.resize(pos);
+        escapeSpacesAndDots(res);
+        return res;
+}
+
+#ifdef HAVE_HRIT
+/**
+ * Add to \a channels the XRIT channels needed to render the composite in
+ * \a recipe, returning false if the recipe cannot be read
+ */
+static bool recipe_channels(const std::string& recipe, std::set<std::string>& channels)
+{
+        FILE* in = fopen(recipe.c_str(), "rt");
+        if (!in) return false;
+        char line[1024];
+        while (fgets(line, sizeof(line), in))
+        {
+                char name[32];
+                char channel[32];
+                if (sscanf(line, " %31s %31s", name, channel) != 2 || name[0] == '#')
+                        continue;
+                string chan(channel);
+                if (chan.back() == 'r')
+                {
+                        chan.pop_back();
+                        // The IR_039 reflectance also needs IR_108 and IR_134
+                        if (chan == "IR_039")
+                        {
+                                channels.insert("IR_108");
+                                channels.insert("IR_134");
+                        }
+                }
+                channels.insert(chan);
+        }
+        fclose(in);
+        return true;
+}
+#endif
+
+// Files that GDAL drivers can write next to an output file, named by
+// appending a suffix to its name
+static const char* sidecar_suffixes[] = { ".aux.xml", ".ovr", ".msk" };
+
 static void parseBands(GDALTranslate& translate, const std::string& arg)
 {
 
@@ -288,12 +402,42 @@ static void parseBands(GDALTranslate& translate, const std::string& arg)
 
 enum Action { VIEW, VIEWMORE, CONVERT, JPG, PNG, DISPLAY };
 
+/// State for processing one input file
+struct Job
+{
+    // Position in the list of input files
+    size_t index;
+    string pathname;
+
+    // Dataset transformation for this file
+    GDALTranslate translate;
+    string scaleX, scaleY;
+
+    // Where to send output and diagnostics: cout and cerr, or the buffers
+    // below when running in parallel
+    ostream* out;
+    ostream* err;
+    ostringstream out_buffer;
+    ostringstream err_buffer;
+
+    // Outcome of processing
+    bool done = false;
+    bool ok = false;
+    string error;
+
+    Job(size_t index, const string& pathname, bool buffered)
+        : index(index), pathname(pathname),
+          out(buffered ? &out_buffer : &cout), err(buffered ? &err_buffer : &cerr)
+    {
+    }
+};
+
 struct Msat
 {
     // Defaults to view
     Action action;
 
-    // Dataset transformation
+    // Dataset transformation given on the command line
     GDALTranslate translate;
     string scaleX, scaleY;
     double lat[2];
@@ -311,6 +455,23 @@ struct Msat
     // Input files to process
     vector<string> input_files;
 
+    // Recipe files for RGB composites
+    vector<string> recipes;
+
+    // Directory to watch for arriving xRIT files
+    string watch_dir;
+
+    // Segments needed to convert a channel in watch mode (0 for a full disk)
+    unsigned first_segment;
+    unsigned last_segment;
+
+    // Number of input files to process in parallel
+    unsigned jobs;
+
+    // GDAL block cache budget for each job, in megabytes (0 to keep the
+    // GDAL default)
+    size_t job_cache;
+
     // Cap to the maximum image size to generate (0 for no cap)
     size_t maxx;
     size_t maxy;
@@ -320,12 +481,29 @@ struct Msat
 
     bool force_calibration;
 
+    // Target grid for --warp (width is 0 if not warping)
+    msat::dataset::LatLonGrid warp_grid;
+    bool warp_bilinear;
+
+    // File where the warp lookup table is cached
+    string warp_table_file;
+
+    // Warp lookup table for the last source grid seen, shared by all jobs
+    std::mutex warp_mutex;
+    std::shared_ptr<const msat::dataset::WarpTable> warp_table;
+
 #ifdef HAVE_MAGICKPP
     msat::Stretch stretch;
 #endif
 
+    // Output files written by parallel jobs, and the index of the input
+    // file that wrote them
+    std::mutex outputs_mutex;
+    std::map<string, size_t> outputs;
+
     Msat()
-        : action(VIEW), quiet(false), force_calibration(false)
+        : action(VIEW), quiet(false), first_segment(0), last_segment(0),
+          jobs(1), job_cache(0), force_calibration(false), warp_bilinear(false)
     {
         lat[0] = lat[1] = 0;
         lon[0] = lon[1] = 0;
@@ -334,7 +512,43 @@ struct Msat
     void parse_cmdline(int argc, char* argv[]);
     int main();
 
-    void scale_if_needed(GDALDataset& ds)
+    /// Process all input files one after the other
+    int run_sequential();
+
+    /// Process all input files on a pool of worker threads
+    int run_parallel();
+
+    /**
+     * Print the number of files processed and the list of those that
+     * failed. Returns the exit status of the program.
+     */
+    int summarize(const vector<string>& failed, unsigned nthreads);
+
+#ifdef HAVE_HRIT
+    /// Convert timeslots arriving in watch_dir, as they complete
+    int run_watch();
+#endif
+
+    /// Open, transform and output one input file
+    bool process(Job& job);
+
+    /**
+     * Get the warp lookup table for the grid of \a ds, loading or computing
+     * it if needed. Returns an empty pointer and sets job.error on failure.
+     */
+    std::shared_ptr<const msat::dataset::WarpTable> get_warp_table(Job& job, GDALDataset& ds);
+
+    /**
+     * Create an output file by calling \a write with its pathname.
+     *
+     * When running in parallel, the file is written to a temporary name and
+     * renamed at the end, together with its sidecar files. If more input
+     * files produce the same output name, the one coming last in the input
+     * list wins, as it would when running sequentially.
+     */
+    bool write_output(Job& job, const string& basename, const char* ext, std::function<bool(const std::string&)> write);
+
+    void scale_if_needed(Job& job, GDALDataset& ds)
     {
         // Scale down image to fit in maxx x maxy
         size_t sx = ds.GetRasterXSize();
@@ -353,13 +567,13 @@ struct Msat
         }
         if (tx != sx && ty != sy)
         {
-            cerr << "Note: image scaled down to " << tx << "x" << ty << " to prevent excessive memory usage." << endl;
-            cerr << "      you can set one of --area, --Area, --around, or --resize to prevent this." << endl;
+            *job.err << "Note: image scaled down to " << tx << "x" << ty << " to prevent excessive memory usage." << endl;
+            *job.err << "      you can set one of --area, --Area, --around, or --resize to prevent this." << endl;
             char buf[16];
-            snprintf(buf, 16, "%zd", tx); scaleX = buf;
-            snprintf(buf, 16, "%zd", ty); scaleY = buf;
-            translate.pszOXSize = scaleX.c_str();
-            translate.pszOYSize = scaleY.c_str();
+            snprintf(buf, 16, "%zd", tx); job.scaleX = buf;
+            snprintf(buf, 16, "%zd", ty); job.scaleY = buf;
+            job.translate.pszOXSize = job.scaleX.c_str();
+            job.translate.pszOYSize = job.scaleY.c_str();
         }
     }
 };
@@ -386,6 +600,16 @@ void Msat::parse_cmdline(int argc, char* argv[])
             { "resize", 1, 0, 'r' },
             { "band", 1, 0, 'b' },
             { "force-calibration", 0, NULL, 'F' },
+            { "warp", 1, NULL, 'w' },
+            { "warp-table", 1, NULL, 'T' },
+            { "jobs", 1, NULL, 'J' },
+            { "job-cache", 1, NULL, 'K' },
+            { "composite", 1, NULL, 'G' },
+            { "recipe", 1, NULL, 'G' },
+#ifdef HAVE_HRIT
+            { "watch", 1, NULL, 'W' },
+            { "segments", 1, NULL, 'Z' },
+#endif
 #ifdef HAVE_MAGICKPP
             { "stretch", 1, 0, 'S' },
             { "jpg",  0, NULL, 'j' },
@@ -483,6 +707,54 @@ void Msat::parse_cmdline(int argc, char* argv[])
                     case 'F': // --force-calibration
                         force_calibration = true;
                         break;
+                    case 'w': { // --warp
+                        string arg(optarg);
+                        size_t pos = arg.find(",bilinear");
+                        if (pos != string::npos && pos + 9 == arg.size())
+                        {
+                            warp_bilinear = true;
+                            arg.resize(pos);
+                        }
+                        if (!warp_grid.parse(arg))
+                        {
+                            cerr << CPLGetLastErrorMsg() << endl;
+                            do_help(argv[0], cerr);
+                            exit(1);
+                        }
+                        break;
+                    }
+                    case 'T': // --warp-table
+                        warp_table_file = optarg;
+                        break;
+                    case 'J': // --jobs
+                        jobs = strtoul(optarg, NULL, 10);
+                        if (jobs == 0)
+                            jobs = std::max(1u, std::thread::hardware_concurrency());
+                        break;
+                    case 'K': // --job-cache
+                        job_cache = strtoul(optarg, NULL, 10);
+                        break;
+                    case 'G': // --composite, --recipe
+                        recipes.push_back(optarg);
+                        break;
+#ifdef HAVE_HRIT
+                    case 'W': // --watch
+                        watch_dir = optarg;
+                        break;
+                    case 'Z': { // --segments
+                        char* endptr;
+                        first_segment = last_segment = strtoul(optarg, &endptr, 10);
+                        if (*endptr == '-')
+                            last_segment = strtoul(endptr + 1, &endptr, 10);
+                        if (*endptr || first_segment == 0 || last_segment < first_segment)
+                        {
+                            cerr << "segments should be in the format first[-last]" << endl;
+                            do_help(argv[0], cerr);
+                            exit(1);
+                        }
+                        break;
+                    }
+#endif
 #ifdef HAVE_MAGICKPP
                     case 'j': // --jpg
                             action = JPG;
@@ -521,14 +793,30 @@ void Msat::parse_cmdline(int argc, char* argv[])
             }
     }
 
-    if (optind == argc)
+    if (optind == argc && watch_dir.empty())
     {
             do_help(argv[0], cerr);
             exit(1);
     }
 
     for (int i = optind; i < argc; ++i)
-        input_files.push_back(argv[i]);
+    {
+        if (recipes.empty())
+            input_files.push_back(argv[i]);
+        else
+            for (const auto& recipe: recipes)
+                input_files.push_back(composite_name(recipe, argv[i]));
+    }
+
+    // Windows need to be shown one at a time, and the watch mode converts
+    // a timeslot at a time
+    if (action == DISPLAY || !watch_dir.empty())
+        jobs = 1;
+
+    // When working one file at a time, composites of the same timeslot can
+    // share the decoded channels
+    if (jobs <= 1 && !recipes.empty())
+        CPLSetConfigOption("MSAT_COMPOSITE_CACHE", "1");
 
 #if 0 // TODO
     if (!quiet)
@@ -559,212 +847,632 @@ int rbindex_by_name(GDALDataset& ds, const std::string& name)
 }
 }
 
-int Msat::main()
+bool Msat::process(Job& job)
 {
-    for (vector<string>::const_iterator i = input_files.begin(); i != input_files.end(); ++i)
+    // Start from the transformation given on the command line
+    for (int i = 0; i < 4; ++i)
+        job.translate.anSrcWin[i] = translate.anSrcWin[i];
+    job.translate.dfULX = translate.dfULX;
+    job.translate.dfULY = translate.dfULY;
+    job.translate.dfLRX = translate.dfLRX;
+    job.translate.dfLRY = translate.dfLRY;
+    job.scaleX = scaleX;
+    job.scaleY = scaleY;
+    if (translate.pszOXSize)
     {
-            unique_ptr<GDALDataset> dataset((GDALDataset*)GDALOpen(i->c_str(), GA_ReadOnly));
-            if (dataset.get() == NULL)
-            {
-                    cerr << CPLGetLastErrorMsg() << endl;
-                    return 1;
-            }
+        job.translate.pszOXSize = job.scaleX.c_str();
+        job.translate.pszOYSize = job.scaleY.c_str();
+    }
 
-            unique_ptr<GDALDataset> ds_orig;
-            if (force_calibration)
-            {
-                ds_orig = move(dataset);
-                dataset.reset(new msat::dataset::CalibratedDataset(*ds_orig));
-            }
+    unique_ptr<GDALDataset> dataset((GDALDataset*)GDALOpen(job.pathname.c_str(), GA_ReadOnly));
+    if (dataset.get() == NULL)
+    {
+            job.error = CPLGetLastErrorMsg();
+            return false;
+    }
+
+    unique_ptr<GDALDataset> ds_orig;
+    if (force_calibration)
+    {
+        ds_orig = move(dataset);
+        dataset.reset(new msat::dataset::CalibratedDataset(*ds_orig));
+    }
+
+    // Reproject before anything else, so that --Area and --around work on
+    // the regular grid
+    unique_ptr<GDALDataset> ds_unwarped;
+    if (warp_grid.width != 0)
+    {
+        std::shared_ptr<const msat::dataset::WarpTable> table = get_warp_table(job, *dataset);
+        if (!table) return false;
+        ds_unwarped = move(dataset);
+        dataset.reset(new msat::dataset::WarpedDataset(*ds_unwarped, table));
+    }
 
-            // Create source band list using band_list
-            if (!band_list.empty())
+    // Create source band list using band_list
+    if (!band_list.empty())
+    {
+        int* bands = (int*)CPLMalloc(band_list.size() * sizeof(int));
+        int band_count = 0;
+        for (vector<string>::const_iterator bi = band_list.begin();
+                bi != band_list.end(); ++bi)
+        {
+            if (bi->empty()) continue;
+            const char* sptr = bi->c_str();
+            char* endptr;
+            unsigned long int idx = strtoul(sptr, &endptr, 10);
+            if (endptr - sptr == (signed)bi->size())
             {
-                int* bands = (int*)CPLMalloc(band_list.size() * sizeof(int));
-                int band_count = 0;
-                for (vector<string>::const_iterator bi = band_list.begin();
-                        bi != band_list.end(); ++bi)
-                {
-                    if (bi->empty()) continue;
-                    const char* sptr = bi->c_str();
-                    char* endptr;
-                    unsigned long int idx = strtoul(sptr, &endptr, 10);
-                    if (endptr - sptr == (signed)bi->size())
-                    {
-                        // If it is an integer, use it literally
-                        bands[band_count++] = idx;
-                    } else {
-                        // If it is a string, remove leading bang (if any)
-                        // and lookup in raster band descriptions
-                        string name = *bi;
-                        if (name[0] == '!')
-                            name = name.substr(1);
-                        idx = rbindex_by_name(*dataset, name);
-                        if (idx != 0)
-                            bands[band_count++] = idx;
-                    }
-                }
-                // If there are no bands to process in this dataset, move on to the next one
-                if (band_count == 0)
-                {
-                    CPLFree(bands);
-                    continue;
-                }
+                // If it is an integer, use it literally
+                bands[band_count++] = idx;
+            } else {
+                // If it is a string, remove leading bang (if any)
+                // and lookup in raster band descriptions
+                string name = *bi;
+                if (name[0] == '!')
+                    name = name.substr(1);
+                idx = rbindex_by_name(*dataset, name);
+                if (idx != 0)
+                    bands[band_count++] = idx;
+            }
+        }
+        // If there are no bands to process in this dataset, move on to the next one
+        if (band_count == 0)
+        {
+            CPLFree(bands);
+            return true;
+        }
 
-                translate.panBandList = bands;
-                translate.nBandCount = band_count;
-                translate.bDefBands = TRUE;
-                if (band_count != dataset->GetRasterCount())
-                    translate.bDefBands = FALSE;
-                else
+        job.translate.panBandList = bands;
+        job.translate.nBandCount = band_count;
+        job.translate.bDefBands = TRUE;
+        if (band_count != dataset->GetRasterCount())
+            job.translate.bDefBands = FALSE;
+        else
+        {
+            for (int ci = 0; ci < band_count; ++ci)
+                if (bands[ci] != ci + 1)
                 {
-                    for (int ci = 0; ci < band_count; ++ci)
-                        if (bands[ci] != ci + 1)
-                        {
-                            translate.bDefBands = FALSE;
-                            break;
-                        }
+                    job.translate.bDefBands = FALSE;
+                    break;
                 }
-            }
+        }
+    }
 
-            // If --Area is given, we can only resolve it to pixel
-            // sizes once we have the dataset
-            if (lat[0] != 0 || lat[1] != 0 || lon[0] != 0 || lon[1] != 0)
+    // If --Area is given, we can only resolve it to pixel
+    // sizes once we have the dataset
+    if (lat[0] != 0 || lat[1] != 0 || lon[0] != 0 || lon[1] != 0)
+    {
+            msat::dataset::GeoReferencer gr;
+            if (gr.init(dataset.get()) != CE_None)
             {
-                    msat::dataset::GeoReferencer gr;
-                    if (gr.init(dataset.get()) != CE_None)
+                    job.error = CPLGetLastErrorMsg();
+                    return false;
+            }
+            int xmin = dataset->GetRasterXSize(),
+                ymin = dataset->GetRasterYSize(),
+                xmax = 0, ymax = 0;
+            for (size_t i = 0; i < 2; ++i)
+                    for (size_t j = 0; j < 2; ++j)
                     {
-                            cerr << CPLGetLastErrorMsg() << endl;
-                            return 1;
-                    }
-                    int xmin = dataset->GetRasterXSize(),
-                        ymin = dataset->GetRasterYSize(),
-                        xmax = 0, ymax = 0;
-                    for (size_t i = 0; i < 2; ++i)
-                            for (size_t j = 0; j < 2; ++j)
+                            int x, y;
+                            if (gr.latlonToPixel(lat[i], lon[j], x, y) != CE_None)
                             {
-                                    int x, y;
-                                    if (gr.latlonToPixel(lat[i], lon[j], x, y) != CE_None)
-                                    {
-                                            cerr << CPLGetLastErrorMsg() << endl;
-                                            return 1;
-                                    }
-                                    if (x < xmin) xmin = x;
-                                    if (x > xmax) xmax = x;
-                                    if (y < ymin) ymin = y;
-                                    if (y > ymax) ymax = y;
+                                    job.error = CPLGetLastErrorMsg();
+                                    return false;
                             }
+                            if (x < xmin) xmin = x;
+                            if (x > xmax) xmax = x;
+                            if (y < ymin) ymin = y;
+                            if (y > ymax) ymax = y;
+                    }
 
-                    translate.anSrcWin[0] = xmin;
-                    translate.anSrcWin[1] = ymin;
-                    translate.anSrcWin[2] = xmax - xmin;
-                    translate.anSrcWin[3] = ymax - ymin;
-            }
+            job.translate.anSrcWin[0] = xmin;
+            job.translate.anSrcWin[1] = ymin;
+            job.translate.anSrcWin[2] = xmax - xmin;
+            job.translate.anSrcWin[3] = ymax - ymin;
+    }
 
-            scale_if_needed(*dataset);
+    scale_if_needed(job, *dataset);
 
-            GDALDataset* vds = translate.translate(dataset.get());
-            //translate.dump(cerr);
+    GDALDataset* vds = job.translate.translate(dataset.get());
+    if (vds == NULL)
+    {
+            job.error = CPLGetLastErrorMsg();
+            return false;
+    }
+    //translate.dump(cerr);
 
-            if (!mdtemplate.empty())
-            {
-                    unique_ptr<GDALDataset> mdds((GDALDataset*)GDALOpen(mdtemplate.c_str(), GA_ReadOnly));
+    if (!mdtemplate.empty())
+    {
+            unique_ptr<GDALDataset> mdds((GDALDataset*)GDALOpen(mdtemplate.c_str(), GA_ReadOnly));
 
-                    // Copy metadata from mdds to vds
-                    vds->SetDescription(mdds->GetDescription());
-                    vds->SetMetadata(mdds->GetMetadata());
+            // Copy metadata from mdds to vds
+            vds->SetDescription(mdds->GetDescription());
+            vds->SetMetadata(mdds->GetMetadata());
 
-                    // Copy raster band metadata from mdds to vds
-                    for (int i = 1; i <= vds->GetRasterCount(); ++i)
+            // Copy raster band metadata from mdds to vds
+            for (int i = 1; i <= vds->GetRasterCount(); ++i)
+            {
+                    GDALRasterBand* mdr = mdds->GetRasterBand(i);
+                    if (mdr != NULL)
                     {
-                            GDALRasterBand* mdr = mdds->GetRasterBand(i);
-                            if (mdr != NULL)
-                            {
-                                    GDALRasterBand* vr = vds->GetRasterBand(i);
-                                    vr->SetDescription(mdr->GetDescription());
-                                    vr->SetMetadata(mdr->GetMetadata());
-                            }
+                            GDALRasterBand* vr = vds->GetRasterBand(i);
+                            vr->SetDescription(mdr->GetDescription());
+                            vr->SetMetadata(mdr->GetMetadata());
                     }
             }
+    }
 
-            switch (action)
-            {
-                    case VIEW:
-                            printDataset(vds, false);
-                            break;
-                    case VIEWMORE:
-                            printDataset(vds, true);
+    bool ok = true;
+    switch (action)
+    {
+            case VIEW:
+                    printDataset(*job.out, vds, false);
+                    printStats(*job.out, dataset.get());
+                    break;
+            case VIEWMORE:
+                    printDataset(*job.out, vds, true);
+                    printStats(*job.out, dataset.get());
+                    break;
+            case CONVERT: {
+                    GDALDriverH driver = GDALGetDriverByName(outdriver.c_str());
+                    if (driver == NULL)
+                    {
+                            job.error = "Driver for \"" + outdriver + "\" not found (see gdalinfo --formats)";
+                            ok = false;
                             break;
-                    case CONVERT: {
-                            GDALDriverH driver = GDALGetDriverByName(outdriver.c_str());
-                            if (driver == NULL)
-                            {
-
-                                    cerr << "Driver for \"" << outdriver << "\" not found (see gdalinfo --formats)" << endl;
-                                    return 1;
-                            }
-
-                            const char* ext = GDALGetMetadataItem(driver, GDAL_DMD_EXTENSION, NULL);
+                    }
 
-                            string fname = output_file_name(vds);
-                            if (ext != NULL)
-                            {
-                                    fname += ".";
-                                    fname += ext;
-                            }
+                    const char* ext = GDALGetMetadataItem(driver, GDAL_DMD_EXTENSION, NULL);
+                    string basename = output_file_name(vds);
+                    string recipe = composite_recipe(job.pathname);
+                    if (!recipe.empty())
+                            basename += "_" + recipe_name(recipe);
+                    ok = write_output(job, basename, ext, [&](const std::string& fname) {
                             GDALDatasetH outds = GDALCreateCopy(driver, fname.c_str(), vds,
                                             TRUE, NULL,
                                             GDALDummyProgress, NULL);
                             if (outds == NULL)
                             {
-                                    cerr << CPLGetLastErrorMsg() << endl;
-                                    return 1;
+                                    job.error = CPLGetLastErrorMsg();
+                                    return false;
                             }
                             GDALClose(outds);
-                            break;
-                    }
+                            return true;
+                    });
+                    break;
+            }
 #ifdef HAVE_MAGICKPP
-                    case JPG:
-                            for (int i = 1; i <= vds->GetRasterCount(); ++i)
-                            {
-                                    GDALRasterBand* rb = vds->GetRasterBand(i);
-                                    string fname = output_file_name(vds, rb) + ".jpg";
-                                    if (!msat::export_image(rb, fname.c_str(), stretch))
-                                    {
-                                            cerr << CPLGetLastErrorMsg() << endl;
-                                            return 1;
-                                    }
-                            }
-                            break;
-                    case PNG:
-                            for (int i = 1; i <= vds->GetRasterCount(); ++i)
+            case JPG:
+                    for (int i = 1; ok && i <= vds->GetRasterCount(); ++i)
+                    {
+                            GDALRasterBand* rb = vds->GetRasterBand(i);
+                            ok = write_output(job, output_file_name(vds, rb), "jpg", [&](const std::string& fname) {
+                                    if (msat::export_image(rb, fname.c_str(), stretch))
+                                            return true;
+                                    job.error = CPLGetLastErrorMsg();
+                                    return false;
+                            });
+                    }
+                    break;
+            case PNG:
+                    for (int i = 1; ok && i <= vds->GetRasterCount(); ++i)
+                    {
+                            GDALRasterBand* rb = vds->GetRasterBand(i);
+                            ok = write_output(job, output_file_name(vds, rb), "png", [&](const std::string& fname) {
+                                    if (msat::export_image(rb, fname.c_str(), stretch))
+                                            return true;
+                                    job.error = CPLGetLastErrorMsg();
+                                    return false;
+                            });
+                    }
+                    break;
+            case DISPLAY:
+                    for (int i = 1; ok && i <= vds->GetRasterCount(); ++i)
+                            if (!msat::display_image(vds->GetRasterBand(i), stretch))
                             {
-                                    GDALRasterBand* rb = vds->GetRasterBand(i);
-                                    string fname = output_file_name(vds, rb) + ".png";
-                                    if (!msat::export_image(rb, fname.c_str(), stretch))
-                                    {
-                                            cerr << CPLGetLastErrorMsg() << endl;
-                                            return 1;
-                                    }
+                                    job.error = CPLGetLastErrorMsg();
+                                    ok = false;
                             }
-                            break;
-                    case DISPLAY:
-                            for (int i = 1; i <= vds->GetRasterCount(); ++i)
-                                    if (!msat::display_image(vds->GetRasterBand(i), stretch))
-                                    {
-                                            cerr << CPLGetLastErrorMsg() << endl;
-                                            return 1;
-                                    }
-                            break;
+                    break;
 #endif
-                    default:
-                            throw std::runtime_error("unsupported action");
+            default:
+                    throw std::runtime_error("unsupported action");
+    }
+
+    if (vds != dataset.get())
+            GDALClose( (GDALDatasetH) vds );
+    return ok;
+}
+
+std::shared_ptr<const msat::dataset::WarpTable> Msat::get_warp_table(Job& job, GDALDataset& ds)
+{
+    using namespace msat::dataset;
+
+    // Images of the same satellite share the grid, and with it the table
+    std::lock_guard<std::mutex> lock(warp_mutex);
+    if (warp_table && warp_table->matches(&ds))
+        return warp_table;
+
+    std::shared_ptr<WarpTable> table(new WarpTable);
+    if (!warp_table_file.empty() && access(warp_table_file.c_str(), F_OK) == 0)
+    {
+        if (table->load(warp_table_file)
+                && table->grid == warp_grid && table->bilinear == warp_bilinear
+                && table->matches(&ds))
+        {
+            warp_table = table;
+            return warp_table;
+        }
+        if (!quiet)
+            *job.err << warp_table_file << ": lookup table does not match " << job.pathname << ": recomputing it" << endl;
+        table.reset(new WarpTable);
+    }
+
+    if (!table->compute(&ds, warp_grid, warp_bilinear))
+    {
+        job.error = CPLGetLastErrorMsg();
+        return std::shared_ptr<const WarpTable>();
+    }
+    if (!warp_table_file.empty() && !table->save(warp_table_file))
+    {
+        job.error = CPLGetLastErrorMsg();
+        return std::shared_ptr<const WarpTable>();
+    }
+    warp_table = table;
+    return warp_table;
+}
+
+bool Msat::write_output(Job& job, const string& basename, const char* ext, std::function<bool(const std::string&)> write)
+{
+    string fname = basename;
+    if (ext != NULL)
+    {
+        fname += ".";
+        fname += ext;
+    }
+
+    if (jobs <= 1)
+        return write(fname);
+
+    string tmpname = basename + ".part" + to_string(job.index);
+    if (ext != NULL)
+    {
+        tmpname += ".";
+        tmpname += ext;
+    }
+
+    auto remove_tmp = [&] {
+        unlink(tmpname.c_str());
+        for (const char* suffix: sidecar_suffixes)
+            unlink((tmpname + suffix).c_str());
+    };
+
+    if (!write(tmpname))
+    {
+        remove_tmp();
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(outputs_mutex);
+    auto i = outputs.find(fname);
+    if (i != outputs.end() && i->second > job.index)
+    {
+        *job.err << fname << ": not written for " << job.pathname << ", as it is also written for " << input_files[i->second] << endl;
+        remove_tmp();
+        return true;
+    }
+    if (rename(tmpname.c_str(), fname.c_str()) != 0)
+    {
+        job.error = "cannot rename " + tmpname + " to " + fname + ": " + strerror(errno);
+        remove_tmp();
+        return false;
+    }
+    // Move the sidecar files along, and remove those left by a previous
+    // output, as GDALCreateCopy does when overwriting a file
+    for (const char* suffix: sidecar_suffixes)
+    {
+        string src = tmpname + suffix;
+        string dst = fname + suffix;
+        if (rename(src.c_str(), dst.c_str()) == 0)
+            continue;
+        if (errno != ENOENT)
+        {
+            job.error = "cannot rename " + src + " to " + dst + ": " + strerror(errno);
+            remove_tmp();
+            return false;
+        }
+        unlink(dst.c_str());
+    }
+    if (i != outputs.end())
+        *job.err << fname << ": written for " << job.pathname << ", replacing the one for " << input_files[i->second] << endl;
+    outputs[fname] = job.index;
+    return true;
+}
+
+int Msat::run_sequential()
+{
+    vector<string> failed;
+    for (size_t i = 0; i < input_files.size(); ++i)
+    {
+        Job job(i, input_files[i], false);
+        bool ok;
+        try {
+            ok = process(job);
+        } catch (std::exception& e) {
+            job.error = e.what();
+            ok = false;
+        }
+        if (!ok)
+        {
+            cerr << job.pathname << ": " << job.error << endl;
+            failed.push_back(job.pathname);
+        }
+    }
+
+    // A single file needs no summary besides its error
+    if (input_files.size() == 1)
+        return failed.empty() ? 0 : 1;
+    return summarize(failed, 1);
+}
+
+int Msat::run_parallel()
+{
+    unsigned nthreads = std::min<size_t>(jobs, input_files.size());
+
+    // The GDAL block cache is shared by all threads: size it to give each
+    // job its budget
+    if (job_cache)
+        GDALSetCacheMax64((GIntBig)job_cache * 1024 * 1024 * nthreads);
+
+    vector<unique_ptr<Job>> all_jobs;
+    for (size_t i = 0; i < input_files.size(); ++i)
+        all_jobs.emplace_back(new Job(i, input_files[i], true));
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next_job = 0;
+
+    auto worker = [&] {
+        while (true)
+        {
+            Job* job;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (next_job == all_jobs.size()) return;
+                job = all_jobs[next_job++].get();
+            }
+
+            bool ok;
+            try {
+                ok = process(*job);
+            } catch (std::exception& e) {
+                job->error = e.what();
+                ok = false;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job->ok = ok;
+                job->done = true;
+            }
+            cond.notify_all();
+        }
+    };
+
+    vector<std::thread> workers;
+    for (unsigned i = 0; i < nthreads; ++i)
+        workers.emplace_back(worker);
+
+    // Print the output of each job in input order, as it becomes available
+    vector<string> failed;
+    for (size_t i = 0; i < all_jobs.size(); ++i)
+    {
+        Job* job = all_jobs[i].get();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return job->done; });
+        }
+        cout << job->out_buffer.str();
+        cerr << job->err_buffer.str();
+        if (!job->ok)
+        {
+            cerr << job->pathname << ": " << job->error << endl;
+            failed.push_back(job->pathname);
+        }
+        // Workers are done with it: free its memory
+        all_jobs[i].reset();
+    }
+
+    for (auto& w: workers)
+        w.join();
+
+    return summarize(failed, nthreads);
+}
+
+int Msat::summarize(const vector<string>& failed, unsigned nthreads)
+{
+    if (!quiet)
+    {
+        cerr << input_files.size() << " files processed with " << nthreads << " jobs: "
+             << input_files.size() - failed.size() << " succeeded, " << failed.size() << " failed." << endl;
+        for (const auto& f: failed)
+            cerr << "  failed: " << f << endl;
+    }
+
+    return failed.empty() ? 0 : 1;
+}
+
+#ifdef HAVE_HRIT
+int Msat::run_watch()
+{
+    // What to make for each timeslot: the composites of the recipes if
+    // given, else each channel on its own
+    vector<std::set<string>> recipe_needs;
+    for (const auto& recipe: recipes)
+    {
+        std::set<string> channels;
+        if (!recipe_channels(recipe, channels))
+        {
+            cerr << recipe << ": cannot read recipe: " << strerror(errno) << endl;
+            return 1;
+        }
+        recipe_needs.push_back(channels);
+    }
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+    {
+        cerr << "cannot initialise inotify: " << strerror(errno) << endl;
+        return 1;
+    }
+    if (inotify_add_watch(fd, watch_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        cerr << watch_dir << ": cannot watch directory: " << strerror(errno) << endl;
+        close(fd);
+        return 1;
+    }
+
+    msat::xrit::SlotIndex index(watch_dir);
+    index.first_segment = first_segment;
+    index.last_segment = last_segment;
+
+    // Products already made (or skipped) for each timeslot, by slot key
+    std::map<string, std::set<string>> made;
+    size_t job_index = 0;
+
+    // Make the products that became possible for a timeslot. If convert is
+    // false, just mark them as done
+    auto update = [&](const msat::xrit::Slot& slot, bool convert) {
+        std::set<string>& slot_made = made[slot.key()];
+        vector<string> names;
+        if (recipes.empty())
+        {
+            for (const auto& i: slot.channels)
+                if (!slot_made.count(i.first) && index.complete(slot, i.first))
+                {
+                    slot_made.insert(i.first);
+                    names.push_back(slot.name(i.first));
+                }
+        } else {
+            for (size_t r = 0; r < recipes.size(); ++r)
+            {
+                if (slot_made.count(recipes[r])) continue;
+                bool ready = true;
+                for (const auto& chan: recipe_needs[r])
+                    if (!index.complete(slot, chan))
+                    {
+                        ready = false;
+                        break;
+                    }
+                if (!ready) continue;
+                slot_made.insert(recipes[r]);
+                // Any channel can be used to name the timeslot
+                names.push_back(composite_name(recipes[r], slot.name(*recipe_needs[r].begin())));
             }
+        }
+
+        if (!convert) return;
+        for (const auto& name: names)
+        {
+            if (!quiet)
+                cerr << name << ": converting" << endl;
+            Job job(job_index++, name, false);
+            bool ok;
+            try {
+                ok = process(job);
+            } catch (std::exception& e) {
+                job.error = e.what();
+                ok = false;
+            }
+            // Keep running after failures: the next timeslot may be fine
+            if (!ok)
+                cerr << name << ": " << job.error << endl;
+        }
+    };
 
-            if (vds != dataset.get())
-                    GDALClose( (GDALDatasetH) vds );
+    // Index the files already in the directory, or all of them again after
+    // inotify lost events. Only the timeslots that complete while watching
+    // are converted
+    auto rescan = [&](bool convert) {
+        DIR* dir = opendir(watch_dir.c_str());
+        if (!dir)
+        {
+            cerr << watch_dir << ": cannot read directory: " << strerror(errno) << endl;
+            return false;
+        }
+        while (struct dirent* de = readdir(dir))
+            index.add(de->d_name);
+        closedir(dir);
+        for (const auto& i: index.slots)
+            update(i.second, convert);
+        return true;
+    };
+
+    if (!rescan(false))
+    {
+        close(fd);
+        return 1;
     }
-    return 0;
+
+    char buf[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)]
+        __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    while (true)
+    {
+        ssize_t len = read(fd, buf, sizeof(buf));
+        if (len < 0)
+        {
+            if (errno == EINTR) continue;
+            cerr << watch_dir << ": cannot read inotify events: " << strerror(errno) << endl;
+            close(fd);
+            return 1;
+        }
+
+        // Collect all the timeslots touched by this batch of events, to
+        // update each only once
+        std::set<string> touched;
+        bool overflow = false;
+        for (char* ptr = buf; ptr < buf + len; )
+        {
+            const struct inotify_event* ev = (const struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                overflow = true;
+                continue;
+            }
+            if (ev->len == 0) continue;
+            if (const msat::xrit::Slot* slot = index.add(ev->name))
+                touched.insert(slot->key());
+        }
+
+        if (overflow)
+            rescan(true);
+        else
+            for (const auto& key: touched)
+                update(index.slots[key], true);
+
+        // Only keep track of recent timeslots
+        index.expire(16);
+        for (auto i = made.begin(); i != made.end(); )
+            if (index.slots.find(i->first) == index.slots.end())
+                i = made.erase(i);
+            else
+                ++i;
+    }
+}
+#endif
+
+int Msat::main()
+{
+#ifdef HAVE_HRIT
+    if (!watch_dir.empty())
+        return run_watch();
+#endif
+    if (jobs <= 1 || input_files.size() <= 1)
+        return run_sequential();
+    return run_parallel();
 }
 
 int main( int argc, char* argv[] )
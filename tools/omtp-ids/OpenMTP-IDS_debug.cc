@@ -23,6 +23,7 @@
 // SYSTEM INCLUDES
 //
 #include <iostream>
+#include <stdexcept>
 #include <cstdlib>
 
 // PROJECT INCLUDES
@@ -59,8 +60,8 @@ main(int argc, char* argv[])
 	try {
 		OpenMTP_IDS openmtp(argv[1]);
 		openmtp.debug(std::cout);
-	} catch (const char* err) {
-		std::cout << argv[0] << ": " << err << std::endl;
+	} catch (std::exception& e) {
+		std::cout << argv[0] << ": " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
 
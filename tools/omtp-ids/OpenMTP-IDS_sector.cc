@@ -25,6 +25,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <iterator>
 #include <vector>
 #include <cmath>
@@ -171,8 +172,8 @@ main(int argc, char* argv[])
 	OpenMTP_IDS omtp_ids;
 	try {
 		omtp_ids = OpenMTP_IDS(argv[1]);
-	} catch (char* err) {
-		std::cout << argv[0] << ": " << err << std::endl;
+	} catch (std::exception& e) {
+		std::cout << argv[0] << ": " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
 
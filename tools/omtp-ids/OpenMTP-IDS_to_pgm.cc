@@ -23,6 +23,7 @@
 // SYSTEM INCLUDES
 //
 #include <iostream>
+#include <stdexcept>
 #include <fstream>
 #include <cstdlib>
 
@@ -188,8 +189,8 @@ main(int argc, char* argv[])
 	OpenMTP_IDS omtp_ids;
 	try {
 		omtp_ids = OpenMTP_IDS(argv[1]);
-	} catch (const char* err) {
-		std::cout << argv[0] << ": " << err << std::endl;
+	} catch (std::exception& e) {
+		std::cout << argv[0] << ": " << e.what() << std::endl;
 		return EXIT_FAILURE;
 	}
 
@@ -65,7 +65,11 @@ int main (int argc, char *argv[])
   if (argc > 5)
     image_overlay = strdup(argv[5]);
   
-  db1.open(argv[1]);
+  if (! db1.open(argv[1]))
+  {
+    std::cerr << "Exit: cannot read AoI and INFO.DBI in " << argv[1] << std::endl;
+    return -1;
+  }
   if (! db1.has_channel(argv[2]))
   {
     std::cerr << "Exit: this channel is not present." << std::endl;